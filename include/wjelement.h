@@ -132,7 +132,9 @@ typedef struct WJElementPublic
 
 	/*
 		A count of changes that have been performed on this element, which can
-		be reset by the consumer.
+		be reset by the consumer. A change to an element is counted by each of
+		its ancestors as well, and loading a document counts each element as a
+		change to its parent and ancestors.
 	*/
 	int								changes;
 
@@ -181,10 +183,34 @@ EXPORT WJElement	__WJEFromString(const char *json, char quote, const char *file,
 EXPORT char *		_WJEToString(WJElement document, XplBool pretty, const char *file, const int line);
 #define WJEToString( d, p ) _WJEToString( (d), (p), __FILE__, __LINE__)
 
-/* Read or write a WJElement to a file by path */
+/*
+	Write a document to a caller provided buffer of size bytes. TRUE is returned
+	if the entire document fit. If it did not then as much as would fit is in
+	the buffer, and *needed is set to the length of the document so that it can
+	be written again to a buffer of at least *needed + 1 bytes.
+*/
+EXPORT XplBool		WJEToBuffer(WJElement document, XplBool pretty, char *buffer, size_t size, size_t *needed);
+
+/*
+	Read or write a WJElement to a file by path
+
+	Where possible the file is memory mapped when it is read, and the document
+	is loaded straight from the mapping into a single arena, as with
+	WJEOpenDocumentArena(). The document is used and closed exactly as any
+	other document. Elements that are detached from it remain valid, but the
+	memory for the entire arena is only reclaimed once every element that was
+	allocated from it has been closed.
+*/
 EXPORT WJElement	WJEFromFile(const char *path);
 EXPORT XplBool		WJEToFile(WJElement document, XplBool pretty, const char *path);
 
+/*
+	Write a WJElement to a file by path, as with WJEToFile(), with any of the
+	WJW_FILE_* flags accepted by WJWOpenPathDocument(). WJW_FILE_ATOMIC and
+	WJW_FILE_SYNC together replace the file in a way that survives a crash.
+*/
+EXPORT XplBool		WJEToFileEx(WJElement document, XplBool pretty, const char *path, uint32 flags);
+
 /*
 	Load a WJElement object from the provided WJReader
 
@@ -196,6 +222,317 @@ typedef XplBool		(* WJELoadCB)(WJElement parent, char *path, void *data, const c
 EXPORT WJElement	_WJEOpenDocument(WJReader reader, char *where, WJELoadCB loadcb, void *data, const char *file, const int line);
 #define				WJEOpenDocument(r, w, lcb, d) _WJEOpenDocument((r), (w), (lcb), (d), __FILE__, __LINE__)
 
+/*
+	Load a WJElement object from the provided WJReader in the same way as
+	WJEOpenDocument(), but allocate every element, name and string from a
+	single arena which is free'd all at once.
+
+	The document is used and closed exactly as any other document. Elements
+	that are detached from it remain valid, but the memory for the entire arena
+	is only reclaimed once every element that was allocated from it has been
+	closed. Elements added to the document later are allocated from the same
+	arena.
+*/
+EXPORT WJElement	_WJEOpenDocumentArena(WJReader reader, char *where, WJELoadCB loadcb, void *data, const char *file, const int line);
+#define				WJEOpenDocumentArena(r, w, lcb, d) _WJEOpenDocumentArena((r), (w), (lcb), (d), __FILE__, __LINE__)
+
+/*
+	Load a WJElement object from the provided WJReader into an arena, as with
+	WJEOpenDocumentArena(), keeping a single copy of each distinct name in a
+	symbol table. Every element with the same name points at the same copy,
+	which saves a great deal of memory for a document that holds many records
+	with the same shape. Elements that are added to the document later share
+	names from the same table.
+
+	A table may be opened with WJEOpenSymbols() and shared by any number of
+	documents. If symbols is NULL then a table belonging to the document is
+	used. The flags may include:
+		WJE_SYMBOLS_VALUES
+			Also keep a single copy of each distinct short string value, both
+			when loading and when a value is set with WJEString().
+
+	A table is kept until it has been closed and every document that uses it
+	has been closed, so it may be closed as soon as the documents have been
+	loaded. Every distinct name and value is kept until then, so values should
+	only be interned when they come from a small set, such as status codes or
+	flags. A table, and the documents that use it, must only be used by one
+	thread at a time.
+
+	The names and values of a document that uses a table must not be modified
+	in place.
+*/
+typedef struct WJESymbols *		WJESymbols;
+
+#define WJE_SYMBOLS_VALUES		0x00000001
+
+EXPORT WJESymbols	WJEOpenSymbols(uint32 flags);
+EXPORT void			WJECloseSymbols(WJESymbols symbols);
+
+EXPORT WJElement	_WJEOpenDocumentInterned(WJReader reader, char *where, WJELoadCB loadcb, void *data, WJESymbols symbols, const char *file, const int line);
+#define				WJEOpenDocumentInterned(r, w, lcb, d, s) _WJEOpenDocumentInterned((r), (w), (lcb), (d), (s), __FILE__, __LINE__)
+
+/*
+	Load the next top level value from a stream of documents, such as a newline
+	delimited JSON log, so that any number of records can be read with a single
+	WJReader and buffer. The reader is switched into stream mode by the first
+	call.
+
+	FALSE is returned with errno set to 0 once the end of the stream has been
+	reached. Otherwise *doc is set to the record, which is NULL if the record
+	was rejected by the load callback.
+
+	If a record is malformed then FALSE is returned with errno set to EILSEQ,
+	and the rest of the line that the error was found on is skipped. Calling
+	WJENextDocument() again continues with the first record on the next line,
+	so a caller that wants to skip bad records can simply keep going:
+
+		for (;;) {
+			if (!WJENextDocument(reader, 0, NULL, NULL, &doc)) {
+				if (EILSEQ == errno) continue;
+				break;
+			}
+			...
+		}
+
+	If flags contains WJE_STREAM_ARENA then each record is allocated from an
+	arena of its own, as with WJEOpenDocumentArena(). As long as a record has
+	not been modified, WJECloseDocument() then frees the entire record at once
+	rather than closing each element in turn. The freecb of the root is still
+	called in that case, but those of the other elements are not.
+*/
+#define WJE_STREAM_ARENA	0x00000001
+
+EXPORT XplBool		_WJENextDocument(WJReader reader, uint32 flags, WJELoadCB loadcb, void *data, WJElement *doc, const char *file, const int line);
+#define				WJENextDocument(r, f, lcb, d, e) _WJENextDocument((r), (f), (lcb), (d), (e), __FILE__, __LINE__)
+
+/*
+	Load a newline delimited stream of documents on a pool of threads, handing
+	each record to the consumer callback as it is loaded. The records are
+	loaded in the same way as with WJENextDocument(), and the consumer owns each
+	record it is handed and must close it. The consumer may return FALSE to stop
+	loading, in which case no more records are delivered.
+
+	The input is split into chunks on newlines, so a record may not contain a
+	newline outside of a string, and records must not span more than one line.
+
+	If flags contains WJE_STREAM_ORDERED then the records are delivered in the
+	order they appear in the input, one at a time. Otherwise each record is
+	delivered by the thread that loaded it as soon as it has been loaded, so the
+	consumer may be called from any number of threads at once. The load
+	callback is always called from the loading threads.
+
+	A threads value of 0 uses one thread for each processor. The records are
+	loaded by the caller's thread if threads is 1 or threads are not available.
+
+	WJELoadParallelMem() uses the data in place. WJELoadParallelPath() maps the
+	file when possible, and otherwise reads it in the same way as
+	WJELoadParallel(), which reads the input with a WJReadCallback such as
+	WJRFileCallback() on the caller's thread.
+
+	A malformed record is skipped along with the rest of its line, as with
+	WJENextDocument(), and the records that follow it are still loaded. FALSE
+	is then returned with errno set to EILSEQ once loading is complete.
+
+	FALSE is returned if loading was stopped by the consumer or failed.
+*/
+#define WJE_STREAM_ORDERED	0x00000002
+
+typedef XplBool		(* WJERecordCB)(WJElement doc, void *data);
+
+EXPORT XplBool		_WJELoadParallel(WJReadCallback callback, void *userdata, int threads, uint32 flags, WJELoadCB loadcb, WJERecordCB cb, void *data, const char *file, const int line);
+#define				WJELoadParallel(rcb, u, t, f, lcb, cb, d) _WJELoadParallel((rcb), (u), (t), (f), (lcb), (cb), (d), __FILE__, __LINE__)
+EXPORT XplBool		_WJELoadParallelMem(const char *json, size_t length, int threads, uint32 flags, WJELoadCB loadcb, WJERecordCB cb, void *data, const char *file, const int line);
+#define				WJELoadParallelMem(j, l, t, f, lcb, cb, d) _WJELoadParallelMem((j), (l), (t), (f), (lcb), (cb), (d), __FILE__, __LINE__)
+EXPORT XplBool		_WJELoadParallelPath(const char *path, int threads, uint32 flags, WJELoadCB loadcb, WJERecordCB cb, void *data, const char *file, const int line);
+#define				WJELoadParallelPath(p, t, f, lcb, cb, d) _WJELoadParallelPath((p), (t), (f), (lcb), (cb), (d), __FILE__, __LINE__)
+
+/*
+	Load a document that consists of a single large array, such as an export of
+	millions of records, on several threads at once. The elements of the array
+	are found by a quick scan of the document, and are then parsed in batches
+	by a pool of threads and added to the array in order.
+
+	The result is the same as loading the document any other way. The data is
+	not modified, and nothing refers to it once the document has been loaded.
+	A document that is not an array, or is too small to be worth splitting, is
+	parsed on the calling thread. The load callback is called from the loading
+	threads, and must be thread safe.
+
+	A threads value of 0 uses one thread for each processor. The file is mapped
+	by WJEOpenArrayParallelPath() when possible.
+*/
+EXPORT WJElement	_WJEOpenArrayParallel(const char *json, size_t length, int threads, WJELoadCB loadcb, void *data, const char *file, const int line);
+#define				WJEOpenArrayParallel(j, l, t, lcb, d) _WJEOpenArrayParallel((j), (l), (t), (lcb), (d), __FILE__, __LINE__)
+EXPORT WJElement	_WJEOpenArrayParallelPath(const char *path, int threads, WJELoadCB loadcb, void *data, const char *file, const int line);
+#define				WJEOpenArrayParallelPath(p, t, lcb, d) _WJEOpenArrayParallelPath((p), (t), (lcb), (d), __FILE__, __LINE__)
+
+/*
+	Parse a JSON document that is already in memory in place, without using a
+	WJReader.
+
+	Names and strings are unescaped within the provided buffer, which must be
+	writable, and the elements of the document point directly into it. The
+	buffer must not be modified or free'd until the document, and any element
+	detached from it, has been closed. The elements are allocated from an arena
+	as with WJEOpenDocumentArena().
+
+	The buffer does not need to be terminated. NULL is returned if the document
+	is empty or can not be parsed.
+
+	Escape sequences are decoded exactly as a WJReader decodes them. A string
+	that ends in the middle of an escape sequence, such as "\u12", can not be
+	parsed, since a WJReader would read the rest of the sequence from past the
+	closing quote.
+*/
+EXPORT WJElement	_WJEOpenDocumentInSitu(char *json, size_t length, WJELoadCB loadcb, void *data, const char *file, const int line);
+#define				WJEOpenDocumentInSitu(j, l, lcb, d) _WJEOpenDocumentInSitu((j), (l), (lcb), (d), __FILE__, __LINE__)
+
+/*
+	Open a document that is already in memory lazily. Only the top level of the
+	document is parsed when it is opened. Each object or array below that is
+	only scanned to find the end of it, and its children are parsed the first
+	time they are needed, so a large document that is only partly used costs
+	little more than scanning through it.
+
+	Every WJE function parses the children of an element before it needs them,
+	but the child, last and count members of an element that has not been
+	materialized are empty. Code that walks the children directly must call
+	WJEMaterialize() first, which parses the children of the element, or of the
+	entire branch if recursive is set. FALSE is returned if they can not be
+	parsed, in which case the element is left empty and keeps failing to
+	materialize until it is given a new value, so a write, copy or hash that
+	reaches it fails too. Since the document is only checked as it is
+	materialized, a badly formed document may still be opened.
+
+	Materializing changes the document, so a lazy document must not be read by
+	more than one thread at a time. The buffer must not be modified or free'd
+	until the document, and any element detached from it, has been closed. The
+	file is mapped by WJEOpenDocumentLazyPath(), and unmapped when the document
+	is closed. If it can't be mapped then it is loaded as usual.
+*/
+EXPORT WJElement	_WJEOpenDocumentLazy(const char *json, size_t length, const char *file, const int line);
+#define				WJEOpenDocumentLazy(j, l) _WJEOpenDocumentLazy((j), (l), __FILE__, __LINE__)
+EXPORT WJElement	_WJEOpenDocumentLazyPath(const char *path, const char *file, const int line);
+#define				WJEOpenDocumentLazyPath(p) _WJEOpenDocumentLazyPath((p), __FILE__, __LINE__)
+EXPORT XplBool		WJEMaterialize(WJElement element, XplBool recursive);
+
+/*
+	Create a frozen copy of a document, which stores the entire document as a
+	single compact block in document order instead of as an element for each
+	value. The original document is left as it was, and may be closed.
+
+	A frozen document is used with the same functions as any other document.
+	The typed getters, such as WJEString() and WJEInt32(), read values straight
+	from the block, and so does WJEWriteDocument() when no callbacks are given.
+	Elements are only created for the parts of the document that are accessed
+	in other ways, such as with WJEGet(), in the same way that a lazy document
+	is materialized, and a frozen document may be modified once that has been
+	done. As with a lazy document, code that walks the children directly must
+	call WJEMaterialize() first, and a frozen document must not be read by more
+	than one thread at a time.
+
+	WJEOpenDocumentFrozen() loads a document from the provided WJReader and
+	returns a frozen copy of it. Only the frozen copy is kept.
+
+	Children of an object with no name are not included, and the writecb and
+	freecb of elements are not copied.
+
+	Since a frozen document is never modified in place, copies of it made with
+	WJECopyDocument() share it rather than copying it.
+*/
+EXPORT WJElement	_WJEFreeze(WJElement document, const char *file, const int line);
+#define				WJEFreeze(d) _WJEFreeze((d), __FILE__, __LINE__)
+EXPORT WJElement	_WJEOpenDocumentFrozen(WJReader reader, char *where, WJELoadCB loadcb, void *data, const char *file, const int line);
+#define				WJEOpenDocumentFrozen(r, w, lcb, d) _WJEOpenDocumentFrozen((r), (w), (lcb), (d), __FILE__, __LINE__)
+
+/*
+	Share a document that is read by many threads, such as a configuration, and
+	replace it with new versions while it is being read, without readers having
+	to take a lock.
+
+	WJEOpenSnapshot() takes ownership of a document, which becomes the first
+	version. Each reading thread opens a reader of its own with
+	WJEOpenSnapshotReader(). WJEReadSnapshot() returns the current version,
+	which stays valid until the same reader calls WJEReadSnapshot() or
+	WJEReleaseSnapshot() again, or is closed. It takes no locks, so it may be
+	called for every request.
+
+	A version must never be modified once it has been published, and it must
+	only be read with functions that do not modify it, such as WJEGet(), the
+	typed getters with WJE_GET, and WJEWriteDocument(). Any lazy or frozen
+	parts of it are materialized when it is published.
+
+	To change the document, the writer makes a copy of the current version with
+	WJECopySnapshot(), modifies the copy, and then publishes it with
+	WJEPublishSnapshot(), which takes ownership of it. Readers that are still
+	using the old version may keep using it. It is closed by the first call to
+	WJEPublishSnapshot() or WJEReclaimSnapshot() after every reader is done with
+	it. Writers do take a lock, so any number of threads may publish.
+
+	Every reader must be closed before the snapshot is closed, which also closes
+	the current version.
+*/
+typedef struct WJESnapshot *		WJESnapshot;
+typedef struct WJESnapshotReader *	WJESnapshotReader;
+
+EXPORT WJESnapshot	WJEOpenSnapshot(WJElement document);
+EXPORT XplBool		WJEPublishSnapshot(WJESnapshot snapshot, WJElement document);
+EXPORT void			WJEReclaimSnapshot(WJESnapshot snapshot);
+EXPORT WJElement	_WJECopySnapshot(WJESnapshot snapshot, const char *file, const int line);
+#define				WJECopySnapshot(s) _WJECopySnapshot((s), __FILE__, __LINE__)
+EXPORT void			WJECloseSnapshot(WJESnapshot snapshot);
+
+EXPORT WJESnapshotReader	WJEOpenSnapshotReader(WJESnapshot snapshot);
+EXPORT WJElement	WJEReadSnapshot(WJESnapshotReader reader);
+EXPORT void			WJEReleaseSnapshot(WJESnapshotReader reader);
+EXPORT void			WJECloseSnapshotReader(WJESnapshotReader reader);
+
+/*
+	Parse a JSON document as the data for it arrives, without blocking to wait
+	for more data the way a WJReader does.
+
+	Each piece of data is passed to WJEFeed() as it arrives, and the document
+	is built as it is parsed. WJEFeed() returns:
+		WJE_PUSH_MORE
+			All of the data has been used, and more is needed.
+
+		WJE_PUSH_AGAIN
+			The budget ran out before all of the data was used. WJEFeed() should
+			be called again with the rest of the data, starting *used bytes in.
+
+		WJE_PUSH_DONE
+			The document is complete. Anything after the first *used bytes is
+			not part of it.
+
+		WJE_PUSH_ERROR
+			The document can not be parsed.
+
+	If budget is not 0 then no more than budget bytes are parsed by a single
+	call, so that a large document can be parsed a piece at a time without
+	holding up anything else for too long.
+
+	A length of 0 indicates the end of the data, which is needed to complete a
+	document that consists of only a number.
+
+	WJEClosePushParser() returns the document if it is complete, or NULL if it
+	is not, and frees the parser. The load callback is used in the same way as
+	with WJEOpenDocument(), and the document is allocated from an arena as with
+	WJEOpenDocumentArena().
+*/
+typedef struct WJEPushParser *	WJEPushParser;
+
+typedef enum {
+	WJE_PUSH_ERROR	= -1,
+	WJE_PUSH_MORE	= 0,
+	WJE_PUSH_AGAIN,
+	WJE_PUSH_DONE
+} WJEPushStatus;
+
+EXPORT WJEPushParser	_WJEOpenPushParser(WJELoadCB loadcb, void *data, const char *file, const int line);
+#define					WJEOpenPushParser(lcb, d) _WJEOpenPushParser((lcb), (d), __FILE__, __LINE__)
+EXPORT WJEPushStatus	WJEFeed(WJEPushParser parser, const char *data, size_t length, size_t budget, size_t *used);
+EXPORT WJElement		WJEClosePushParser(WJEPushParser parser);
+
 /* Write a WJElement object to the provided WJWriter */
 typedef XplBool		(* WJEWriteCB)(WJElement node, WJWriter writer, void *data);
 EXPORT XplBool		_WJEWriteDocument(WJElement document, WJWriter writer, char *name,
@@ -205,7 +542,14 @@ EXPORT XplBool		_WJEWriteDocument(WJElement document, WJWriter writer, char *nam
 /* Write a WJElement object to the provided FILE* */
 EXPORT void			WJEWriteFILE(WJElement document, FILE* fd);
 
-/* Read a WJElement object from the provided FILE* */
+/*
+	Read a WJElement object from the provided FILE*, starting at the current
+	position. The FILE is left positioned at the end of the file.
+
+	A FILE for a regular file is memory mapped and loaded into an arena in the
+	same way as with WJEFromFile(), so the memory for the document is only
+	reclaimed once every element that was allocated from it has been closed.
+*/
 EXPORT WJElement	WJEReadFILE(FILE* fd);
 
 /* Destroy a WJElement object */
@@ -224,7 +568,19 @@ EXPORT XplBool		_WJECloseDocument(WJElement document, const char *file, const in
 #define				WJERemove(d, p) \
 					while ((WJECloseDocument(WJEGet((d), (p), NULL)))) { ; }
 
-/* Duplicate an existing WJElement */
+/*
+	Duplicate an existing WJElement
+
+	If no callback is provided then the parts of the original that are frozen
+	(see WJEFreeze()) are shared with the copy instead of being copied, and are
+	only copied along the path of a change to either of them. A copy of a large
+	frozen document costs the same as a copy of a small one, and only uses
+	memory for the parts of it that are changed.
+
+	Only values from a document that has been passed to WJEFreeze() are ever
+	shared. Anything else, including every part of a document that was never
+	frozen and every copy made with a callback, is copied in full.
+*/
 typedef XplBool		(* WJECopyCB)(WJElement destination, WJElement object, void *data, const char *file, const int line);
 EXPORT WJElement	_WJECopyDocument(WJElement to, WJElement from, WJECopyCB loadcb, void *data, const char *file, const int line);
 #define				WJECopyDocument(t, f, lcb, d) _WJECopyDocument((t), (f), (lcb), (d), __FILE__, __LINE__)
@@ -244,6 +600,17 @@ EXPORT XplBool		WJERename(WJElement document, const char *name);
 /* Merge all fields from one object to another */
 EXPORT XplBool		WJEMergeObjects(WJElement to, WJElement from, XplBool overwrite);
 
+/*
+	Stop counting changes on the calling thread, such as while building a large
+	document that will be treated as unmodified once it is complete, until a
+	matching call to WJEResumeChanges(). Calls may be nested.
+
+	A record read with WJE_STREAM_ARENA still notices that it has been modified
+	while changes are suspended, and is then closed one element at a time.
+*/
+EXPORT void			WJESuspendChanges(void);
+EXPORT void			WJEResumeChanges(void);
+
 /*
 	Find the first element within the hierarchy of a WJElement that matches the
 	specified path.
@@ -254,6 +621,55 @@ EXPORT XplBool		WJEMergeObjects(WJElement to, WJElement from, XplBool overwrite)
 EXPORT WJElement	_WJEGet(WJElement container, char *path, WJElement last, const char *file, const int line);
 #define WJEGet( c, p, l )	_WJEGet( (c), (p), (l), __FILE__, __LINE__ )
 
+/*
+	A path may be compiled once into a selector to be used many times, with
+	WJEGetCompiled() or any of the *Compiled variants of the functions below,
+	without needing to be parsed again.
+
+	Paths that are passed as strings are compiled on demand, and a path that is
+	used more than once is kept in a cache belonging to the calling thread, so
+	using a compiled selector directly only avoids the cost of finding the path
+	in that cache. The cache is free'd when the thread exits, or sooner by
+	calling WJEFreeSelectorCache().
+
+	A compiled selector may be used by any number of threads at once, and must
+	be free'd with WJEFreeSelector() once it is no longer needed.
+*/
+typedef struct WJECompiledSelector *	WJESelector;
+
+EXPORT WJESelector	WJECompileSelector(const char *path);
+EXPORT void			WJEFreeSelector(WJESelector selector);
+EXPORT void			WJEFreeSelectorCache(void);
+
+EXPORT WJElement	_WJEGetCompiled(WJElement container, WJESelector selector, WJElement last, const char *file, const int line);
+#define WJEGetCompiled( c, s, l )	_WJEGetCompiled( (c), (s), (l), __FILE__, __LINE__ )
+
+/*
+	A projection loads only the parts of a document that are matched by a set of
+	selectors, along with everything below those parts, and the elements that
+	lead to them.
+
+	Pass WJEProjectionLoadCB() as the load callback with the projection as the
+	data when loading a document, by any means. Anything that is not wanted is
+	skipped without being read, so loading a few values from a large document
+	costs little more than scanning through it.
+
+	The elements of an array before an offset that a selector asks for are
+	loaded without anything below them, so that a projected document can be
+	read with the same selectors that built it.
+
+	Conditions in the selectors are not applied while loading, and a negative
+	offset matches every element since the length of an array isn't known
+	until it has been read. The projection tracks the state of the document
+	being loaded, so it may only be used to load one document at a time.
+*/
+typedef struct WJEProjection *	WJEProjection;
+
+EXPORT WJEProjection	WJEOpenProjection(const char **selectors, int count);
+EXPORT void				WJECloseProjection(WJEProjection projection);
+EXPORT XplBool			WJEProjectionLoadCB(WJElement parent, char *name, void *data, const char *file, const int line);
+#define					WJEOpenDocumentProjected(r, w, p) _WJEOpenDocument((r), (w), WJEProjectionLoadCB, (p), __FILE__, __LINE__)
+
 typedef enum {
 	/*
 		Return the value of an element.  If the element does not exist then the
@@ -359,6 +775,49 @@ EXPORT int64		WJEInt64F(	WJElement container, WJEAction action, WJElement *last,
 EXPORT uint64		WJEUInt64F(	WJElement container, WJEAction action, WJElement *last, uint64 value,					const char *pathf, ...) XplFormatString(5, 6);
 EXPORT double		WJEDoubleF(	WJElement container, WJEAction action, WJElement *last, double value,					const char *pathf, ...) XplFormatString(5, 6);
 
+/*
+	The following functions are identical to the non Compiled variants except
+	that a selector compiled with WJECompileSelector() is used in place of the
+	path. For example:
+		WJESelector	sel = WJECompileSelector("foo.bar[0]");
+
+		val = WJEInt32Compiled(doc, sel, WJE_GET, 0);
+*/
+#define _WJEStringCompiled(	container, sel, action, last,	value)		__WJEStringCompiled(	(container), (sel), (action), (last),	(value),		__FILE__, __LINE__)
+#define  WJEStringCompiled(	container, sel, action,			value)		__WJEStringCompiled(	(container), (sel), (action), NULL,		(value),		__FILE__, __LINE__)
+#define _WJEStringNCompiled(container, sel, action, last,	value, len)	__WJEStringNCompiled(	(container), (sel), (action), (last),	(value), (len),	__FILE__, __LINE__)
+#define  WJEStringNCompiled(container, sel, action,			value, len)	__WJEStringNCompiled(	(container), (sel), (action), NULL,		(value), (len),	__FILE__, __LINE__)
+#define _WJEObjectCompiled(	container, sel, action, last)				__WJEObjectCompiled(	(container), (sel), (action), (last),					__FILE__, __LINE__)
+#define  WJEObjectCompiled(	container, sel, action)						__WJEObjectCompiled(	(container), (sel), (action), NULL,						__FILE__, __LINE__)
+#define _WJEBoolCompiled(	container, sel, action, last,	value)		__WJEBoolCompiled(		(container), (sel), (action), (last),	(value),		__FILE__, __LINE__)
+#define  WJEBoolCompiled(	container, sel, action,			value)		__WJEBoolCompiled(		(container), (sel), (action), NULL,		(value),		__FILE__, __LINE__)
+#define _WJEArrayCompiled(	container, sel, action, last)				__WJEArrayCompiled(		(container), (sel), (action), (last),					__FILE__, __LINE__)
+#define  WJEArrayCompiled(	container, sel, action)						__WJEArrayCompiled(		(container), (sel), (action), NULL,						__FILE__, __LINE__)
+#define _WJENullCompiled(	container, sel, action, last)				__WJENullCompiled(		(container), (sel), (action), (last),					__FILE__, __LINE__)
+#define  WJENullCompiled(	container, sel, action)						__WJENullCompiled(		(container), (sel), (action), NULL,						__FILE__, __LINE__)
+#define _WJEInt32Compiled(	container, sel, action, last,	value)		__WJEInt32Compiled(		(container), (sel), (action), (last),	(value),		__FILE__, __LINE__)
+#define  WJEInt32Compiled(	container, sel, action,			value)		__WJEInt32Compiled(		(container), (sel), (action), NULL,		(value),		__FILE__, __LINE__)
+#define _WJEUInt32Compiled(	container, sel, action, last,	value)		__WJEUInt32Compiled(	(container), (sel), (action), (last),	(value),		__FILE__, __LINE__)
+#define  WJEUInt32Compiled(	container, sel, action,			value)		__WJEUInt32Compiled(	(container), (sel), (action), NULL,		(value),		__FILE__, __LINE__)
+#define _WJEInt64Compiled(	container, sel, action, last,	value)		__WJEInt64Compiled(		(container), (sel), (action), (last),	(value),		__FILE__, __LINE__)
+#define  WJEInt64Compiled(	container, sel, action,			value)		__WJEInt64Compiled(		(container), (sel), (action), NULL,		(value),		__FILE__, __LINE__)
+#define _WJEUInt64Compiled(	container, sel, action, last,	value)		__WJEUInt64Compiled(	(container), (sel), (action), (last),	(value),		__FILE__, __LINE__)
+#define  WJEUInt64Compiled(	container, sel, action,			value)		__WJEUInt64Compiled(	(container), (sel), (action), NULL,		(value),		__FILE__, __LINE__)
+#define _WJEDoubleCompiled(	container, sel, action, last,	value)		__WJEDoubleCompiled(	(container), (sel), (action), (last),	(value),		__FILE__, __LINE__)
+#define  WJEDoubleCompiled(	container, sel, action,			value)		__WJEDoubleCompiled(	(container), (sel), (action), NULL,		(value),		__FILE__, __LINE__)
+
+EXPORT XplBool		__WJEBoolCompiled(		WJElement container, WJESelector selector, WJEAction action, WJElement *last, XplBool value,				const char *file, const int line);
+EXPORT char *		__WJEStringCompiled(	WJElement container, WJESelector selector, WJEAction action, WJElement *last, const char *value,			const char *file, const int line);
+EXPORT char *		__WJEStringNCompiled(	WJElement container, WJESelector selector, WJEAction action, WJElement *last, const char *value, size_t len,const char *file, const int line);
+EXPORT WJElement	__WJEObjectCompiled(	WJElement container, WJESelector selector, WJEAction action, WJElement *last,								const char *file, const int line);
+EXPORT WJElement	__WJEArrayCompiled(		WJElement container, WJESelector selector, WJEAction action, WJElement *last,								const char *file, const int line);
+EXPORT WJElement	__WJENullCompiled(		WJElement container, WJESelector selector, WJEAction action, WJElement *last,								const char *file, const int line);
+EXPORT int32		__WJEInt32Compiled(		WJElement container, WJESelector selector, WJEAction action, WJElement *last, int32 value,					const char *file, const int line);
+EXPORT uint32		__WJEUInt32Compiled(	WJElement container, WJESelector selector, WJEAction action, WJElement *last, uint32 value,					const char *file, const int line);
+EXPORT int64		__WJEInt64Compiled(		WJElement container, WJESelector selector, WJEAction action, WJElement *last, int64 value,					const char *file, const int line);
+EXPORT uint64		__WJEUInt64Compiled(	WJElement container, WJESelector selector, WJEAction action, WJElement *last, uint64 value,					const char *file, const int line);
+EXPORT double		__WJEDoubleCompiled(	WJElement container, WJESelector selector, WJEAction action, WJElement *last, double value,					const char *file, const int line);
+
 
 
 /*
@@ -382,11 +841,16 @@ EXPORT WJElement _WJEChild(WJElement container, char *name, WJEAction action, co
 */
 EXPORT WJElement _WJEAny(WJElement container, char *path, WJEAction action, WJElement last, const char *file, const int line);
 #define WJEAny(c, p, a, l) _WJEAny((c), (p), (a), (l), __FILE__, __LINE__)
+EXPORT WJElement _WJEAnyCompiled(WJElement container, WJESelector selector, WJEAction action, WJElement last, const char *file, const int line);
+#define WJEAnyCompiled(c, s, a, l) _WJEAnyCompiled((c), (s), (a), (l), __FILE__, __LINE__)
 
 
-/* Calculate a hash for a document */
+/*
+	Calculate a hash for a document. FALSE is returned if part of the document
+	couldn't be read, in which case the hash is incomplete.
+*/
 typedef int (* WJEHashCB)(void *context, void *data, size_t size);
-EXPORT void WJEHash(WJElement document, WJEHashCB update, void *context);
+EXPORT XplBool WJEHash(WJElement document, WJEHashCB update, void *context);
 
 /* WJElement Schema-related stuff */
 /*
@@ -39,6 +39,28 @@ typedef struct {
 	uint32					depth;
 	uint32					maxdepth;
 	void					*userdata;
+
+	/*
+		If set to TRUE then the document may contain any number of values at
+		the top level, such as a newline delimited JSON log, which may be
+		separated by whitespace, commas or nothing at all. Each call to
+		WJRNext() with a NULL parent returns the next value, until the end of
+		the data is reached.
+	*/
+	XplBool					stream;
+
+	/*
+		If set then the buffer is allowed to grow, up to this size, instead of
+		truncating a name that doesn't fit, or failing when the names of the
+		current element and its parents don't fit. Growing doubles the size of
+		the buffer, so the cost of reading a very long name is still
+		proportional to its length. A long string value is still returned in
+		pieces by WJRString(), since it never needs to fit all at once.
+
+		Pointers that were returned by WJRNext() remain valid when the buffer
+		grows. Use (size_t) -1 to allow the buffer to grow without a limit.
+	*/
+	size_t					maxbuffersize;
 } WJReaderPublic;
 typedef WJReaderPublic *	WJReader;
 
@@ -60,13 +82,37 @@ typedef size_t				(* WJReadCallback)(char *data, size_t length, size_t seen, voi
 	If a buffersize of 0 is passed to WJROpenDocument then the default size will
 	be used (4KB).  Some data is kept in the buffer while parsing, such as
 	element names and values.  If the buffer is not large enough for these then
-	the document will fail to be parsed and will be aborted.
+	the document will fail to be parsed and will be aborted, unless the buffer
+	is allowed to grow by setting maxbuffersize.
 */
 EXPORT WJReader				_WJROpenDocument(WJReadCallback callback, void *userdata, char *buffer, size_t buffersize, uint32 maxdepth);
 #define WJROpenDocument(c, u, b, s) \
 							_WJROpenDocument((c), (u), (b), (s), 250)
 EXPORT XplBool				WJRCloseDocument(WJReader doc);
 
+/*
+	Finish with the current document as WJRCloseDocument() would, and prepare
+	the same reader to read a new document with the given callback, without
+	allocating anything. The maxdepth, stream and maxbuffersize settings are
+	kept. If the buffer had grown then the largest buffer is kept as well.
+
+	Any pointers that were returned for the previous document are no longer
+	valid once the reader has been reset.
+*/
+EXPORT XplBool				WJRResetDocument(WJReader doc, WJReadCallback callback, void *userdata);
+
+/*
+	Open a JSON document with a reader taken from a pool that belongs to the
+	calling thread, as WJROpenDocument() with the default buffer size would.
+	A new reader is only allocated when the pool is empty.
+
+	The document must be closed with WJRCloseDocument() as usual, which returns
+	the reader to the pool of the thread that closes it. A thread that uses
+	pooled readers should call WJRFreePool() before exiting to free its pool.
+*/
+EXPORT WJReader				WJROpenPooledDocument(WJReadCallback callback, void *userdata);
+EXPORT void					WJRFreePool(void);
+
 /*
 	Return a string, which contains the name of the next element of the
 	specified parent, prefixed by a single character that represents the type.
@@ -97,6 +143,27 @@ typedef enum {
 
 EXPORT char *				WJRNext(char *parent, size_t maxnamelen, WJReader doc);
 
+/*
+	Skip past the rest of the object or array that was just returned by
+	WJRNext(), without reading any of its children. The contents are only
+	scanned for the matching closing bracket, so names and strings are not
+	unescaped and numbers are not parsed, which is much faster than reading
+	past each child.
+
+	FALSE is returned if value is not an object or array, or is not the value
+	that was most recently returned by WJRNext(). Any other value is cheap to
+	read past anyway.
+*/
+EXPORT XplBool				WJRSkip(char *value, WJReader doc);
+
+/*
+	Throw away the rest of the current line of a stream, such as after a value
+	that couldn't be parsed, and start over at the top level so that the next
+	call to WJRNext() with a NULL parent returns the first value on the next
+	line. FALSE is returned if there are no more lines.
+*/
+EXPORT XplBool				WJRSkipLine(WJReader doc);
+
 /*
 	Return the value of the last object returned by WJRNext().	The calling
 	application is expected to know the type of the value, and call the
@@ -135,6 +202,23 @@ EXPORT XplBool				WJRIntOrDouble(WJReader doc, uint64 *i, double *d);
 */
 EXPORT XplBool				WJRNegative(WJReader doc);
 
+/*
+	Parse the number at str, without reading at or beyond end. The result is
+	correctly rounded and does not depend on the current locale. A leading '-'
+	is not accepted, since the sign is tracked separately (see WJRNegative()).
+
+	If the number has a fraction or an exponent then *hasDecimalPoint is set to
+	TRUE, *d is set to the value and *i to the value truncated. Otherwise *i is
+	set to the value (limited to the range of a uint64) and *d to the nearest
+	double.
+
+	Hex and octal values are accepted, as strtoll() would.
+
+	A pointer to the first character following the number is returned, which
+	will be str if there is no number there.
+*/
+EXPORT char *				WJRParseNumber(const char *str, const char *end, XplBool *hasDecimalPoint, uint64 *i, double *d);
+
 
 /*
 	An alternative method of opening a JSON document, which will provide a
@@ -158,6 +242,26 @@ EXPORT size_t				WJRMemCallback(char *buffer, size_t length, size_t seen, void *
 #define WJROpenMemDocument(json, buffer, buffersize) \
 							WJROpenDocument(WJRMemCallback, (json), (buffer), (buffersize))
 
+/*
+	An alternative method of opening a JSON document by path. The file is memory
+	mapped when possible and the buffer is filled from the mapping instead of
+	through stdio. If the file can not be mapped then it is read in the same way
+	as WJROpenFILEDocument().
+
+	This only changes where the buffer is filled from. The data is still copied
+	from the mapping into the reader's buffer, and the buffer is refilled in the
+	same way as for any other source, since the reader modifies the buffer as
+	it parses. To parse a file without copying it into a buffer, use
+	WJEFromFile() or WJEOpenDocumentLazyPath() instead.
+
+	The file is closed by WJRCloseDocument(), which does not read the remainder
+	of the document. A buffersize of 0 will use a default buffer size that is
+	larger than the one used by WJROpenDocument().
+*/
+EXPORT WJReader				_WJROpenPathDocument(const char *path, char *buffer, size_t buffersize, uint32 maxdepth);
+#define WJROpenPathDocument(path, buffer, buffersize) \
+							_WJROpenPathDocument((path), (buffer), (buffersize), 250)
+
 #ifdef __cplusplus
 }
 #endif
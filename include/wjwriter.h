@@ -64,6 +64,16 @@ typedef struct {
 		void			*data;
 		void			(* freecb)(void *data);
 	} user;
+
+	/*
+		A printf style format (ie "%e") to use when writing a double. If NULL
+		(the default) then the shortest representation that reads back as
+		exactly the same value is written instead.
+
+		Older versions always used "%e", and the default may be changed back to
+		that at build time by defining WJW_LEGACY_DOUBLE_FORMAT.
+	*/
+	char				*doubleFormat;
 } WJWriterPublic;
 typedef WJWriterPublic*	WJWriter;
 
@@ -78,6 +88,31 @@ typedef WJWriterPublic*	WJWriter;
 EXPORT WJWriter			_WJWOpenDocument(XplBool pretty, WJWriteCallback callback, void *writedata, size_t buffersize);
 EXPORT XplBool			WJWCloseDocument(WJWriter doc);
 
+/*
+	Finish the current document as WJWCloseDocument() would, and prepare the
+	same writer to write a new document with the given callback, without
+	allocating anything. The result of finishing the previous document is
+	returned.
+
+	The pretty, base, escapeInvalidChars and doubleFormat settings are kept,
+	as is the size of the write buffer. Anything that was set up by one of the
+	helper open functions, such as the memory or file to write to, is finished
+	and not used again.
+*/
+EXPORT XplBool			WJWResetDocument(WJWriter doc, WJWriteCallback callback, void *writedata);
+
+/*
+	Open a stream with a writer taken from a pool that belongs to the calling
+	thread, as WJWOpenDocument() would. A new writer is only allocated when the
+	pool is empty.
+
+	The document must be closed with WJWCloseDocument() as usual, which returns
+	the writer to the pool of the thread that closes it. A thread that uses
+	pooled writers should call WJWFreePool() before exiting to free its pool.
+*/
+EXPORT WJWriter			WJWOpenPooledDocument(XplBool pretty, WJWriteCallback callback, void *writedata);
+EXPORT void				WJWFreePool(void);
+
 /*
 	Open an array.	All objects that are direct children of the array MUST NOT
 	be named.  A value of NULL should be passed as name for any such values.
@@ -115,6 +150,18 @@ EXPORT XplBool			WJWInt64(char *name, int64 value, WJWriter doc);
 EXPORT XplBool			WJWUInt64(char *name, uint64 value, WJWriter doc);
 EXPORT XplBool			WJWDouble(char *name, double value, WJWriter doc);
 
+/*
+	Format a double as the shortest JSON number that reads back as exactly the
+	same value. A number that has no fraction is still written with one (ie
+	1.0) so that it is read as a double.
+
+	The buffer must be at least WJW_DOUBLE_SIZE bytes. The length of the result
+	is returned, or 0 if the value is NaN or infinite since JSON can't
+	represent those.
+*/
+#define WJW_DOUBLE_SIZE			32
+EXPORT size_t			WJWFormatDouble(double value, char *buffer);
+
 /*
 	Write a raw pre-formatted value to the document.  It is up to the caller to
 	ensure that the data is properly formatted and complete.
@@ -124,15 +171,74 @@ EXPORT XplBool			WJWRawValue(char *name, char *value, XplBool done, WJWriter doc
 /*
 	An alternative method of opening a JSON document for writing, which will
 	provide a proper callback for writing the data to an open FILE *.
+
+	WJWOpenFILEDocumentEx() uses a buffer of the given size instead of the
+	default, such as WJW_FILE_BUFFER_SIZE to write a large document in fewer,
+	larger blocks.
 */
 EXPORT size_t			WJWFileCallback(char *buffer, size_t length, void *data);
 #define WJWOpenFILEDocument(pretty, file) _WJWOpenDocument((pretty), WJWFileCallback, (file), 0)
+#define WJWOpenFILEDocumentEx(pretty, file, buffersize) \
+							_WJWOpenDocument((pretty), WJWFileCallback, (file), (buffersize))
+
+/*
+	Open a JSON document that is written directly to a file descriptor, or to a
+	file by path, in large blocks without going through stdio.
+
+	WJWOpenFDDocument() does not close the descriptor. WJWOpenPathDocument()
+	creates or truncates the file, and closes it when the document is closed.
+
+	The following flags may be used:
+		WJW_FILE_SYNC
+			Flush the data to disk before the document is closed. Any failure
+			causes WJWCloseDocument() to return FALSE.
+
+		WJW_FILE_ATOMIC
+			Write the document to a temporary file in the same directory and
+			rename it over path when the document is closed, so that readers
+			only ever see the old or the complete new file. The temporary file
+			is removed if anything fails. This is ignored by WJWOpenFDDocument().
+
+			Combine with WJW_FILE_SYNC for a write that survives a crash.
+
+		WJW_FILE_PREALLOCATE
+			Allocate size bytes of disk space for the file up front, where the
+			platform supports it. Any space that isn't used is released when
+			the document is closed.
+
+	Both return NULL with errno set to ENOSYS on platforms that aren't
+	supported, in which case WJWOpenFILEDocument() should be used instead.
+*/
+#define WJW_FILE_BUFFER_SIZE	(256 * 1024)
+
+#define WJW_FILE_SYNC			0x01
+#define WJW_FILE_ATOMIC			0x02
+#define WJW_FILE_PREALLOCATE	0x04
+
+EXPORT WJWriter			WJWOpenFDDocument(XplBool pretty, int fd, uint32 flags);
+EXPORT WJWriter			WJWOpenPathDocument(XplBool pretty, const char *path, uint32 flags, uint64 size);
 
 /*
 	An alternative method of opening a JSON document for writing, which will
 	provide a proper callback for allocating and writing to a memory allocation.
+
+	If *mem is not NULL then the document is appended to the string it points
+	to. The allocation grows as needed and *mem is always a terminated string.
+
+	WJWOpenMemDocumentEx() reserves room for size bytes up front, which saves
+	growing the allocation when the size of the document can be estimated.
 */
 EXPORT WJWriter			WJWOpenMemDocument(XplBool pretty, char **mem);
+EXPORT WJWriter			WJWOpenMemDocumentEx(XplBool pretty, char **mem, size_t size);
+
+/*
+	Open a JSON document that is written to a caller provided buffer of size
+	bytes. Anything that doesn't fit is discarded, but the buffer is always
+	terminated, and *needed is set to the full length of the document (not
+	including the terminator) so that the caller can retry with a larger
+	buffer if needed is not less than size.
+*/
+EXPORT WJWriter			WJWOpenBufferDocument(XplBool pretty, char *buffer, size_t size, size_t *needed);
 
 #ifdef __cplusplus
 }
@@ -222,4 +222,29 @@ EXPORT char * strspace( char *source );
 EXPORT char * strndup(char* p, size_t maxlen);
 #endif
 
+
+/* xplfile.h */
+
+/*
+	Map a file into memory, read only, from the specified offset to the end of
+	the file. The kernel is advised that the mapping will be read sequentially.
+
+	FALSE is returned if the file can not be mapped, including when it is empty,
+	is not a regular file, or mapping files is not supported on this platform.
+	The caller is expected to fall back to reading the file normally.
+*/
+typedef struct {
+	/* The data, starting at the requested offset */
+	char		*data;
+	size_t		length;
+
+	/* The actual mapping, which starts on a page boundary */
+	void		*base;
+	size_t		size;
+} XplFileMap;
+
+EXPORT XplBool XplFileMapOpen(XplFileMap *map, int fd, uint64 offset);
+EXPORT XplBool XplFileMapOpenPath(XplFileMap *map, const char *path);
+EXPORT void XplFileMapClose(XplFileMap *map);
+
 #endif
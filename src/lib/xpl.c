@@ -23,6 +23,13 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "memmgr.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 #ifndef asprintf
 EXPORT int asprintf(char **ret, const char *format, ...) {
 	va_list ap;
@@ -346,3 +353,82 @@ EXPORT void * MemMallocEx(void *ptr, size_t size, size_t *actual, XplBool wait,
 	return(result);
 }
 
+EXPORT XplBool XplFileMapOpen(XplFileMap *map, int fd, uint64 offset)
+{
+#ifndef _WIN32
+	struct stat		st;
+	long			pagesize;
+	uint64			start;
+
+	if (!map) {
+		return(FALSE);
+	}
+	memset(map, 0, sizeof(XplFileMap));
+
+	if (fd < 0 || fstat(fd, &st) || !S_ISREG(st.st_mode) ||
+		(uint64) st.st_size <= offset || (uint64) st.st_size != (size_t) st.st_size
+	) {
+		return(FALSE);
+	}
+
+	/* The mapping itself must start on a page boundary */
+	if ((pagesize = sysconf(_SC_PAGESIZE)) <= 0) {
+		pagesize = 4096;
+	}
+	start = offset - (offset % pagesize);
+
+	map->size = st.st_size - start;
+	if (MAP_FAILED == (map->base = mmap(NULL, map->size, PROT_READ, MAP_PRIVATE, fd, start))) {
+		memset(map, 0, sizeof(XplFileMap));
+		return(FALSE);
+	}
+
+#ifdef MADV_SEQUENTIAL
+	madvise(map->base, map->size, MADV_SEQUENTIAL);
+#endif
+
+	map->data	= (char *) map->base + (offset - start);
+	map->length	= st.st_size - offset;
+
+	return(TRUE);
+#else
+	if (map) {
+		memset(map, 0, sizeof(XplFileMap));
+	}
+
+	return(FALSE);
+#endif
+}
+
+EXPORT XplBool XplFileMapOpenPath(XplFileMap *map, const char *path)
+{
+#ifndef _WIN32
+	XplBool		result;
+	int			fd;
+
+	if (!path || (fd = open(path, O_RDONLY)) < 0) {
+		return(FALSE);
+	}
+
+	/* The mapping remains valid once the file is closed */
+	result = XplFileMapOpen(map, fd, 0);
+	close(fd);
+
+	return(result);
+#else
+	return(XplFileMapOpen(map, -1, 0));
+#endif
+}
+
+EXPORT void XplFileMapClose(XplFileMap *map)
+{
+#ifndef _WIN32
+	if (map && map->base) {
+		munmap(map->base, map->size);
+	}
+#endif
+
+	if (map) {
+		memset(map, 0, sizeof(XplFileMap));
+	}
+}
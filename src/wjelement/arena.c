@@ -0,0 +1,310 @@
+/*
+    This file is part of WJElement.
+
+    WJElement is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation.
+
+    WJElement is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with WJElement.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "element.h"
+
+/*
+	Document arenas
+
+	An arena hands out memory for elements, names and strings by bumping a
+	pointer through large chunks. Nothing allocated from an arena is ever free'd
+	individually. Instead the arena keeps a count of the live elements that
+	were allocated from it, and all of the chunks are free'd at once when the
+	last of those elements is closed.
+
+	This means that an element that is detached from an arena document keeps
+	the entire arena alive until it is closed as well.
+*/
+
+#define WJE_ARENA_ALIGN			8
+#define WJE_ARENA_MIN_CHUNK		(16 * 1024)
+#define WJE_ARENA_MAX_CHUNK		(1024 * 1024)
+
+typedef struct WJEArenaChunk {
+	struct WJEArenaChunk	*next;
+
+	size_t					size;
+	size_t					used;
+
+	/* Force the alignment of the data */
+	union {
+		uint64				i;
+		double				d;
+		void				*p;
+	} data[];
+} WJEArenaChunk;
+
+struct WJEArena {
+	/* The chunk that is currently being allocated from is always first */
+	WJEArenaChunk			*chunks;
+
+	/* The size that will be used for the next chunk */
+	size_t					chunksize;
+
+	/* The number of live elements that have been allocated from the arena */
+	size_t					elements;
+
+	/*
+		The document that the arena holds, if it may be free'd all at once, and
+		whether anything allocated from the arena has been changed since it was
+		loaded.
+	*/
+	WJElement				record;
+	XplBool					dirty;
+
+	/* The source that elements in the arena still refer to, if it is owned */
+	void					*source;
+	void					(* freesource)(void *source);
+
+	/* The symbol table that names and values are shared from, if any */
+	WJESymbols				symbols;
+
+	/* Another arena that elements in this one refer to memory in, if any */
+	WJEArena				*shared;
+};
+
+WJEArena * WJEArenaNew(void)
+{
+	return(WJEArenaNewEx(WJE_ARENA_MIN_CHUNK));
+}
+
+/*
+	Create an arena that starts with chunks of the specified size, for a
+	document that is expected to need less than the default.
+*/
+WJEArena * WJEArenaNewEx(size_t chunksize)
+{
+	WJEArena	*arena;
+
+	if ((arena = MemMalloc(sizeof(WJEArena)))) {
+		memset(arena, 0, sizeof(WJEArena));
+		arena->chunksize = chunksize ? chunksize : WJE_ARENA_MIN_CHUNK;
+	}
+
+	return(arena);
+}
+
+static WJEArenaChunk * WJEArenaChunkNew(size_t size)
+{
+	WJEArenaChunk	*chunk;
+
+	if ((chunk = MemMalloc(sizeof(WJEArenaChunk) + size))) {
+		chunk->next = NULL;
+		chunk->size = size;
+		chunk->used = 0;
+	}
+
+	return(chunk);
+}
+
+void * WJEArenaAlloc(WJEArena *arena, size_t size)
+{
+	WJEArenaChunk	*chunk;
+	char			*result;
+
+	if (!arena) {
+		return(NULL);
+	}
+
+	size = (size + (WJE_ARENA_ALIGN - 1)) & ~((size_t) WJE_ARENA_ALIGN - 1);
+
+	if ((chunk = arena->chunks) && chunk->size - chunk->used >= size) {
+		result = ((char *) chunk->data) + chunk->used;
+		chunk->used += size;
+
+		return(result);
+	}
+
+	if (size > arena->chunksize / 4) {
+		/*
+			Give a large allocation a chunk of its own, and keep allocating
+			from the current chunk.
+		*/
+		if (!(chunk = WJEArenaChunkNew(size))) {
+			return(NULL);
+		}
+
+		if (arena->chunks) {
+			chunk->next = arena->chunks->next;
+			arena->chunks->next = chunk;
+		} else {
+			arena->chunks = chunk;
+		}
+	} else {
+		if (!(chunk = WJEArenaChunkNew(arena->chunksize))) {
+			return(NULL);
+		}
+
+		chunk->next = arena->chunks;
+		arena->chunks = chunk;
+
+		if (arena->chunksize < WJE_ARENA_MAX_CHUNK) {
+			arena->chunksize *= 2;
+		}
+	}
+
+	chunk->used = size;
+	return(chunk->data);
+}
+
+char * WJEArenaStrndup(WJEArena *arena, const char *value, size_t len)
+{
+	char		*result;
+
+	if ((result = WJEArenaAlloc(arena, len + 1))) {
+		memcpy(result, value, len);
+		result[len] = '\0';
+	}
+
+	return(result);
+}
+
+void WJEArenaRetain(WJEArena *arena)
+{
+	if (arena) {
+		arena->elements++;
+	}
+}
+
+/*
+	Give the arena ownership of the source that a document was loaded from, for
+	a document that refers back to it, such as a lazy document. The source is
+	free'd along with the arena.
+*/
+void WJEArenaSource(WJEArena *arena, void *source, void (* freesource)(void *source))
+{
+	if (arena) {
+		arena->source		= source;
+		arena->freesource	= freesource;
+	}
+}
+
+/*
+	Share names, and possibly short string values, of the elements allocated
+	from the arena from a symbol table. The arena holds a reference to the
+	table until it is free'd.
+*/
+void WJEArenaSymbols(WJEArena *arena, WJESymbols symbols)
+{
+	if (arena) {
+		WJESymbolsRetain(symbols);
+		WJESymbolsRelease(arena->symbols);
+		arena->symbols = symbols;
+	}
+}
+
+/*
+	Return the copy of value from the arena's symbol table, or NULL if the
+	arena doesn't have one or the table doesn't intern this value.
+*/
+char * WJEArenaIntern(WJEArena *arena, const char *value, size_t len, XplBool isvalue)
+{
+	if (!arena || !arena->symbols) {
+		return(NULL);
+	}
+
+	return(WJESymbolsIntern(arena->symbols, value, len, isvalue));
+}
+
+/*
+	Keep another arena alive for as long as this one, because elements in this
+	arena refer to memory that belongs to it, such as the tape of a frozen
+	document. An arena can only refer to one other arena, so FALSE is returned
+	if it already refers to a different one.
+*/
+XplBool WJEArenaShare(WJEArena *arena, WJEArena *shared)
+{
+	if (!arena || !shared || (arena->shared && arena->shared != shared)) {
+		return(FALSE);
+	}
+
+	if (!arena->shared) {
+		WJEArenaRetain(shared);
+		arena->shared = shared;
+	}
+
+	return(TRUE);
+}
+
+static void WJEArenaFree(WJEArena *arena)
+{
+	WJEArenaChunk	*chunk;
+
+	if (arena->freesource) {
+		arena->freesource(arena->source);
+	}
+	WJESymbolsRelease(arena->symbols);
+	WJEArenaRelease(arena->shared);
+
+	while ((chunk = arena->chunks)) {
+		arena->chunks = chunk->next;
+		MemFree(chunk);
+	}
+
+	MemFree(arena);
+}
+
+void WJEArenaRelease(WJEArena *arena)
+{
+	if (!arena || --arena->elements) {
+		return;
+	}
+
+	WJEArenaFree(arena);
+}
+
+/*
+	Records
+
+	An arena that was created to hold a single document, such as a record read
+	from a stream, can be free'd all at once when that document is closed
+	instead of closing each element in it one at a time.
+
+	This is only safe if every element allocated from the arena is still part
+	of the document, and none of them own any memory of their own. That is true
+	of a document that has just been loaded, since the loader allocates
+	everything from the arena, and any change to the document that could make
+	it untrue (modifying, adding, renaming or detaching an element) marks the
+	arena as dirty with WJEArenaChanged().
+
+	The changes counters can't be used for this, since the consumer may reset
+	them or suspend counting.
+*/
+void WJEArenaRecord(WJEArena *arena, WJElement document)
+{
+	if (arena && document) {
+		arena->record	= document;
+		arena->dirty	= FALSE;
+	}
+}
+
+void WJEArenaChanged(WJEArena *arena)
+{
+	if (arena) {
+		arena->dirty = TRUE;
+	}
+}
+
+XplBool WJEArenaCloseRecord(WJEArena *arena, WJElement document)
+{
+	if (!arena || !document || arena->record != document || arena->dirty) {
+		return(FALSE);
+	}
+
+	WJEArenaFree(arena);
+	return(TRUE);
+}
@@ -17,20 +17,92 @@
 #include "element.h"
 #include <time.h>
 
+/*
+	The number of times WJESuspendChanges() has been called on this thread
+	without a matching call to WJEResumeChanges().
+*/
+static WJE_THREAD_LOCAL int WJEChangesSuspended = 0;
+
+EXPORT void WJESuspendChanges(void)
+{
+	WJEChangesSuspended++;
+}
+
+EXPORT void WJEResumeChanges(void)
+{
+	if (WJEChangesSuspended > 0) {
+		WJEChangesSuspended--;
+	}
+}
+
 void WJEChanged(WJElement element)
 {
+	/* Even while changes are suspended a record can no longer be free'd at once */
+	if (element) {
+		WJEArenaChanged(((_WJElement *) element)->arena);
+	}
+
+	if (WJEChangesSuspended) {
+		return;
+	}
+
 	for (; element; element = element->parent) {
 		element->changes++;
 	}
 }
 
+/*
+	Count a complete child that was created with WJE_FLAG_UNCOUNTED as a change
+	to its parent, along with every change that has been counted below it.
+
+	The loaders build each child completely before counting it, so that loading
+	a document doesn't walk up to the root for every element in it, and the
+	result is the same as if each element had been counted as it was created.
+	Only the parent is updated unless ancestors is set, because a parent that
+	is still being loaded is counted by its own parent once it is complete.
+*/
+void WJECountChild(WJElement child, XplBool ancestors)
+{
+	WJElement	parent;
+	int			changes;
+
+	if (WJEChangesSuspended || !child || !(parent = child->parent)) {
+		return;
+	}
+
+	changes = child->changes + 1;
+	do {
+		parent->changes += changes;
+	} while (ancestors && (parent = parent->parent));
+}
+
 _WJElement * _WJENew(_WJElement *parent, char *name, size_t len, const char *file, int line)
+{
+	return(_WJENewEx(parent, parent ? parent->arena : NULL, name, len, 0, file, line));
+}
+
+/*
+	Create a new element, allocated from the provided arena if there is one.
+	Children of an arena element are normally allocated from the same arena.
+
+	If flags contains WJE_FLAG_NAME_BORROWED then the name is not copied, and
+	must already be terminated at len and remain valid for the life of the new
+	element. If the arena has a symbol table then the name is shared from it.
+
+	If flags contains WJE_FLAG_UNCOUNTED then the new element is not counted as
+	a change to the parent, and the caller must call WJECountChild() once it is
+	complete.
+*/
+_WJElement * _WJENewEx(_WJElement *parent, WJEArena *arena, char *name, size_t len, uint32 flags, const char *file, int line)
 {
 	_WJElement	*result;
 	WJElement	prev;
+	char		*symbol;
 
 	if (parent) {
-		_WJEChanged((WJElement) parent);
+		if (!(flags & WJE_FLAG_UNCOUNTED)) {
+			_WJEChanged((WJElement) parent);
+		}
 
 		if (WJR_TYPE_ARRAY == parent->pub.type) {
 			/* Children of an array can not have a name */
@@ -45,16 +117,43 @@ _WJElement * _WJENew(_WJElement *parent, char *name, size_t len, const char *fil
 		}
 	}
 
-	if ((result = MemMalloc(sizeof(_WJElement) + len + 1))) {
+	if (!name) {
+		flags &= ~WJE_FLAG_NAME_BORROWED;
+	} else if (!(flags & WJE_FLAG_NAME_BORROWED) &&
+		(symbol = WJEArenaIntern(arena, name, len, FALSE))
+	) {
+		name	= symbol;
+		flags	|= WJE_FLAG_NAME_BORROWED;
+	}
+
+	if (flags & WJE_FLAG_NAME_BORROWED) {
+		/* There is no need to reserve room for a copy of the name */
+		len = 0;
+	}
+
+	if (arena) {
+		result = WJEArenaAlloc(arena, sizeof(_WJElement) + len + 1);
+	} else {
+		result = MemMalloc(sizeof(_WJElement) + len + 1);
+	}
+
+	if (result) {
 		memset(result, 0, sizeof(_WJElement));
 
-		MemUpdateOwner(result, file, line);
+		if ((result->arena = arena)) {
+			WJEArenaRetain(arena);
+		} else {
+			MemUpdateOwner(result, file, line);
+		}
 
-		if (name) {
+		if (flags & WJE_FLAG_NAME_BORROWED) {
+			result->pub.name = name;
+		} else if (name) {
 			strncpy(result->_name, name, len);
 			result->pub.name = result->_name;
 		}
 		result->_name[len] = '\0';
+		result->flags = flags & ~WJE_FLAG_UNCOUNTED;
 
 		if (parent) {
 			result->pub.parent = (WJElement) parent;
@@ -69,6 +168,8 @@ _WJElement * _WJENew(_WJElement *parent, char *name, size_t len, const char *fil
 
 			parent->pub.last = (WJElement) result;
 			parent->pub.count++;
+
+			_WJEIndexAdd(parent, (WJElement) result);
 		}
 
 		result->pub.type = WJR_TYPE_OBJECT;
@@ -83,14 +184,21 @@ _WJElement * _WJEReset(_WJElement *e, WJRType type)
 
 	if (!e) return(NULL);
 
+	/* None of the children are going to be kept, so don't bother indexing */
+	_WJEIndexFree(e);
+
 	while ((child = e->pub.child)) {
 		WJEDetach(child);
 		WJECloseDocument(child);
 	}
 
-	if (WJR_TYPE_STRING == e->pub.type && e->value.string) {
+	if (WJR_TYPE_STRING == e->pub.type && e->value.string &&
+		!(e->flags & WJE_FLAG_STRING_BORROWED)
+	) {
 		MemRelease(&(e->value.string));
 	}
+	e->flags		&= ~(WJE_FLAG_STRING_BORROWED | WJE_FLAG_LAZY | WJE_FLAG_FROZEN |
+						WJE_FLAG_MALFORMED);
 	e->value.string	= NULL;
 	e->pub.length	= 0;
 	e->pub.type		= type;
@@ -106,9 +214,15 @@ EXPORT XplBool _WJEDetach(WJElement document, const char *file, const int line)
 
 	MemUpdateOwner(document, file, line);
 
+	if (document->parent || document->prev || document->next) {
+		/* The arena can't be free'd with the record while the document is held */
+		WJEArenaChanged(((_WJElement *) document)->arena);
+	}
+
 	/* Remove references to the document */
 	if (document->parent) {
 		WJEChanged(document->parent);
+		_WJEIndexRemove((_WJElement *) document->parent, document);
 
 		if (document->parent->child == document) {
 			document->parent->child = document->next;
@@ -146,6 +260,10 @@ EXPORT XplBool WJEAttach(WJElement container, WJElement document)
 		return(TRUE);
 	}
 
+	if (!WJEMaterialized(container)) {
+		return(FALSE);
+	}
+
 	if (document->name) {
 		while ((prev = WJEChild(container, document->name, WJE_GET))) {
 			WJEDetach(prev);
@@ -166,6 +284,7 @@ EXPORT XplBool WJEAttach(WJElement container, WJElement document)
 	}
 	container->last = document;
 	container->count++;
+	_WJEIndexAdd((_WJElement *) container, document);
 	WJEChanged(container);
 
 	return(TRUE);
@@ -174,25 +293,33 @@ EXPORT XplBool WJEAttach(WJElement container, WJElement document)
 EXPORT XplBool WJERename(WJElement document, const char *name)
 {
 	_WJElement	*current = (_WJElement *) document;
-	WJElement	e;
+	_WJElement	*parent;
 
 	if (!document) {
 		return(FALSE);
 	}
 
 	/* Look for any siblings with that name, and fail if found */
-	if (name && document->parent) {
-		for (e = document->parent->child; e; e = e->next) {
-			if (e != document && !stricmp(e->name, name)) {
-				return(FALSE);
-			}
-		}
+	if (name && document->parent &&
+		WJEFindChild(document->parent, name, strlen(name), WJE_IGNORE_CASE, document)
+	) {
+		return(FALSE);
+	}
+
+	/* The index is keyed on the name, so it must be removed while it changes */
+	if ((parent = (_WJElement *) document->parent)) {
+		_WJEIndexRemove(parent, document);
 	}
 
+	WJEArenaChanged(current->arena);
+
 	/* Free the previous name if needed */
-	if (document->name && current->_name != document->name) {
+	if (document->name && current->_name != document->name &&
+		!(current->flags & WJE_FLAG_NAME_BORROWED)
+	) {
 		MemRelease(&document->name);
 	}
+	current->flags &= ~WJE_FLAG_NAME_BORROWED;
 
 	/* Set the new name */
 	if (name) {
@@ -203,10 +330,21 @@ EXPORT XplBool WJERename(WJElement document, const char *name)
 		document->name = NULL;
 	}
 
+	if (parent) {
+		_WJEIndexAdd(parent, document);
+	}
+
 	return(TRUE);
 }
 
-static WJElement _WJELoad(_WJElement *parent, WJReader reader, char *where, WJELoadCB loadcb, void *data, const char *file, const int line)
+/*
+	The longest name that is loaded from a reader with a fixed size buffer. A
+	reader that is allowed to grow its buffer never needs to truncate a name.
+*/
+#define WJEMaxNameLen(r)	((r)->maxbuffersize ? (size_t) -1 : 2048)
+
+/* The result is left for the caller to count as a change to the parent */
+static WJElement _WJELoad(_WJElement *parent, WJEArena *arena, WJReader reader, char *where, WJELoadCB loadcb, void *data, const char *file, const int line)
 {
 	char		*current, *name, *value;
 	_WJElement	*l = NULL;
@@ -214,7 +352,7 @@ static WJElement _WJELoad(_WJElement *parent, WJReader reader, char *where, WJEL
 	size_t		actual, used, len;
 
 	if (!reader) {
-		return((WJElement) _WJENew(NULL, NULL, 0, file, line));
+		return((WJElement) _WJENewEx(NULL, arena, NULL, 0, 0, file, line));
 	}
 
 	if (!where) {
@@ -222,7 +360,7 @@ static WJElement _WJELoad(_WJElement *parent, WJReader reader, char *where, WJEL
 			A NULL poisition in a WJReader indicates the root of the document,
 			so we must read to find the first real object.
 		*/
-		where = WJRNext(NULL, 2048, reader);
+		where = WJRNext(NULL, WJEMaxNameLen(reader), reader);
 	}
 
 	if (!where) {
@@ -234,15 +372,17 @@ static WJElement _WJELoad(_WJElement *parent, WJReader reader, char *where, WJEL
 
 	if (name && (WJEChild((WJElement) parent, name, WJE_GET))) {
 		/* Do not load duplicate names */
+		WJRSkip(where, reader);
 		return(NULL);
 	}
 
 	if (loadcb && !loadcb((WJElement)parent, name, data, file, line)) {
 		/* The consumer has rejected this item */
+		WJRSkip(where, reader);
 		return(NULL);
 	}
 
-	if ((l = _WJENew(parent, name, name ? strlen(name) : 0, file, line))) {
+	if ((l = _WJENewEx(parent, arena, name, name ? strlen(name) : 0, WJE_FLAG_UNCOUNTED, file, line))) {
 		switch ((l->pub.type = *where)) {
 			default:
 			case WJR_TYPE_UNKNOWN:
@@ -251,8 +391,8 @@ static WJElement _WJELoad(_WJElement *parent, WJReader reader, char *where, WJEL
 
 			case WJR_TYPE_OBJECT:
 			case WJR_TYPE_ARRAY:
-				while (reader && (current = WJRNext(where, 2048, reader))) {
-					_WJELoad(l, reader, current, loadcb, data, file, line);
+				while (reader && (current = WJRNext(where, WJEMaxNameLen(reader), reader))) {
+					_WJECountChild(_WJELoad(l, arena, reader, current, loadcb, data, file, line), FALSE);
 				}
 				break;
 
@@ -266,6 +406,17 @@ static WJElement _WJELoad(_WJElement *parent, WJReader reader, char *where, WJEL
 
 				do {
 					if ((value = WJRStringEx(&complete, &len, reader))) {
+						if (arena && complete && !used) {
+							/* The entire string was returned at once */
+							if ((l->value.string = WJEArenaIntern(arena, value, len, TRUE)) ||
+								(l->value.string = WJEArenaStrndup(arena, value, len))
+							) {
+								l->flags |= WJE_FLAG_STRING_BORROWED;
+								l->pub.length = len;
+							}
+							break;
+						}
+
 						if (used + len >= actual) {
 							l->value.string = MemMallocEx(l->value.string,
 								len + 1 + used, &actual, TRUE, TRUE);
@@ -278,6 +429,16 @@ static WJElement _WJELoad(_WJElement *parent, WJReader reader, char *where, WJEL
 						l->pub.length = used;
 					}
 				} while (!complete);
+
+				if (arena && l->value.string && !(l->flags & WJE_FLAG_STRING_BORROWED) &&
+					((value = WJEArenaIntern(arena, l->value.string, used, TRUE)) ||
+					(value = WJEArenaStrndup(arena, l->value.string, used)))
+				) {
+					/* Keep everything in the arena, so it can be free'd at once */
+					MemFree(l->value.string);
+					l->value.string	= value;
+					l->flags		|= WJE_FLAG_STRING_BORROWED;
+				}
 				break;
 
 			case WJR_TYPE_NUMBER:
@@ -325,13 +486,114 @@ EXPORT WJElement _WJEOpenDocument(WJReader reader, char *where, WJELoadCB loadcb
 {
 	WJElement	element;
 
-	if ((element = _WJELoad(NULL, reader, where, loadcb, data, file, line))) {
+	if ((element = _WJELoad(NULL, NULL, reader, where, loadcb, data, file, line))) {
 		MemUpdateOwner(element, file, line);
 	}
 
 	return(element);
 }
 
+static WJElement WJELoadArena(WJReader reader, char *where, WJELoadCB loadcb, void *data, WJESymbols symbols, const char *file, const int line)
+{
+	WJElement	element;
+	WJEArena	*arena;
+
+	if (!(arena = WJEArenaNew())) {
+		return(NULL);
+	}
+	WJEArenaSymbols(arena, symbols);
+
+	/*
+		Hold a reference while loading so that the arena is free'd below if
+		nothing was loaded.
+	*/
+	WJEArenaRetain(arena);
+	element = _WJELoad(NULL, arena, reader, where, loadcb, data, file, line);
+	WJEArenaRelease(arena);
+
+	return(element);
+}
+
+EXPORT WJElement _WJEOpenDocumentArena(WJReader reader, char *where, WJELoadCB loadcb, void *data, const char *file, const int line)
+{
+	return(WJELoadArena(reader, where, loadcb, data, NULL, file, line));
+}
+
+EXPORT WJElement _WJEOpenDocumentInterned(WJReader reader, char *where, WJELoadCB loadcb, void *data, WJESymbols symbols, const char *file, const int line)
+{
+	WJElement	element;
+
+	if (symbols) {
+		return(WJELoadArena(reader, where, loadcb, data, symbols, file, line));
+	}
+
+	/* The document holds the only reference to a table of its own */
+	symbols = WJEOpenSymbols(0);
+	element = WJELoadArena(reader, where, loadcb, data, symbols, file, line);
+	WJECloseSymbols(symbols);
+
+	return(element);
+}
+
+EXPORT XplBool _WJENextDocument(WJReader reader, uint32 flags, WJELoadCB loadcb, void *data, WJElement *doc, const char *file, const int line)
+{
+	WJEArena	*arena;
+	WJRType		type;
+	char		*where;
+
+	if (!doc || !reader) {
+		errno = EINVAL;
+		return(FALSE);
+	}
+	*doc = NULL;
+
+	reader->stream = TRUE;
+	if (!(where = WJRNext(NULL, WJEMaxNameLen(reader), reader))) {
+		if (reader->depth) {
+			/* There was something other than a value at the top level */
+			WJRSkipLine(reader);
+			errno = EILSEQ;
+			return(FALSE);
+		}
+
+		/* The end of the stream */
+		errno = 0;
+		return(FALSE);
+	}
+	type = (WJRType) *where;
+
+	if (!(flags & WJE_STREAM_ARENA)) {
+		if ((*doc = _WJELoad(NULL, NULL, reader, where, loadcb, data, file, line))) {
+			MemUpdateOwner(*doc, file, line);
+		}
+	} else if ((arena = WJEArenaNew())) {
+		WJEArenaRetain(arena);
+		if ((*doc = _WJELoad(NULL, arena, reader, where, loadcb, data, file, line))) {
+			WJEArenaRecord(arena, *doc);
+		}
+		WJEArenaRelease(arena);
+	}
+
+	/*
+		A scalar may not have been read past yet, but an object or array has
+		been closed once it is loaded, unless it was malformed. If so then drop
+		it, along with the rest of its line.
+	*/
+	if (reader->depth && (WJR_TYPE_OBJECT == type || WJR_TYPE_ARRAY == type)) {
+		if (*doc) {
+			_WJECloseDocument(*doc, file, line);
+			*doc = NULL;
+		}
+
+		WJRSkipLine(reader);
+		errno = EILSEQ;
+		return(FALSE);
+	}
+
+	/* A record that was rejected or couldn't be loaded is skipped */
+	return(TRUE);
+}
+
 typedef struct WJEMemArgs
 {
 	char		*json;
@@ -417,14 +679,95 @@ EXPORT WJElement __WJEFromString(const char *json, char quote, const char *file,
 	return(doc);
 }
 
+/*
+	Make a rough guess at the length of the JSON representation of a document,
+	so that the memory used to write it can be allocated up front instead of
+	growing as it is written.
+
+	Strings are assumed to need no escaping, and numbers are assumed to be
+	short, so this is only ever an estimate.
+*/
+static size_t WJEEstimateSize(WJElement document, XplBool pretty, size_t depth)
+{
+	const uint64	*tape;
+	WJElement		child;
+	size_t			size	= 0;
+
+	if (!document) {
+		return(0);
+	}
+
+	if (document->name) {
+		/* "name": */
+		size += strlen(document->name) + 4;
+	}
+
+	if (pretty) {
+		/* A line break and an indent */
+		size += depth + 1;
+	}
+
+	switch (document->type) {
+		default:
+		case WJR_TYPE_UNKNOWN:
+			break;
+
+		case WJR_TYPE_OBJECT:
+		case WJR_TYPE_ARRAY:
+			size += pretty ? depth + 3 : 2;
+
+			if ((tape = WJETapeOf(document))) {
+				size += WJETapeEstimate(tape, pretty, depth + 1);
+				break;
+			}
+
+			if (!WJEMaterialized(document)) {
+				break;
+			}
+
+			for (child = document->child; child; child = child->next) {
+				/* A comma */
+				size += 1 + WJEEstimateSize(child, pretty, depth + 1);
+			}
+			break;
+
+		case WJR_TYPE_STRING:
+			size += document->length + 2;
+			break;
+
+		case WJR_TYPE_NUMBER:
+#ifdef WJE_DISTINGUISH_INTEGER_TYPE
+		case WJR_TYPE_INTEGER:
+#endif
+			size += 8;
+			break;
+
+		case WJR_TYPE_NULL:
+		case WJR_TYPE_TRUE:
+		case WJR_TYPE_BOOL:
+		case WJR_TYPE_FALSE:
+			size += 5;
+			break;
+	}
+
+	return(size);
+}
+
 EXPORT char * _WJEToString(WJElement document, XplBool pretty, const char *file, const int line)
 {
 	WJWriter		writer;
 	char			*mem	= NULL;
+	XplBool			ok;
 
-	if ((writer = WJWOpenMemDocument(pretty, &mem))) {
-		WJEWriteDocument(document, writer, NULL);
+	if ((writer = WJWOpenMemDocumentEx(pretty, &mem,
+					WJEEstimateSize(document, pretty, 0)))) {
+		ok = WJEWriteDocument(document, writer, NULL);
 		WJWCloseDocument(writer);
+
+		if (!ok && mem) {
+			/* Part of the document couldn't be read */
+			MemRelease(&mem);
+		}
 	}
 	if (mem) {
 		MemUpdateOwner(mem, file, line);
@@ -432,9 +775,52 @@ EXPORT char * _WJEToString(WJElement document, XplBool pretty, const char *file,
 	return(mem);
 }
 
+EXPORT XplBool WJEToBuffer(WJElement document, XplBool pretty, char *buffer, size_t size, size_t *needed)
+{
+	WJWriter		writer;
+	size_t			length	= 0;
+	XplBool			result	= FALSE;
+
+	if ((writer = WJWOpenBufferDocument(pretty, buffer, size, &length))) {
+		result = WJEWriteDocument(document, writer, NULL);
+		result = WJWCloseDocument(writer) && result && length < size;
+	}
+
+	if (needed) {
+		*needed = length;
+	}
+	return(result);
+}
+
+/*
+	Load a document directly from a memory mapped file. If it can't be parsed
+	that way then it is loaded with a WJReader instead, so that a badly formed
+	document results in exactly what it would have otherwise.
+*/
+static WJElement WJEFromMap(XplFileMap *map, const char *file, const int line)
+{
+	WJElement	e		= NULL;
+	WJEMemArgs	args;
+	WJReader	reader;
+
+	if (!_WJEParseBuffer(map->data, map->length, FALSE, NULL, NULL, &e, file, line)) {
+		args.json	= map->data;
+		args.quote	= '\0';
+		args.len	= map->length;
+
+		if ((reader = WJROpenDocument(WJEMemCallback, &args, NULL, 0))) {
+			e = _WJEOpenDocument(reader, NULL, NULL, NULL, file, line);
+			WJRCloseDocument(reader);
+		}
+	}
+
+	return(e);
+}
+
 EXPORT WJElement WJEFromFile(const char *path)
 {
 	WJElement	e	= NULL;
+	XplFileMap	map;
 	FILE		*f;
 	WJReader	reader;
 
@@ -443,6 +829,13 @@ EXPORT WJElement WJEFromFile(const char *path)
 		return(NULL);
 	}
 
+	if (XplFileMapOpenPath(&map, path)) {
+		e = WJEFromMap(&map, __FILE__, __LINE__);
+		XplFileMapClose(&map);
+
+		return(e);
+	}
+
 	if ((f = fopen(path, "rb"))) {
 		if ((reader = WJROpenFILEDocument(f, NULL, 0))) {
 			e = WJEOpenDocument(reader, NULL, NULL, NULL);
@@ -456,6 +849,11 @@ EXPORT WJElement WJEFromFile(const char *path)
 }
 
 EXPORT XplBool WJEToFile(WJElement document, XplBool pretty, const char *path)
+{
+	return(WJEToFileEx(document, pretty, path, 0));
+}
+
+EXPORT XplBool WJEToFileEx(WJElement document, XplBool pretty, const char *path, uint32 flags)
 {
 	FILE			*f;
 	WJWriter		writer;
@@ -466,8 +864,25 @@ EXPORT XplBool WJEToFile(WJElement document, XplBool pretty, const char *path)
 		return(FALSE);
 	}
 
+	if ((writer = WJWOpenPathDocument(pretty, path, flags,
+					(flags & WJW_FILE_PREALLOCATE) ?
+						WJEEstimateSize(document, pretty, 0) : 0))) {
+		if (!(ret = WJEWriteDocument(document, writer, NULL))) {
+			/* Don't replace the file with a partial document */
+			writer->write.cb = NULL;
+		}
+
+		if (!WJWCloseDocument(writer)) {
+			ret = FALSE;
+		}
+		return(ret);
+	} else if (errno != ENOSYS) {
+		return(FALSE);
+	}
+
+	/* Writing to a file directly isn't supported on this platform */
 	if ((f = fopen(path, "wb"))) {
-		if ((writer = WJWOpenFILEDocument(pretty, f))) {
+		if ((writer = WJWOpenFILEDocumentEx(pretty, f, WJW_FILE_BUFFER_SIZE))) {
 			ret = WJEWriteDocument(document, writer, NULL);
 
 			WJWCloseDocument(writer);
@@ -479,7 +894,8 @@ EXPORT XplBool WJEToFile(WJElement document, XplBool pretty, const char *path)
 	return(ret);
 }
 
-static WJElement _WJECopy(_WJElement *parent, WJElement original, WJECopyCB copycb, void *data, const char *file, const int line)
+/* The result is left for the caller to count as a change to the parent */
+static WJElement _WJECopy(_WJElement *parent, WJElement original, WJECopyCB copycb, void *data, WJEArena **shared, XplBool *failed, const char *file, const int line)
 {
 	_WJElement	*l = NULL;
 	_WJElement	*o;
@@ -495,7 +911,16 @@ static WJElement _WJECopy(_WJElement *parent, WJElement original, WJECopyCB copy
 		return(NULL);
 	}
 
-	if ((l = _WJENew(parent, original->name, original->name ? strlen(original->name) : 0, file, line))) {
+	if (!copycb && (o->flags & WJE_FLAG_FROZEN) &&
+		(l = _WJETapeShare(parent, o, shared, file, line))
+	) {
+		/* The frozen value is shared rather than copied */
+		return((WJElement) l);
+	}
+
+	if ((l = _WJENewEx(parent, parent ? parent->arena : NULL, original->name,
+		original->name ? strlen(original->name) : 0, WJE_FLAG_UNCOUNTED, file, line))
+	) {
 		switch ((l->pub.type = original->type)) {
 			default:
 			case WJR_TYPE_UNKNOWN:
@@ -504,8 +929,12 @@ static WJElement _WJECopy(_WJElement *parent, WJElement original, WJECopyCB copy
 
 			case WJR_TYPE_OBJECT:
 			case WJR_TYPE_ARRAY:
-				for (c = original->child; c; c = c->next) {
-					_WJECopy(l, c, copycb, data, file, line);
+				if (!WJEMaterialized(original)) {
+					*failed = TRUE;
+				}
+
+				for (c = original->child; c && !*failed; c = c->next) {
+					_WJECountChild(_WJECopy(l, c, copycb, data, shared, failed, file, line), FALSE);
 				}
 				break;
 
@@ -551,18 +980,46 @@ static WJElement _WJECopy(_WJElement *parent, WJElement original, WJECopyCB copy
 
 EXPORT WJElement _WJECopyDocument(WJElement to, WJElement from, WJECopyCB copycb, void *data, const char *file, const int line)
 {
+	WJEArena	*shared	= NULL;
+	XplBool		failed	= FALSE;
+
 	if (to) {
-		WJElement	c;
+		WJElement	c, last;
+
+		if (!WJEMaterialized(from)) {
+			return(NULL);
+		}
+
+		/* The copied values are not allocated from the arena of to */
+		WJEArenaChanged(((_WJElement *) to)->arena);
 
-		for (c = from->child; c; c = c->next) {
-			_WJECopy((_WJElement *) to, c, copycb, data, file, line);
+		last = to->last;
+		for (c = from->child; c && !failed; c = c->next) {
+			_WJECountChild(_WJECopy((_WJElement *) to, c, copycb, data, &shared, &failed, file, line), TRUE);
+		}
+
+		if (failed) {
+			/* Part of from couldn't be read, so remove what was copied */
+			while (to->last != last) {
+				WJECloseDocument(to->last);
+			}
+			to = NULL;
 		}
 	} else {
-		if ((to = _WJECopy(NULL, from, copycb, data, file, line))) {
+		if ((to = _WJECopy(NULL, from, copycb, data, &shared, &failed, file, line)) &&
+			failed
+		) {
+			WJECloseDocument(to);
+			to = NULL;
+		}
+
+		if (to && !((_WJElement *) to)->arena) {
 			MemUpdateOwner(to, file, line);
 		}
 	}
 
+	/* Any frozen values that were shared hold references of their own */
+	WJEArenaRelease(shared);
 	return(to);
 }
 
@@ -571,7 +1028,8 @@ EXPORT XplBool WJEMergeObjects(WJElement to, WJElement from, XplBool overwrite)
 	WJElement	a, b;
 
 	if (!to || !from ||
-		WJR_TYPE_OBJECT != to->type || WJR_TYPE_OBJECT != from->type
+		WJR_TYPE_OBJECT != to->type || WJR_TYPE_OBJECT != from->type ||
+		!WJEMaterialized(from)
 	) {
 		return(FALSE);
 	}
@@ -599,11 +1057,13 @@ EXPORT XplBool WJEMergeObjects(WJElement to, WJElement from, XplBool overwrite)
 	return(TRUE);
 }
 
-EXPORT XplBool _WJEWriteDocument(WJElement document, WJWriter writer, char *name,
-						WJEWriteCB precb, WJEWriteCB postcb, void *data)
+static XplBool WJEWriteElement(WJElement document, WJWriter writer, char *name,
+						WJEWriteCB precb, WJEWriteCB postcb, void *data,
+						XplBool *failed)
 {
-	_WJElement	*current = (_WJElement *) document;
-	WJElement	child;
+	_WJElement		*current = (_WJElement *) document;
+	const uint64	*tape;
+	WJElement		child;
 
 	if (precb && !precb(document, writer, data)) {
 		return(FALSE);
@@ -614,6 +1074,17 @@ EXPORT XplBool _WJEWriteDocument(WJElement document, WJWriter writer, char *name
 			return(document->writecb(document, writer, name));
 		}
 
+		if (!precb && !postcb && (tape = WJETapeOf(document))) {
+			/* There is no need to materialize a frozen value to write it */
+			WJETapeWrite(tape, writer, name);
+			return(TRUE);
+		}
+
+		if (!WJEMaterialized(document)) {
+			*failed = TRUE;
+			return(FALSE);
+		}
+
 		switch (current->pub.type) {
 			default:
 			case WJR_TYPE_UNKNOWN:
@@ -628,9 +1099,9 @@ EXPORT XplBool _WJEWriteDocument(WJElement document, WJWriter writer, char *name
 
 				child = current->pub.child;
 				do {
-					_WJEWriteDocument(child, writer, child ? child->name : NULL,
-						precb, postcb, data);
-				} while (child && (child = child->next));
+					WJEWriteElement(child, writer, child ? child->name : NULL,
+						precb, postcb, data, failed);
+				} while (!*failed && child && (child = child->next));
 
 				WJWCloseObject(writer);
 				break;
@@ -640,9 +1111,9 @@ EXPORT XplBool _WJEWriteDocument(WJElement document, WJWriter writer, char *name
 
 				child = current->pub.child;
 				do {
-					_WJEWriteDocument(child, writer, NULL,
-						precb, postcb, data);
-				} while (child && (child = child->next));
+					WJEWriteElement(child, writer, NULL,
+						precb, postcb, data, failed);
+				} while (!*failed && child && (child = child->next));
 
 				WJWCloseArray(writer);
 				break;
@@ -656,7 +1127,9 @@ EXPORT XplBool _WJEWriteDocument(WJElement document, WJWriter writer, char *name
 			case WJR_TYPE_INTEGER:
 #endif
 				if (current->value.number.hasDecimalPoint) {
+#ifdef WJE_DISTINGUISH_INTEGER_TYPE
 					current->pub.type = WJR_TYPE_NUMBER;
+#endif
 					if (!current->value.number.negative) {
 						WJWDouble(name, current->value.number.d, writer);
 					} else {
@@ -689,6 +1162,19 @@ EXPORT XplBool _WJEWriteDocument(WJElement document, WJWriter writer, char *name
 	return(TRUE);
 }
 
+EXPORT XplBool _WJEWriteDocument(WJElement document, WJWriter writer, char *name,
+						WJEWriteCB precb, WJEWriteCB postcb, void *data)
+{
+	XplBool		failed	= FALSE;
+
+	/*
+		A FALSE return from a callback only skips that element, but part of the
+		document that can't be read fails the whole write.
+	*/
+	return(WJEWriteElement(document, writer, name, precb, postcb, data, &failed) &&
+		!failed);
+}
+
 EXPORT XplBool _WJECloseDocument(WJElement document, const char *file, const int line)
 {
 	_WJElement	*current = (_WJElement *) document;
@@ -705,6 +1191,11 @@ EXPORT XplBool _WJECloseDocument(WJElement document, const char *file, const int
 		return(TRUE);
 	}
 
+	if (current->arena && WJEArenaCloseRecord(current->arena, document)) {
+		/* An unmodified record is free'd along with its arena, all at once */
+		return(TRUE);
+	}
+
 	WJEChanged(document);
 
 	/* Remove references to this object */
@@ -726,23 +1217,32 @@ EXPORT XplBool _WJECloseDocument(WJElement document, const char *file, const int
 		document->next->prev = document->prev;
 	}
 
-
 	/* Destroy all children */
+	_WJEIndexFree(current);
 	while ((child = document->child)) {
 		WJEDetach(child);
 		_WJECloseDocument(child, file, line);
 	}
 
 	if (current->pub.type == WJR_TYPE_STRING) {
-		MemFreeEx(current->value.string, file, line);
+		if (!(current->flags & WJE_FLAG_STRING_BORROWED)) {
+			MemFreeEx(current->value.string, file, line);
+		}
 		current->pub.length = 0;
 	}
 
-	if (document->name && current->_name != document->name) {
+	if (document->name && current->_name != document->name &&
+		!(current->flags & WJE_FLAG_NAME_BORROWED)
+	) {
 		MemReleaseEx(&document->name, file, line);
 	}
 
-	MemFreeEx(current, file, line);
+	if (current->arena) {
+		/* The memory is reclaimed when the last element of the arena closes */
+		WJEArenaRelease(current->arena);
+	} else {
+		MemFreeEx(current, file, line);
+	}
 
 	return(TRUE);
 }
@@ -798,6 +1298,17 @@ EXPORT WJElement WJEReadFILE(FILE* fd)
 {
 	WJReader		reader;
 	WJElement		obj = NULL;
+	XplFileMap		map;
+	long			offset;
+
+	if (fd && (offset = ftell(fd)) >= 0 && XplFileMapOpen(&map, fileno(fd), offset)) {
+		obj = WJEFromMap(&map, __FILE__, __LINE__);
+		XplFileMapClose(&map);
+
+		/* Leave the file at the end, as reading the document would have */
+		fseek(fd, 0, SEEK_END);
+		return(obj);
+	}
 
 	if ((reader = WJROpenDocument(fileReaderCB, fd, NULL, 0))) {
 		obj = WJEOpenDocument(reader, NULL, NULL, NULL);
@@ -27,10 +27,57 @@
 
 #include <wjelement.h>
 
+typedef struct WJEIndex WJEIndex;
+typedef struct WJEArena WJEArena;
+
+/* value.string was not allocated on its own and must not be free'd */
+#define WJE_FLAG_STRING_BORROWED	0x00000001
+
+/* pub.name points to memory owned by someone else and must not be free'd */
+#define WJE_FLAG_NAME_BORROWED		0x00000002
+
+/*
+	The children of this object or array have not been parsed yet. value.string
+	points to the source of it and pub.length is the length of the source.
+*/
+#define WJE_FLAG_LAZY				0x00000004
+
+/*
+	Along with WJE_FLAG_LAZY, the children of this object or array are still on
+	the tape of a frozen document. value.string points to its first word.
+*/
+#define WJE_FLAG_FROZEN				0x00000008
+
+/*
+	Only used when creating an element, which is then not counted as a change
+	to its parent until WJECountChild() is called once it is complete.
+*/
+#define WJE_FLAG_UNCOUNTED			0x00000010
+
+/*
+	The children of this lazy object or array could not be parsed, so it was
+	left empty. It fails to materialize again until it is reset, so that a
+	write or copy of it can't quietly treat it as an empty one.
+*/
+#define WJE_FLAG_MALFORMED			0x00000020
+
+#if defined(_MSC_VER)
+#define WJE_THREAD_LOCAL			__declspec(thread)
+#else
+#define WJE_THREAD_LOCAL			__thread
+#endif
+
 typedef struct {
 	WJElementPublic		pub;
 	WJElementPublic		*parent;
 
+	/* Name index of the children, only used by objects with many children */
+	WJEIndex			*index;
+
+	/* The arena this element was allocated from, if any */
+	WJEArena			*arena;
+	uint32				flags;
+
 	union {
 		char			*string;
 		XplBool			boolean;
@@ -49,11 +96,71 @@ typedef struct {
 
 /* element.c */
 _WJElement * _WJENew(_WJElement *parent, char *name, size_t len, const char *file, int line);
+_WJElement * _WJENewEx(_WJElement *parent, WJEArena *arena, char *name, size_t len, uint32 flags, const char *file, int line);
 _WJElement * _WJEReset(_WJElement *e, WJRType type);
 
+/* arena.c */
+WJEArena * WJEArenaNew(void);
+WJEArena * WJEArenaNewEx(size_t chunksize);
+void * WJEArenaAlloc(WJEArena *arena, size_t size);
+char * WJEArenaStrndup(WJEArena *arena, const char *value, size_t len);
+void WJEArenaRetain(WJEArena *arena);
+void WJEArenaRelease(WJEArena *arena);
+void WJEArenaRecord(WJEArena *arena, WJElement document);
+void WJEArenaChanged(WJEArena *arena);
+XplBool WJEArenaCloseRecord(WJEArena *arena, WJElement document);
+void WJEArenaSource(WJEArena *arena, void *source, void (* freesource)(void *source));
+void WJEArenaSymbols(WJEArena *arena, WJESymbols symbols);
+char * WJEArenaIntern(WJEArena *arena, const char *value, size_t len, XplBool isvalue);
+XplBool WJEArenaShare(WJEArena *arena, WJEArena *shared);
+
+/* symbols.c */
+void WJESymbolsRetain(WJESymbols symbols);
+void WJESymbolsRelease(WJESymbols symbols);
+char * WJESymbolsIntern(WJESymbols symbols, const char *value, size_t len, XplBool isvalue);
+
+/* tape.c */
+#define WJETapeType(p)			((WJRType) (*(p) >> 56))
+
+XplBool _WJETapeMaterialize(_WJElement *e);
+_WJElement * _WJETapeShare(_WJElement *parent, _WJElement *original, WJEArena **arena, const char *file, int line);
+const uint64 * WJETapeOf(WJElement e);
+const uint64 * WJETapeChild(const uint64 *container, const uint64 *last, char **name, size_t *len);
+void WJETapeLoad(const uint64 *p, _WJElement *e, XplBool lazy);
+void WJETapeWrite(const uint64 *p, WJWriter writer, char *name);
+size_t WJETapeEstimate(const uint64 *container, XplBool pretty, size_t depth);
+
+/* index.c */
+#define WJE_INDEX_MIN_COUNT		16
+
+WJElement WJEFindChild(WJElement container, const char *name, size_t len, WJEAction action, WJElement skip);
+void _WJEIndexAdd(_WJElement *container, WJElement e);
+void _WJEIndexRemove(_WJElement *container, WJElement e);
+void _WJEIndexFree(_WJElement *container);
+XplBool _WJEIndexAll(WJElement container);
+
+/* parse.c */
+XplBool _WJEParseBuffer(char *json, size_t length, XplBool insitu, WJELoadCB loadcb, void *data, WJElement *doc, const char *file, const int line);
+XplBool _WJEParseLazy(const char *json, size_t length, WJElement *doc, const char *file, const int line);
+size_t WJEUnescape(char *to, const char *from, size_t len);
+#define WJE_UNESCAPE_FAILED		((size_t) -1)
+XplBool _WJEParseSplitArray(const char *json, size_t length, size_t size, const char **starts, size_t max, size_t *count, const char **end);
+XplBool _WJEParseElements(const char *json, size_t length, WJElement parent, WJELoadCB loadcb, void *data, WJElement *first, WJElement *last, int *count, int *changes, const char *file, const int line);
+
+/*
+	Parse the children of e if they haven't been parsed yet. FALSE is returned
+	if they couldn't be, in which case e is left empty.
+*/
+static INLINE XplBool WJEMaterialized(WJElement e)
+{
+	return(!(((_WJElement *) e)->flags & (WJE_FLAG_LAZY | WJE_FLAG_MALFORMED)) ||
+		WJEMaterialize(e, FALSE));
+}
+
 /* search.c */
 typedef int (* WJEMatchCB)(WJElement root, WJElement parent, WJElement e, WJEAction action, char *name, size_t len);
-WJElement WJESearch(WJElement container, const char *path, WJEAction *action, WJElement last, const char *file, const int line);
+WJElement WJESearch(WJElement container, const char *path, WJESelector selector, WJEAction *action, WJElement last, const char *file, const int line);
+WJElement WJESearchValue(WJElement container, const char *path, WJESelector selector, WJEAction *action, WJElement last, _WJElement *scratch, const char *file, const int line);
 
 /*
 	Allow a few extra characters in dot seperated alpha numeric names for the
@@ -96,9 +203,12 @@ WJElement WJESearch(WJElement container, const char *path, WJEAction *action, WJ
 */
 #define WJENew(p, n, l, f, ln)			(WJElement) _WJENew((_WJElement *) (p), (n), (l), (f), (ln))
 #define WJEReset(e, t)					(WJElement) _WJEReset((_WJElement *) (e), t)
-#define _WJESearch(c, p, a, l, f, ln)	(_WJElement *) WJESearch((c), (p), (a), (l), (f), (ln))
+#define _WJESearch(c, p, s, a, l, f, ln)	(_WJElement *) WJESearch((c), (p), (s), (a), (l), (f), (ln))
+#define _WJESearchValue(c, p, s, a, l, sc, f, ln)	(_WJElement *) WJESearchValue((c), (p), (s), (a), (l), (sc), (f), (ln))
 
 void WJEChanged(WJElement element);
 #define _WJEChanged(e) WJEChanged((WJElement) (e))
+void WJECountChild(WJElement child, XplBool ancestors);
+#define _WJECountChild(c, a) WJECountChild((WJElement) (c), (a))
 
 #endif // __WJ_ELEMENT_P_H
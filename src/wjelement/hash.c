@@ -18,7 +18,7 @@
 #include "element.h"
 #include <stdlib.h>
 
-static void _WJEHash(WJElement document, int depth, WJEHashCB update, void *context)
+static XplBool _WJEHash(WJElement document, int depth, WJEHashCB update, void *context)
 {
 	WJElement	child;
 	char		*s;
@@ -26,7 +26,11 @@ static void _WJEHash(WJElement document, int depth, WJEHashCB update, void *cont
 	uint32		b;
 
 	if (!document) {
-		return;
+		return(TRUE);
+	}
+
+	if (!WJEMaterialized(document)) {
+		return(FALSE);
 	}
 
 	switch (document->type) {
@@ -45,7 +49,9 @@ static void _WJEHash(WJElement document, int depth, WJEHashCB update, void *cont
 				if (child->name) {
 					update(context, child->name, strlen(child->name) + 1);
 				}
-				_WJEHash(child, depth + 1, update, context);
+				if (!_WJEHash(child, depth + 1, update, context)) {
+					return(FALSE);
+				}
 			}
 
 			update(context, &depth, sizeof(depth));
@@ -56,7 +62,9 @@ static void _WJEHash(WJElement document, int depth, WJEHashCB update, void *cont
 
 			for (child = document->child; child; child = child->next) {
 				update(context, "", 1);
-				_WJEHash(child, depth + 1, update, context);
+				if (!_WJEHash(child, depth + 1, update, context)) {
+					return(FALSE);
+				}
 			}
 
 			update(context, &depth, sizeof(depth));
@@ -85,11 +93,13 @@ static void _WJEHash(WJElement document, int depth, WJEHashCB update, void *cont
 			update(context, &b, sizeof(b));
 			break;
 	}
+
+	return(TRUE);
 }
 
-EXPORT void WJEHash(WJElement document, WJEHashCB update, void *context)
+EXPORT XplBool WJEHash(WJElement document, WJEHashCB update, void *context)
 {
-	_WJEHash(document, 0, update, context);
+	return(_WJEHash(document, 0, update, context));
 }
 
 
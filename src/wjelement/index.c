@@ -0,0 +1,282 @@
+/*
+    This file is part of WJElement.
+
+    WJElement is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation.
+
+    WJElement is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with WJElement.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "element.h"
+#include <ctype.h>
+
+/*
+	Name index for large objects
+
+	Looking up a child by name normally requires walking the list of children,
+	which makes loading an object with many members O(n^2) since every new
+	member is checked for a duplicate name.
+
+	Once an object has WJE_INDEX_MIN_COUNT children an open addressing hash
+	table of the children is built the first time a name is looked up, and it
+	is kept up to date by the functions that add, remove and rename children.
+	Smaller objects are never indexed and are searched as they always have been.
+
+	The hash is calculated on the lower case version of the name so that the
+	same table can be used for case sensitive and case insensitive lookups.
+*/
+
+/* A slot that used to hold an element, which must not end a probe */
+#define WJE_INDEX_REMOVED		((WJElement) &WJEIndexRemoved)
+static char WJEIndexRemoved;
+
+typedef struct {
+	uint32				hash;
+	WJElement			e;
+} WJEIndexSlot;
+
+struct WJEIndex {
+	/* The index was allocated from the container's arena, and is not free'd */
+	XplBool				arena;
+
+	/* The number of slots, which is always a power of 2 */
+	size_t				size;
+
+	/* The number of slots holding an element */
+	size_t				used;
+
+	/* The number of slots holding WJE_INDEX_REMOVED */
+	size_t				removed;
+
+	WJEIndexSlot		slots[];
+};
+
+static uint32 WJEIndexHash(const char *name, size_t len)
+{
+	uint32		h = 2166136261U;
+
+	while (len--) {
+		h ^= (uint32) tolower((unsigned char) *(name++));
+		h *= 16777619U;
+	}
+
+	return(h);
+}
+
+static XplBool WJEIndexMatch(WJElement e, const char *name, size_t len, WJEAction action)
+{
+	/* A name that was shared from a symbol table may be the same pointer */
+	return(e->name && (e->name == name || !wstrncmp(e->name, name, len, action)) &&
+		!e->name[len]);
+}
+
+static void WJEIndexInsert(WJEIndex *index, WJElement e, uint32 hash)
+{
+	size_t		i;
+	size_t		mask = index->size - 1;
+
+	for (i = hash & mask; ; i = (i + 1) & mask) {
+		if (!index->slots[i].e) {
+			index->used++;
+			break;
+		}
+
+		if (index->slots[i].e == WJE_INDEX_REMOVED) {
+			index->removed--;
+			index->used++;
+			break;
+		}
+	}
+
+	index->slots[i].hash	= hash;
+	index->slots[i].e		= e;
+}
+
+/* Build a new index for all current children of container */
+static WJEIndex * WJEIndexBuild(WJElement container, size_t count)
+{
+	WJEArena	*arena = ((_WJElement *) container)->arena;
+	WJEIndex	*index;
+	WJElement	e;
+	size_t		size = 64;
+
+	while (size < count * 2) {
+		size <<= 1;
+	}
+
+	if (arena) {
+		index = WJEArenaAlloc(arena, sizeof(WJEIndex) + (size * sizeof(WJEIndexSlot)));
+	} else {
+		index = MemMalloc(sizeof(WJEIndex) + (size * sizeof(WJEIndexSlot)));
+	}
+
+	if (!index) {
+		return(NULL);
+	}
+	memset(index, 0, sizeof(WJEIndex) + (size * sizeof(WJEIndexSlot)));
+	index->arena	= arena ? TRUE : FALSE;
+	index->size		= size;
+
+	for (e = container->child; e; e = e->next) {
+		if (e->name) {
+			WJEIndexInsert(index, e, WJEIndexHash(e->name, strlen(e->name)));
+		}
+	}
+
+	return(index);
+}
+
+void _WJEIndexAdd(_WJElement *container, WJElement e)
+{
+	WJEIndex	*index;
+
+	if (!(index = container->index) || !e->name) {
+		return;
+	}
+
+	if ((index->used + index->removed + 1) * 2 > index->size) {
+		/*
+			Rebuild the table, which drops any removed slots and grows it if
+			needed. The new child has already been linked to the container.
+		*/
+		container->index = WJEIndexBuild((WJElement) container, index->used + 1);
+		if (!index->arena) {
+			MemFree(index);
+		}
+		return;
+	}
+
+	WJEIndexInsert(index, e, WJEIndexHash(e->name, strlen(e->name)));
+}
+
+void _WJEIndexRemove(_WJElement *container, WJElement e)
+{
+	WJEIndex	*index;
+	size_t		i, mask;
+
+	if (!(index = container->index) || !e->name) {
+		return;
+	}
+
+	mask = index->size - 1;
+	for (i = WJEIndexHash(e->name, strlen(e->name)) & mask;
+		index->slots[i].e; i = (i + 1) & mask
+	) {
+		if (index->slots[i].e == e) {
+			index->slots[i].e = WJE_INDEX_REMOVED;
+			index->used--;
+			index->removed++;
+			return;
+		}
+	}
+}
+
+void _WJEIndexFree(_WJElement *container)
+{
+	if (container->index) {
+		if (!container->index->arena) {
+			MemFree(container->index);
+		}
+		container->index = NULL;
+	}
+}
+
+/*
+	Materialize every part of a document and build the index of every object in
+	it that is large enough to use one, so that the document can then be read
+	without anything being modified. FALSE is returned if part of it could not
+	be materialized or indexed.
+*/
+XplBool _WJEIndexAll(WJElement container)
+{
+	_WJElement	*c = (_WJElement *) container;
+	WJElement	e;
+
+	if (!container) {
+		return(TRUE);
+	}
+
+	if (!WJEMaterialized(container)) {
+		return(FALSE);
+	}
+
+	if (!c->index && container->count >= WJE_INDEX_MIN_COUNT &&
+		WJR_TYPE_OBJECT == container->type &&
+		!(c->index = WJEIndexBuild(container, container->count))
+	) {
+		return(FALSE);
+	}
+
+	for (e = container->child; e; e = e->next) {
+		if (!_WJEIndexAll(e)) {
+			return(FALSE);
+		}
+	}
+
+	return(TRUE);
+}
+
+/*
+	Find the first child of container with the specified name, ignoring 'skip'
+	if it is non-NULL. The name does not need to be terminated.
+*/
+WJElement WJEFindChild(WJElement container, const char *name, size_t len, WJEAction action, WJElement skip)
+{
+	_WJElement	*c = (_WJElement *) container;
+	WJEIndex	*index;
+	WJElement	e, found;
+	size_t		i, mask;
+	uint32		hash;
+	int			matches;
+
+	if (!container || !name || !WJEMaterialized(container)) {
+		return(NULL);
+	}
+
+	if (!(index = c->index) && container->count >= WJE_INDEX_MIN_COUNT &&
+		WJR_TYPE_OBJECT == container->type
+	) {
+		index = c->index = WJEIndexBuild(container, container->count);
+	}
+
+	if (index) {
+		hash	= WJEIndexHash(name, len);
+		mask	= index->size - 1;
+		found	= NULL;
+		matches	= 0;
+
+		for (i = hash & mask; (e = index->slots[i].e); i = (i + 1) & mask) {
+			if (e != WJE_INDEX_REMOVED && e != skip &&
+				index->slots[i].hash == hash && WJEIndexMatch(e, name, len, action)
+			) {
+				found = e;
+				matches++;
+			}
+		}
+
+		if (matches <= 1) {
+			return(found);
+		}
+
+		/*
+			There is more than one child with this name, so the list has to be
+			walked to find the first one.
+		*/
+	}
+
+	for (e = container->child; e; e = e->next) {
+		if (e != skip && WJEIndexMatch(e, name, len, action)) {
+			return(e);
+		}
+	}
+
+	return(NULL);
+}
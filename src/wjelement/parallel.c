@@ -0,0 +1,857 @@
+/*
+    This file is part of WJElement.
+
+    WJElement is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation.
+
+    WJElement is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with WJElement.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "element.h"
+
+#ifndef _WIN32
+#include <pthread.h>
+#include <unistd.h>
+#define WJE_PARALLEL_THREADS
+#endif
+
+/*
+	Parallel loading
+
+	A newline delimited stream can be split anywhere there is a newline, since
+	a newline can only appear between values. The caller's thread reads the
+	input and splits it into chunks that end on a newline, which are queued for
+	a pool of workers. Each worker has a reader buffer of its own, and loads
+	the records in a chunk with WJENextDocument() exactly as a single threaded
+	loop would.
+
+	When the records must be delivered in order each worker keeps the records
+	it has loaded with the chunk, and whichever worker completes the oldest
+	outstanding chunk delivers it, along with any chunks after it that are
+	already complete. Otherwise each record is delivered by the worker that
+	loaded it as soon as it has been loaded.
+
+	No more than WJE_PARALLEL_CHUNKS chunks per worker may be outstanding at
+	once, which limits the memory used when the consumer is slower than the
+	workers, or when one chunk holds up the delivery of those after it.
+
+	Without threads the chunks are loaded by the caller's thread, one at a
+	time, which still delivers the records in order.
+*/
+#ifndef WJE_PARALLEL_CHUNK_SIZE
+#define WJE_PARALLEL_CHUNK_SIZE		(1024 * 1024)
+#endif
+
+#define WJE_PARALLEL_CHUNKS			4
+#define WJE_PARALLEL_MAX_THREADS	256
+#define WJE_PARALLEL_READER_SIZE	(64 * 1024)
+
+typedef struct WJEChunk {
+	struct WJEChunk	*next;
+	uint64			seq;
+
+	const char		*data;
+	size_t			length;
+
+	/* Set if the data belongs to the chunk */
+	char			*buffer;
+
+	/* The records loaded from the chunk, when they are delivered in order */
+	WJElement		*docs;
+	size_t			count;
+	size_t			size;
+
+	/* Set if any of the records in the chunk were malformed */
+	XplBool			malformed;
+} WJEChunk;
+
+typedef struct {
+	uint32			flags;
+	WJELoadCB		loadcb;
+	WJERecordCB		cb;
+	void			*data;
+	const char		*file;
+	int				line;
+
+	/* Set once the consumer has asked to stop, or something has failed */
+	volatile XplBool	stop;
+	XplBool			failed;
+
+	/* Set once a chunk with a malformed record has been loaded */
+	XplBool			malformed;
+
+	/* The reader buffer used when loading on the caller's thread */
+	char			*buffer;
+
+	int				threads;
+#ifdef WJE_PARALLEL_THREADS
+	pthread_t		*workers;
+
+	pthread_mutex_t	lock;
+	pthread_cond_t	work;
+	pthread_cond_t	room;
+
+	/* Chunks waiting for a worker */
+	WJEChunk		*head;
+	WJEChunk		*tail;
+	XplBool			done;
+
+	uint64			issued;
+	uint64			finished;
+
+	/* Loaded chunks waiting to be delivered, indexed by seq % slots */
+	WJEChunk		**ready;
+	size_t			slots;
+	XplBool			delivering;
+#endif
+} WJEParallel;
+
+static size_t WJEChunkCallback(char *buffer, size_t length, size_t seen, void *userdata)
+{
+	WJEChunk	*chunk	= (WJEChunk *) userdata;
+
+	if (seen >= chunk->length) {
+		return(0);
+	}
+
+	if (length > chunk->length - seen) {
+		length = chunk->length - seen;
+	}
+	memcpy(buffer, chunk->data + seen, length);
+
+	return(length);
+}
+
+static WJEChunk * WJENewChunk(const char *data, size_t length, char *buffer)
+{
+	WJEChunk	*chunk;
+
+	if ((chunk = MemMalloc(sizeof(WJEChunk)))) {
+		memset(chunk, 0, sizeof(WJEChunk));
+
+		chunk->data		= data;
+		chunk->length	= length;
+		chunk->buffer	= buffer;
+	} else if (buffer) {
+		MemFree(buffer);
+	}
+
+	return(chunk);
+}
+
+static void WJEFreeChunk(WJEChunk *chunk)
+{
+	while (chunk->count) {
+		WJECloseDocument(chunk->docs[--chunk->count]);
+	}
+
+	if (chunk->docs) {
+		MemFree(chunk->docs);
+	}
+	if (chunk->buffer) {
+		MemFree(chunk->buffer);
+	}
+	MemFree(chunk);
+}
+
+/* Hand a record to the consumer, which owns it from then on */
+static void WJEDeliver(WJEParallel *p, WJElement doc)
+{
+	if (p->stop) {
+		WJECloseDocument(doc);
+	} else if (!p->cb(doc, p->data)) {
+		p->stop = TRUE;
+	}
+}
+
+static void WJEDeliverChunk(WJEParallel *p, WJEChunk *chunk)
+{
+	size_t		i;
+
+	for (i = 0; i < chunk->count; i++) {
+		WJEDeliver(p, chunk->docs[i]);
+	}
+	chunk->count = 0;
+}
+
+static void WJELoadChunk(WJEParallel *p, WJEChunk *chunk, char *buffer, XplBool keep)
+{
+	WJReader	reader;
+	WJElement	doc;
+	WJElement	*docs;
+
+	if (p->stop) {
+		return;
+	}
+
+	if (!buffer || !(reader = WJROpenDocument(WJEChunkCallback, chunk, buffer, WJE_PARALLEL_READER_SIZE))) {
+		p->failed = TRUE;
+		p->stop = TRUE;
+		return;
+	}
+
+	while (!p->stop) {
+		if (!_WJENextDocument(reader, p->flags, p->loadcb, p->data, &doc, p->file, p->line)) {
+			if (EILSEQ != errno) {
+				/* The end of the chunk */
+				break;
+			}
+
+			/* Skip the malformed record and carry on with the next line */
+			chunk->malformed = TRUE;
+			continue;
+		}
+
+		if (!doc) {
+			/* The record was rejected by the load callback */
+			continue;
+		}
+
+		if (!keep) {
+			WJEDeliver(p, doc);
+			continue;
+		}
+
+		if (chunk->count == chunk->size) {
+			if (!(docs = MemRealloc(chunk->docs, (chunk->size + 64) * 2 * sizeof(WJElement)))) {
+				WJECloseDocument(doc);
+				p->failed = TRUE;
+				p->stop = TRUE;
+				break;
+			}
+
+			chunk->docs = docs;
+			chunk->size = (chunk->size + 64) * 2;
+		}
+		chunk->docs[chunk->count++] = doc;
+	}
+
+	WJRCloseDocument(reader);
+}
+
+#ifdef WJE_PARALLEL_THREADS
+static void WJEFinishChunk(WJEParallel *p, WJEChunk *chunk)
+{
+	pthread_mutex_lock(&p->lock);
+
+	if (chunk->malformed) {
+		p->malformed = TRUE;
+	}
+
+	if (!(p->flags & WJE_STREAM_ORDERED)) {
+		p->finished++;
+		pthread_cond_signal(&p->room);
+		pthread_mutex_unlock(&p->lock);
+
+		WJEFreeChunk(chunk);
+		return;
+	}
+
+	p->ready[chunk->seq % p->slots] = chunk;
+	if (p->delivering) {
+		/* The worker that is delivering will pick this chunk up if it's next */
+		pthread_mutex_unlock(&p->lock);
+		return;
+	}
+	p->delivering = TRUE;
+
+	while ((chunk = p->ready[p->finished % p->slots]) && chunk->seq == p->finished) {
+		p->ready[p->finished % p->slots] = NULL;
+		pthread_mutex_unlock(&p->lock);
+
+		WJEDeliverChunk(p, chunk);
+		WJEFreeChunk(chunk);
+
+		pthread_mutex_lock(&p->lock);
+		p->finished++;
+		pthread_cond_signal(&p->room);
+	}
+
+	p->delivering = FALSE;
+	pthread_mutex_unlock(&p->lock);
+}
+
+static void * WJEParallelWorker(void *arg)
+{
+	WJEParallel	*p		= (WJEParallel *) arg;
+	WJEChunk	*chunk;
+	char		*buffer;
+
+	buffer = MemMalloc(WJE_PARALLEL_READER_SIZE);
+
+	pthread_mutex_lock(&p->lock);
+	for (;;) {
+		while (!p->head && !p->done) {
+			pthread_cond_wait(&p->work, &p->lock);
+		}
+
+		if (!(chunk = p->head)) {
+			break;
+		}
+		if (!(p->head = chunk->next)) {
+			p->tail = NULL;
+		}
+		pthread_mutex_unlock(&p->lock);
+
+		WJELoadChunk(p, chunk, buffer, (p->flags & WJE_STREAM_ORDERED) ? TRUE : FALSE);
+		WJEFinishChunk(p, chunk);
+
+		pthread_mutex_lock(&p->lock);
+	}
+	pthread_mutex_unlock(&p->lock);
+
+	if (buffer) {
+		MemFree(buffer);
+	}
+
+	/* The callbacks may have used selectors on this thread */
+	WJEFreeSelectorCache();
+	return(NULL);
+}
+#endif
+
+static void WJEParallelStart(WJEParallel *p, int threads, uint32 flags, WJELoadCB loadcb, WJERecordCB cb, void *data, const char *file, const int line)
+{
+	memset(p, 0, sizeof(WJEParallel));
+
+	p->flags	= flags;
+	p->loadcb	= loadcb;
+	p->cb		= cb;
+	p->data		= data;
+	p->file		= file;
+	p->line		= line;
+
+#ifdef WJE_PARALLEL_THREADS
+	if (threads <= 0) {
+		threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+	}
+	if (threads > WJE_PARALLEL_MAX_THREADS) {
+		threads = WJE_PARALLEL_MAX_THREADS;
+	}
+
+	if (threads > 1) {
+		p->slots	= threads * WJE_PARALLEL_CHUNKS;
+		p->ready	= MemMalloc(p->slots * sizeof(WJEChunk *));
+		p->workers	= MemMalloc(threads * sizeof(pthread_t));
+
+		if (p->ready && p->workers) {
+			memset(p->ready, 0, p->slots * sizeof(WJEChunk *));
+
+			pthread_mutex_init(&p->lock, NULL);
+			pthread_cond_init(&p->work, NULL);
+			pthread_cond_init(&p->room, NULL);
+
+			for (p->threads = 0; p->threads < threads; p->threads++) {
+				if (pthread_create(&p->workers[p->threads], NULL, WJEParallelWorker, p)) {
+					break;
+				}
+			}
+
+			if (p->threads) {
+				return;
+			}
+
+			pthread_cond_destroy(&p->room);
+			pthread_cond_destroy(&p->work);
+			pthread_mutex_destroy(&p->lock);
+		}
+
+		/* Fall back to loading on the caller's thread */
+		if (p->ready) {
+			MemRelease(&p->ready);
+		}
+		if (p->workers) {
+			MemRelease(&p->workers);
+		}
+	}
+#endif
+
+	p->buffer = MemMalloc(WJE_PARALLEL_READER_SIZE);
+}
+
+/*
+	Queue a chunk to be loaded, waiting for room if too many are outstanding.
+	The chunk is always consumed, and FALSE is returned once loading has
+	stopped.
+*/
+static XplBool WJEParallelQueue(WJEParallel *p, WJEChunk *chunk)
+{
+	if (!chunk) {
+		p->failed = TRUE;
+		p->stop = TRUE;
+		return(FALSE);
+	}
+
+#ifdef WJE_PARALLEL_THREADS
+	if (p->threads) {
+		pthread_mutex_lock(&p->lock);
+		while (!p->stop && p->issued - p->finished >= p->slots) {
+			pthread_cond_wait(&p->room, &p->lock);
+		}
+
+		if (p->stop) {
+			pthread_mutex_unlock(&p->lock);
+			WJEFreeChunk(chunk);
+			return(FALSE);
+		}
+
+		chunk->seq = p->issued++;
+		if (p->tail) {
+			p->tail->next = chunk;
+		} else {
+			p->head = chunk;
+		}
+		p->tail = chunk;
+
+		pthread_cond_signal(&p->work);
+		pthread_mutex_unlock(&p->lock);
+		return(TRUE);
+	}
+#endif
+
+	WJELoadChunk(p, chunk, p->buffer, FALSE);
+	if (chunk->malformed) {
+		p->malformed = TRUE;
+	}
+	WJEFreeChunk(chunk);
+
+	return(!p->stop);
+}
+
+static XplBool WJEParallelFinish(WJEParallel *p)
+{
+#ifdef WJE_PARALLEL_THREADS
+	int			i;
+
+	if (p->threads) {
+		pthread_mutex_lock(&p->lock);
+		p->done = TRUE;
+		pthread_cond_broadcast(&p->work);
+		pthread_mutex_unlock(&p->lock);
+
+		for (i = 0; i < p->threads; i++) {
+			pthread_join(p->workers[i], NULL);
+		}
+
+		pthread_cond_destroy(&p->room);
+		pthread_cond_destroy(&p->work);
+		pthread_mutex_destroy(&p->lock);
+
+		MemRelease(&p->ready);
+		MemRelease(&p->workers);
+	}
+#endif
+
+	if (p->buffer) {
+		MemRelease(&p->buffer);
+	}
+
+	if (p->failed) {
+		errno = ENOMEM;
+	} else if (p->malformed) {
+		/* Everything else was loaded, but the caller must know about it */
+		errno = EILSEQ;
+		return(FALSE);
+	}
+	return(!p->stop);
+}
+
+EXPORT XplBool _WJELoadParallelMem(const char *json, size_t length, int threads, uint32 flags, WJELoadCB loadcb, WJERecordCB cb, void *data, const char *file, const int line)
+{
+	WJEParallel	p;
+	const char	*end;
+	size_t		size;
+
+	if (!cb || (!json && length)) {
+		errno = EINVAL;
+		return(FALSE);
+	}
+
+	WJEParallelStart(&p, threads, flags, loadcb, cb, data, file, line);
+
+	while (length && !p.stop) {
+		size = length;
+
+		if (size > WJE_PARALLEL_CHUNK_SIZE) {
+			/* End the chunk on the first newline past the chunk size */
+			if ((end = memchr(json + WJE_PARALLEL_CHUNK_SIZE, '\n', length - WJE_PARALLEL_CHUNK_SIZE))) {
+				size = end + 1 - json;
+			}
+		}
+
+		if (!WJEParallelQueue(&p, WJENewChunk(json, size, NULL))) {
+			break;
+		}
+
+		json	+= size;
+		length	-= size;
+	}
+
+	return(WJEParallelFinish(&p));
+}
+
+EXPORT XplBool _WJELoadParallel(WJReadCallback callback, void *userdata, int threads, uint32 flags, WJELoadCB loadcb, WJERecordCB cb, void *data, const char *file, const int line)
+{
+	WJEParallel	p;
+	char		*buffer;
+	char		*next;
+	size_t		size, used, end, r;
+	size_t		seen	= 0;
+	XplBool		eof		= FALSE;
+
+	if (!callback || !cb) {
+		errno = EINVAL;
+		return(FALSE);
+	}
+
+	WJEParallelStart(&p, threads, flags, loadcb, cb, data, file, line);
+
+	size	= WJE_PARALLEL_CHUNK_SIZE;
+	used	= 0;
+	buffer	= MemMalloc(size);
+
+	while (buffer && !eof && !p.stop) {
+		while (used < size && (r = callback(buffer + used, size - used, seen, userdata)) > 0) {
+			used += r;
+			seen += r;
+		}
+		eof = (used < size);
+
+		if (eof) {
+			end = used;
+		} else {
+			/* End the chunk after the last newline */
+			for (end = used; end > 0 && buffer[end - 1] != '\n'; end--);
+
+			if (!end) {
+				/* A single record is larger than the buffer */
+				if (!(next = MemRealloc(buffer, size * 2))) {
+					p.failed = TRUE;
+					p.stop = TRUE;
+					break;
+				}
+
+				buffer	= next;
+				size	*= 2;
+				continue;
+			}
+		}
+
+		/*
+			The rest of the buffer holds the start of the next chunk, and has to
+			be copied before this chunk is queued since a worker may free it.
+		*/
+		next = NULL;
+		if (!eof) {
+			size = WJE_PARALLEL_CHUNK_SIZE;
+			if (size < (used - end) * 2) {
+				size = (used - end) * 2;
+			}
+
+			if ((next = MemMalloc(size))) {
+				memcpy(next, buffer + end, used - end);
+			}
+		}
+
+		if (end) {
+			WJEParallelQueue(&p, WJENewChunk(buffer, end, buffer));
+		} else {
+			MemFree(buffer);
+		}
+
+		buffer	= next;
+		used	-= end;
+	}
+
+	if (buffer) {
+		MemFree(buffer);
+	} else if (!eof) {
+		p.failed = TRUE;
+		p.stop = TRUE;
+	}
+
+	return(WJEParallelFinish(&p));
+}
+
+EXPORT XplBool _WJELoadParallelPath(const char *path, int threads, uint32 flags, WJELoadCB loadcb, WJERecordCB cb, void *data, const char *file, const int line)
+{
+	XplFileMap	map;
+	FILE		*f;
+	XplBool		result;
+	size_t		skip	= 0;
+
+	if (!path || !cb) {
+		errno = EINVAL;
+		return(FALSE);
+	}
+
+	if (XplFileMapOpenPath(&map, path)) {
+		if (map.length >= 3 && map.data[0] == (char) 0xEF &&
+			map.data[1] == (char) 0xBB && map.data[2] == (char) 0xBF
+		) {
+			/* Ignore the BOM, as WJRFileCallback() does */
+			skip = 3;
+		}
+
+		result = _WJELoadParallelMem(map.data + skip, map.length - skip, threads, flags, loadcb, cb, data, file, line);
+
+		XplFileMapClose(&map);
+		return(result);
+	}
+
+	if (!(f = fopen(path, "rb"))) {
+		return(FALSE);
+	}
+
+	result = _WJELoadParallel(WJRFileCallback, f, threads, flags, loadcb, cb, data, file, line);
+
+	fclose(f);
+	return(result);
+}
+
+/*
+	Parallel arrays
+
+	A document that consists of a single large array is split into batches of
+	elements by a quick scan that only looks for the commas at the top level of
+	the array. Each batch is then parsed by the in memory parser on one of the
+	workers, and the batches are linked into the array in order once they are
+	all complete.
+
+	There are several batches per worker so that a batch that takes longer than
+	the others does not hold up the whole load for long.
+*/
+#define WJE_ARRAY_BATCHES			8
+#define WJE_ARRAY_MIN_BATCH			(64 * 1024)
+
+typedef struct {
+	const char		*json;
+	size_t			length;
+
+	WJElement		first;
+	WJElement		last;
+	int				count;
+	int				changes;
+	XplBool			ok;
+} WJEArrayBatch;
+
+typedef struct {
+	WJElement		array;
+	WJELoadCB		loadcb;
+	void			*data;
+	const char		*file;
+	int				line;
+
+	WJEArrayBatch	*batches;
+	size_t			count;
+	size_t			next;
+
+#ifdef WJE_PARALLEL_THREADS
+	pthread_mutex_t	lock;
+#endif
+} WJEArrayLoad;
+
+static void WJEArrayLoadBatch(WJEArrayLoad *load, WJEArrayBatch *batch)
+{
+	batch->ok = _WJEParseElements(batch->json, batch->length, load->array,
+		load->loadcb, load->data, &batch->first, &batch->last, &batch->count,
+		&batch->changes, load->file, load->line);
+}
+
+#ifdef WJE_PARALLEL_THREADS
+static void * WJEArrayWorker(void *arg)
+{
+	WJEArrayLoad	*load	= (WJEArrayLoad *) arg;
+	size_t			i;
+
+	for (;;) {
+		pthread_mutex_lock(&load->lock);
+		i = load->next++;
+		pthread_mutex_unlock(&load->lock);
+
+		if (i >= load->count) {
+			break;
+		}
+		WJEArrayLoadBatch(load, &load->batches[i]);
+	}
+
+	/* The load callback may have used selectors on this thread */
+	WJEFreeSelectorCache();
+	return(NULL);
+}
+#endif
+
+EXPORT WJElement _WJEOpenArrayParallel(const char *json, size_t length, int threads, WJELoadCB loadcb, void *data, const char *file, const int line)
+{
+	WJEArrayLoad	load;
+	WJEArrayBatch	*batch;
+	const char		**starts	= NULL;
+	const char		*end;
+	size_t			size, i;
+	XplBool			ok			= TRUE;
+	WJElement		doc			= NULL;
+#ifdef WJE_PARALLEL_THREADS
+	pthread_t		*workers	= NULL;
+	int				started		= 0;
+#endif
+
+	if (!json) {
+		errno = EINVAL;
+		return(NULL);
+	}
+
+#ifdef WJE_PARALLEL_THREADS
+	if (threads <= 0) {
+		threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+	}
+	if (threads > WJE_PARALLEL_MAX_THREADS) {
+		threads = WJE_PARALLEL_MAX_THREADS;
+	}
+#else
+	threads = 1;
+#endif
+
+	memset(&load, 0, sizeof(load));
+	load.loadcb	= loadcb;
+	load.data	= data;
+	load.file	= file;
+	load.line	= line;
+
+	size = length / (threads * WJE_ARRAY_BATCHES);
+	if (size < WJE_ARRAY_MIN_BATCH) {
+		size = WJE_ARRAY_MIN_BATCH;
+	}
+
+	/* The last batch may be up to a full batch over */
+	load.count = (length / size) + 2;
+
+	if (threads < 2 || length < 2 * WJE_ARRAY_MIN_BATCH ||
+		!(starts = MemMalloc(load.count * sizeof(char *))) ||
+		!_WJEParseSplitArray(json, length, size, starts, load.count, &load.count, &end) ||
+		!(load.batches = MemMalloc(load.count * sizeof(WJEArrayBatch)))
+	) {
+		/* Anything that isn't worth splitting, or can't be split, is parsed in the usual way */
+		if (starts) {
+			MemFree(starts);
+		}
+
+		_WJEParseBuffer((char *) json, length, FALSE, loadcb, data, &doc, file, line);
+		return(doc);
+	}
+
+	if ((loadcb && !loadcb(NULL, NULL, data, file, line)) ||
+		!(load.array = WJEArray(NULL, NULL, WJE_NEW))
+	) {
+		/* The consumer has rejected the document */
+		MemFree(starts);
+		MemFree(load.batches);
+		return(NULL);
+	}
+	MemUpdateOwner(load.array, file, line);
+
+	memset(load.batches, 0, load.count * sizeof(WJEArrayBatch));
+	for (i = 0; i < load.count; i++) {
+		load.batches[i].json	= starts[i];
+		load.batches[i].length	= ((i + 1 < load.count) ? starts[i + 1] : end) - starts[i];
+	}
+	MemFree(starts);
+
+#ifdef WJE_PARALLEL_THREADS
+	if ((size_t) threads > load.count) {
+		threads = (int) load.count;
+	}
+
+	pthread_mutex_init(&load.lock, NULL);
+	if ((workers = MemMalloc(threads * sizeof(pthread_t)))) {
+		for (; started < threads; started++) {
+			if (pthread_create(&workers[started], NULL, WJEArrayWorker, &load)) {
+				break;
+			}
+		}
+	}
+
+	if (started) {
+		for (i = 0; i < (size_t) started; i++) {
+			pthread_join(workers[i], NULL);
+		}
+	} else {
+		/* Load the batches on this thread instead */
+		for (i = 0; i < load.count; i++) {
+			WJEArrayLoadBatch(&load, &load.batches[i]);
+		}
+	}
+
+	if (workers) {
+		MemFree(workers);
+	}
+	pthread_mutex_destroy(&load.lock);
+#else
+	for (i = 0; i < load.count; i++) {
+		WJEArrayLoadBatch(&load, &load.batches[i]);
+	}
+#endif
+
+	/* Link the batches into the array, in order */
+	for (i = 0; i < load.count; i++) {
+		batch = &load.batches[i];
+
+		if (!batch->ok) {
+			ok = FALSE;
+		} else if (batch->first) {
+			if ((batch->first->prev = load.array->last)) {
+				load.array->last->next = batch->first;
+			} else {
+				load.array->child = batch->first;
+			}
+			load.array->last = batch->last;
+			load.array->count += batch->count;
+
+			/* Count them as a serial load would have */
+			load.array->changes += batch->changes;
+		}
+	}
+	MemFree(load.batches);
+
+	if (!ok) {
+		/* The array is not valid, so the result must match a failed parse */
+		_WJECloseDocument(load.array, file, line);
+		return(NULL);
+	}
+
+	return(load.array);
+}
+
+EXPORT WJElement _WJEOpenArrayParallelPath(const char *path, int threads, WJELoadCB loadcb, void *data, const char *file, const int line)
+{
+	XplFileMap	map;
+	WJReader	reader;
+	WJElement	doc		= NULL;
+
+	if (!path) {
+		errno = EINVAL;
+		return(NULL);
+	}
+
+	if (!XplFileMapOpenPath(&map, path)) {
+		/* Read anything that can't be mapped in the usual way */
+		if ((reader = WJROpenPathDocument(path, NULL, 0))) {
+			doc = _WJEOpenDocument(reader, NULL, loadcb, data, file, line);
+			WJRCloseDocument(reader);
+		}
+		return(doc);
+	}
+
+	/* Nothing refers to the mapping once it has been parsed */
+	doc = _WJEOpenArrayParallel(map.data, map.length, threads, loadcb, data, file, line);
+
+	XplFileMapClose(&map);
+	return(doc);
+}
@@ -0,0 +1,968 @@
+/*
+    This file is part of WJElement.
+
+    WJElement is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation.
+
+    WJElement is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with WJElement.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "element.h"
+#include <ctype.h>
+
+/*
+	In memory parser
+
+	WJEOpenDocument() reads a document through a WJReader, which copies the
+	document through a small buffer, and every name and string is then copied
+	again into the elements. When the entire document is already in memory it
+	can be parsed directly instead.
+
+	The same extensions to JSON that the WJReader allows are accepted here,
+	including python style comments, trailing commas and literals in any case.
+
+	When parsing in place the names and strings are unescaped within the source
+	buffer and the elements point directly into it. The elements themselves are
+	always allocated from an arena.
+
+	A lazy document only parses the top level of the document when it is opened.
+	Any object or array below that is skipped over, and remembers where it is
+	in the source so that its children can be parsed the first time they are
+	needed.
+*/
+
+/* Match the default maxdepth used by WJROpenDocument() */
+#define WJE_PARSE_MAXDEPTH		250
+
+typedef struct {
+	char			*pos;
+	char			*end;
+
+	/* Unescape names and strings within the source buffer */
+	XplBool			insitu;
+
+	/* Skip objects and arrays other than the root, and parse them on demand */
+	XplBool			lazy;
+
+	WJEArena		*arena;
+
+	WJELoadCB		loadcb;
+	void			*data;
+
+	uint32			depth;
+
+	const char		*file;
+	int				line;
+} WJEParser;
+
+static XplBool WJEParseValue(WJEParser *parser, _WJElement *parent, char *name, size_t len, _WJElement **result);
+
+static void WJEParseSpace(WJEParser *parser)
+{
+	for (; parser->pos < parser->end; parser->pos++) {
+		if ('#' == *parser->pos) {
+			/* Python style comment. Skip until the end of the line */
+			while (parser->pos < parser->end - 1 && '\n' != *parser->pos) {
+				parser->pos++;
+			}
+		} else if (!isspace((unsigned char) *parser->pos)) {
+			break;
+		}
+	}
+}
+
+/*
+	The value of a hex digit, decoded exactly as the WJReader does, which does
+	not check that it is actually a hex digit.
+*/
+#define WJEHexDigit(c)		((c) <= '9' ? (c) - '0' : (toupper((c)) & 7) + 9)
+
+/*
+	Unescape len bytes of a raw string into 'to', which may be the same as
+	'from' since an escape sequence is never shorter than what it results in.
+
+	Escape sequences are decoded exactly as WJRStringEx() decodes them, taking
+	the same number of characters whether or not they are valid hex digits. The
+	WJReader would take those characters from past the closing quote of a
+	string that ends in the middle of a sequence, which can't be done here, so
+	WJE_UNESCAPE_FAILED is returned for such a string instead and the caller
+	must fail, or fall back to a WJReader.
+
+	Returns the length of the result, which is not terminated.
+*/
+size_t WJEUnescape(char *to, const char *from, size_t len)
+{
+	const char		*end	= from + len;
+	char			*o		= to;
+	unsigned int	c, d;
+
+	while (from < end) {
+		if ('\\' != *from || from + 1 >= end) {
+			*(o++) = *(from++);
+			continue;
+		}
+
+		switch (toupper((unsigned char) from[1])) {
+			default:
+				/* Simply move the character over */
+				*(o++) = from[1];
+				from += 2;
+				break;
+
+			case 'B': *(o++) = '\b'; from += 2; break;
+			case 'F': *(o++) = '\f'; from += 2; break;
+			case 'N': *(o++) = '\n'; from += 2; break;
+			case 'R': *(o++) = '\r'; from += 2; break;
+			case 'T': *(o++) = '\t'; from += 2; break;
+
+			case 'X':
+				/* Two hex digits to a non-utf-8 byte */
+				if (end - from < 4) {
+					return(WJE_UNESCAPE_FAILED);
+				}
+
+				*(o++) = (char) ((WJEHexDigit(from[2]) << 4) + WJEHexDigit(from[3]));
+				from += 4;
+				break;
+
+			case 'U':
+				/* Four hex digits to a utf-8 encoding */
+				if (end - from < 6) {
+					return(WJE_UNESCAPE_FAILED);
+				}
+
+				c = (WJEHexDigit(from[2]) << 12) + (WJEHexDigit(from[3]) << 8) +
+					(WJEHexDigit(from[4]) << 4) + (WJEHexDigit(from[5]));
+
+				if (c >= 0xD800 && c <= 0xDBFF &&
+					end - from >= 8 && '\\' == from[6] &&
+					'U' == toupper((unsigned char) from[7])
+				) {
+					/* A high surrogate must be followed by a low surrogate */
+					if (end - from < 12) {
+						return(WJE_UNESCAPE_FAILED);
+					}
+
+					d = (WJEHexDigit(from[8]) << 12) + (WJEHexDigit(from[9]) << 8) +
+						(WJEHexDigit(from[10]) << 4) + (WJEHexDigit(from[11]));
+
+					if (d >= 0xDC00 && d <= 0xDFFF) {
+						c = 0x10000 + (((c & 0x3ff) << 10) | (d & 0x3ff));
+						from += 12;
+
+						*(o++) = (char) (0xF0 | (c >> 18));
+						*(o++) = (char) (0x80 | ((c >> 12) & 0x3F));
+						*(o++) = (char) (0x80 | ((c >> 6) & 0x3F));
+						*(o++) = (char) (0x80 | (c & 0x3F));
+						break;
+					}
+				}
+				from += 6;
+
+				if (c < 0x80) {
+					*(o++) = (char) c;
+				} else if (c < 0x800) {
+					*(o++) = (char) (0xC0 | (c >> 6));
+					*(o++) = (char) (0x80 | (c & 0x3F));
+				} else if (c >= 0xD800 && c <= 0xDFFF) {
+					/* An unpaired or low surrogate is dropped */
+					;
+				} else {
+					*(o++) = (char) (0xE0 | (c >> 12));
+					*(o++) = (char) (0x80 | ((c >> 6) & 0x3F));
+					*(o++) = (char) (0x80 | (c & 0x3F));
+				}
+				break;
+		}
+	}
+
+	return(o - to);
+}
+
+/*
+	Find the closing quote of the string starting at parser->pos, which must
+	point just past the opening quote.
+*/
+static char * WJEParseStringEnd(WJEParser *parser, XplBool *escaped)
+{
+	char		*s = parser->pos;
+	char		*q = NULL;
+	char		*b;
+
+	*escaped = FALSE;
+	while (s < parser->end) {
+		if ((!q || q < s) && !(q = memchr(s, '"', parser->end - s))) {
+			break;
+		}
+
+		if (!(b = memchr(s, '\\', q - s))) {
+			return(q);
+		}
+
+		/* Skip the escaped character, which may be the quote */
+		*escaped = TRUE;
+		s = b + 2;
+	}
+
+	return(NULL);
+}
+
+/*
+	Parse the string starting at parser->pos, which must point at the opening
+	quote.
+
+	When parsing in place the result is unescaped and terminated within the
+	source buffer. Otherwise a terminated copy is allocated from the arena if
+	tmp is NULL, or is placed in *tmp if it is large enough or in a newly
+	allocated *tmp if not. If the string needs neither unescaping nor 'terminate'
+	then the result may point into the source buffer without a copy.
+*/
+static XplBool WJEParseString(WJEParser *parser, XplBool terminate, char **tmp, size_t tmpsize, char **value, size_t *len)
+{
+	XplBool		escaped;
+	char		*start	= parser->pos + 1;
+	char		*q;
+	char		*o;
+
+	parser->pos = start;
+	if (!(q = WJEParseStringEnd(parser, &escaped))) {
+		return(FALSE);
+	}
+	parser->pos = q + 1;
+
+	if (parser->insitu) {
+		*len = escaped ? WJEUnescape(start, start, q - start) : (size_t) (q - start);
+		if (WJE_UNESCAPE_FAILED == *len) {
+			return(FALSE);
+		}
+		start[*len] = '\0';
+
+		*value = start;
+		return(TRUE);
+	}
+
+	if (tmp && !escaped && !terminate) {
+		*len = q - start;
+		*value = start;
+		return(TRUE);
+	}
+
+	if (!tmp) {
+		o = WJEArenaAlloc(parser->arena, (q - start) + 1);
+	} else if ((size_t) (q - start) < tmpsize) {
+		o = *tmp;
+	} else {
+		o = *tmp = MemMalloc((q - start) + 1);
+	}
+
+	if (!o) {
+		return(FALSE);
+	}
+
+	if (escaped) {
+		if (WJE_UNESCAPE_FAILED == (*len = WJEUnescape(o, start, q - start))) {
+			return(FALSE);
+		}
+	} else {
+		memcpy(o, start, (*len = q - start));
+	}
+	o[*len] = '\0';
+
+	*value = o;
+	return(TRUE);
+}
+
+static XplBool WJEParseNumber(WJEParser *parser, _WJElement *e)
+{
+	char		*end;
+
+	if ('-' == *parser->pos) {
+		e->value.number.negative = TRUE;
+		parser->pos++;
+	}
+
+	end = WJRParseNumber(parser->pos, parser->end, &e->value.number.hasDecimalPoint,
+			&e->value.number.i, &e->value.number.d);
+	if (end == parser->pos) {
+		return(FALSE);
+	}
+
+	/* Skip anything else that looks like part of the number, as WJReader does */
+	for (parser->pos = end; parser->pos < parser->end && (
+		isalnum((unsigned char) *parser->pos) ||
+		'.' == *parser->pos || '+' == *parser->pos || '-' == *parser->pos);
+		parser->pos++
+	);
+
+#ifdef WJE_DISTINGUISH_INTEGER_TYPE
+	if (!e->value.number.hasDecimalPoint) {
+		e->pub.type = WJR_TYPE_INTEGER;
+	}
+#endif
+
+	return(TRUE);
+}
+
+/*
+	Skip past the value at parser->pos without building any elements. The value
+	is not validated beyond what is needed to find the end of it.
+*/
+static XplBool WJEParseSkip(WJEParser *parser)
+{
+	XplBool		escaped;
+	char		*q;
+	uint32		depth = 0;
+
+	do {
+		WJEParseSpace(parser);
+		if (parser->pos >= parser->end) {
+			return(FALSE);
+		}
+
+		switch (*parser->pos) {
+			case '"':
+				parser->pos++;
+				if (!(q = WJEParseStringEnd(parser, &escaped))) {
+					return(FALSE);
+				}
+				parser->pos = q + 1;
+				break;
+
+			case '{': case '[':
+				depth++;
+				parser->pos++;
+				break;
+
+			case '}': case ']':
+				if (!depth) {
+					return(FALSE);
+				}
+				depth--;
+				parser->pos++;
+				break;
+
+			case ',': case ':':
+				if (!depth) {
+					return(FALSE);
+				}
+				parser->pos++;
+				break;
+
+			default:
+				for (; parser->pos < parser->end && (
+					isalnum((unsigned char) *parser->pos) ||
+					'.' == *parser->pos || '+' == *parser->pos || '-' == *parser->pos);
+					parser->pos++
+				);
+				break;
+		}
+	} while (depth);
+
+	return(TRUE);
+}
+
+static XplBool WJEParseObject(WJEParser *parser, _WJElement *e)
+{
+	char		buffer[256];
+	char		*tmp;
+	char		*name;
+	size_t		len;
+	XplBool		r;
+
+	for (parser->pos++;;) {
+		WJEParseSpace(parser);
+
+		if (parser->pos >= parser->end) {
+			return(FALSE);
+		}
+
+		if ('}' == *parser->pos) {
+			parser->pos++;
+			return(TRUE);
+		}
+
+		if ('"' != *parser->pos) {
+			return(FALSE);
+		}
+
+		/*
+			The name needs to be terminated if there is a load callback, so
+			that it can be passed to the callback.
+		*/
+		tmp = buffer;
+		if (!WJEParseString(parser, parser->loadcb ? TRUE : FALSE, &tmp,
+			sizeof(buffer), &name, &len)
+		) {
+			return(FALSE);
+		}
+
+		WJEParseSpace(parser);
+		if (parser->pos >= parser->end || ':' != *parser->pos) {
+			r = FALSE;
+		} else {
+			parser->pos++;
+			WJEParseSpace(parser);
+
+			if ((len && WJEFindChild((WJElement) e, name, len, WJE_GET, NULL)) ||
+				(parser->loadcb && !parser->loadcb((WJElement) e, len ? name : NULL,
+					parser->data, parser->file, parser->line)) ||
+				!len
+			) {
+				/*
+					Do not load duplicate names, elements the consumer has
+					rejected, or elements without a name. As with a WJReader
+					the consumer is still asked about an element without a
+					name, with a NULL name, before it is dropped.
+				*/
+				r = WJEParseSkip(parser);
+			} else {
+				r = WJEParseValue(parser, e, name, len, NULL);
+			}
+		}
+
+		if (tmp != buffer) {
+			MemFree(tmp);
+		}
+
+		if (!r) {
+			return(FALSE);
+		}
+
+		WJEParseSpace(parser);
+		if (parser->pos < parser->end && ',' == *parser->pos) {
+			parser->pos++;
+		} else if (parser->pos >= parser->end || '}' != *parser->pos) {
+			return(FALSE);
+		}
+	}
+}
+
+static XplBool WJEParseArray(WJEParser *parser, _WJElement *e)
+{
+	for (parser->pos++;;) {
+		WJEParseSpace(parser);
+
+		if (parser->pos >= parser->end) {
+			return(FALSE);
+		}
+
+		if (']' == *parser->pos) {
+			parser->pos++;
+			return(TRUE);
+		}
+
+		if (parser->loadcb && !parser->loadcb((WJElement) e, NULL,
+			parser->data, parser->file, parser->line)
+		) {
+			/* The consumer has rejected this item */
+			if (!WJEParseSkip(parser)) {
+				return(FALSE);
+			}
+		} else if (!WJEParseValue(parser, e, NULL, 0, NULL)) {
+			return(FALSE);
+		}
+
+		WJEParseSpace(parser);
+		if (parser->pos < parser->end && ',' == *parser->pos) {
+			parser->pos++;
+		} else if (parser->pos >= parser->end || ']' != *parser->pos) {
+			return(FALSE);
+		}
+	}
+}
+
+/*
+	Parse the value at parser->pos and add it to parent, which has already been
+	checked for duplicates. The name must be terminated if parsing in place.
+*/
+static XplBool WJEParseValue(WJEParser *parser, _WJElement *parent, char *name, size_t len, _WJElement **result)
+{
+	_WJElement	*e;
+	WJRType		type;
+	XplBool		r = TRUE;
+
+	switch (*parser->pos) {
+		case '{':						type = WJR_TYPE_OBJECT;		break;
+		case '[':						type = WJR_TYPE_ARRAY;		break;
+		case '"':						type = WJR_TYPE_STRING;		break;
+		case 't': case 'T':				type = WJR_TYPE_TRUE;		break;
+		case 'f': case 'F':				type = WJR_TYPE_FALSE;		break;
+		case 'n': case 'N':				type = WJR_TYPE_NULL;		break;
+
+		case '-': case '+':
+		case '0': case '1': case '2': case '3': case '4':
+		case '5': case '6': case '7': case '8': case '9':
+										type = WJR_TYPE_NUMBER;		break;
+
+		default:
+			return(FALSE);
+	}
+
+	if (!(e = _WJENewEx(parent, parser->arena, name, len, WJE_FLAG_UNCOUNTED |
+		(parser->insitu ? WJE_FLAG_NAME_BORROWED : 0), parser->file, parser->line))
+	) {
+		return(WJEParseSkip(parser));
+	}
+
+	if (result) {
+		*result = e;
+	}
+
+	switch ((e->pub.type = type)) {
+		default:
+			break;
+
+		case WJR_TYPE_OBJECT:
+		case WJR_TYPE_ARRAY:
+			if (parser->lazy && parent) {
+				/* Remember where the children are and parse them later */
+				e->value.string = parser->pos;
+
+				if ((r = WJEParseSkip(parser))) {
+					e->pub.length = parser->pos - e->value.string;
+					e->flags |= WJE_FLAG_LAZY;
+				} else {
+					e->value.string = NULL;
+				}
+				break;
+			}
+
+			if (++parser->depth >= WJE_PARSE_MAXDEPTH) {
+				return(FALSE);
+			}
+
+			if (WJR_TYPE_OBJECT == type) {
+				r = WJEParseObject(parser, e);
+			} else {
+				r = WJEParseArray(parser, e);
+			}
+
+			parser->depth--;
+			break;
+
+		case WJR_TYPE_STRING:
+			if ((r = WJEParseString(parser, TRUE, NULL, 0, &e->value.string, &e->pub.length))) {
+				/* The string belongs to the source buffer or the arena */
+				e->flags |= WJE_FLAG_STRING_BORROWED;
+			}
+			break;
+
+		case WJR_TYPE_NUMBER:
+			r = WJEParseNumber(parser, e);
+			break;
+
+		case WJR_TYPE_TRUE:
+		case WJR_TYPE_FALSE:
+		case WJR_TYPE_NULL:
+			e->value.boolean = (WJR_TYPE_TRUE == type);
+
+			/* Skip past any alpha numeric characters of the value */
+			for (; parser->pos < parser->end && isalnum((unsigned char) *parser->pos); parser->pos++);
+			break;
+	}
+
+	/* Count it as a change to the parent now that everything in it is loaded */
+	_WJECountChild(e, FALSE);
+	return(r);
+}
+
+/*
+	Parse the document in the buffer, which is only modified if 'insitu' is set.
+
+	FALSE is returned if the document can not be parsed. If the document is empty
+	or rejected by the load callback then TRUE is returned with *doc set to NULL.
+*/
+static XplBool WJEParseBufferEx(char *json, size_t length, XplBool insitu, XplBool lazy, WJELoadCB loadcb, void *data, WJElement *doc, const char *file, const int line)
+{
+	WJEParser	parser;
+	_WJElement	*root	= NULL;
+	XplBool		r		= TRUE;
+
+	*doc = NULL;
+
+	if (!json) {
+		errno = EINVAL;
+		return(FALSE);
+	}
+
+	memset(&parser, 0, sizeof(parser));
+	parser.pos		= json;
+	parser.end		= json + length;
+	parser.insitu	= insitu;
+	parser.lazy		= lazy;
+	parser.loadcb	= loadcb;
+	parser.data		= data;
+	parser.file		= file;
+	parser.line		= line;
+
+	/* Ignore the BOM (byte order marker) since it is pointless in UTF-8 */
+	if (parser.end - parser.pos >= 3 && (char) 0xEF == parser.pos[0] &&
+		(char) 0xBB == parser.pos[1] && (char) 0xBF == parser.pos[2]
+	) {
+		parser.pos += 3;
+	}
+
+	WJEParseSpace(&parser);
+	if (parser.pos >= parser.end) {
+		/* This appears to be an empty document */
+		return(TRUE);
+	}
+
+	if (loadcb && !loadcb(NULL, NULL, data, file, line)) {
+		/* The consumer has rejected the document */
+		return(TRUE);
+	}
+
+	if (!(parser.arena = WJEArenaNew())) {
+		return(FALSE);
+	}
+
+	/* Hold a reference so that the arena is free'd below if nothing was loaded */
+	WJEArenaRetain(parser.arena);
+
+	if (!(r = WJEParseValue(&parser, NULL, NULL, 0, &root)) && root) {
+		_WJECloseDocument((WJElement) root, file, line);
+		root = NULL;
+	}
+
+	WJEArenaRelease(parser.arena);
+
+	*doc = (WJElement) root;
+	return(r);
+}
+
+XplBool _WJEParseBuffer(char *json, size_t length, XplBool insitu, WJELoadCB loadcb, void *data, WJElement *doc, const char *file, const int line)
+{
+	return(WJEParseBufferEx(json, length, insitu, FALSE, loadcb, data, doc, file, line));
+}
+
+/*
+	Parse the top level of the document in the buffer, which must remain valid
+	and unmodified for as long as any part of the document has not been
+	materialized.
+*/
+XplBool _WJEParseLazy(const char *json, size_t length, WJElement *doc, const char *file, const int line)
+{
+	return(WJEParseBufferEx((char *) json, length, FALSE, TRUE, NULL, NULL, doc, file, line));
+}
+
+EXPORT WJElement _WJEOpenDocumentInSitu(char *json, size_t length, WJELoadCB loadcb, void *data, const char *file, const int line)
+{
+	WJElement	doc;
+
+	_WJEParseBuffer(json, length, TRUE, loadcb, data, &doc, file, line);
+	return(doc);
+}
+
+EXPORT WJElement _WJEOpenDocumentLazy(const char *json, size_t length, const char *file, const int line)
+{
+	WJElement	doc;
+
+	_WJEParseLazy(json, length, &doc, file, line);
+	return(doc);
+}
+
+static void WJEMapFree(void *source)
+{
+	XplFileMapClose((XplFileMap *) source);
+	MemFree(source);
+}
+
+EXPORT WJElement _WJEOpenDocumentLazyPath(const char *path, const char *file, const int line)
+{
+	XplFileMap	*map;
+	WJElement	doc		= NULL;
+
+	if (!path) {
+		errno = EINVAL;
+		return(NULL);
+	}
+
+	if (!(map = MemMalloc(sizeof(XplFileMap)))) {
+		return(NULL);
+	}
+
+	if (!XplFileMapOpenPath(map, path)) {
+		/* There is nothing to refer back to, so load all of it now */
+		MemFree(map);
+		return(WJEFromFile(path));
+	}
+
+	if (_WJEParseLazy(map->data, map->length, &doc, file, line) && doc) {
+		/* The mapping is unmapped when the last element in the arena is closed */
+		WJEArenaSource(((_WJElement *) doc)->arena, map, WJEMapFree);
+		return(doc);
+	}
+
+	WJEMapFree(map);
+	return(doc);
+}
+
+/*
+	Parse the children of a lazy object or array, leaving any objects or arrays
+	within them to be parsed when they are needed in turn.
+
+	Parsing the children is not a change to the document, so changes are not
+	counted while they are created, and the change counters of the element and
+	its ancestors are left as they were. If the children can't be parsed the
+	element is left empty.
+*/
+EXPORT XplBool WJEMaterialize(WJElement element, XplBool recursive)
+{
+	_WJElement	*e		= (_WJElement *) element;
+	WJEParser	parser;
+	WJElement	child;
+	XplBool		r		= TRUE;
+
+	if (!e) {
+		return(FALSE);
+	}
+
+	if (e->flags & WJE_FLAG_LAZY) {
+		WJESuspendChanges();
+
+		if (e->flags & WJE_FLAG_FROZEN) {
+			r = _WJETapeMaterialize(e);
+		} else {
+			memset(&parser, 0, sizeof(parser));
+			parser.pos		= e->value.string;
+			parser.end		= e->value.string + e->pub.length;
+			parser.lazy		= TRUE;
+			parser.arena	= e->arena;
+			parser.file		= __FILE__;
+			parser.line		= __LINE__;
+
+			for (child = element; child; child = child->parent) {
+				parser.depth++;
+			}
+
+			e->flags		&= ~WJE_FLAG_LAZY;
+			e->value.string	= NULL;
+			e->pub.length	= 0;
+
+			if (parser.depth >= WJE_PARSE_MAXDEPTH) {
+				r = FALSE;
+			} else if (WJR_TYPE_OBJECT == e->pub.type) {
+				r = WJEParseObject(&parser, e);
+			} else {
+				r = WJEParseArray(&parser, e);
+			}
+		}
+
+		if (!r) {
+			while ((child = e->pub.child)) {
+				WJEDetach(child);
+				WJECloseDocument(child);
+			}
+			e->flags |= WJE_FLAG_MALFORMED;
+		}
+
+		WJEResumeChanges();
+	} else if (e->flags & WJE_FLAG_MALFORMED) {
+		r = FALSE;
+	}
+
+	if (recursive) {
+		for (child = e->pub.child; child; child = child->next) {
+			if (!WJEMaterialize(child, TRUE)) {
+				r = FALSE;
+			}
+		}
+	}
+
+	return(r);
+}
+
+/*
+	Split the elements of the array at the start of the buffer into batches of
+	roughly 'size' bytes, for loading each batch separately. The start of each
+	batch is stored in starts, and *end is set to the closing bracket, which
+	ends the last batch. A batch may end with a trailing comma.
+
+	This only tracks what is needed to find the elements at the top level of the
+	array, which is much less work than parsing them. FALSE is returned if the
+	buffer does not contain an array, more than max batches would be needed, or
+	the end of the array can not be found.
+*/
+XplBool _WJEParseSplitArray(const char *json, size_t length, size_t size, const char **starts, size_t max, size_t *count, const char **end)
+{
+	WJEParser	parser;
+	XplBool		escaped;
+	char		*batch;
+	char		*q;
+	uint32		depth	= 0;
+
+	memset(&parser, 0, sizeof(parser));
+	parser.pos		= (char *) json;
+	parser.end		= (char *) json + length;
+	*count			= 0;
+
+	if (parser.end - parser.pos >= 3 && (char) 0xEF == parser.pos[0] &&
+		(char) 0xBB == parser.pos[1] && (char) 0xBF == parser.pos[2]
+	) {
+		parser.pos += 3;
+	}
+
+	WJEParseSpace(&parser);
+	if (parser.pos >= parser.end || '[' != *parser.pos) {
+		return(FALSE);
+	}
+	batch = ++parser.pos;
+
+	while (parser.pos < parser.end) {
+		switch (*parser.pos) {
+			case '"':
+				parser.pos++;
+				if (!(q = WJEParseStringEnd(&parser, &escaped))) {
+					return(FALSE);
+				}
+				parser.pos = q;
+				break;
+
+			case '#':
+				WJEParseSpace(&parser);
+				continue;
+
+			case '{': case '[':
+				depth++;
+				break;
+
+			case '}': case ']':
+				if (!depth) {
+					if ('}' == *parser.pos || *count >= max) {
+						return(FALSE);
+					}
+
+					starts[(*count)++] = batch;
+					*end = parser.pos;
+					return(TRUE);
+				}
+				depth--;
+				break;
+
+			case ',':
+				if (!depth && (size_t) (parser.pos - batch) >= size) {
+					if (*count + 1 >= max) {
+						return(FALSE);
+					}
+
+					starts[(*count)++] = batch;
+					batch = parser.pos + 1;
+				}
+				break;
+
+			default:
+				break;
+		}
+
+		parser.pos++;
+	}
+
+	return(FALSE);
+}
+
+/*
+	Parse a sequence of values separated by commas, which are allocated from an
+	arena of their own and linked together as siblings, but are not added to
+	parent. The load callback is called with parent for each value, in the same
+	way as for the elements of an array.
+
+	If every value can be parsed then their parent pointers are set and TRUE is
+	returned. Otherwise any values that were parsed are closed.
+
+	The values are not counted as changes to parent, but changes is set to what
+	they would have added to its changes counter, so that the caller can count
+	them once they have been added.
+*/
+XplBool _WJEParseElements(const char *json, size_t length, WJElement parent, WJELoadCB loadcb, void *data, WJElement *first, WJElement *last, int *count, int *changes, const char *file, const int line)
+{
+	WJEParser	parser;
+	_WJElement	*e;
+	WJElement	n;
+	XplBool		r		= TRUE;
+
+	*first		= NULL;
+	*last		= NULL;
+	*count		= 0;
+	*changes	= 0;
+
+	memset(&parser, 0, sizeof(parser));
+	parser.pos		= (char *) json;
+	parser.end		= (char *) json + length;
+	parser.loadcb	= loadcb;
+	parser.data		= data;
+	parser.file		= file;
+	parser.line		= line;
+
+	if (!(parser.arena = WJEArenaNew())) {
+		return(FALSE);
+	}
+	WJEArenaRetain(parser.arena);
+
+	for (;;) {
+		WJEParseSpace(&parser);
+		if (parser.pos >= parser.end) {
+			break;
+		}
+
+		e = NULL;
+		if (loadcb && !loadcb(parent, NULL, data, file, line)) {
+			/* The consumer has rejected this item */
+			r = WJEParseSkip(&parser);
+		} else if (!(r = WJEParseValue(&parser, NULL, NULL, 0, &e)) && e) {
+			_WJECloseDocument((WJElement) e, file, line);
+			e = NULL;
+		}
+
+		if (!r) {
+			break;
+		}
+
+		if (e) {
+			if ((e->pub.prev = *last)) {
+				(*last)->next = (WJElement) e;
+			} else {
+				*first = (WJElement) e;
+			}
+			*last = (WJElement) e;
+			(*count)++;
+			*changes += e->pub.changes + 1;
+		}
+
+		WJEParseSpace(&parser);
+		if (parser.pos < parser.end) {
+			if (',' != *parser.pos) {
+				r = FALSE;
+				break;
+			}
+			parser.pos++;
+		}
+	}
+
+	WJEArenaRelease(parser.arena);
+
+	if (!r) {
+		while ((n = *first)) {
+			*first = n->next;
+			_WJECloseDocument(n, file, line);
+		}
+
+		*last		= NULL;
+		*count		= 0;
+		*changes	= 0;
+		return(FALSE);
+	}
+
+	for (n = *first; n; n = n->next) {
+		n->parent = parent;
+	}
+	return(TRUE);
+}
@@ -0,0 +1,784 @@
+/*
+    This file is part of WJElement.
+
+    WJElement is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation.
+
+    WJElement is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with WJElement.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "element.h"
+#include <ctype.h>
+
+/*
+	Push parser
+
+	A WJReader pulls data through a callback, which has to block until the data
+	is available. A push parser is instead handed data as it arrives with
+	WJEFeed(), and builds the document as it goes. All of the state needed to
+	pick up where it left off is kept in the parser, so a name, string or
+	number may be split across any number of calls.
+
+	The same extensions to JSON are accepted as by the in memory parser, and
+	the elements are allocated from an arena in the same way.
+
+	Anything that has to be carried over from one call to the next, such as
+	the start of a string, is copied into a token buffer. Anything that arrives
+	in a single call is used directly from the caller's data.
+*/
+
+/* Match the default maxdepth used by WJROpenDocument() */
+#define WJE_PUSH_MAXDEPTH		250
+
+typedef enum {
+	/* Waiting for the start of the document */
+	WJE_PUSH_STATE_START,
+
+	/* Waiting for a value, or the end of an array */
+	WJE_PUSH_STATE_VALUE,
+
+	/* Waiting for the name of a child, or the end of an object */
+	WJE_PUSH_STATE_NAME,
+	WJE_PUSH_STATE_COLON,
+
+	/* Waiting for a comma or the end of the current object or array */
+	WJE_PUSH_STATE_NEXT,
+
+	/* In the middle of a token */
+	WJE_PUSH_STATE_STRING,
+	WJE_PUSH_STATE_SCALAR,
+
+	/* Skipping a value that is not being loaded */
+	WJE_PUSH_STATE_SKIP,
+
+	/* Skipping a comment, before returning to the resume state */
+	WJE_PUSH_STATE_COMMENT,
+
+	WJE_PUSH_STATE_DONE,
+	WJE_PUSH_STATE_ERROR
+} WJEPushState;
+
+struct WJEPushParser {
+	WJEPushState	state;
+	WJEPushState	resume;
+
+	WJEArena		*arena;
+	_WJElement		*root;
+
+	/* The object or array that values are currently being added to */
+	_WJElement		*current;
+	uint32			depth;
+
+	/* The next value has been rejected and is to be skipped */
+	XplBool			reject;
+
+	/* The current string is a name, rather than a value */
+	XplBool			isname;
+
+	/* The string contains escapes, and the last byte seen was a backslash */
+	XplBool			escaped;
+	XplBool			escape;
+
+	/* Where a value that is being skipped is up to */
+	uint32			skipdepth;
+	XplBool			skipstring;
+
+	/* The part of a token that has been seen so far */
+	char			*token;
+	size_t			tokenlen;
+	size_t			tokensize;
+
+	/* The name of the next child of an object */
+	char			*name;
+	size_t			namelen;
+	size_t			namesize;
+
+	WJELoadCB		loadcb;
+	void			*data;
+
+	const char		*file;
+	int				line;
+};
+
+/* The characters that may make up a number or a literal such as true */
+#define WJEIsScalar(c)	(isalnum((unsigned char) (c)) || \
+							'.' == (c) || '+' == (c) || '-' == (c))
+
+/* Ensure that buffer can hold at least size bytes */
+static XplBool WJEPushReserve(char **buffer, size_t *bufsize, size_t size)
+{
+	char		*b;
+
+	if (size <= *bufsize) {
+		return(TRUE);
+	}
+
+	size = xpl_max(size, *bufsize * 2);
+	size = xpl_max(size, 64);
+
+	if (!(b = MemRealloc(*buffer, size))) {
+		return(FALSE);
+	}
+
+	*buffer		= b;
+	*bufsize	= size;
+	return(TRUE);
+}
+
+/* Keep part of a token that continues in the next call */
+static XplBool WJEPushKeep(WJEPushParser parser, const char *data, size_t length)
+{
+	if (!WJEPushReserve(&parser->token, &parser->tokensize, parser->tokenlen + length + 1)) {
+		return(FALSE);
+	}
+
+	memcpy(parser->token + parser->tokenlen, data, length);
+	parser->tokenlen += length;
+	return(TRUE);
+}
+
+/*
+	Find the closing quote of a string, continuing from where the last call
+	left off if the data ended in the middle of an escape sequence.
+*/
+static const char * WJEPushStringEnd(WJEPushParser parser, const char *s, const char *end)
+{
+	const char	*q;
+	const char	*b;
+
+	if (parser->escape) {
+		if (s >= end) {
+			return(NULL);
+		}
+
+		/* Skip the escaped character, which may be a quote */
+		parser->escape = FALSE;
+		s++;
+	}
+
+	while (s < end) {
+		q = memchr(s, '"', end - s);
+
+		if (!(b = memchr(s, '\\', (q ? q : end) - s))) {
+			return(q);
+		}
+
+		parser->escaped = TRUE;
+		if (b + 1 >= end) {
+			parser->escape = TRUE;
+			return(NULL);
+		}
+		s = b + 2;
+	}
+
+	return(NULL);
+}
+
+static _WJElement * WJEPushNew(WJEPushParser parser, WJRType type)
+{
+	_WJElement	*e;
+
+	if (!(e = _WJENewEx(parser->current, parser->arena,
+		parser->current ? parser->name : NULL, parser->current ? parser->namelen : 0,
+		WJE_FLAG_UNCOUNTED, parser->file, parser->line))
+	) {
+		return(NULL);
+	}
+
+	e->pub.type = type;
+	if (WJR_TYPE_OBJECT != type && WJR_TYPE_ARRAY != type) {
+		/* An object or array is counted once it is closed, with its children */
+		_WJECountChild(e, FALSE);
+	}
+	if (!parser->root) {
+		parser->root = e;
+	}
+
+	return(e);
+}
+
+/* A value is complete, so move on to whatever comes after it */
+static void WJEPushValueDone(WJEPushParser parser)
+{
+	if (!parser->current) {
+		parser->state = WJE_PUSH_STATE_DONE;
+	} else {
+		parser->state = WJE_PUSH_STATE_NEXT;
+	}
+}
+
+static XplBool WJEPushString(WJEPushParser parser, const char *raw, size_t len)
+{
+	_WJElement	*e;
+	char		*o;
+
+	if (parser->isname) {
+		if (!WJEPushReserve(&parser->name, &parser->namesize, len + 1)) {
+			return(FALSE);
+		}
+
+		if (parser->escaped) {
+			if (WJE_UNESCAPE_FAILED == (parser->namelen = WJEUnescape(parser->name, raw, len))) {
+				return(FALSE);
+			}
+		} else {
+			memcpy(parser->name, raw, (parser->namelen = len));
+		}
+		parser->name[parser->namelen] = '\0';
+
+		parser->state = WJE_PUSH_STATE_COLON;
+		return(TRUE);
+	}
+
+	if (!(o = WJEArenaAlloc(parser->arena, len + 1)) ||
+		!(e = WJEPushNew(parser, WJR_TYPE_STRING))
+	) {
+		return(FALSE);
+	}
+
+	if (parser->escaped) {
+		if (WJE_UNESCAPE_FAILED == (e->pub.length = WJEUnescape(o, raw, len))) {
+			e->pub.length = 0;
+			return(FALSE);
+		}
+	} else {
+		memcpy(o, raw, (e->pub.length = len));
+	}
+	o[e->pub.length] = '\0';
+
+	/* The string belongs to the arena */
+	e->value.string	= o;
+	e->flags		|= WJE_FLAG_STRING_BORROWED;
+
+	WJEPushValueDone(parser);
+	return(TRUE);
+}
+
+static XplBool WJEPushScalar(WJEPushParser parser, const char *s, size_t len)
+{
+	_WJElement	*e;
+	const char	*end	= s + len;
+	WJRType		type;
+
+	switch (*s) {
+		case 't': case 'T':				type = WJR_TYPE_TRUE;		break;
+		case 'f': case 'F':				type = WJR_TYPE_FALSE;		break;
+		case 'n': case 'N':				type = WJR_TYPE_NULL;		break;
+		default:						type = WJR_TYPE_NUMBER;		break;
+	}
+
+	if (!(e = WJEPushNew(parser, type))) {
+		return(FALSE);
+	}
+
+	if (WJR_TYPE_NUMBER != type) {
+		e->value.boolean = (WJR_TYPE_TRUE == type);
+	} else {
+		if ('-' == *s) {
+			e->value.number.negative = TRUE;
+			s++;
+		}
+
+		if (s == WJRParseNumber(s, end, &e->value.number.hasDecimalPoint,
+			&e->value.number.i, &e->value.number.d)
+		) {
+			return(FALSE);
+		}
+
+#ifdef WJE_DISTINGUISH_INTEGER_TYPE
+		if (!e->value.number.hasDecimalPoint) {
+			e->pub.type = WJR_TYPE_INTEGER;
+		}
+#endif
+	}
+
+	WJEPushValueDone(parser);
+	return(TRUE);
+}
+
+/* Open an object or array, or close the current one */
+static XplBool WJEPushOpen(WJEPushParser parser, WJRType type)
+{
+	_WJElement	*e;
+
+	if (++parser->depth >= WJE_PUSH_MAXDEPTH || !(e = WJEPushNew(parser, type))) {
+		return(FALSE);
+	}
+
+	parser->current	= e;
+	parser->state	= (WJR_TYPE_OBJECT == type) ? WJE_PUSH_STATE_NAME : WJE_PUSH_STATE_VALUE;
+	return(TRUE);
+}
+
+static void WJEPushClose(WJEPushParser parser)
+{
+	_WJECountChild(parser->current, FALSE);
+	parser->current = (_WJElement *) parser->current->pub.parent;
+	parser->depth--;
+
+	WJEPushValueDone(parser);
+}
+
+/*
+	The first character of a value has been reached. Decide if it is going to
+	be loaded, and start on it.
+*/
+static XplBool WJEPushValue(WJEPushParser parser, const char *pos)
+{
+	if (!parser->reject && parser->loadcb &&
+		(!parser->current || WJR_TYPE_ARRAY == parser->current->pub.type) &&
+		!parser->loadcb((WJElement) parser->current, NULL, parser->data,
+			parser->file, parser->line)
+	) {
+		/* The consumer has rejected this item, or the entire document */
+		parser->reject = TRUE;
+	}
+
+	parser->tokenlen	= 0;
+	parser->escaped		= FALSE;
+	parser->escape		= FALSE;
+
+	if (parser->reject) {
+		parser->reject		= FALSE;
+		parser->skipdepth	= 0;
+		parser->skipstring	= FALSE;
+		parser->state		= WJE_PUSH_STATE_SKIP;
+
+		return(TRUE);
+	}
+
+	switch (*pos) {
+		case '{':
+			return(WJEPushOpen(parser, WJR_TYPE_OBJECT));
+
+		case '[':
+			return(WJEPushOpen(parser, WJR_TYPE_ARRAY));
+
+		case '"':
+			parser->isname	= FALSE;
+			parser->state	= WJE_PUSH_STATE_STRING;
+			return(TRUE);
+
+		case 't': case 'T':
+		case 'f': case 'F':
+		case 'n': case 'N':
+		case '-': case '+':
+		case '0': case '1': case '2': case '3': case '4':
+		case '5': case '6': case '7': case '8': case '9':
+			parser->state	= WJE_PUSH_STATE_SCALAR;
+			return(TRUE);
+
+		default:
+			return(FALSE);
+	}
+}
+
+/*
+	The name of a child has been read, so decide if the value that follows is
+	going to be loaded.
+*/
+static void WJEPushNamed(WJEPushParser parser)
+{
+	if (!parser->namelen ||
+		WJEFindChild((WJElement) parser->current, parser->name, parser->namelen, WJE_GET, NULL) ||
+		(parser->loadcb && !parser->loadcb((WJElement) parser->current, parser->name,
+			parser->data, parser->file, parser->line))
+	) {
+		/*
+			Do not load elements without a name, duplicate names, or elements
+			the consumer has rejected.
+		*/
+		parser->reject = TRUE;
+	}
+
+	parser->state = WJE_PUSH_STATE_VALUE;
+}
+
+/*
+	Parse as much of the data as possible, returning a pointer to the first
+	byte that was not used. All of the data is used unless the document ends
+	before it does.
+*/
+static const char * WJEPushParse(WJEPushParser parser, const char *pos, const char *end)
+{
+	const char	*q;
+	char		c;
+
+	while (pos < end) {
+		c = *pos;
+
+		switch (parser->state) {
+			case WJE_PUSH_STATE_DONE:
+			case WJE_PUSH_STATE_ERROR:
+				return(pos);
+
+			case WJE_PUSH_STATE_START:
+			case WJE_PUSH_STATE_VALUE:
+			case WJE_PUSH_STATE_NAME:
+			case WJE_PUSH_STATE_COLON:
+			case WJE_PUSH_STATE_NEXT:
+				if (isspace((unsigned char) c)) {
+					pos++;
+					continue;
+				}
+
+				if ('#' == c) {
+					/* Python style comment */
+					parser->resume	= parser->state;
+					parser->state	= WJE_PUSH_STATE_COMMENT;
+					continue;
+				}
+				break;
+
+			case WJE_PUSH_STATE_COMMENT:
+				if (!(q = memchr(pos, '\n', end - pos))) {
+					return(end);
+				}
+
+				parser->state = parser->resume;
+				pos = q;
+				continue;
+
+			case WJE_PUSH_STATE_STRING:
+				if (!(q = WJEPushStringEnd(parser, pos, end))) {
+					if (!WJEPushKeep(parser, pos, end - pos)) {
+						parser->state = WJE_PUSH_STATE_ERROR;
+					}
+					return(end);
+				}
+
+				if (parser->tokenlen) {
+					if (!WJEPushKeep(parser, pos, q - pos) ||
+						!WJEPushString(parser, parser->token, parser->tokenlen)
+					) {
+						parser->state = WJE_PUSH_STATE_ERROR;
+					}
+				} else if (!WJEPushString(parser, pos, q - pos)) {
+					parser->state = WJE_PUSH_STATE_ERROR;
+				}
+
+				pos = q + 1;
+				continue;
+
+			case WJE_PUSH_STATE_SCALAR:
+				for (q = pos; q < end && WJEIsScalar(*q); q++);
+
+				if (q == end) {
+					/* The token may continue in the next call */
+					if (!WJEPushKeep(parser, pos, end - pos)) {
+						parser->state = WJE_PUSH_STATE_ERROR;
+					}
+					return(end);
+				}
+
+				if (parser->tokenlen) {
+					if (!WJEPushKeep(parser, pos, q - pos) ||
+						!WJEPushScalar(parser, parser->token, parser->tokenlen)
+					) {
+						parser->state = WJE_PUSH_STATE_ERROR;
+					}
+				} else if (!WJEPushScalar(parser, pos, q - pos)) {
+					parser->state = WJE_PUSH_STATE_ERROR;
+				}
+
+				pos = q;
+				continue;
+
+			case WJE_PUSH_STATE_SKIP:
+				if (parser->skipstring) {
+					if (!(q = WJEPushStringEnd(parser, pos, end))) {
+						return(end);
+					}
+
+					parser->skipstring = FALSE;
+					pos = q + 1;
+
+					if (!parser->skipdepth) {
+						WJEPushValueDone(parser);
+					}
+					continue;
+				}
+
+				if (!parser->skipdepth && parser->tokenlen) {
+					/* Skipping a number or literal */
+					if (!WJEIsScalar(c)) {
+						WJEPushValueDone(parser);
+					} else {
+						pos++;
+					}
+					continue;
+				}
+
+				switch (c) {
+					case '"':
+						parser->skipstring = TRUE;
+						break;
+
+					case '{': case '[':
+						parser->skipdepth++;
+						break;
+
+					case '}': case ']':
+						if (!parser->skipdepth) {
+							parser->state = WJE_PUSH_STATE_ERROR;
+							return(pos);
+						}
+
+						if (!--parser->skipdepth) {
+							WJEPushValueDone(parser);
+						}
+						break;
+
+					case '#':
+						if (parser->skipdepth) {
+							parser->resume	= parser->state;
+							parser->state	= WJE_PUSH_STATE_COMMENT;
+							continue;
+						}
+						/* fall through */
+
+					default:
+						if (!parser->skipdepth) {
+							if (!WJEIsScalar(c)) {
+								parser->state = WJE_PUSH_STATE_ERROR;
+								return(pos);
+							}
+
+							/* Note that a scalar is being skipped */
+							parser->tokenlen = 1;
+						}
+						break;
+				}
+
+				pos++;
+				continue;
+		}
+
+		/* A structural character */
+		switch (parser->state) {
+			default:
+				break;
+
+			case WJE_PUSH_STATE_START:
+				/* Ignore the BOM (byte order marker) since it is pointless in UTF-8 */
+				if ((char) 0xEF == c || (char) 0xBB == c || (char) 0xBF == c) {
+					pos++;
+					continue;
+				}
+
+				parser->state = WJE_PUSH_STATE_VALUE;
+				/* fall through */
+
+			case WJE_PUSH_STATE_VALUE:
+				if (']' == c && parser->current &&
+					WJR_TYPE_ARRAY == parser->current->pub.type
+				) {
+					/* The end of an array, which may follow a trailing comma */
+					WJEPushClose(parser);
+					pos++;
+					continue;
+				}
+
+				if (!WJEPushValue(parser, pos)) {
+					parser->state = WJE_PUSH_STATE_ERROR;
+					return(pos);
+				}
+
+				if (WJE_PUSH_STATE_SKIP != parser->state &&
+					WJE_PUSH_STATE_SCALAR != parser->state
+				) {
+					pos++;
+				}
+				continue;
+
+			case WJE_PUSH_STATE_NAME:
+				if ('}' == c) {
+					WJEPushClose(parser);
+					pos++;
+					continue;
+				}
+
+				if ('"' == c) {
+					parser->tokenlen	= 0;
+					parser->escaped		= FALSE;
+					parser->escape		= FALSE;
+					parser->isname		= TRUE;
+					parser->state		= WJE_PUSH_STATE_STRING;
+					pos++;
+					continue;
+				}
+				break;
+
+			case WJE_PUSH_STATE_COLON:
+				if (':' == c) {
+					WJEPushNamed(parser);
+					pos++;
+					continue;
+				}
+				break;
+
+			case WJE_PUSH_STATE_NEXT:
+				if (',' == c) {
+					if (WJR_TYPE_OBJECT == parser->current->pub.type) {
+						parser->state = WJE_PUSH_STATE_NAME;
+					} else {
+						parser->state = WJE_PUSH_STATE_VALUE;
+					}
+					pos++;
+					continue;
+				}
+
+				if ((('}' == c && WJR_TYPE_OBJECT == parser->current->pub.type) ||
+					(']' == c && WJR_TYPE_ARRAY == parser->current->pub.type))
+				) {
+					WJEPushClose(parser);
+					pos++;
+					continue;
+				}
+				break;
+		}
+
+		parser->state = WJE_PUSH_STATE_ERROR;
+		return(pos);
+	}
+
+	return(pos);
+}
+
+/* There is no more data, so finish off anything that was waiting for more */
+static void WJEPushEnd(WJEPushParser parser)
+{
+	if (WJE_PUSH_STATE_COMMENT == parser->state) {
+		parser->state = parser->resume;
+	}
+
+	switch (parser->state) {
+		case WJE_PUSH_STATE_START:
+			/* This appears to be an empty document */
+			parser->state = WJE_PUSH_STATE_DONE;
+			break;
+
+		case WJE_PUSH_STATE_SCALAR:
+			if (!parser->tokenlen || !WJEPushScalar(parser, parser->token, parser->tokenlen)) {
+				parser->state = WJE_PUSH_STATE_ERROR;
+			}
+			break;
+
+		case WJE_PUSH_STATE_SKIP:
+			if (!parser->skipdepth && !parser->skipstring && parser->tokenlen) {
+				WJEPushValueDone(parser);
+			}
+			break;
+
+		default:
+			break;
+	}
+
+	if (WJE_PUSH_STATE_DONE != parser->state) {
+		parser->state = WJE_PUSH_STATE_ERROR;
+	}
+}
+
+EXPORT WJEPushParser _WJEOpenPushParser(WJELoadCB loadcb, void *data, const char *file, const int line)
+{
+	WJEPushParser	parser;
+
+	if (!(parser = MemMalloc(sizeof(struct WJEPushParser)))) {
+		return(NULL);
+	}
+	memset(parser, 0, sizeof(struct WJEPushParser));
+
+	if (!(parser->arena = WJEArenaNew())) {
+		MemFree(parser);
+		return(NULL);
+	}
+
+	/* Hold a reference so that the arena is free'd on close if nothing was loaded */
+	WJEArenaRetain(parser->arena);
+
+	parser->state	= WJE_PUSH_STATE_START;
+	parser->loadcb	= loadcb;
+	parser->data	= data;
+	parser->file	= file;
+	parser->line	= line;
+
+	return(parser);
+}
+
+EXPORT WJEPushStatus WJEFeed(WJEPushParser parser, const char *data, size_t length, size_t budget, size_t *used)
+{
+	const char	*end;
+
+	if (used) {
+		*used = 0;
+	}
+
+	if (!parser || (!data && length)) {
+		errno = EINVAL;
+		return(WJE_PUSH_ERROR);
+	}
+
+	if (!length) {
+		WJEPushEnd(parser);
+	} else if (WJE_PUSH_STATE_DONE != parser->state) {
+		end = WJEPushParse(parser, data,
+				data + ((budget && budget < length) ? budget : length));
+
+		if (used) {
+			*used = end - data;
+		}
+
+		if (WJE_PUSH_STATE_DONE != parser->state &&
+			WJE_PUSH_STATE_ERROR != parser->state && end < data + length
+		) {
+			/* The budget for this call has been used up */
+			return(WJE_PUSH_AGAIN);
+		}
+	}
+
+	switch (parser->state) {
+		case WJE_PUSH_STATE_DONE:
+			return(WJE_PUSH_DONE);
+
+		case WJE_PUSH_STATE_ERROR:
+			return(WJE_PUSH_ERROR);
+
+		default:
+			return(WJE_PUSH_MORE);
+	}
+}
+
+EXPORT WJElement WJEClosePushParser(WJEPushParser parser)
+{
+	WJElement	doc	= NULL;
+
+	if (!parser) {
+		return(NULL);
+	}
+
+	if (WJE_PUSH_STATE_DONE == parser->state) {
+		doc = (WJElement) parser->root;
+	} else if (parser->root) {
+		_WJECloseDocument((WJElement) parser->root, parser->file, parser->line);
+	}
+
+	if (parser->token) {
+		MemFree(parser->token);
+	}
+	if (parser->name) {
+		MemFree(parser->name);
+	}
+
+	WJEArenaRelease(parser->arena);
+	MemFree(parser);
+
+	return(doc);
+}
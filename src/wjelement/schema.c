@@ -357,6 +357,8 @@ static int CompareJson(WJElement obj1, WJElement obj2) {
 	switch(obj1->type) {
 	case WJR_TYPE_OBJECT:
 	case WJR_TYPE_ARRAY:
+		WJEMaterialize(obj1, FALSE);
+		WJEMaterialize(obj2, FALSE);
 		if(obj1->count != obj2->count) {
 			return -1;
 		}
@@ -419,7 +421,13 @@ static XplBool SchemaValidate(WJElement schema, WJElement document,
 			schema = loadcb(str, client, __FILE__, __LINE__);
 		}
 	}
+	/* counts are checked below, which aren't known until lazy elements are parsed */
+	if(document) {
+		WJEMaterialize(document, FALSE);
+	}
 	if(schema) {
+		WJEMaterialize(schema, TRUE);
+
 		/* determine json-schema version */
 		/*
 		  NOTE:
@@ -1385,7 +1393,7 @@ EXPORT char * WJESchemaNameFindBacklink(char *describedby, const char *format,
 	}
 
 	/* Does this type have a backlink that matches the format specified? */
-	if ((link = WJEChild(sub, "backlinks", WJE_GET))) {
+	if ((link = WJEChild(sub, "backlinks", WJE_GET)) && WJEMaterialize(link, FALSE)) {
 		for (link = link->child; link; link = link->next) {
 			if ((str = WJEString(link, NULL, WJE_GET, NULL)) &&
 				!strcmp(format, str)
@@ -99,8 +99,8 @@ static int WJEMatchExact(WJElement root, WJElement parent, WJElement e, WJEActio
 	} else {
 		/* Verify that the name matches exactly, case sensitive */
 
-		if (e->name && strlen(e->name) == len &&
-			name && !strncmp(e->name, name, len)
+		if (e->name && name &&
+			!strncmp(e->name, name, len) && !e->name[len]
 		) {
 			return(0);
 		} else {
@@ -802,8 +802,593 @@ static int WJECheckCondition(WJElement e, char **condition, WJEAction action)
 	return(r);
 }
 
-/* Find a child WJElement by name.  See description in wjelement.h */
-WJElement WJESearch(WJElement container, const char *path, WJEAction *action, WJElement last, const char *file, const int line)
+/*
+	Compiled selectors
+
+	Searching for an element requires parsing the portion of the path that
+	matches the depth of every candidate element, which means that the start of
+	the path gets parsed over and over again. A compiled selector holds a copy
+	of the path along with the result of parsing each portion of it, so that
+	any portion can be found by depth.
+
+	Selectors that are only known as strings are compiled on demand and kept in
+	a small per thread cache, with the least recently used selector evicted once
+	WJE_SELECTOR_CACHE_SIZE are cached. Since each thread has its own cache
+	there is no locking, and a selector taken from the cache is only ever used
+	by one thread, so it can be reference counted without atomics. A selector
+	that is compiled by the caller is never reference counted, so it may be
+	shared between threads.
+
+	A path is only added to the cache the second time it is seen, so that paths
+	that are built for a single use, such as by the WJE*F() functions, are
+	compiled and free'd as they always were instead of evicting paths that are
+	used over and over again. The hash of the last path that missed is kept for
+	each bucket to tell.
+
+	The cache is free'd when its thread exits.
+*/
+#ifndef WJE_SELECTOR_CACHE_SIZE
+#define WJE_SELECTOR_CACHE_SIZE		256
+#endif
+#define WJE_SELECTOR_CACHE_BUCKETS	(WJE_SELECTOR_CACHE_SIZE * 2)
+
+#if WJE_SELECTOR_CACHE_SIZE > 0
+#ifdef _WIN32
+#include <windows.h>
+
+typedef DWORD							WJESelectorCacheKey;
+typedef INIT_ONCE						WJESelectorCacheOnce;
+#define WJE_SELECTOR_CACHE_ONCE			INIT_ONCE_STATIC_INIT
+#define WJESelectorCacheKeySet(k, v)	FlsSetValue((k), (v))
+#else
+#include <pthread.h>
+
+typedef pthread_key_t					WJESelectorCacheKey;
+typedef pthread_once_t					WJESelectorCacheOnce;
+#define WJE_SELECTOR_CACHE_ONCE			PTHREAD_ONCE_INIT
+#define WJESelectorCacheKeySet(k, v)	pthread_setspecific((k), (v))
+#endif
+#endif
+
+typedef struct {
+	char					*name;
+	size_t					len;
+	char					*end;
+	WJEMatchCB				cb;
+	XplBool					specific;
+
+	/* The offset for a subscript with a single offset (ie [2]), or -1 */
+	long					index;
+} WJESelectorStep;
+
+struct WJECompiledSelector {
+	/* The number of users of a cached selector, including the cache itself */
+	int						refs;
+
+	/* Links used by the cache */
+	uint32					hash;
+	WJESelector				chain;
+	WJESelector				newer;
+	WJESelector				older;
+
+	/*
+		The number of portions of the path that could be parsed. Any element
+		that is deeper than this can't match.
+	*/
+	int						count;
+	WJESelectorStep			*steps;
+	char					*path;
+};
+
+typedef struct {
+	int						count;
+	WJESelector				newest;
+	WJESelector				oldest;
+	WJESelector				buckets[WJE_SELECTOR_CACHE_BUCKETS];
+
+	/* The hash of the last path that wasn't found in each bucket */
+	uint32					seen[WJE_SELECTOR_CACHE_BUCKETS];
+} WJESelectorCache;
+
+#if WJE_SELECTOR_CACHE_SIZE > 0
+static WJE_THREAD_LOCAL WJESelectorCache *WJESelectorCacheData = NULL;
+
+/*
+	The cache is also stored in a thread specific key, only so that it is free'd
+	by the key's destructor when the thread exits.
+*/
+static WJESelectorCacheKey	WJESelectorCacheExitKey;
+static XplBool				WJESelectorCacheKeyValid	= FALSE;
+static WJESelectorCacheOnce	WJESelectorCacheKeyOnce		= WJE_SELECTOR_CACHE_ONCE;
+#endif
+
+EXPORT WJESelector WJECompileSelector(const char *path)
+{
+	WJESelector		selector;
+	WJEMatchCB		cb;
+	XplBool			specific;
+	char			*name;
+	char			*end;
+	size_t			len;
+	size_t			size;
+	int				count;
+
+	if (!path) {
+		return(NULL);
+	}
+
+	/* Count the portions of the path first, to allocate it all at once */
+	for (count = 0, end = (char *) path;
+		WJENextName(end, &len, &end, &cb, &specific);
+		count++
+	);
+
+	size = strlen(path) + 1;
+	if (!(selector = MemMalloc(sizeof(struct WJECompiledSelector) +
+		(count * sizeof(WJESelectorStep)) + size))
+	) {
+		return(NULL);
+	}
+	memset(selector, 0, sizeof(struct WJECompiledSelector));
+
+	selector->refs	= 1;
+	selector->count	= count;
+	selector->steps	= (WJESelectorStep *) (selector + 1);
+	selector->path	= (char *) (selector->steps + count);
+	memcpy(selector->path, path, size);
+
+	for (count = 0, end = selector->path; count < selector->count; count++) {
+		name = WJENextName(end, &len, &end, &cb, &specific);
+
+		selector->steps[count].name		= name;
+		selector->steps[count].len		= len;
+		selector->steps[count].end		= end;
+		selector->steps[count].cb		= cb;
+		selector->steps[count].specific	= specific;
+		selector->steps[count].index	= -1;
+
+		if (cb == WJEMatchSubscript && len > 0) {
+			for (size = 0; size < len && isdigit((unsigned char) name[size]); size++);
+
+			/* A leading 0 would make it octal */
+			if (size == len && len < 10 && (len == 1 || name[0] != '0')) {
+				selector->steps[count].index = atol(name);
+			}
+		}
+	}
+
+	return(selector);
+}
+
+EXPORT void WJEFreeSelector(WJESelector selector)
+{
+	if (selector && !--selector->refs) {
+		MemFree(selector);
+	}
+}
+
+#if WJE_SELECTOR_CACHE_SIZE > 0
+static void WJESelectorCacheFree(WJESelectorCache *cache)
+{
+	WJESelector			selector;
+
+	while ((selector = cache->oldest)) {
+		cache->oldest = selector->newer;
+		WJEFreeSelector(selector);
+	}
+
+	MemFree(cache);
+}
+
+/* Called with the cache of a thread that is exiting */
+#ifdef _WIN32
+static VOID WINAPI WJESelectorCacheExit(PVOID data)
+#else
+static void WJESelectorCacheExit(void *data)
+#endif
+{
+	WJESelectorCache	*cache = data;
+
+	if (cache) {
+		if (cache == WJESelectorCacheData) {
+			WJESelectorCacheData = NULL;
+		}
+
+		WJESelectorCacheFree(cache);
+	}
+}
+
+#ifdef _WIN32
+static BOOL CALLBACK WJESelectorCacheKeyCreate(PINIT_ONCE once, PVOID param, PVOID *context)
+{
+	WJESelectorCacheExitKey		= FlsAlloc(WJESelectorCacheExit);
+	WJESelectorCacheKeyValid	= (WJESelectorCacheExitKey != FLS_OUT_OF_INDEXES);
+	return(TRUE);
+}
+#else
+static void WJESelectorCacheKeyCreate(void)
+{
+	WJESelectorCacheKeyValid = !pthread_key_create(&WJESelectorCacheExitKey,
+									WJESelectorCacheExit);
+}
+#endif
+
+/*
+	Create the key that frees each thread's cache on exit, the first time any
+	thread creates a cache. Nothing is cached if the key couldn't be created,
+	since nothing would free the cache.
+*/
+static XplBool WJESelectorCacheKeyReady(void)
+{
+#ifdef _WIN32
+	InitOnceExecuteOnce(&WJESelectorCacheKeyOnce, WJESelectorCacheKeyCreate, NULL, NULL);
+#else
+	pthread_once(&WJESelectorCacheKeyOnce, WJESelectorCacheKeyCreate);
+#endif
+
+	return(WJESelectorCacheKeyValid);
+}
+#endif
+
+static uint32 WJESelectorHash(const char *path)
+{
+	uint32		h = 2166136261U;
+
+	while (*path) {
+		h ^= (uint32) (unsigned char) *(path++);
+		h *= 16777619U;
+	}
+
+	return(h);
+}
+
+/*
+	Return a compiled version of path from the calling thread's cache, compiling
+	it if needed. The caller must release the result with WJEFreeSelector().
+*/
+static WJESelector WJESelectorCacheGet(const char *path)
+{
+#if WJE_SELECTOR_CACHE_SIZE > 0
+	WJESelectorCache	*cache;
+	WJESelector			selector;
+	WJESelector			*link;
+	uint32				hash;
+
+	if (!(cache = WJESelectorCacheData)) {
+		if (!WJESelectorCacheKeyReady() ||
+			!(cache = MemMalloc(sizeof(WJESelectorCache)))
+		) {
+			return(WJECompileSelector(path));
+		}
+
+		memset(cache, 0, sizeof(WJESelectorCache));
+		WJESelectorCacheData = cache;
+		WJESelectorCacheKeySet(WJESelectorCacheExitKey, cache);
+	}
+
+	hash = WJESelectorHash(path);
+	for (selector = cache->buckets[hash % WJE_SELECTOR_CACHE_BUCKETS];
+		selector; selector = selector->chain
+	) {
+		if (selector->hash == hash && !strcmp(selector->path, path)) {
+			break;
+		}
+	}
+
+	if (selector) {
+		/* Move it to the front of the list */
+		if (selector != cache->newest) {
+			selector->newer->older = selector->older;
+			if (selector->older) {
+				selector->older->newer = selector->newer;
+			} else {
+				cache->oldest = selector->newer;
+			}
+
+			selector->newer = NULL;
+			selector->older = cache->newest;
+			cache->newest->newer = selector;
+			cache->newest = selector;
+		}
+
+		selector->refs++;
+		return(selector);
+	}
+
+	if (cache->seen[hash % WJE_SELECTOR_CACHE_BUCKETS] != hash) {
+		/* Don't cache a path until it is used again */
+		cache->seen[hash % WJE_SELECTOR_CACHE_BUCKETS] = hash;
+		return(WJECompileSelector(path));
+	}
+
+	if (!(selector = WJECompileSelector(path))) {
+		return(NULL);
+	}
+
+	if (cache->count == WJE_SELECTOR_CACHE_SIZE) {
+		/* Evict the least recently used selector */
+		WJESelector		old = cache->oldest;
+
+		for (link = &cache->buckets[old->hash % WJE_SELECTOR_CACHE_BUCKETS];
+			*link != old; link = &(*link)->chain
+		);
+		*link = old->chain;
+
+		if ((cache->oldest = old->newer)) {
+			cache->oldest->older = NULL;
+		} else {
+			cache->newest = NULL;
+		}
+
+		cache->count--;
+		WJEFreeSelector(old);
+	}
+
+	selector->hash	= hash;
+	selector->chain	= cache->buckets[hash % WJE_SELECTOR_CACHE_BUCKETS];
+	cache->buckets[hash % WJE_SELECTOR_CACHE_BUCKETS] = selector;
+
+	selector->newer	= NULL;
+	if ((selector->older = cache->newest)) {
+		selector->older->newer = selector;
+	} else {
+		cache->oldest = selector;
+	}
+	cache->newest = selector;
+	cache->count++;
+
+	/* One reference for the cache and one for the caller */
+	selector->refs++;
+	return(selector);
+#else
+	return(WJECompileSelector(path));
+#endif
+}
+
+EXPORT void WJEFreeSelectorCache(void)
+{
+#if WJE_SELECTOR_CACHE_SIZE > 0
+	WJESelectorCache	*cache;
+
+	if ((cache = WJESelectorCacheData)) {
+		WJESelectorCacheData = NULL;
+		WJESelectorCacheKeySet(WJESelectorCacheExitKey, NULL);
+
+		WJESelectorCacheFree(cache);
+	}
+#endif
+}
+
+/*
+	Projections
+
+	A projection decides whether to load each element as the document is read,
+	based on a set of selectors. An element is loaded if it is matched by the
+	portion of any selector for its depth, and its parent was loaded for the
+	same selector. Anything below an element that matches all of a selector is
+	loaded.
+
+	Each selector that is still matching at each depth of the element that is
+	being loaded is kept in the projection, since the loader always finishes an
+	element before moving on to its next sibling. The offset of an element
+	within its parent is counted here as well, so that an offset refers to the
+	position in the source document.
+
+	The elements of an array that come before an offset that a selector asks
+	for are loaded as well, without anything below them, so that the element
+	that was asked for is found at the same offset in the loaded document.
+
+	A match function only looks at the name of an element and its offset in its
+	parent, so each element is checked by handing it a stand in for the element
+	that is about to be loaded.
+*/
+#define WJE_PROJECTION_SKIP		0
+#define WJE_PROJECTION_MATCH	1
+
+/* The element only holds the place of a later sibling, so nothing below it */
+#define WJE_PROJECTION_PLACE	2
+
+struct WJEProjection {
+	int						count;
+	WJESelector				*selectors;
+
+	/* The size of the arrays below, in levels of depth */
+	uint32					size;
+
+	/* A WJE_PROJECTION_* value for each selector at each depth */
+	char					*matching;
+	WJElement				*parents;
+	long					*offsets;
+};
+
+EXPORT WJEProjection WJEOpenProjection(const char **selectors, int count)
+{
+	WJEProjection	projection;
+	int				i;
+
+	if (!selectors || count <= 0) {
+		errno = EINVAL;
+		return(NULL);
+	}
+
+	if (!(projection = MemMalloc(sizeof(struct WJEProjection) + (count * sizeof(WJESelector))))) {
+		return(NULL);
+	}
+	memset(projection, 0, sizeof(struct WJEProjection));
+
+	projection->selectors = (WJESelector *) (projection + 1);
+	for (i = 0; i < count; i++) {
+		if (!(projection->selectors[i] = WJECompileSelector(selectors[i]))) {
+			WJECloseProjection(projection);
+			return(NULL);
+		}
+		projection->count++;
+	}
+
+	return(projection);
+}
+
+EXPORT void WJECloseProjection(WJEProjection projection)
+{
+	int				i;
+
+	if (!projection) {
+		return;
+	}
+
+	for (i = 0; i < projection->count; i++) {
+		WJEFreeSelector(projection->selectors[i]);
+	}
+
+	if (projection->matching) {
+		MemFree(projection->matching);
+	}
+	if (projection->parents) {
+		MemFree(projection->parents);
+	}
+	if (projection->offsets) {
+		MemFree(projection->offsets);
+	}
+	MemFree(projection);
+}
+
+static XplBool WJEProjectionGrow(WJEProjection projection, uint32 depth)
+{
+	char			*matching;
+	WJElement		*parents;
+	long			*offsets;
+	uint32			size;
+
+	if (depth < projection->size) {
+		return(TRUE);
+	}
+
+	size = (depth + 1) * 2;
+
+	if (!(matching = MemRealloc(projection->matching, size * projection->count))) {
+		return(FALSE);
+	}
+	projection->matching = matching;
+
+	if (!(parents = MemRealloc(projection->parents, size * sizeof(WJElement)))) {
+		return(FALSE);
+	}
+	projection->parents = parents;
+
+	if (!(offsets = MemRealloc(projection->offsets, size * sizeof(long)))) {
+		return(FALSE);
+	}
+	projection->offsets = offsets;
+
+	memset(projection->parents + projection->size, 0, (size - projection->size) * sizeof(WJElement));
+	projection->size = size;
+
+	return(TRUE);
+}
+
+static XplBool WJEProjectionMatch(WJESelectorStep *step, WJElement parent, char *name, long offset)
+{
+	WJElementPublic	p;
+	WJElementPublic	e;
+
+	if (step->cb == WJEMatchAll) {
+		return(TRUE);
+	}
+
+	if (step->cb == WJEMatchExact) {
+		return(name && !strncmp(name, step->name, step->len) && !name[step->len]);
+	}
+
+	if (step->index >= 0) {
+		return(offset == step->index);
+	}
+
+	/* A parent with the element as its last child, at the right offset */
+	memset(&p, 0, sizeof(p));
+	memset(&e, 0, sizeof(e));
+
+	p.type		= parent->type;
+	p.count		= offset + 1;
+	p.child		= &e;
+	p.last		= &e;
+
+	e.name		= name;
+	e.parent	= &p;
+
+	return(!step->cb(NULL, &p, &e, WJE_GET, step->name, step->len));
+}
+
+EXPORT XplBool WJEProjectionLoadCB(WJElement parent, char *name, void *data, const char *file, const int line)
+{
+	WJEProjection	projection	= (WJEProjection) data;
+	WJESelector		selector;
+	WJESelectorStep	*step;
+	WJElement		e;
+	char			*matching;
+	long			offset;
+	uint32			depth		= 0;
+	XplBool			load		= FALSE;
+	int				i;
+
+	if (!projection) {
+		return(TRUE);
+	}
+
+	for (e = parent; e; e = e->parent) {
+		depth++;
+	}
+
+	if (!WJEProjectionGrow(projection, depth)) {
+		/* Load anything that can't be checked */
+		return(TRUE);
+	}
+	matching = projection->matching + (depth * projection->count);
+
+	if (!depth) {
+		/* The root of a new document */
+		memset(projection->parents, 0, projection->size * sizeof(WJElement));
+		memset(matching, WJE_PROJECTION_MATCH, projection->count);
+		return(TRUE);
+	}
+
+	if (projection->parents[depth] != parent) {
+		projection->parents[depth] = parent;
+		projection->offsets[depth] = 0;
+	}
+	offset = projection->offsets[depth]++;
+
+	for (i = 0; i < projection->count; i++) {
+		selector = projection->selectors[i];
+
+		if (WJE_PROJECTION_MATCH != matching[i - projection->count]) {
+			matching[i] = WJE_PROJECTION_SKIP;
+		} else if (depth > (uint32) selector->count) {
+			/* This is part of an element that matched the entire selector */
+			matching[i] = WJE_PROJECTION_MATCH;
+		} else if (WJEProjectionMatch((step = &selector->steps[depth - 1]), parent, name, offset)) {
+			matching[i] = WJE_PROJECTION_MATCH;
+		} else if (WJR_TYPE_ARRAY == parent->type && step->cb != WJEMatchAll &&
+			step->cb != WJEMatchExact && step->index > offset
+		) {
+			/* Keep the offset of the element that the selector asks for */
+			matching[i] = WJE_PROJECTION_PLACE;
+		} else {
+			matching[i] = WJE_PROJECTION_SKIP;
+		}
+
+		if (WJE_PROJECTION_SKIP != matching[i]) {
+			load = TRUE;
+		}
+	}
+
+	return(load);
+}
+
+/*
+	Find a child WJElement by selector.  See description of WJEGet() in
+	wjelement.h
+*/
+static WJElement WJESelect(WJElement container, WJESelector selector, WJEAction *action, WJElement last, const char *file, const int line)
 {
 	WJElement	e, n;
 	WJElement	match		= NULL;
@@ -813,26 +1398,10 @@ WJElement WJESearch(WJElement container, const char *path, WJEAction *action, WJ
 	size_t		len			= 0;
 	WJEMatchCB	cb			= NULL;
 	XplBool		specific	= TRUE;
+	WJESelectorStep	*step;
 	char		*tmp;
 	int			depth;
-
-	if (!container && ((*action & WJE_ACTION_MASK) == WJE_NEW || (*action & WJE_ACTION_MASK) == WJE_SET)) {
-		if ((container = WJENew(NULL, NULL, 0, file, line))) {
-			MemUpdateOwner(container, file, line);
-			container->type = WJR_TYPE_UNKNOWN;
-		}
-	}
-
-	MemAssert(container);
-
-	/* An empty name, or "." refers to the current object, so just return it */
-	if (!path || !*path || !stricmp(path, ".") || !container) {
-		if (!last) {
-			return(container);
-		} else {
-			return(NULL);
-		}
-	}
+	long		i;
 
 	/*
 		'match' points to the last partial match.  If it is non-NULL then it's
@@ -849,6 +1418,11 @@ WJElement WJESearch(WJElement container, const char *path, WJEAction *action, WJ
 
 	e = last;
 	for (;;) {
+		if (match && !WJEMaterialized(match)) {
+			/* The children of match can't be parsed, so they can't match */
+			match = NULL;
+		}
+
 		if (match && !match->child && ((*action & WJE_ACTION_MASK) == WJE_NEW || (*action & WJE_ACTION_MASK) == WJE_SET)) {
 			/* Insert additional child elements if needed to satisfy the path */
 			e		= NULL;
@@ -864,30 +1438,55 @@ WJElement WJESearch(WJElement container, const char *path, WJEAction *action, WJ
 		}
 
 		/*
-			Find the next portion of the path, and additional information about
-			it to allow matching it to an element or to create a new match.
+			Find the portion of the path for this depth, and additional
+			information about it to allow matching it to an element or to
+			create a new match.
 		*/
-		cb	= NULL;
-		end	= (char *) path;
-		for (; depth; depth--) {
-			if (!(name = WJENextName(end, &len, &end, &cb, &specific))) {
-				break;
-			}
-		}
-
-		if (!cb || !name || depth) {
+		if (depth < 1 || depth > selector->count) {
 			/* This portion of the path is invalid.  Bail. */
 			return(NULL);
 		}
 
+		step		= &selector->steps[depth - 1];
+		name		= step->name;
+		len			= step->len;
+		end			= step->end;
+		cb			= step->cb;
+		specific	= step->specific;
+
 		/*
 			Does e match?
 
 			Since all ancestors of e have already been verified and the current
 			portion of the path has already been parsed might as well check
 			siblings of e as well.
+
+			When looking for an exact name starting at the first child the
+			name index can be used to skip directly to the first candidate.
 		*/
-		for (n = e; n; n = n->next) {
+		n = e;
+		if (e && !e->prev && e->parent && cb == WJEMatchExact &&
+			e->parent->count >= WJE_INDEX_MIN_COUNT
+		) {
+			if (!(n = WJEFindChild(e->parent, name, len, WJE_GET, NULL))) {
+				e = e->parent->last;
+			}
+		} else if (e && !e->prev && e->parent && step->index >= 0) {
+			/*
+				A single offset can only match the child at that offset, so
+				there is no need to check any of the children before it.
+			*/
+			if (step->index >= e->parent->count) {
+				n = NULL;
+				e = e->parent->last;
+			} else {
+				for (i = 0; i < step->index; i++) {
+					n = n->next;
+				}
+			}
+		}
+
+		for (; n; n = n->next) {
 			e = n;
 			if (!cb(container, n->parent, n, *action, name, len) &&
 				(!end || !*end || !WJECheckCondition(n, &end, *action))
@@ -951,7 +1550,7 @@ WJElement WJESearch(WJElement container, const char *path, WJEAction *action, WJ
 			return(n);
 		}
 
-		if (n && !n->child && '|' == *end) {
+		if (n && WJEMaterialized(n) && !n->child && '|' == *end) {
 			/*
 				The rest of the selector is marked as optional, and we have no
 				children, so consider this a match
@@ -966,11 +1565,208 @@ WJElement WJESearch(WJElement container, const char *path, WJEAction *action, WJ
 	return(NULL);
 }
 
+/*
+	Find a child WJElement by path, or by a compiled selector if one is
+	provided.  See description of WJEGet() in wjelement.h
+*/
+WJElement WJESearch(WJElement container, const char *path, WJESelector selector, WJEAction *action, WJElement last, const char *file, const int line)
+{
+	WJESelector	cached	= NULL;
+	WJElement	e;
+
+	if (!container && ((*action & WJE_ACTION_MASK) == WJE_NEW || (*action & WJE_ACTION_MASK) == WJE_SET)) {
+		if ((container = WJENew(NULL, NULL, 0, file, line))) {
+			MemUpdateOwner(container, file, line);
+			container->type = WJR_TYPE_UNKNOWN;
+		}
+	}
+
+	MemAssert(container);
+
+	if (selector) {
+		path = selector->path;
+	}
+
+	/* An empty name, or "." refers to the current object, so just return it */
+	if (!path || !*path || !stricmp(path, ".") || !container) {
+		if (!last) {
+			return(container);
+		} else {
+			return(NULL);
+		}
+	}
+
+	if (!selector && !(selector = cached = WJESelectorCacheGet(path))) {
+		return(NULL);
+	}
+
+	e = WJESelect(container, selector, action, last, file, line);
+
+	/*
+		The selector may have been evicted from the cache while it was in use,
+		if a condition in the path required a search of its own.
+	*/
+	WJEFreeSelector(cached);
+	return(e);
+}
+
+/*
+	Find the value for the remaining steps of a selector in the same way as
+	WJESelect() would, starting at element or at the frozen value p, without
+	materializing anything that is still frozen. Only exact names and single
+	offsets are handled.
+
+	1 is returned if the value was found, with *result set to the element or
+	to scratch if the value is still frozen. 0 is returned if it does not
+	exist, and -1 if the steps must be handled by WJESelect() instead.
+*/
+static int WJESelectValue(WJElement element, const uint64 *p, WJESelectorStep *step, int count, _WJElement *scratch, WJElement *result)
+{
+	WJElement		e;
+	const uint64	*c;
+	char			*name;
+	size_t			len;
+	long			i;
+	int				r;
+
+	if (!count) {
+		if (p) {
+			memset(scratch, 0, sizeof(_WJElement));
+			WJETapeLoad(p, scratch, FALSE);
+
+			element = (WJElement) scratch;
+		}
+
+		*result = element;
+		return(1);
+	}
+
+	if (!p && !(p = WJETapeOf(element))) {
+		if (!WJEMaterialized(element)) {
+			return(0);
+		}
+
+		if (step->index >= 0) {
+			if (step->index >= element->count) {
+				return(0);
+			}
+
+			for (e = element->child, i = 0; i < step->index; i++) {
+				e = e->next;
+			}
+
+			return(WJESelectValue(e, NULL, step + 1, count - 1, scratch, result));
+		}
+
+		if (WJR_TYPE_OBJECT != element->type) {
+			return(WJR_TYPE_ARRAY == element->type ? -1 : 0);
+		}
+
+		if (element->count >= WJE_INDEX_MIN_COUNT) {
+			e = WJEFindChild(element, step->name, step->len, WJE_GET, NULL);
+		} else {
+			e = element->child;
+		}
+
+		/* A later sibling with the same name may match the rest of the path */
+		for (; e; e = e->next) {
+			if (!WJEMatchExact(NULL, element, e, WJE_GET, step->name, step->len) &&
+				(r = WJESelectValue(e, NULL, step + 1, count - 1, scratch, result))
+			) {
+				return(r);
+			}
+		}
+
+		return(0);
+	}
+
+	switch (WJETapeType(p)) {
+		case WJR_TYPE_OBJECT:
+			break;
+
+		case WJR_TYPE_ARRAY:
+			if (step->index < 0) {
+				return(-1);
+			}
+			break;
+
+		default:
+			return(0);
+	}
+
+	for (c = WJETapeChild(p, NULL, &name, &len), i = 0; c;
+		c = WJETapeChild(p, c, &name, &len), i++
+	) {
+		if (step->index >= 0) {
+			if (i == step->index) {
+				return(WJESelectValue(NULL, c, step + 1, count - 1, scratch, result));
+			}
+		} else if (len == step->len && !memcmp(name, step->name, len) &&
+			(r = WJESelectValue(NULL, c, step + 1, count - 1, scratch, result))
+		) {
+			return(r);
+		}
+	}
+
+	return(0);
+}
+
+/*
+	A version of WJESearch() for the typed getters, which only need to read the
+	value that is found. A value that is still part of a frozen document is
+	read into scratch rather than materializing the elements on the way to it,
+	so scratch must not be provided if the result is going to be kept.
+*/
+WJElement WJESearchValue(WJElement container, const char *path, WJESelector selector, WJEAction *action, WJElement last, _WJElement *scratch, const char *file, const int line)
+{
+	WJESelector	cached	= NULL;
+	WJElement	e		= NULL;
+	int			i, r	= -1;
+
+	if (!container || last || !scratch || (*action & WJE_ACTION_MASK) != WJE_GET ||
+		(!selector && (!path || !*path || !stricmp(path, ".")))
+	) {
+		return(WJESearch(container, path, selector, action, last, file, line));
+	}
+
+	if (!selector && !(selector = cached = WJESelectorCacheGet(path))) {
+		return(NULL);
+	}
+
+	for (i = 0; i < selector->count; i++) {
+		WJESelectorStep	*step = &selector->steps[i];
+
+		if ((step->cb != WJEMatchExact && (step->cb != WJEMatchSubscript || step->index < 0)) ||
+			(step->end && *step->end && '[' != *step->end && !isalnumx(*step->end))
+		) {
+			break;
+		}
+	}
+
+	if (selector->count > 0 && i == selector->count) {
+		r = WJESelectValue(container, NULL, selector->steps, selector->count, scratch, &e);
+	}
+
+	if (r < 0) {
+		e = WJESearch(container, path, selector, action, last, file, line);
+	}
+
+	WJEFreeSelector(cached);
+	return(e);
+}
+
 EXPORT WJElement _WJEGet(WJElement container, char *path, WJElement last, const char *file, const int line)
 {
 	WJEAction	a = WJE_GET;
 
-	return(WJESearch(container, path, &a, last, file, line));
+	return(WJESearch(container, path, NULL, &a, last, file, line));
+}
+
+EXPORT WJElement _WJEGetCompiled(WJElement container, WJESelector selector, WJElement last, const char *file, const int line)
+{
+	WJEAction	a = WJE_GET;
+
+	return(WJESearch(container, NULL, selector, &a, last, file, line));
 }
 
 EXPORT WJElement _WJEChild(WJElement container, char *name, WJEAction action, const char *file, const int line)
@@ -979,11 +1775,7 @@ EXPORT WJElement _WJEChild(WJElement container, char *name, WJEAction action, co
 
 	if (!container || !name) return(NULL);
 
-	for (e = container->child; e; e = e->next) {
-		if (e->name && !wstrcmp(e->name, name, action)) {
-			break;
-		}
-	}
+	e = WJEFindChild(container, name, strlen(name), action, NULL);
 
 	switch ((action & WJE_ACTION_MASK)) {
 		case WJE_GET:
@@ -1020,7 +1812,12 @@ EXPORT WJElement _WJEChild(WJElement container, char *name, WJEAction action, co
 //		call this. I want to discourage the use of those functions though.
 EXPORT WJElement _WJEAny(WJElement container, char *path, WJEAction action, WJElement last, const char *file, const int line)
 {
-	return(WJESearch(container, path, &action, last, file, line));
+	return(WJESearch(container, path, NULL, &action, last, file, line));
+}
+
+EXPORT WJElement _WJEAnyCompiled(WJElement container, WJESelector selector, WJEAction action, WJElement last, const char *file, const int line)
+{
+	return(WJESearch(container, NULL, selector, &action, last, file, line));
 }
 
 
@@ -0,0 +1,291 @@
+/*
+    This file is part of WJElement.
+
+    WJElement is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation.
+
+    WJElement is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with WJElement.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "element.h"
+
+#ifdef _WIN32
+#include <windows.h>
+
+typedef CRITICAL_SECTION				WJESnapshotMutex;
+#define WJESnapshotMutexInit(m)			InitializeCriticalSection((m))
+#define WJESnapshotMutexFree(m)			DeleteCriticalSection((m))
+#define WJESnapshotLock(m)				EnterCriticalSection((m))
+#define WJESnapshotUnlock(m)			LeaveCriticalSection((m))
+
+#define WJESnapshotLoad(p)				((WJElement) InterlockedCompareExchangePointer((PVOID volatile *) (p), NULL, NULL))
+#define WJESnapshotStore(p, v)			InterlockedExchangePointer((PVOID volatile *) (p), (v))
+#define WJESnapshotExchange(p, v)		((WJElement) InterlockedExchangePointer((PVOID volatile *) (p), (v)))
+#else
+#include <pthread.h>
+
+typedef pthread_mutex_t					WJESnapshotMutex;
+#define WJESnapshotMutexInit(m)			pthread_mutex_init((m), NULL)
+#define WJESnapshotMutexFree(m)			pthread_mutex_destroy((m))
+#define WJESnapshotLock(m)				pthread_mutex_lock((m))
+#define WJESnapshotUnlock(m)			pthread_mutex_unlock((m))
+
+#define WJESnapshotLoad(p)				__atomic_load_n((p), __ATOMIC_SEQ_CST)
+#define WJESnapshotStore(p, v)			__atomic_store_n((p), (v), __ATOMIC_SEQ_CST)
+#define WJESnapshotExchange(p, v)		__atomic_exchange_n((p), (v), __ATOMIC_SEQ_CST)
+#endif
+
+/*
+	Snapshots
+
+	A snapshot holds the current version of a document that is read by many
+	threads, and is replaced as a whole by publishing a new version. A version
+	is never modified once it has been published, so readers don't need to
+	take any locks to use it.
+
+	Each reader has a slot of its own, which it sets to the version it is using
+	before it uses it. Reading the current version takes nothing more than an
+	atomic load and store, and a second load to make sure that the version
+	wasn't replaced in between, in which case the reader tries again with the
+	new one.
+
+	A version that has been replaced is kept until no reader's slot refers to
+	it any longer, and is closed by the next publish or reclaim after that.
+	Only publishing and reclaiming take the lock, which also keeps the list of
+	readers stable while it is checked.
+*/
+
+struct WJESnapshotReader {
+	/* The version that the reader is using, which must not be closed */
+	WJElement					inuse;
+
+	/*
+		The slot is written every time the reader reads a version, so keep it
+		away from the slots of other readers.
+	*/
+	char						padding[64];
+
+	WJESnapshot					snapshot;
+	struct WJESnapshotReader	*next;
+};
+
+struct WJESnapshot {
+	WJElement					current;
+
+	WJESnapshotMutex			lock;
+	WJESnapshotReader			readers;
+
+	/* Versions that have been replaced, which may still be in use */
+	WJElement					*retired;
+	size_t						count;
+	size_t						size;
+};
+
+/*
+	Prepare a version to be read by many threads at once, by doing anything
+	that reading it could otherwise do to it the first time, such as
+	materializing lazy or frozen parts of it and building name indexes.
+*/
+static XplBool WJESnapshotPrepare(WJElement document)
+{
+	if (!document || document->parent) {
+		return(FALSE);
+	}
+
+	return(_WJEIndexAll(document));
+}
+
+/* Close any retired versions that no reader is using. The lock must be held. */
+static void WJESnapshotReclaim(WJESnapshot snapshot)
+{
+	WJESnapshotReader	reader;
+	size_t				i, kept;
+
+	for (i = kept = 0; i < snapshot->count; i++) {
+		for (reader = snapshot->readers; reader; reader = reader->next) {
+			if (WJESnapshotLoad(&reader->inuse) == snapshot->retired[i]) {
+				break;
+			}
+		}
+
+		if (reader) {
+			snapshot->retired[kept++] = snapshot->retired[i];
+		} else {
+			WJECloseDocument(snapshot->retired[i]);
+		}
+	}
+
+	snapshot->count = kept;
+}
+
+EXPORT WJESnapshot WJEOpenSnapshot(WJElement document)
+{
+	WJESnapshot		snapshot;
+
+	if (!WJESnapshotPrepare(document) ||
+		!(snapshot = MemMalloc(sizeof(struct WJESnapshot)))
+	) {
+		return(NULL);
+	}
+	memset(snapshot, 0, sizeof(struct WJESnapshot));
+
+	WJESnapshotMutexInit(&snapshot->lock);
+	snapshot->current = document;
+
+	return(snapshot);
+}
+
+EXPORT XplBool WJEPublishSnapshot(WJESnapshot snapshot, WJElement document)
+{
+	WJElement	*retired;
+	WJElement	old;
+	size_t		size;
+
+	if (!snapshot || !WJESnapshotPrepare(document)) {
+		return(FALSE);
+	}
+
+	WJESnapshotLock(&snapshot->lock);
+
+	if (snapshot->count == snapshot->size) {
+		size = snapshot->size ? snapshot->size * 2 : 8;
+
+		if (!(retired = MemRealloc(snapshot->retired, size * sizeof(WJElement)))) {
+			WJESnapshotUnlock(&snapshot->lock);
+			return(FALSE);
+		}
+
+		snapshot->retired	= retired;
+		snapshot->size		= size;
+	}
+
+	if ((old = WJESnapshotExchange(&snapshot->current, document)) && old != document) {
+		snapshot->retired[snapshot->count++] = old;
+	}
+	WJESnapshotReclaim(snapshot);
+
+	WJESnapshotUnlock(&snapshot->lock);
+	return(TRUE);
+}
+
+EXPORT void WJEReclaimSnapshot(WJESnapshot snapshot)
+{
+	if (snapshot) {
+		WJESnapshotLock(&snapshot->lock);
+		WJESnapshotReclaim(snapshot);
+		WJESnapshotUnlock(&snapshot->lock);
+	}
+}
+
+EXPORT WJElement _WJECopySnapshot(WJESnapshot snapshot, const char *file, const int line)
+{
+	WJElement	copy;
+
+	if (!snapshot) {
+		return(NULL);
+	}
+
+	/* The current version can't be closed while the lock is held */
+	WJESnapshotLock(&snapshot->lock);
+	copy = _WJECopyDocument(NULL, snapshot->current, NULL, NULL, file, line);
+	WJESnapshotUnlock(&snapshot->lock);
+
+	return(copy);
+}
+
+EXPORT void WJECloseSnapshot(WJESnapshot snapshot)
+{
+	WJESnapshotReader	reader;
+	size_t				i;
+
+	if (!snapshot) {
+		return;
+	}
+
+	while ((reader = snapshot->readers)) {
+		snapshot->readers = reader->next;
+		MemFree(reader);
+	}
+
+	for (i = 0; i < snapshot->count; i++) {
+		WJECloseDocument(snapshot->retired[i]);
+	}
+	WJECloseDocument(snapshot->current);
+
+	WJESnapshotMutexFree(&snapshot->lock);
+	MemRelease(&snapshot->retired);
+	MemFree(snapshot);
+}
+
+EXPORT WJESnapshotReader WJEOpenSnapshotReader(WJESnapshot snapshot)
+{
+	WJESnapshotReader	reader;
+
+	if (!snapshot || !(reader = MemMalloc(sizeof(struct WJESnapshotReader)))) {
+		return(NULL);
+	}
+	memset(reader, 0, sizeof(struct WJESnapshotReader));
+	reader->snapshot = snapshot;
+
+	WJESnapshotLock(&snapshot->lock);
+	reader->next		= snapshot->readers;
+	snapshot->readers	= reader;
+	WJESnapshotUnlock(&snapshot->lock);
+
+	return(reader);
+}
+
+EXPORT WJElement WJEReadSnapshot(WJESnapshotReader reader)
+{
+	WJElement	version;
+
+	if (!reader) {
+		return(NULL);
+	}
+
+	do {
+		version = WJESnapshotLoad(&reader->snapshot->current);
+		WJESnapshotStore(&reader->inuse, version);
+
+		/* If it was replaced before the slot was set then it may be closed */
+	} while (WJESnapshotLoad(&reader->snapshot->current) != version);
+
+	return(version);
+}
+
+EXPORT void WJEReleaseSnapshot(WJESnapshotReader reader)
+{
+	if (reader) {
+		WJESnapshotStore(&reader->inuse, NULL);
+	}
+}
+
+EXPORT void WJECloseSnapshotReader(WJESnapshotReader reader)
+{
+	WJESnapshot			snapshot;
+	WJESnapshotReader	*link;
+
+	if (!reader) {
+		return;
+	}
+	snapshot = reader->snapshot;
+
+	WJESnapshotLock(&snapshot->lock);
+	for (link = &snapshot->readers; *link; link = &(*link)->next) {
+		if (*link == reader) {
+			*link = reader->next;
+			break;
+		}
+	}
+	WJESnapshotUnlock(&snapshot->lock);
+
+	MemFree(reader);
+}
@@ -0,0 +1,201 @@
+/*
+    This file is part of WJElement.
+
+    WJElement is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation.
+
+    WJElement is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with WJElement.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "element.h"
+
+/*
+	Symbol tables
+
+	A symbol table keeps a single copy of each distinct name, and optionally of
+	each short string value, so that a document made up of many records with
+	the same shape only stores each name once. Elements point at the copy in the
+	table, and treat it as borrowed.
+
+	A table is attached to the arena of a document, and is kept until every
+	arena that uses it has been free'd, which also covers elements that have
+	been detached from the document. The copies themselves are allocated from
+	an arena of the table's own, and are never free'd individually.
+*/
+
+#define WJE_SYMBOLS_MIN_SIZE	256
+
+/* The longest string value that is interned when WJE_SYMBOLS_VALUES is set */
+#ifndef WJE_SYMBOLS_MAX_VALUE
+#define WJE_SYMBOLS_MAX_VALUE	32
+#endif
+
+typedef struct WJESymbol {
+	struct WJESymbol	*next;
+	uint32				hash;
+	size_t				len;
+
+	char				value[];
+} WJESymbol;
+
+struct WJESymbols {
+	/* The caller's reference, and one for each arena using the table */
+	int					refs;
+	uint32				flags;
+
+	WJEArena			*arena;
+
+	/* The number of buckets, which is always a power of 2 */
+	size_t				size;
+	size_t				count;
+	WJESymbol			**buckets;
+};
+
+static uint32 WJESymbolHash(const char *value, size_t len)
+{
+	uint32		h = 2166136261U;
+
+	while (len--) {
+		h ^= (uint32) (unsigned char) *(value++);
+		h *= 16777619U;
+	}
+
+	return(h);
+}
+
+EXPORT WJESymbols WJEOpenSymbols(uint32 flags)
+{
+	WJESymbols	symbols;
+
+	if (!(symbols = MemMalloc(sizeof(struct WJESymbols)))) {
+		return(NULL);
+	}
+	memset(symbols, 0, sizeof(struct WJESymbols));
+
+	symbols->refs	= 1;
+	symbols->flags	= flags;
+	symbols->size	= WJE_SYMBOLS_MIN_SIZE;
+
+	if (!(symbols->arena = WJEArenaNew()) ||
+		!(symbols->buckets = MemMalloc(symbols->size * sizeof(WJESymbol *)))
+	) {
+		if (symbols->arena) {
+			WJEArenaRetain(symbols->arena);
+			WJEArenaRelease(symbols->arena);
+		}
+		MemFree(symbols);
+		return(NULL);
+	}
+
+	memset(symbols->buckets, 0, symbols->size * sizeof(WJESymbol *));
+	WJEArenaRetain(symbols->arena);
+
+	return(symbols);
+}
+
+void WJESymbolsRetain(WJESymbols symbols)
+{
+	if (symbols) {
+		symbols->refs++;
+	}
+}
+
+void WJESymbolsRelease(WJESymbols symbols)
+{
+	if (!symbols || --symbols->refs) {
+		return;
+	}
+
+	WJEArenaRelease(symbols->arena);
+	MemFree(symbols->buckets);
+	MemFree(symbols);
+}
+
+EXPORT void WJECloseSymbols(WJESymbols symbols)
+{
+	WJESymbolsRelease(symbols);
+}
+
+/* Double the number of buckets, or leave the table as it is if that fails */
+static void WJESymbolsGrow(WJESymbols symbols)
+{
+	WJESymbol	**buckets;
+	WJESymbol	*symbol;
+	size_t		size, i;
+
+	size = symbols->size * 2;
+	if (!(buckets = MemMalloc(size * sizeof(WJESymbol *)))) {
+		return;
+	}
+	memset(buckets, 0, size * sizeof(WJESymbol *));
+
+	for (i = 0; i < symbols->size; i++) {
+		while ((symbol = symbols->buckets[i])) {
+			symbols->buckets[i] = symbol->next;
+
+			symbol->next = buckets[symbol->hash & (size - 1)];
+			buckets[symbol->hash & (size - 1)] = symbol;
+		}
+	}
+
+	MemFree(symbols->buckets);
+	symbols->buckets	= buckets;
+	symbols->size		= size;
+}
+
+/*
+	Return the copy of value that is kept in the table, adding one if needed.
+	The value does not need to be terminated, but the copy is.
+
+	NULL is returned if value is a string value (rather than a name) and the
+	table doesn't intern values of that length.
+*/
+char * WJESymbolsIntern(WJESymbols symbols, const char *value, size_t len, XplBool isvalue)
+{
+	WJESymbol	*symbol;
+	uint32		hash;
+	size_t		i;
+
+	if (!symbols || !value ||
+		(isvalue && (!(symbols->flags & WJE_SYMBOLS_VALUES) || len > WJE_SYMBOLS_MAX_VALUE))
+	) {
+		return(NULL);
+	}
+
+	hash	= WJESymbolHash(value, len);
+	i		= hash & (symbols->size - 1);
+
+	for (symbol = symbols->buckets[i]; symbol; symbol = symbol->next) {
+		if (symbol->hash == hash && symbol->len == len &&
+			!memcmp(symbol->value, value, len)
+		) {
+			return(symbol->value);
+		}
+	}
+
+	if (!(symbol = WJEArenaAlloc(symbols->arena, sizeof(WJESymbol) + len + 1))) {
+		return(NULL);
+	}
+
+	memcpy(symbol->value, value, len);
+	symbol->value[len]	= '\0';
+	symbol->hash		= hash;
+	symbol->len			= len;
+
+	symbol->next		= symbols->buckets[i];
+	symbols->buckets[i]	= symbol;
+
+	if (++symbols->count > symbols->size) {
+		WJESymbolsGrow(symbols);
+	}
+
+	return(symbol->value);
+}
@@ -0,0 +1,694 @@
+/*
+    This file is part of WJElement.
+
+    WJElement is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation.
+
+    WJElement is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with WJElement.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "element.h"
+
+/*
+	Frozen documents
+
+	A frozen document is stored as a tape of 8 byte words in document order,
+	followed by a pool of strings. The top byte of each word is a tag, which is
+	the WJRType of a value or WJE_TAPE_NAME, and the rest is the payload:
+
+		object, array	The number of words in the value, including these two,
+						followed by a word with the number of children. Each
+						child of an object is preceded by the word of its name.
+		name, string	The distance in bytes from the word to the string in
+						the pool. Each string in the pool is preceded by a 32
+						bit length and followed by a terminator, and each
+						distinct string is only stored once.
+		number			Bit 0 is set if the number is negative, and bit 1 if
+						it has a decimal point. The integer and double values
+						follow in two more words.
+		true, false		The boolean value
+
+	The elements of a frozen document are only created as they are needed, in
+	the same way as a lazy document. An object or array that hasn't been
+	materialized has both WJE_FLAG_LAZY and WJE_FLAG_FROZEN set, and
+	value.string points to its first word. Values that are read with the typed
+	getters, and documents that are written, are read straight from the tape
+	instead.
+
+	The tape is owned by the arena of the document, and the elements that are
+	created share names and strings from the pool.
+*/
+
+#define WJE_TAPE_NAME			'K'
+
+#define WJE_TAPE_NEGATIVE		0x01
+#define WJE_TAPE_DECIMAL		0x02
+
+#define WJETapeTag(w)			((char) ((w) >> 56))
+#define WJETapePayload(w)		((w) & 0x00FFFFFFFFFFFFFFULL)
+#define WJETapeWord(t, p)		((((uint64) (unsigned char) (t)) << 56) | (uint64) (p))
+
+/* The initial size of the arena chunks for a frozen document */
+#define WJE_TAPE_ARENA_CHUNK	1024
+
+/* The number of words in the value at p */
+static size_t WJETapeSize(const uint64 *p)
+{
+	switch (WJETapeTag(*p)) {
+		case WJR_TYPE_OBJECT:
+		case WJR_TYPE_ARRAY:
+			return((size_t) WJETapePayload(*p));
+
+		case WJR_TYPE_NUMBER:
+#ifdef WJE_DISTINGUISH_INTEGER_TYPE
+		case WJR_TYPE_INTEGER:
+#endif
+			return(3);
+
+		default:
+			return(1);
+	}
+}
+
+/* The string that the name or string word at p refers to */
+static char * WJETapeString(const uint64 *p, size_t *len)
+{
+	char		*s = (char *) p + WJETapePayload(*p);
+	uint32		l;
+
+	memcpy(&l, s - sizeof(l), sizeof(l));
+	if (len) {
+		*len = l;
+	}
+
+	return(s);
+}
+
+/*
+	Building a tape
+
+	The words and the pool are collected in buffers of their own, with the
+	position of each string in the pool stored in its word, and then copied
+	into a single block once the size of each is known. The positions are
+	replaced with the distance from each word at that point.
+*/
+typedef struct {
+	uint32				hash;
+	size_t				offset;
+} WJETapeSlot;
+
+typedef struct {
+	uint64				*words;
+	size_t				used;
+	size_t				size;
+
+	char				*pool;
+	size_t				poolused;
+	size_t				poolsize;
+
+	/* An open addressing table of the strings in the pool */
+	WJETapeSlot			*slots;
+	size_t				slotsused;
+	size_t				slotsize;
+
+	XplBool				failed;
+} WJETapeBuilder;
+
+static size_t WJETapeAddWord(WJETapeBuilder *b, uint64 word)
+{
+	uint64		*words;
+	size_t		size;
+
+	if (b->used == b->size) {
+		size = b->size ? b->size * 2 : 256;
+
+		if (!(words = MemRealloc(b->words, size * sizeof(uint64)))) {
+			b->failed = TRUE;
+			return(0);
+		}
+
+		b->words	= words;
+		b->size		= size;
+	}
+
+	b->words[b->used] = word;
+	return(b->used++);
+}
+
+static uint32 WJETapeHash(const char *value, size_t len)
+{
+	uint32		h = 2166136261U;
+
+	while (len--) {
+		h ^= (uint32) (unsigned char) *(value++);
+		h *= 16777619U;
+	}
+
+	return(h);
+}
+
+static XplBool WJETapeGrowSlots(WJETapeBuilder *b)
+{
+	WJETapeSlot	*slots;
+	size_t		size, i, j;
+
+	size = b->slotsize ? b->slotsize * 2 : 1024;
+	if (!(slots = MemMalloc(size * sizeof(WJETapeSlot)))) {
+		return(FALSE);
+	}
+	memset(slots, 0, size * sizeof(WJETapeSlot));
+
+	for (i = 0; i < b->slotsize; i++) {
+		if (b->slots[i].offset) {
+			for (j = b->slots[i].hash & (size - 1); slots[j].offset; j = (j + 1) & (size - 1));
+			slots[j] = b->slots[i];
+		}
+	}
+
+	MemFree(b->slots);
+	b->slots	= slots;
+	b->slotsize	= size;
+	return(TRUE);
+}
+
+/* Return the position of a copy of value in the pool, adding it if needed */
+static size_t WJETapeAddString(WJETapeBuilder *b, const char *value, size_t len)
+{
+	char		*pool;
+	size_t		size, i;
+	uint32		hash, l;
+
+	if (!value) {
+		value = "";
+		len = 0;
+	}
+
+	if ((uint32) len != len ||
+		((b->slotsused + 1) * 2 > b->slotsize && !WJETapeGrowSlots(b))
+	) {
+		b->failed = TRUE;
+		return(0);
+	}
+
+	hash = WJETapeHash(value, len);
+	for (i = hash & (b->slotsize - 1); b->slots[i].offset; i = (i + 1) & (b->slotsize - 1)) {
+		if (b->slots[i].hash == hash) {
+			memcpy(&l, b->pool + b->slots[i].offset - sizeof(l), sizeof(l));
+
+			if (l == len && !memcmp(b->pool + b->slots[i].offset, value, len)) {
+				return(b->slots[i].offset);
+			}
+		}
+	}
+
+	if (b->poolsize - b->poolused < sizeof(l) + len + 1) {
+		size = b->poolsize ? b->poolsize * 2 : 4096;
+		while (size - b->poolused < sizeof(l) + len + 1) {
+			size *= 2;
+		}
+
+		if (!(pool = MemRealloc(b->pool, size))) {
+			b->failed = TRUE;
+			return(0);
+		}
+
+		b->pool		= pool;
+		b->poolsize	= size;
+	}
+
+	l = (uint32) len;
+	memcpy(b->pool + b->poolused, &l, sizeof(l));
+	b->poolused += sizeof(l);
+
+	memcpy(b->pool + b->poolused, value, len);
+	b->pool[b->poolused + len] = '\0';
+
+	b->slots[i].hash	= hash;
+	b->slots[i].offset	= b->poolused;
+	b->slotsused++;
+
+	b->poolused += len + 1;
+	return(b->slots[i].offset);
+}
+
+static void WJETapeAdd(WJETapeBuilder *b, WJElement element)
+{
+	_WJElement	*e = (_WJElement *) element;
+	WJElement	child;
+	size_t		start;
+	uint64		count;
+	uint64		flags;
+	uint64		word;
+
+	switch (e->pub.type) {
+		case WJR_TYPE_OBJECT:
+		case WJR_TYPE_ARRAY:
+			start = WJETapeAddWord(b, WJETapeWord(e->pub.type, 0));
+			WJETapeAddWord(b, 0);
+
+			if (!WJEMaterialized((WJElement) e)) {
+				b->failed = TRUE;
+			}
+
+			for (count = 0, child = e->pub.child; child && !b->failed; child = child->next) {
+				if (WJR_TYPE_OBJECT == e->pub.type) {
+					if (!child->name || !*child->name) {
+						/* There is no way to refer to it, or to write it */
+						continue;
+					}
+
+					WJETapeAddWord(b, WJETapeWord(WJE_TAPE_NAME,
+						WJETapeAddString(b, child->name, strlen(child->name))));
+				}
+
+				WJETapeAdd(b, child);
+				count++;
+			}
+
+			if (!b->failed) {
+				b->words[start]		|= b->used - start;
+				b->words[start + 1]	= count;
+			}
+			break;
+
+		case WJR_TYPE_STRING:
+			WJETapeAddWord(b, WJETapeWord(WJR_TYPE_STRING,
+				WJETapeAddString(b, e->value.string, e->pub.length)));
+			break;
+
+		case WJR_TYPE_NUMBER:
+#ifdef WJE_DISTINGUISH_INTEGER_TYPE
+		case WJR_TYPE_INTEGER:
+#endif
+			flags = 0;
+			if (e->value.number.negative) {
+				flags |= WJE_TAPE_NEGATIVE;
+			}
+			if (e->value.number.hasDecimalPoint) {
+				flags |= WJE_TAPE_DECIMAL;
+			}
+
+			memcpy(&word, &e->value.number.d, sizeof(double));
+
+			WJETapeAddWord(b, WJETapeWord(e->pub.type, flags));
+			WJETapeAddWord(b, e->value.number.i);
+			WJETapeAddWord(b, word);
+			break;
+
+		case WJR_TYPE_TRUE:
+		case WJR_TYPE_FALSE:
+		case WJR_TYPE_BOOL:
+			WJETapeAddWord(b, WJETapeWord(e->pub.type, e->value.boolean ? 1 : 0));
+			break;
+
+		default:
+			WJETapeAddWord(b, WJETapeWord(e->pub.type, 0));
+			break;
+	}
+}
+
+/* Copy the words and the pool into one block, replacing the string positions */
+static uint64 * WJETapeFinish(WJETapeBuilder *b)
+{
+	uint64		*tape;
+	size_t		i, step;
+
+	if (b->failed || !b->used ||
+		!(tape = MemMalloc((b->used * sizeof(uint64)) + b->poolused))
+	) {
+		return(NULL);
+	}
+
+	memcpy(tape, b->words, b->used * sizeof(uint64));
+	if (b->poolused) {
+		memcpy(tape + b->used, b->pool, b->poolused);
+	}
+
+	for (i = 0; i < b->used; i += step) {
+		switch (WJETapeTag(tape[i])) {
+			case WJR_TYPE_OBJECT:
+			case WJR_TYPE_ARRAY:
+				/* Step into the children rather than over them */
+				step = 2;
+				break;
+
+			case WJE_TAPE_NAME:
+			case WJR_TYPE_STRING:
+				tape[i] = WJETapeWord(WJETapeTag(tape[i]),
+					((b->used - i) * sizeof(uint64)) + WJETapePayload(tape[i]));
+				step = 1;
+				break;
+
+			default:
+				step = WJETapeSize(tape + i);
+				break;
+		}
+	}
+
+	return(tape);
+}
+
+static void WJETapeFree(void *tape)
+{
+	MemFree(tape);
+}
+
+/*
+	Set e to the value at p. An object or array is left to be materialized
+	later if lazy is set, and is otherwise left empty.
+*/
+void WJETapeLoad(const uint64 *p, _WJElement *e, XplBool lazy)
+{
+	e->pub.type = (WJRType) WJETapeTag(*p);
+
+	switch (e->pub.type) {
+		case WJR_TYPE_OBJECT:
+		case WJR_TYPE_ARRAY:
+			if (lazy) {
+				e->value.string	= (char *) p;
+				e->flags		|= WJE_FLAG_LAZY | WJE_FLAG_FROZEN;
+			}
+			break;
+
+		case WJR_TYPE_STRING:
+			e->value.string	= WJETapeString(p, &e->pub.length);
+			e->flags		|= WJE_FLAG_STRING_BORROWED;
+			break;
+
+		case WJR_TYPE_NUMBER:
+#ifdef WJE_DISTINGUISH_INTEGER_TYPE
+		case WJR_TYPE_INTEGER:
+#endif
+			e->value.number.negative		= (WJETapePayload(*p) & WJE_TAPE_NEGATIVE) ? TRUE : FALSE;
+			e->value.number.hasDecimalPoint	= (WJETapePayload(*p) & WJE_TAPE_DECIMAL) ? TRUE : FALSE;
+			e->value.number.i				= p[1];
+			memcpy(&e->value.number.d, p + 2, sizeof(double));
+			break;
+
+		case WJR_TYPE_TRUE:
+		case WJR_TYPE_FALSE:
+		case WJR_TYPE_BOOL:
+			e->value.boolean = WJETapePayload(*p) ? TRUE : FALSE;
+			break;
+
+		default:
+			break;
+	}
+}
+
+EXPORT WJElement _WJEFreeze(WJElement document, const char *file, const int line)
+{
+	WJETapeBuilder	b;
+	WJEArena		*arena;
+	_WJElement		*root	= NULL;
+	uint64			*tape;
+
+	if (!document) {
+		errno = EINVAL;
+		return(NULL);
+	}
+
+	memset(&b, 0, sizeof(b));
+	WJETapeAdd(&b, document);
+	tape = WJETapeFinish(&b);
+
+	MemRelease(&b.words);
+	MemRelease(&b.pool);
+	MemRelease(&b.slots);
+
+	if (!tape) {
+		return(NULL);
+	}
+
+	if (!(arena = WJEArenaNewEx(WJE_TAPE_ARENA_CHUNK))) {
+		MemFree(tape);
+		return(NULL);
+	}
+
+	/* The tape is free'd along with the arena */
+	WJEArenaSource(arena, tape, WJETapeFree);
+	WJEArenaRetain(arena);
+
+	if ((root = _WJENewEx(NULL, arena, document->name,
+		document->name ? strlen(document->name) : 0, 0, file, line))
+	) {
+		WJETapeLoad(tape, root, TRUE);
+	}
+
+	WJEArenaRelease(arena);
+	return((WJElement) root);
+}
+
+EXPORT WJElement _WJEOpenDocumentFrozen(WJReader reader, char *where, WJELoadCB loadcb, void *data, const char *file, const int line)
+{
+	WJElement	doc, frozen;
+
+	if (!(doc = _WJEOpenDocumentArena(reader, where, loadcb, data, file, line))) {
+		return(NULL);
+	}
+
+	/* The loaded document is only needed until it has been frozen */
+	WJEArenaRecord(((_WJElement *) doc)->arena, doc);
+
+	frozen = _WJEFreeze(doc, file, line);
+	_WJECloseDocument(doc, file, line);
+
+	return(frozen);
+}
+
+/*
+	Return the child of the frozen object or array at container that follows
+	last, or the first child if last is NULL. The name of the child is returned
+	as well if the container is an object.
+*/
+const uint64 * WJETapeChild(const uint64 *container, const uint64 *last, char **name, size_t *len)
+{
+	const uint64	*p;
+
+	if (!last) {
+		p = container + 2;
+	} else {
+		p = last + WJETapeSize(last);
+	}
+
+	if (p >= container + WJETapeSize(container)) {
+		return(NULL);
+	}
+
+	if (WJE_TAPE_NAME == WJETapeTag(*p)) {
+		*name = WJETapeString(p++, len);
+	} else {
+		*name	= NULL;
+		*len	= 0;
+	}
+
+	return(p);
+}
+
+/*
+	Create the children of a frozen object or array. Objects and arrays among
+	them are left to be materialized when they are needed in turn.
+*/
+XplBool _WJETapeMaterialize(_WJElement *e)
+{
+	const uint64	*container	= (const uint64 *) e->value.string;
+	const uint64	*p;
+	_WJElement		*child;
+	char			*name;
+	size_t			len;
+
+	e->flags		&= ~(WJE_FLAG_LAZY | WJE_FLAG_FROZEN);
+	e->value.string	= NULL;
+	e->pub.length	= 0;
+
+	if (!container) {
+		return(FALSE);
+	}
+
+	for (p = WJETapeChild(container, NULL, &name, &len); p;
+		p = WJETapeChild(container, p, &name, &len)
+	) {
+		if (!(child = _WJENewEx(e, e->arena, name, len,
+			WJE_FLAG_NAME_BORROWED | WJE_FLAG_UNCOUNTED, __FILE__, __LINE__))
+		) {
+			return(FALSE);
+		}
+
+		WJETapeLoad(p, child, TRUE);
+	}
+
+	return(TRUE);
+}
+
+/*
+	Create a copy of a frozen object or array that refers to the same tape as
+	the original, since the tape itself is never modified. Nothing below it is
+	copied until it is materialized, which happens along the path of any change
+	to it, so a copy costs the same no matter how large the original is.
+
+	The copy is allocated from *arena, which is created if needed and keeps the
+	arena that the original was allocated from (and so the tape) alive. NULL is
+	returned if *arena already refers to a different one, in which case the
+	original must be copied as usual. Like any other copy, the result is left
+	for the caller to count as a change to the parent.
+*/
+_WJElement * _WJETapeShare(_WJElement *parent, _WJElement *original, WJEArena **arena, const char *file, int line)
+{
+	_WJElement		*e;
+
+	if (!(original->flags & WJE_FLAG_FROZEN) || !original->arena) {
+		return(NULL);
+	}
+
+	if (!*arena) {
+		if (!(*arena = WJEArenaNewEx(WJE_TAPE_ARENA_CHUNK))) {
+			return(NULL);
+		}
+
+		/* Hold a reference to it until the caller is done copying */
+		WJEArenaRetain(*arena);
+	}
+
+	if (!WJEArenaShare(*arena, original->arena)) {
+		return(NULL);
+	}
+
+	if ((e = _WJENewEx(parent, *arena, original->pub.name,
+		original->pub.name ? strlen(original->pub.name) : 0, WJE_FLAG_UNCOUNTED, file, line))
+	) {
+		WJETapeLoad((const uint64 *) original->value.string, e, TRUE);
+	}
+
+	return(e);
+}
+
+/* The frozen value of e, if it is an object or array that is still frozen */
+const uint64 * WJETapeOf(WJElement e)
+{
+	if (e && (((_WJElement *) e)->flags & WJE_FLAG_FROZEN)) {
+		return((const uint64 *) ((_WJElement *) e)->value.string);
+	}
+
+	return(NULL);
+}
+
+/*
+	Write a frozen value straight from the tape, with the same results as
+	WJEWriteDocument() would have after materializing it.
+*/
+void WJETapeWrite(const uint64 *p, WJWriter writer, char *name)
+{
+	const uint64	*child;
+	double			d;
+	char			*s;
+	size_t			len;
+
+	switch (WJETapeTag(*p)) {
+		default:
+		case WJR_TYPE_UNKNOWN:
+			break;
+
+		case WJR_TYPE_NULL:
+			WJWNull(name, writer);
+			break;
+
+		case WJR_TYPE_OBJECT:
+		case WJR_TYPE_ARRAY:
+			if (WJR_TYPE_OBJECT == WJETapeTag(*p)) {
+				WJWOpenObject(name, writer);
+			} else {
+				WJWOpenArray(name, writer);
+			}
+
+			for (child = WJETapeChild(p, NULL, &s, &len); child;
+				child = WJETapeChild(p, child, &s, &len)
+			) {
+				WJETapeWrite(child, writer, s);
+			}
+
+			if (WJR_TYPE_OBJECT == WJETapeTag(*p)) {
+				WJWCloseObject(writer);
+			} else {
+				WJWCloseArray(writer);
+			}
+			break;
+
+		case WJR_TYPE_STRING:
+			s = WJETapeString(p, &len);
+			WJWStringN(name, s, len, TRUE, writer);
+			break;
+
+		case WJR_TYPE_NUMBER:
+#ifdef WJE_DISTINGUISH_INTEGER_TYPE
+		case WJR_TYPE_INTEGER:
+#endif
+			if (WJETapePayload(*p) & WJE_TAPE_DECIMAL) {
+				memcpy(&d, p + 2, sizeof(double));
+				WJWDouble(name, (WJETapePayload(*p) & WJE_TAPE_NEGATIVE) ? -d : d, writer);
+			} else if (!(WJETapePayload(*p) & WJE_TAPE_NEGATIVE)) {
+				WJWUInt64(name, p[1], writer);
+			} else {
+				WJWInt64(name, -((int64) p[1]), writer);
+			}
+			break;
+
+		case WJR_TYPE_TRUE:
+		case WJR_TYPE_BOOL:
+		case WJR_TYPE_FALSE:
+			WJWBoolean(name, WJETapePayload(*p) ? TRUE : FALSE, writer);
+			break;
+	}
+}
+
+/* Estimate the size of the children of a frozen object or array */
+size_t WJETapeEstimate(const uint64 *container, XplBool pretty, size_t depth)
+{
+	const uint64	*p;
+	char			*name;
+	size_t			len;
+	size_t			size	= 0;
+
+	for (p = WJETapeChild(container, NULL, &name, &len); p;
+		p = WJETapeChild(container, p, &name, &len)
+	) {
+		/* A comma, the name and a line break and indent */
+		size += 1 + (name ? len + 4 : 0) + (pretty ? depth + 2 : 0);
+
+		switch (WJETapeTag(*p)) {
+			case WJR_TYPE_OBJECT:
+			case WJR_TYPE_ARRAY:
+				size += (pretty ? depth + 4 : 2) +
+					WJETapeEstimate(p, pretty, depth + 1);
+				break;
+
+			case WJR_TYPE_STRING:
+				WJETapeString(p, &len);
+				size += len + 2;
+				break;
+
+			case WJR_TYPE_NUMBER:
+#ifdef WJE_DISTINGUISH_INTEGER_TYPE
+			case WJR_TYPE_INTEGER:
+#endif
+				size += 8;
+				break;
+
+			case WJR_TYPE_NULL:
+			case WJR_TYPE_TRUE:
+			case WJR_TYPE_BOOL:
+			case WJR_TYPE_FALSE:
+				size += 5;
+				break;
+		}
+	}
+
+	return(size);
+}
@@ -21,16 +21,18 @@
 #define strtoull _strtoui64
 #endif
 
-EXPORT XplBool __WJEBool(WJElement container, const char *path, WJEAction action, WJElement *last, XplBool value, const char *file, const int line)
+static XplBool WJEBoolSearch(WJElement container, const char *path, WJESelector selector, WJEAction action, WJElement *last, XplBool value, const char *file, const int line)
 {
 	_WJElement		*e;
+	_WJElement		scratch;
 	char			*s;
 
 	/*
 		Find an element that is appropriate for the given action, creating new
-		elements as needed.
+		elements as needed. A value that is only read may be found in scratch.
 	*/
-	e = _WJESearch(container, path, &action, last ? *last : NULL, file, line);
+	e = _WJESearchValue(container, path, selector, &action, last ? *last : NULL,
+		last ? NULL : &scratch, file, line);
 	if (e) {
 		switch (e->pub.type) {
 			case WJR_TYPE_UNKNOWN:
@@ -185,9 +187,10 @@ static uint64 _WJEGetNum(void *value, size_t size, XplBool issigned, XplBool *ne
 	return(num);
 }
 
-static void _WJENum(WJElement container, const char *path, WJEAction action, WJElement *last, void *value, size_t size, XplBool issigned, const char *file, const int line)
+static void _WJENum(WJElement container, const char *path, WJESelector selector, WJEAction action, WJElement *last, void *value, size_t size, XplBool issigned, const char *file, const int line)
 {
 	_WJElement		*e;
+	_WJElement		scratch;
 	char			*s, *end;
 	uint64			r;
 	uint64			v;
@@ -195,9 +198,10 @@ static void _WJENum(WJElement container, const char *path, WJEAction action, WJE
 
 	/*
 		Find an element that is appropriate for the given action, creating new
-		elements as needed.
+		elements as needed. A value that is only read may be found in scratch.
 	*/
-	e = _WJESearch(container, path, &action, last ? *last : NULL, file, line);
+	e = _WJESearchValue(container, path, selector, &action, last ? *last : NULL,
+		last ? NULL : &scratch, file, line);
 
 	if (e) {
 		switch (e->pub.type) {
@@ -307,35 +311,17 @@ static void _WJENum(WJElement container, const char *path, WJEAction action, WJE
 	}
 }
 
-EXPORT char * __WJEString(WJElement container, const char *path, WJEAction action, WJElement *last, const char *value, const char *file, const int line)
-{
-	size_t		len	= 0;
-
-	switch ((action & WJE_ACTION_MASK)) {
-		default:
-			break;
-
-		case WJE_SET:
-		case WJE_NEW:
-		case WJE_PUT:
-			if (value) {
-				len = strlen(value);
-			}
-			break;
-	}
-
-	return(__WJEStringN(container, path, action, last, value, len, file, line));
-}
-
-EXPORT char * __WJEStringN(WJElement container, const char *path, WJEAction action, WJElement *last, const char *value, size_t len, const char *file, const int line)
+static char * WJEStringNSearch(WJElement container, const char *path, WJESelector selector, WJEAction action, WJElement *last, const char *value, size_t len, const char *file, const int line)
 {
 	_WJElement		*e;
+	_WJElement		scratch;
 
 	/*
 		Find an element that is appropriate for the given action, creating new
-		elements as needed.
+		elements as needed. A value that is only read may be found in scratch.
 	*/
-	e = _WJESearch(container, path, &action, last ? *last : NULL, file, line);
+	e = _WJESearchValue(container, path, selector, &action, last ? *last : NULL,
+		last ? NULL : &scratch, file, line);
 	if (e) {
 		switch (e->pub.type) {
 			case WJR_TYPE_UNKNOWN:
@@ -407,6 +393,11 @@ EXPORT char * __WJEStringN(WJElement container, const char *path, WJEAction acti
 			if ((e = _WJEReset(e, WJR_TYPE_STRING))) {
 				if (!value) {
 					return((e->value.string = NULL));
+				} else if ((e->value.string = WJEArenaIntern(e->arena, value, len, TRUE))) {
+					/* Share the value from the document's symbol table */
+					e->flags		|= WJE_FLAG_STRING_BORROWED;
+					e->pub.length	= len;
+					return(e->value.string);
 				} else {
 					e->value.string = MemMallocWait(len + 1);
 					strncpy(e->value.string, value, len);
@@ -422,7 +413,27 @@ EXPORT char * __WJEStringN(WJElement container, const char *path, WJEAction acti
 	}
 }
 
-EXPORT WJElement __WJEObject(WJElement container, const char *path, WJEAction action, WJElement *last, const char *file, const int line)
+static char * WJEStringSearch(WJElement container, const char *path, WJESelector selector, WJEAction action, WJElement *last, const char *value, const char *file, const int line)
+{
+	size_t		len	= 0;
+
+	switch ((action & WJE_ACTION_MASK)) {
+		default:
+			break;
+
+		case WJE_SET:
+		case WJE_NEW:
+		case WJE_PUT:
+			if (value) {
+				len = strlen(value);
+			}
+			break;
+	}
+
+	return(WJEStringNSearch(container, path, selector, action, last, value, len, file, line));
+}
+
+static WJElement WJEObjectSearch(WJElement container, const char *path, WJESelector selector, WJEAction action, WJElement *last, const char *file, const int line)
 {
 	WJElement	e;
 	WJEAction	a;
@@ -436,7 +447,7 @@ EXPORT WJElement __WJEObject(WJElement container, const char *path, WJEAction ac
 	e = (last ? *last : NULL);
 	do {
 		a = action;
-		e = WJESearch(container, path, &a, e, file, line);
+		e = WJESearch(container, path, selector, &a, e, file, line);
 	} while (e && (action & WJE_ACTION_MASK) == WJE_GET && e->type != WJR_TYPE_OBJECT);
 
 	if (e) {
@@ -474,7 +485,7 @@ EXPORT WJElement __WJEObject(WJElement container, const char *path, WJEAction ac
 	}
 }
 
-EXPORT WJElement __WJEArray(WJElement container, const char *path, WJEAction action, WJElement *last, const char *file, const int line)
+static WJElement WJEArraySearch(WJElement container, const char *path, WJESelector selector, WJEAction action, WJElement *last, const char *file, const int line)
 {
 	WJElement	e;
 	WJEAction	a;
@@ -488,7 +499,7 @@ EXPORT WJElement __WJEArray(WJElement container, const char *path, WJEAction act
 	e = (last ? *last : NULL);
 	do {
 		a = action;
-		e = WJESearch(container, path, &a, e, file, line);
+		e = WJESearch(container, path, selector, &a, e, file, line);
 	} while (e && (action & WJE_ACTION_MASK) == WJE_GET && e->type != WJR_TYPE_ARRAY);
 
 	if (e) {
@@ -526,7 +537,7 @@ EXPORT WJElement __WJEArray(WJElement container, const char *path, WJEAction act
 	}
 }
 
-EXPORT WJElement __WJENull(WJElement container, const char *path, WJEAction action, WJElement *last, const char *file, const int line)
+static WJElement WJENullSearch(WJElement container, const char *path, WJESelector selector, WJEAction action, WJElement *last, const char *file, const int line)
 {
 	WJElement	e;
 	WJEAction	a;
@@ -540,7 +551,7 @@ EXPORT WJElement __WJENull(WJElement container, const char *path, WJEAction acti
 	e = (last ? *last : NULL);
 	do {
 		a = action;
-		e = WJESearch(container, path, &a, e, file, line);
+		e = WJESearch(container, path, selector, &a, e, file, line);
 	} while (e && (action & WJE_ACTION_MASK) == WJE_GET && e->type != WJR_TYPE_NULL);
 
 	if (e) {
@@ -580,14 +591,14 @@ EXPORT WJElement __WJENull(WJElement container, const char *path, WJEAction acti
 
 EXPORT int32 __WJEInt32(WJElement container, const char *path, WJEAction action, WJElement *last, int32 value, const char *file, const int line)
 {
-	_WJENum(container, path, action, last, &value, sizeof(value), TRUE, file, line);
+	_WJENum(container, path, NULL, action, last, &value, sizeof(value), TRUE, file, line);
 
 	return(value);
 }
 
 EXPORT uint32 __WJEUInt32(WJElement container, const char *path, WJEAction action, WJElement *last, uint32 value, const char *file, const int line)
 {
-	_WJENum(container, path, action, last, &value, sizeof(value), FALSE, file, line);
+	_WJENum(container, path, NULL, action, last, &value, sizeof(value), FALSE, file, line);
 
 	return(value);
 }
@@ -595,27 +606,29 @@ EXPORT uint32 __WJEUInt32(WJElement container, const char *path, WJEAction actio
 
 EXPORT int64 __WJEInt64(WJElement container, const char *path, WJEAction action, WJElement *last, int64 value, const char *file, const int line)
 {
-	_WJENum(container, path, action, last, &value, sizeof(value), TRUE, file, line);
+	_WJENum(container, path, NULL, action, last, &value, sizeof(value), TRUE, file, line);
 
 	return(value);
 }
 
 EXPORT uint64 __WJEUInt64(WJElement container, const char *path, WJEAction action, WJElement *last, uint64 value, const char *file, const int line)
 {
-	_WJENum(container, path, action, last, &value, sizeof(value), FALSE, file, line);
+	_WJENum(container, path, NULL, action, last, &value, sizeof(value), FALSE, file, line);
 
 	return(value);
 }
 
-EXPORT double __WJEDouble(WJElement container, const char *path, WJEAction action, WJElement *last, double value, const char *file, const int line)
+static double WJEDoubleSearch(WJElement container, const char *path, WJESelector selector, WJEAction action, WJElement *last, double value, const char *file, const int line)
 {
 	_WJElement		*e;
+	_WJElement		scratch;
 
 	/*
 		Find an element that is appropriate for the given action, creating new
-		elements as needed.
+		elements as needed. A value that is only read may be found in scratch.
 	*/
-	if ((e = _WJESearch(container, path, &action, last ? *last : NULL, file, line))) {
+	if ((e = _WJESearchValue(container, path, selector, &action, last ? *last : NULL,
+		last ? NULL : &scratch, file, line))) {
 		switch (e->pub.type) {
 			case WJR_TYPE_UNKNOWN:
 				/*
@@ -737,6 +750,108 @@ EXPORT double __WJEDouble(WJElement container, const char *path, WJEAction actio
 	}
 }
 
+EXPORT XplBool __WJEBool(WJElement container, const char *path, WJEAction action, WJElement *last, XplBool value, const char *file, const int line)
+{
+	return(WJEBoolSearch(container, path, NULL, action, last, value, file, line));
+}
+
+EXPORT char * __WJEString(WJElement container, const char *path, WJEAction action, WJElement *last, const char *value, const char *file, const int line)
+{
+	return(WJEStringSearch(container, path, NULL, action, last, value, file, line));
+}
+
+EXPORT char * __WJEStringN(WJElement container, const char *path, WJEAction action, WJElement *last, const char *value, size_t len, const char *file, const int line)
+{
+	return(WJEStringNSearch(container, path, NULL, action, last, value, len, file, line));
+}
+
+EXPORT WJElement __WJEObject(WJElement container, const char *path, WJEAction action, WJElement *last, const char *file, const int line)
+{
+	return(WJEObjectSearch(container, path, NULL, action, last, file, line));
+}
+
+EXPORT WJElement __WJEArray(WJElement container, const char *path, WJEAction action, WJElement *last, const char *file, const int line)
+{
+	return(WJEArraySearch(container, path, NULL, action, last, file, line));
+}
+
+EXPORT WJElement __WJENull(WJElement container, const char *path, WJEAction action, WJElement *last, const char *file, const int line)
+{
+	return(WJENullSearch(container, path, NULL, action, last, file, line));
+}
+
+EXPORT double __WJEDouble(WJElement container, const char *path, WJEAction action, WJElement *last, double value, const char *file, const int line)
+{
+	return(WJEDoubleSearch(container, path, NULL, action, last, value, file, line));
+}
+
+/*
+	The same as the functions above, but with a compiled selector in place of
+	the path.
+*/
+EXPORT XplBool __WJEBoolCompiled(WJElement container, WJESelector selector, WJEAction action, WJElement *last, XplBool value, const char *file, const int line)
+{
+	return(WJEBoolSearch(container, NULL, selector, action, last, value, file, line));
+}
+
+EXPORT char * __WJEStringCompiled(WJElement container, WJESelector selector, WJEAction action, WJElement *last, const char *value, const char *file, const int line)
+{
+	return(WJEStringSearch(container, NULL, selector, action, last, value, file, line));
+}
+
+EXPORT char * __WJEStringNCompiled(WJElement container, WJESelector selector, WJEAction action, WJElement *last, const char *value, size_t len, const char *file, const int line)
+{
+	return(WJEStringNSearch(container, NULL, selector, action, last, value, len, file, line));
+}
+
+EXPORT WJElement __WJEObjectCompiled(WJElement container, WJESelector selector, WJEAction action, WJElement *last, const char *file, const int line)
+{
+	return(WJEObjectSearch(container, NULL, selector, action, last, file, line));
+}
+
+EXPORT WJElement __WJEArrayCompiled(WJElement container, WJESelector selector, WJEAction action, WJElement *last, const char *file, const int line)
+{
+	return(WJEArraySearch(container, NULL, selector, action, last, file, line));
+}
+
+EXPORT WJElement __WJENullCompiled(WJElement container, WJESelector selector, WJEAction action, WJElement *last, const char *file, const int line)
+{
+	return(WJENullSearch(container, NULL, selector, action, last, file, line));
+}
+
+EXPORT int32 __WJEInt32Compiled(WJElement container, WJESelector selector, WJEAction action, WJElement *last, int32 value, const char *file, const int line)
+{
+	_WJENum(container, NULL, selector, action, last, &value, sizeof(value), TRUE, file, line);
+
+	return(value);
+}
+
+EXPORT uint32 __WJEUInt32Compiled(WJElement container, WJESelector selector, WJEAction action, WJElement *last, uint32 value, const char *file, const int line)
+{
+	_WJENum(container, NULL, selector, action, last, &value, sizeof(value), FALSE, file, line);
+
+	return(value);
+}
+
+EXPORT int64 __WJEInt64Compiled(WJElement container, WJESelector selector, WJEAction action, WJElement *last, int64 value, const char *file, const int line)
+{
+	_WJENum(container, NULL, selector, action, last, &value, sizeof(value), TRUE, file, line);
+
+	return(value);
+}
+
+EXPORT uint64 __WJEUInt64Compiled(WJElement container, WJESelector selector, WJEAction action, WJElement *last, uint64 value, const char *file, const int line)
+{
+	_WJENum(container, NULL, selector, action, last, &value, sizeof(value), FALSE, file, line);
+
+	return(value);
+}
+
+EXPORT double __WJEDoubleCompiled(WJElement container, WJESelector selector, WJEAction action, WJElement *last, double value, const char *file, const int line)
+{
+	return(WJEDoubleSearch(container, NULL, selector, action, last, value, file, line));
+}
+
 static char * WJEPathF(char *buffer, size_t len, const char *pathf, va_list args)
 {
 	size_t		needed;
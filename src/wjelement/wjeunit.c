@@ -23,6 +23,10 @@
 #include <wjwriter.h>
 #include <wjelement.h>
 
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
 /*
 	The JSON document below will be provided to each of the test functions.
 
@@ -699,6 +703,2271 @@ static int LargeDoc2Test(WJElement doc)
 	return(result);
 }
 
+static int IndexTest(WJElement doc)
+{
+	WJElement	o, e;
+	WJReader	r;
+	char		json[64 * 32];
+	char		name[32];
+	int			i;
+	size_t		len;
+
+	/* Build an object large enough to be indexed, including a duplicate key */
+	len = strprintf(json, sizeof(json), NULL, "{");
+	for (i = 0; i < 64; i++) {
+		len += strprintf(json + len, sizeof(json) - len, NULL,
+			"\"Key%d\":%d,", i, i);
+	}
+	strprintf(json + len, sizeof(json) - len, NULL, "\"Key5\":-1}");
+
+	if (!(r = WJROpenMemDocument(json, NULL, 0))) return(__LINE__);
+	o = WJEOpenDocument(r, NULL, NULL, NULL);
+	WJRCloseDocument(r);
+
+	if (!o) return(__LINE__);
+
+	/* Duplicate names must be dropped while loading, keeping the first */
+	if (64 != o->count) return(__LINE__);
+	if (5 != WJEInt32(o, "Key5", WJE_GET, -2)) return(__LINE__);
+
+	for (i = 0; i < 64; i++) {
+		strprintf(name, sizeof(name), NULL, "Key%d", i);
+		if (i != WJEInt32(o, name, WJE_GET, -1)) return(__LINE__);
+		if (!(e = WJEChild(o, name, WJE_GET)) || i != WJEInt32(e, NULL, WJE_GET, -1)) {
+			return(__LINE__);
+		}
+	}
+
+	/* Lookups are case sensitive unless asked not to be */
+	if (WJEChild(o, "key10", WJE_GET)) return(__LINE__);
+	if (10 != WJEInt32(WJEChild(o, "key10", WJE_GET | WJE_IGNORE_CASE), NULL, WJE_GET, -1)) {
+		return(__LINE__);
+	}
+	if (WJEChild(o, "Key64", WJE_GET)) return(__LINE__);
+
+	/* Detached elements must no longer be found */
+	e = WJEChild(o, "Key20", WJE_GET);
+	WJEDetach(e);
+	if (WJEChild(o, "Key20", WJE_GET)) return(__LINE__);
+
+	/* Attached and renamed elements must be found by their new names */
+	if (!WJERename(e, "Moved") || !WJEAttach(o, e)) return(__LINE__);
+	if (WJEChild(o, "Moved", WJE_GET) != e) return(__LINE__);
+	if (!WJERename(e, "Renamed")) return(__LINE__);
+	if (WJEChild(o, "Moved", WJE_GET)) return(__LINE__);
+	if (WJEChild(o, "Renamed", WJE_GET) != e) return(__LINE__);
+
+	/* Renaming to the name of a sibling must fail */
+	if (WJERename(e, "key21")) return(__LINE__);
+
+	/* Adding enough members to force the index to grow */
+	for (i = 64; i < 1000; i++) {
+		strprintf(name, sizeof(name), NULL, "Key%d", i);
+		WJEInt32(o, name, WJE_NEW, i);
+	}
+	for (i = 0; i < 1000; i++) {
+		strprintf(name, sizeof(name), NULL, "Key%d", i);
+		if (i != 20 && i != WJEInt32(o, name, WJE_GET, -1)) return(__LINE__);
+	}
+
+	/* Removing members one at a time */
+	for (i = 0; i < 1000; i += 2) {
+		strprintf(name, sizeof(name), NULL, "Key%d", i);
+		WJECloseDocument(WJEChild(o, name, WJE_GET));
+		if (WJEChild(o, name, WJE_GET)) return(__LINE__);
+	}
+	if (501 != o->count) return(__LINE__);
+	if (999 != WJEInt32(o, "Key999", WJE_GET, -1)) return(__LINE__);
+
+	WJECloseDocument(o);
+	return(0);
+}
+
+static int ArenaTest(WJElement doc)
+{
+	char		*json;
+	WJReader	r;
+	WJElement	d, e, n;
+	int			i;
+
+	json = GenerateBigJSONStr(10000);
+	r = WJROpenMemDocument(json, NULL, 0);
+	d = WJEOpenDocumentArena(r, NULL, NULL, NULL);
+	WJRCloseDocument(r);
+	MemRelease(&json);
+
+	if (!d) return(__LINE__);
+	if (10000 != d->count) return(__LINE__);
+
+	for (i = 0, e = d->child; e; e = e->next, i++) {
+		if (1 != WJEInt32(e, "a", WJE_GET, -1)) return(__LINE__);
+		if (strcmp(WJEString(e, "b", WJE_GET, ""), "abc")) return(__LINE__);
+	}
+	if (10000 != i) return(__LINE__);
+
+	/* Modify arena allocated elements */
+	e = d->child;
+	if (strcmp(WJEString(e, "b", WJE_SET, "replaced"), "replaced")) return(__LINE__);
+	WJEString(e, "c", WJE_NEW, "new");
+	if (!WJERename(WJEGet(e, "a", NULL), "renamed")) return(__LINE__);
+	WJEInt32(e, "b", WJE_SET, 3);
+	WJECloseDocument(WJEGet(d, "[1]", NULL));
+
+	/* A detached element must outlive the document it came from */
+	e = d->last;
+	WJEDetach(e);
+	WJECloseDocument(d);
+
+	if (strcmp(WJEString(e, "b", WJE_GET, ""), "abc")) return(__LINE__);
+	WJEString(e, "b", WJE_SET, "changed");
+
+	/* An arena element attached to a regular document */
+	n = WJEObject(NULL, NULL, WJE_NEW);
+	WJEAttach(n, e);
+	if (strcmp(WJEString(n, "[0].b", WJE_GET, ""), "changed")) return(__LINE__);
+	WJECloseDocument(n);
+
+	/* An empty document must not leak the arena */
+	r = WJROpenMemDocument("", NULL, 0);
+	d = WJEOpenDocumentArena(r, NULL, NULL, NULL);
+	WJRCloseDocument(r);
+	if (d) return(__LINE__);
+
+	return(0);
+}
+
+static XplBool InSituLoadCB(WJElement parent, char *path, void *data, const char *file, const int line)
+{
+	(*((int *) data))++;
+	return(TRUE);
+}
+
+/*
+	Load json with a WJReader, and with either the in place parser or by path,
+	and check that both give the same document.
+*/
+static int InSituCompare(char *json, XplBool path)
+{
+	char		file[]	= "wjeunit-insitu.json";
+	char		*copy, *a, *b;
+	WJReader	reader;
+	WJElement	x, y	= NULL;
+	FILE		*f;
+	int			r		= 0;
+
+	if (!(reader = WJROpenMemDocument(json, NULL, 0))) return(__LINE__);
+	x = WJEOpenDocument(reader, NULL, NULL, NULL);
+	WJRCloseDocument(reader);
+
+	if (path) {
+		if ((f = fopen(file, "wb"))) {
+			fputs(json, f);
+			fclose(f);
+			y = WJEFromFile(file);
+		}
+		remove(file);
+	} else if ((copy = MemStrdup(json))) {
+		y = WJEOpenDocumentInSitu(copy, strlen(copy), NULL, NULL);
+	}
+
+	a = WJEToString(x, FALSE);
+	b = WJEToString(y, FALSE);
+	if (!a || !b || strcmp(a, b)) r = __LINE__;
+
+	MemRelease(&a);
+	MemRelease(&b);
+	WJECloseDocument(x);
+	WJECloseDocument(y);
+	if (!path) {
+		MemRelease(&copy);
+	}
+	return(r);
+}
+
+static int InSituTest(WJElement doc)
+{
+	char		*j, *x, *a, *b;
+	WJElement	d, e;
+	WJReader	reader;
+	int			calls[2]	= { 0, 0 };
+	int			r			= 0;
+	char		empty[]		= "{ \"\": 1, \"a\": { \"\": [ 2 ], \"c\": 4 }, \"b\": 3 }";
+	char		*escapes	= "[ \"\\uZZZZ\", \"\\xZ1\\xg0\", \"\\u00e9\\uD83D\", \"\\uD83Dx\","
+							  " \"\\uDC00\", \"a\\q\", \"\\uD83D\\u0041\", \"\\U00E9\\X41\","
+							  " \"\\uD83D\\uZZZZ\", \"\\ud83d\\UDE00\" ]";
+	char		*truncated	= "[ \"\\u12\", \"\\x\", \"ab\" ]";
+	char		str[]	= "# comment\n{ \"na\\\"me\": \"x\\u00e9\\n\\ud83d\\ude00\",\n"
+							"\"dup\": 1, \"dup\": 2, \"list\": [ 1, -2.5, 3e2, TRUE, null, ], }";
+
+	/* The in place parser must produce the same document as WJEOpenDocument */
+	if (!(j = MemStrdup(json))) return(__LINE__);
+	for (x = j; *x; x++) {
+		if (*x == '\'') *x = '"';
+	}
+
+	d = WJEOpenDocumentInSitu(j, strlen(j), NULL, NULL);
+	a = WJEToString(doc, FALSE);
+	b = WJEToString(d, FALSE);
+
+	if (!d || !a || !b || strcmp(a, b)) r = __LINE__;
+
+	/* Names and strings should point into the source buffer */
+	if (!r && (!(x = WJEString(d, "string", WJE_GET, NULL)) ||
+		x < j || x >= j + strlen(json))
+	) {
+		r = __LINE__;
+	}
+
+	MemRelease(&a);
+	MemRelease(&b);
+	WJECloseDocument(d);
+	MemRelease(&j);
+	if (r) return(r);
+
+	if (!(d = WJEOpenDocumentInSitu(str, sizeof(str) - 1, NULL, NULL))) return(__LINE__);
+
+	if (!(e = WJEChild(d, "na\"me", WJE_GET))) return(__LINE__);
+	if (strcmp(WJEString(e, NULL, WJE_GET, ""), "x\xc3\xa9\n\xf0\x9f\x98\x80")) return(__LINE__);
+	if (1 != WJEInt32(d, "dup", WJE_GET, -1)) return(__LINE__);
+	if (!(e = WJEArray(d, "list", WJE_GET)) || 5 != e->count) return(__LINE__);
+	if (WJEDouble(d, "list[1]", WJE_GET, 0) != -2.5) return(__LINE__);
+	if (WJEDouble(d, "list[2]", WJE_GET, 0) != 300) return(__LINE__);
+	if (!WJEBool(d, "list[3]", WJE_GET, FALSE)) return(__LINE__);
+	if (WJR_TYPE_NULL != WJEGet(d, "list[4]", NULL)->type) return(__LINE__);
+
+	/* The WJReader must decode the same surrogate pair */
+	if (!(e = WJEFromString("[ \"x\\ud83d\\ude00\" ]"))) return(__LINE__);
+	if (strcmp(WJEString(e, "[0]", WJE_GET, ""), "x\xf0\x9f\x98\x80")) return(__LINE__);
+	WJECloseDocument(e);
+
+	/* Borrowed names and strings can still be replaced */
+	if (!WJERename(WJEGet(d, "dup", NULL), "renamed")) return(__LINE__);
+	WJEString(d, "renamed", WJE_SET, "value");
+	if (strcmp(WJEString(d, "renamed", WJE_GET, ""), "value")) return(__LINE__);
+	WJECloseDocument(d);
+
+	/* Invalid documents */
+	strcpy(str, "{ \"a\": [ 1, 2 }");
+	if ((d = WJEOpenDocumentInSitu(str, strlen(str), NULL, NULL))) return(__LINE__);
+	strcpy(str, "[ \"abc ]");
+	if ((d = WJEOpenDocumentInSitu(str, strlen(str), NULL, NULL))) return(__LINE__);
+	if ((d = WJEOpenDocumentInSitu(str, 0, NULL, NULL))) return(__LINE__);
+
+	/* Invalid escape sequences are decoded just as a WJReader decodes them */
+	if ((r = InSituCompare(escapes, FALSE))) return(r);
+	if ((r = InSituCompare(escapes, TRUE))) return(r);
+
+	/*
+		A WJReader reads a sequence that is cut short from past the closing
+		quote, which the parser can't, so it falls back to a WJReader.
+	*/
+	if (!(x = MemStrdup(truncated))) return(__LINE__);
+	d = WJEOpenDocumentInSitu(x, strlen(x), NULL, NULL);
+	MemRelease(&x);
+	if (d) return(__LINE__);
+	if ((r = InSituCompare(truncated, TRUE))) return(r);
+
+	/* Members without a name are handled just as a WJReader handles them */
+	if (!(reader = WJROpenMemDocument(empty, NULL, 0))) return(__LINE__);
+	e = WJEOpenDocument(reader, NULL, InSituLoadCB, &calls[0]);
+	WJRCloseDocument(reader);
+	d = WJEOpenDocumentInSitu(empty, strlen(empty), InSituLoadCB, &calls[1]);
+
+	a = WJEToString(e, FALSE);
+	b = WJEToString(d, FALSE);
+	if (!a || !b || strcmp(a, b) || calls[0] != calls[1]) r = __LINE__;
+
+	MemRelease(&a);
+	MemRelease(&b);
+	WJECloseDocument(e);
+	WJECloseDocument(d);
+	return(r);
+}
+
+static int MapFileTest(WJElement doc)
+{
+	char		path[]	= "wjeunit-mapfile.json";
+	char		*a, *b, *c;
+	FILE		*f;
+	WJReader	reader;
+	WJElement	d, e, m;
+	int			r		= 0;
+
+	/* Write the test document out with a BOM, using real double quotes */
+	if (!(a = WJEToString(doc, TRUE))) return(__LINE__);
+	if (!(f = fopen(path, "wb"))) {
+		MemRelease(&a);
+		return(__LINE__);
+	}
+	fputs("\xEF\xBB\xBF", f);
+	fputs(a, f);
+	fclose(f);
+
+	/* A mapped file, a FILE and a path reader must all match the original */
+	d = WJEFromFile(path);
+
+	if ((f = fopen(path, "rb"))) {
+		e = WJEReadFILE(f);
+		if (!feof(f) && EOF != fgetc(f)) r = __LINE__;
+		fclose(f);
+	} else {
+		e = NULL;
+	}
+
+	if ((reader = WJROpenPathDocument(path, NULL, 0))) {
+		m = WJEOpenDocument(reader, NULL, NULL, NULL);
+		WJRCloseDocument(reader);
+	} else {
+		m = NULL;
+	}
+
+	b = WJEToString(d, TRUE);
+	c = WJEToString(e, TRUE);
+	MemRelease(&a);
+	a = WJEToString(m, TRUE);
+
+	if (!r && (!b || !c || !a || strcmp(a, b) || strcmp(b, c))) r = __LINE__;
+	if (!r && strcmp(WJEString(d, "string", WJE_GET, ""), "This is a single string")) r = __LINE__;
+
+	MemRelease(&a);
+	MemRelease(&b);
+	MemRelease(&c);
+	WJECloseDocument(d);
+	WJECloseDocument(e);
+	WJECloseDocument(m);
+
+	/* A badly formed file must load just as much as the reader would */
+	if (!r && (f = fopen(path, "wb"))) {
+		fputs("{ \"a\": 1, \"b\": [ 2, 3 ", f);
+		fclose(f);
+
+		if (!(d = WJEFromFile(path))) {
+			r = __LINE__;
+		} else if (1 != WJEInt32(d, "a", WJE_GET, -1) ||
+			3 != WJEInt32(d, "b[1]", WJE_GET, -1)
+		) {
+			r = __LINE__;
+		}
+		WJECloseDocument(d);
+	}
+
+	/* An empty file is an empty document */
+	if (!r && (f = fopen(path, "wb"))) {
+		fclose(f);
+
+		if ((d = WJEFromFile(path))) r = __LINE__;
+	}
+
+	remove(path);
+	if (!r && (d = WJEFromFile(path))) r = __LINE__;
+
+	return(r);
+}
+
+static int ScanTest(WJElement doc)
+{
+	char		*json, *expected, *j, *x;
+	char		*spaces	= " \t\r\n\v\f";
+	WJReader	reader;
+	WJElement	d;
+	int			i, k, r	= 0;
+
+	if (!(json = MemMalloc(64 * 1024))) return(__LINE__);
+	if (!(expected = MemMalloc(16 * 1024))) {
+		MemRelease(&json);
+		return(__LINE__);
+	}
+
+	/*
+		Build strings and runs of whitespace of every length around the sizes
+		that the reader scans at once, with escapes on either side of each run.
+	*/
+	j = json;
+	*j++ = '[';
+	for (i = 0; i < 70; i++) {
+		for (k = 0; k < i; k++) *j++ = spaces[k % 6];
+		*j++ = '"';
+		for (k = 0; k < i; k++) *j++ = 'a' + (k % 26);
+		j += sprintf(j, "\\\"");
+		for (k = 0; k < i; k++) *j++ = 'A' + (k % 26);
+		j += sprintf(j, "\\u00e9\\ud83d\\ude00");
+		for (k = 0; k < i; k++) *j++ = '0' + (k % 10);
+		j += sprintf(j, "\",");
+	}
+
+	/* A string that is longer than the reader's buffer, with many escapes */
+	*j++ = '"';
+	for (k = 0; k < 10000; k++) {
+		if (k % 37) {
+			*j++ = 'a' + (k % 26);
+		} else {
+			j += sprintf(j, "\\t");
+		}
+	}
+	j += sprintf(j, "\" ]");
+
+	if (!(reader = WJROpenDocument(WJRMemCallback, json, NULL, 0)) ||
+		!(d = WJEOpenDocument(reader, NULL, NULL, NULL))
+	) {
+		r = __LINE__;
+	} else if (71 != d->count) {
+		r = __LINE__;
+	}
+	WJRCloseDocument(reader);
+
+	for (i = 0; !r && i < 70; i++) {
+		x = expected;
+		for (k = 0; k < i; k++) *x++ = 'a' + (k % 26);
+		*x++ = '"';
+		for (k = 0; k < i; k++) *x++ = 'A' + (k % 26);
+		x += sprintf(x, "\xc3\xa9\xf0\x9f\x98\x80");
+		for (k = 0; k < i; k++) *x++ = '0' + (k % 10);
+		*x = '\0';
+
+		sprintf(json, "[%d]", i);
+		if (strcmp(WJEString(d, json, WJE_GET, ""), expected)) r = __LINE__;
+	}
+
+	if (!r) {
+		x = expected;
+		for (k = 0; k < 10000; k++) {
+			*x++ = (k % 37) ? 'a' + (k % 26) : '\t';
+		}
+		*x = '\0';
+
+		if (strcmp(WJEString(d, "[70]", WJE_GET, ""), expected)) r = __LINE__;
+	}
+
+	WJECloseDocument(d);
+	MemRelease(&expected);
+	MemRelease(&json);
+
+	return(r);
+}
+
+static int NumbersTest(WJElement doc)
+{
+	struct {
+		char		*str;
+		XplBool		hasDecimalPoint;
+		uint64		i;
+		double		d;
+		int			used;
+	} numbers[] = {
+		{ "0",							FALSE,	0,			0.0,						1	},
+		{ "42,",						FALSE,	42,			42.0,						2	},
+		{ "0.1",						TRUE,	0,			0.1,						3	},
+		{ "1.5e3",						TRUE,	1500,		1500.0,						5	},
+		{ "2E-2]",						TRUE,	0,			0.02,						4	},
+		{ "1e",							FALSE,	1,			1.0,						1	},
+		{ "0x10",						FALSE,	16,			16.0,						4	},
+		{ "9007199254740993",			FALSE,	9007199254740993ULL,	9007199254740992.0,	16	},
+		{ "18446744073709551615",		FALSE,	18446744073709551615ULL, 18446744073709551615.0, 20 },
+		{ "123456789012345678901234567890", FALSE, 18446744073709551615ULL, 1.2345678901234568e29, 30 },
+		{ "1.7976931348623157e308",		TRUE,	18446744073709551615ULL, 1.7976931348623157e308, 22 },
+		{ "2.2250738585072011e-308",	TRUE,	0,			2.2250738585072011e-308,	23	},
+		{ "4.9406564584124654e-324",	TRUE,	0,			4.9406564584124654e-324,	23	},
+		{ "1e-400",						TRUE,	0,			0.0,						6	},
+
+		/* Exactly half way between 1 and the next double, and either side */
+		{ "1.00000000000000011102230246251565404236316680908203125",	TRUE, 1, 1.0,					55	},
+		{ "1.00000000000000011102230246251565404236316680908203126",	TRUE, 1, 1.0000000000000002,	55	},
+		{ "1.00000000000000011102230246251565404236316680908203124",	TRUE, 1, 1.0,					55	},
+		{ NULL }
+	};
+	XplBool		hasDecimalPoint;
+	uint64		i;
+	double		d;
+	char		*end;
+	WJElement	e;
+	int			x;
+
+	for (x = 0; numbers[x].str; x++) {
+		end = WJRParseNumber(numbers[x].str, numbers[x].str + strlen(numbers[x].str),
+				&hasDecimalPoint, &i, &d);
+
+		if (end != numbers[x].str + numbers[x].used ||
+			hasDecimalPoint != numbers[x].hasDecimalPoint ||
+			i != numbers[x].i || d != numbers[x].d
+		) {
+			printf("e: Incorrect result for \"%s\"\n", numbers[x].str);
+			return(__LINE__);
+		}
+	}
+
+	/* The end of the buffer must be respected */
+	end = "12345";
+	if (WJRParseNumber(end, end + 3, NULL, &i, NULL) != end + 3 || i != 123) return(__LINE__);
+	if (WJRParseNumber(end, end, NULL, NULL, NULL) != end) return(__LINE__);
+
+	/* The reader and the in memory parser must agree */
+	if (!(e = WJEFromString("[ 1.5e3, -2.5, -7, 1E+2, 18446744073709551615 ]"))) return(__LINE__);
+	if (WJEDouble(e, "[0]", WJE_GET, 0) != 1500.0) return(__LINE__);
+	if (WJEDouble(e, "[1]", WJE_GET, 0) != -2.5) return(__LINE__);
+	if (WJEInt32(e, "[2]", WJE_GET, 0) != -7) return(__LINE__);
+	if (WJEInt32(e, "[3]", WJE_GET, 0) != 100) return(__LINE__);
+	if (WJEUInt64(e, "[4]", WJE_GET, 0) != 18446744073709551615ULL) return(__LINE__);
+	WJECloseDocument(e);
+
+	return(0);
+}
+
+static int DoublesTest(WJElement doc)
+{
+	struct {
+		double		d;
+		char		*str;
+	} doubles[] = {
+		{ 0.0,						"0.0"						},
+		{ -0.0,						"-0.0"						},
+		{ 1.0,						"1.0"						},
+		{ -2.5,						"-2.5"						},
+		{ 0.1,						"0.1"						},
+		{ 1.0 / 3.0,				"0.3333333333333333"		},
+		{ 1e-7,						"1e-7"						},
+		{ 0.000001,					"0.000001"					},
+		{ 1e21,						"1e21"						},
+		{ 1e20,						"100000000000000000000.0"	},
+		{ 123456.789e-20,			"1.23456789e-15"			},
+		{ 1.7976931348623157e308,	"1.7976931348623157e308"	},
+		{ 2.2250738585072014e-308,	"2.2250738585072014e-308"	},
+		{ 4.9406564584124654e-324,	"5e-324"					},
+		{ 0.0,						NULL						}
+	};
+	double		values[]	= { 0.1, 0.2, 0.30000000000000004, 3.141592653589793, -1e300, 5e-324, 1e16, 0.0 };
+	char		buffer[WJW_DOUBLE_SIZE];
+	char		*json;
+	char		*mem		= NULL;
+	WJElement	e;
+	WJWriter	writer;
+	int			x;
+
+	for (x = 0; doubles[x].str; x++) {
+		if (WJWFormatDouble(doubles[x].d, buffer) != strlen(doubles[x].str) ||
+			strcmp(buffer, doubles[x].str)
+		) {
+			printf("e: Incorrect result for %s: %s\n", doubles[x].str, buffer);
+			return(__LINE__);
+		}
+	}
+
+#ifndef WJW_LEGACY_DOUBLE_FORMAT
+	/* Doubles must survive a trip through a string unchanged */
+	if (!(e = WJEArray(NULL, NULL, WJE_NEW))) return(__LINE__);
+	for (x = 0; x < (int) (sizeof(values) / sizeof(values[0])); x++) {
+		WJEDouble(e, "[$]", WJE_NEW, values[x]);
+	}
+
+	if (!(json = WJEToString(e, FALSE))) return(__LINE__);
+	WJECloseDocument(e);
+
+	if (!(e = WJEFromString(json))) return(__LINE__);
+	MemRelease(&json);
+
+	for (x = 0; x < (int) (sizeof(values) / sizeof(values[0])); x++) {
+		if (WJEDoubleF(e, WJE_GET, NULL, -1, "[%d]", x) != values[x]) {
+			printf("e: %.17g did not survive a round trip\n", values[x]);
+			return(__LINE__);
+		}
+	}
+	WJECloseDocument(e);
+#endif
+
+	/* The legacy format is still available */
+	if (!(writer = WJWOpenMemDocument(FALSE, &mem))) return(__LINE__);
+	writer->doubleFormat = "%e";
+	WJWDouble(NULL, 1.0, writer);
+	WJWCloseDocument(writer);
+	if (!mem || strcmp(mem, "1.000000e+00")) return(__LINE__);
+	MemRelease(&mem);
+
+	return(0);
+}
+
+static int IntegersTest(WJElement doc)
+{
+	struct {
+		int			base;
+		char		*str;
+	} results[] = {
+		{ 10,	"[0,-2147483648,4294967295,-9223372036854775808,18446744073709551615,99,-100]"	},
+		{ 16,	"[0x00000000,0x80000000,0xffffffff,0x8000000000000000,0xffffffffffffffff,0x00000063,0xffffff9c]"	},
+		{ 8,	"[00,020000000000,037777777777,01000000000000000000000,01777777777777777777777,0143,037777777634]"	},
+		{ 0 }
+	};
+	char		*mem;
+	WJWriter	writer;
+	int			x;
+
+	for (x = 0; results[x].str; x++) {
+		mem = NULL;
+		if (!(writer = WJWOpenMemDocument(FALSE, &mem))) return(__LINE__);
+		writer->base = results[x].base;
+
+		WJWOpenArray(NULL, writer);
+		WJWUInt32(NULL, 0, writer);
+		WJWInt32(NULL, -2147483647 - 1, writer);
+		WJWUInt32(NULL, 4294967295U, writer);
+		WJWInt64(NULL, -9223372036854775807LL - 1, writer);
+		WJWUInt64(NULL, 18446744073709551615ULL, writer);
+		WJWInt32(NULL, 99, writer);
+		WJWInt32(NULL, -100, writer);
+		WJWCloseArray(writer);
+		WJWCloseDocument(writer);
+
+		if (!mem || strcmp(mem, results[x].str)) {
+			printf("e: Incorrect result for base %d: %s\n", results[x].base, mem ? mem : "(null)");
+			return(__LINE__);
+		}
+		MemRelease(&mem);
+	}
+
+	return(0);
+}
+
+static int EscapeTest(WJElement doc)
+{
+	struct {
+		char		*str;
+		char		*escaped;
+	} chars[] = {
+		{ "\"",				"\\\""			},
+		{ "\\",				"\\\\"			},
+		{ "\n",				"\\n"			},
+		{ "\x01",			"\\u0001"		},
+		{ "\x1f",			"\\u001f"		},
+		{ "\xc3\xa9",		"\xc3\xa9"		},
+		{ "\xff",			"\\xff"			},
+		{ NULL }
+	};
+	char		value[80];
+	char		expected[96];
+	char		*mem;
+	WJWriter	writer;
+	int			x, i;
+
+	/*
+		Put each character that needs attention at every position in a long run
+		of plain characters, to cover both sides of each vector boundary.
+	*/
+	for (x = 0; chars[x].str; x++) {
+		for (i = 0; i < 70 - (int) strlen(chars[x].str); i++) {
+			memset(value, 'a', sizeof(value));
+			memcpy(value + i, chars[x].str, strlen(chars[x].str));
+			value[70] = '\0';
+
+			memset(expected, 'a', sizeof(expected));
+			expected[0] = '"';
+			memcpy(expected + 1 + i, chars[x].escaped, strlen(chars[x].escaped));
+			strcpy(expected + 1 + 70 - strlen(chars[x].str) + strlen(chars[x].escaped), "\"");
+
+			mem = NULL;
+			if (!(writer = WJWOpenMemDocument(FALSE, &mem))) return(__LINE__);
+			WJWString(NULL, value, TRUE, writer);
+			WJWCloseDocument(writer);
+
+			if (!mem || strcmp(mem, expected)) {
+				printf("e: Incorrect result: %s\n", mem ? mem : "(null)");
+				return(__LINE__);
+			}
+			MemRelease(&mem);
+		}
+	}
+
+	return(0);
+}
+
+static int SelectorTest(WJElement doc)
+{
+	char		*paths[] = {
+		"string", "digits[3]", "digits[-1]", "digits[010]", "digits[42]",
+		"digits[2,4]", "strings[1:2]", "digits[]>7", "a.b.c.names[2]",
+		"a;ant", "a|names", "['a*'].ant", "'space balls'.'the movie'",
+		"[\"string\"]", "", NULL
+	};
+	WJESelector	selector;
+	WJElement	e, a, b;
+	char		path[32];
+	int			x;
+
+	/* A compiled selector must find exactly what the path would */
+	for (x = 0; paths[x]; x++) {
+		if (!(selector = WJECompileSelector(paths[x]))) return(__LINE__);
+
+		a = b = NULL;
+		do {
+			a = WJEGet(doc, paths[x], a);
+			b = WJEGetCompiled(doc, selector, b);
+
+			if (a != b) {
+				printf("e: Compiled selector did not match \"%s\"\n", paths[x]);
+				WJEFreeSelector(selector);
+				return(__LINE__);
+			}
+		} while (a);
+
+		WJEFreeSelector(selector);
+	}
+
+	/* Create elements with a compiled selector */
+	if (!(e = WJEObject(NULL, NULL, WJE_NEW))) return(__LINE__);
+	if (!(selector = WJECompileSelector("one.two[$]"))) return(__LINE__);
+
+	for (x = 0; x < 3; x++) {
+		WJEInt32Compiled(e, selector, WJE_NEW, x);
+	}
+	WJEFreeSelector(selector);
+
+	if (!(selector = WJECompileSelector("one.two[2]"))) return(__LINE__);
+	if (WJEInt32Compiled(e, selector, WJE_GET, -1) != 2) return(__LINE__);
+	if (WJEInt32(e, "one.two[1]", WJE_GET, -1) != 1) return(__LINE__);
+	if (WJEInt32(e, "one.two[3]", WJE_GET, -1) != -1) return(__LINE__);
+	if (WJEStringCompiled(e, selector, WJE_SET, "two") == NULL) return(__LINE__);
+	if (strcmp(WJEString(e, "one.two[2]", WJE_GET, ""), "two")) return(__LINE__);
+	WJEFreeSelector(selector);
+
+	/* Use more paths than fit in the cache, and then go back to the first */
+	for (x = 0; x < 600; x++) {
+		sprintf(path, "n%d", x);
+		WJEInt32(e, path, WJE_NEW, x);
+	}
+	for (x = 0; x < 600; x++) {
+		if (WJEInt32F(e, WJE_GET, NULL, -1, "n%d", x) != x) return(__LINE__);
+	}
+
+	WJECloseDocument(e);
+	WJEFreeSelectorCache();
+
+	return(0);
+}
+
+static int ToBufferTest(WJElement doc)
+{
+	WJWriter	writer;
+	WJElement	e;
+	char		*full, *pretty, *mem;
+	char		buffer[64];
+	size_t		needed, length;
+	int			x;
+
+	if (!(full = WJEToString(doc, FALSE))) return(__LINE__);
+	length = strlen(full);
+
+	/* Writing to a buffer that is too small must report the full length */
+	if (WJEToBuffer(doc, FALSE, buffer, sizeof(buffer), &needed)) return(__LINE__);
+	if (needed != length) return(__LINE__);
+	if (strlen(buffer) != sizeof(buffer) - 1) return(__LINE__);
+	if (strncmp(buffer, full, sizeof(buffer) - 1)) return(__LINE__);
+
+	if (WJEToBuffer(doc, FALSE, NULL, 0, &needed)) return(__LINE__);
+	if (needed != length) return(__LINE__);
+
+	/* A buffer of needed + 1 bytes must hold the whole thing */
+	if (!(mem = MemMalloc(needed + 1))) return(__LINE__);
+	if (!WJEToBuffer(doc, FALSE, mem, needed + 1, &needed)) return(__LINE__);
+	if (strcmp(mem, full)) return(__LINE__);
+	MemRelease(&mem);
+
+	/* Pretty output must match as well */
+	if (!(pretty = WJEToString(doc, TRUE))) return(__LINE__);
+	if (!(mem = MemMalloc(strlen(pretty) + 1))) return(__LINE__);
+	if (!WJEToBuffer(doc, TRUE, mem, strlen(pretty) + 1, &needed)) return(__LINE__);
+	if (needed != strlen(pretty) || strcmp(mem, pretty)) return(__LINE__);
+	MemRelease(&mem);
+	MemRelease(&pretty);
+
+	/* Small documents fit in small buffers */
+	if (!(e = WJEGet(doc, "digits", NULL))) return(__LINE__);
+	if (!WJEToBuffer(e, FALSE, buffer, sizeof(buffer), &needed)) return(__LINE__);
+	if (strcmp(buffer, "[0,1,2,3,4,5,6,7,8,9]") || needed != 21) return(__LINE__);
+
+	/* A memory document appends to an existing string */
+	if (!(mem = MemStrdup("x"))) return(__LINE__);
+	if (!(writer = WJWOpenMemDocumentEx(FALSE, &mem, 4))) return(__LINE__);
+	WJEWriteDocument(doc, writer, NULL);
+	if (!WJWCloseDocument(writer)) return(__LINE__);
+	if (mem[0] != 'x' || strcmp(mem + 1, full)) return(__LINE__);
+	MemRelease(&mem);
+
+	/* Grow from nothing, many times over */
+	if (!(writer = WJWOpenMemDocument(FALSE, &mem))) return(__LINE__);
+	WJWOpenArray(NULL, writer);
+	for (x = 0; x < 1000; x++) {
+		WJEWriteDocument(doc, writer, NULL);
+	}
+	WJWCloseArray(writer);
+	if (!WJWCloseDocument(writer)) return(__LINE__);
+	if (strlen(mem) != 1000 * (length + 1) + 1) return(__LINE__);
+	if (strncmp(mem + 1, full, length)) return(__LINE__);
+	if (strncmp(mem + 1 + 999 * (length + 1), full, length)) return(__LINE__);
+	MemRelease(&mem);
+
+	MemRelease(&full);
+	return(0);
+}
+
+static int ToFileTest(WJElement doc)
+{
+	char		path[]	= "wjeunit-tofile.json";
+	uint32		flags[]	= {
+		0, WJW_FILE_SYNC, WJW_FILE_ATOMIC, WJW_FILE_ATOMIC | WJW_FILE_SYNC,
+		WJW_FILE_PREALLOCATE, WJW_FILE_ATOMIC | WJW_FILE_PREALLOCATE
+	};
+	WJElement	big, d;
+	char		*expected, *a;
+	FILE		*f;
+	long		length;
+	int			x, r	= 0;
+#ifndef _WIN32
+	struct stat	st;
+#endif
+
+	/* Large enough to need more than one block */
+	if (!(big = WJEArray(NULL, NULL, WJE_NEW))) return(__LINE__);
+	for (x = 0; x < 2000; x++) {
+		WJEAttach(big, WJECopyDocument(NULL, doc, NULL, NULL));
+	}
+	if (!(expected = WJEToString(big, TRUE))) return(__LINE__);
+
+	for (x = 0; !r && x < sizeof(flags) / sizeof(flags[0]); x++) {
+		/* Start with something longer, so that it must be replaced */
+		if ((f = fopen(path, "wb"))) {
+			fputs(expected, f);
+			fputs(expected, f);
+			fclose(f);
+		}
+
+		if (!WJEToFileEx(big, TRUE, path, flags[x])) {
+			r = __LINE__;
+			break;
+		}
+
+		if (!(f = fopen(path, "rb"))) {
+			r = __LINE__;
+			break;
+		}
+		fseek(f, 0, SEEK_END);
+		length = ftell(f);
+		fclose(f);
+
+		if (length != (long) strlen(expected)) {
+			r = __LINE__;
+			break;
+		}
+
+		d = WJEFromFile(path);
+		a = WJEToString(d, TRUE);
+		if (!a || strcmp(a, expected)) r = __LINE__;
+
+		MemRelease(&a);
+		WJECloseDocument(d);
+	}
+
+#ifndef _WIN32
+	/* A file that is replaced atomically keeps its mode */
+	if (!r && (chmod(path, 0640) || !WJEToFileEx(doc, FALSE, path, WJW_FILE_ATOMIC) ||
+		stat(path, &st) || (st.st_mode & 07777) != 0640)
+	) {
+		r = __LINE__;
+	}
+#endif
+
+	/* A file can't be written to a directory that doesn't exist */
+	if (!r && WJEToFileEx(doc, FALSE, "wjeunit-missing/tofile.json", WJW_FILE_ATOMIC)) r = __LINE__;
+	if (!r && WJEToFile(doc, FALSE, "wjeunit-missing/tofile.json")) r = __LINE__;
+
+	remove(path);
+	MemRelease(&expected);
+	WJECloseDocument(big);
+	return(r);
+}
+
+static int PushTest(WJElement doc)
+{
+	char			*tricky	= "\xEF\xBB\xBF { # comment \"{[\n"
+		"\"s\": \"a\\\"b\\u00e9\\ud83d\\ude00\\n\", \"n\": -1.5e3, \"i\": 42,"
+		"\"l\": [ TRUE, false, null, ], \"s\": \"duplicate\", \"\": 1,"
+		"\"o\": { \"\\u0041\": {}, \"b\": [[], {}] }, }";
+	char			*json, *a, *b;
+	size_t			length, used, x, step;
+	WJEPushParser	parser;
+	WJEPushStatus	status;
+	WJElement		d;
+	int				r		= 0;
+
+	if (!(json = WJEToString(doc, TRUE))) return(__LINE__);
+	length = strlen(json);
+
+	/* Any split of the data must result in the same document */
+	for (step = 1; !r && step < length + 10; step = step * 2 + 1) {
+		if (!(parser = WJEOpenPushParser(NULL, NULL))) return(__LINE__);
+
+		for (x = 0, status = WJE_PUSH_MORE; x < length && WJE_PUSH_MORE == status; x += step) {
+			status = WJEFeed(parser, json + x, xpl_min(step, length - x), 0, &used);
+		}
+
+		d = WJEClosePushParser(parser);
+		if (WJE_PUSH_DONE != status || !d) {
+			r = __LINE__;
+		} else if (!(a = WJEToString(d, TRUE)) || strcmp(a, json)) {
+			r = __LINE__;
+		}
+
+		MemRelease(&a);
+		WJECloseDocument(d);
+	}
+
+	/* A budget limits how much is parsed by each call */
+	if (!r && (parser = WJEOpenPushParser(NULL, NULL))) {
+		for (x = 0; WJE_PUSH_AGAIN == (status = WJEFeed(parser, json + x, length - x, 100, &used)); x += used) {
+			if (used != 100) r = __LINE__;
+		}
+		if (WJE_PUSH_DONE != status || x + used != length) r = __LINE__;
+
+		if ((d = WJEClosePushParser(parser))) {
+			a = WJEToString(d, TRUE);
+			if (!a || strcmp(a, json)) r = __LINE__;
+			MemRelease(&a);
+		} else {
+			r = __LINE__;
+		}
+		WJECloseDocument(d);
+	}
+	MemRelease(&json);
+	if (r) return(r);
+
+	/* Extensions must be handled just as the in memory parser does */
+	if (!(json = MemStrdup(tricky))) return(__LINE__);
+	d = WJEOpenDocumentInSitu(json, strlen(json), NULL, NULL);
+	b = WJEToString(d, FALSE);
+	WJECloseDocument(d);
+
+	length = strlen(tricky);
+	for (step = 1; !r && step <= length; step++) {
+		if (!(parser = WJEOpenPushParser(NULL, NULL))) return(__LINE__);
+
+		for (x = 0, status = WJE_PUSH_MORE; x < length && WJE_PUSH_MORE == status; x += step) {
+			status = WJEFeed(parser, tricky + x, xpl_min(step, length - x), 0, &used);
+		}
+
+		d = WJEClosePushParser(parser);
+		if (WJE_PUSH_DONE != status || !d) {
+			r = __LINE__;
+		} else if (!(a = WJEToString(d, FALSE)) || !b || strcmp(a, b)) {
+			r = __LINE__;
+		}
+
+		MemRelease(&a);
+		WJECloseDocument(d);
+	}
+	MemRelease(&b);
+	MemRelease(&json);
+	if (r) return(r);
+
+	/* A number isn't complete until the end of the data */
+	if (!(parser = WJEOpenPushParser(NULL, NULL))) return(__LINE__);
+	if (WJE_PUSH_MORE != WJEFeed(parser, "12", 2, 0, NULL)) return(__LINE__);
+	if (WJE_PUSH_MORE != WJEFeed(parser, "34", 2, 0, NULL)) return(__LINE__);
+	if (WJE_PUSH_DONE != WJEFeed(parser, NULL, 0, 0, NULL)) return(__LINE__);
+	if (!(d = WJEClosePushParser(parser))) return(__LINE__);
+	if (1234 != WJEInt32(d, NULL, WJE_GET, 0)) return(__LINE__);
+	WJECloseDocument(d);
+
+	/* Anything after the document is left for the caller */
+	if (!(parser = WJEOpenPushParser(NULL, NULL))) return(__LINE__);
+	if (WJE_PUSH_DONE != WJEFeed(parser, "[1] [2]", 7, 0, &used)) return(__LINE__);
+	if (used != 3) return(__LINE__);
+	if (!(d = WJEClosePushParser(parser))) return(__LINE__);
+	WJECloseDocument(d);
+
+	/* A badly formed or incomplete document is not returned */
+	if (!(parser = WJEOpenPushParser(NULL, NULL))) return(__LINE__);
+	if (WJE_PUSH_ERROR != WJEFeed(parser, "{ \"a\": 1 ]", 11, 0, NULL)) return(__LINE__);
+	if ((d = WJEClosePushParser(parser))) return(__LINE__);
+
+	if (!(parser = WJEOpenPushParser(NULL, NULL))) return(__LINE__);
+	if (WJE_PUSH_MORE != WJEFeed(parser, "{ \"a\": [ 1, ", 12, 0, NULL)) return(__LINE__);
+	if (WJE_PUSH_ERROR != WJEFeed(parser, NULL, 0, 0, NULL)) return(__LINE__);
+	if ((d = WJEClosePushParser(parser))) return(__LINE__);
+
+	return(0);
+}
+
+static XplBool StreamLoadCB(WJElement parent, char *path, void *data, const char *file, const int line)
+{
+	int			*count	= (int *) data;
+
+	/* Reject the third record */
+	if (!parent) {
+		return((*count)++ != 2);
+	}
+	return(TRUE);
+}
+
+static XplBool StreamFreeCB(WJElement e)
+{
+	(*((int *) e->client))++;
+	return(TRUE);
+}
+
+static int StreamTest(WJElement doc)
+{
+	char		*records[]	= {
+		"{\"a\":1,\"b\":[2,3]}", "\"string\"", "42", "[1,{\"x\":null}]",
+		"true", "false", "{\"a\":\"b\"}", NULL
+	};
+	uint32		flags[]		= { 0, WJE_STREAM_ARENA };
+	int			good[]		= { 1, 4, 5 };
+	char		*json, *a, *big;
+	size_t		len;
+	WJReader	reader;
+	WJElement	e, c;
+	int			i, f, x, r	= 0;
+
+	/* A large record, with a long string and enough children to be indexed */
+	if (!(e = WJEObject(NULL, NULL, WJE_NEW))) return(__LINE__);
+	if (!(big = MemMalloc(10001))) return(__LINE__);
+	memset(big, 'x', 10000);
+	big[10000] = '\0';
+	WJEString(e, "long", WJE_NEW, big);
+	for (x = 0; x < 40; x++) {
+		WJEInt32F(e, WJE_NEW, NULL, x, "member%d", x);
+	}
+	MemRelease(&big);
+	big = WJEToString(e, FALSE);
+	WJECloseDocument(e);
+	if (!big) return(__LINE__);
+
+	len = strlen(big) * 2 + 1024;
+	if (!(json = MemMalloc(len))) return(__LINE__);
+
+	/* Newline delimited, along with some other ways of separating values */
+	strprintf(json, len, NULL, "%s\n%s\n%s\n%s\r\n\n%s %s,%s%s\n%s\n",
+		records[0], records[1], records[2], records[3], records[4],
+		records[5], records[6], big, big);
+
+	for (f = 0; !r && f < (int) (sizeof(flags) / sizeof(flags[0])); f++) {
+		if (!(reader = WJROpenMemDocument(json, NULL, 0))) return(__LINE__);
+
+		for (i = 0; WJENextDocument(reader, flags[f], NULL, NULL, &e); i++) {
+			a = WJEToString(e, FALSE);
+
+			if (!a || strcmp(a, i < 7 ? records[i] : big)) {
+				r = __LINE__;
+			}
+
+			if (i == 8) {
+				/* A modified record must still be closed properly */
+				WJEString(e, "long", WJE_SET, "short");
+				WJECloseDocument(WJEChild(e, "member3", WJE_GET));
+			}
+
+			c = NULL;
+			if (i == 7) {
+				/* Even if the changes have been reset, or weren't counted */
+				e->changes = 0;
+				WJESuspendChanges();
+				WJEString(e, "long", WJE_SET, "short");
+				WJEResumeChanges();
+
+				e->changes = 0;
+				c = WJEChild(e, "member5", WJE_GET);
+				WJEDetach(c);
+				e->changes = 0;
+			}
+
+			MemRelease(&a);
+			WJECloseDocument(e);
+
+			if (c) {
+				/* A detached child outlives the record */
+				if (5 != WJEInt32(c, NULL, WJE_GET, -1)) r = __LINE__;
+				WJECloseDocument(c);
+			}
+
+			if (r) break;
+		}
+		WJRCloseDocument(reader);
+
+		if (!r && i != 9) r = __LINE__;
+	}
+
+	/*
+		An unmodified record is free'd all at once, without closing its children,
+		but a modified one is closed one element at a time.
+	*/
+	if (!r && (reader = WJROpenMemDocument("{\"a\":{\"b\":1}}\n{\"a\":{\"b\":1}}\n", NULL, 0))) {
+		x = 0;
+		for (i = 0; WJENextDocument(reader, WJE_STREAM_ARENA, NULL, NULL, &e); i++) {
+			if ((c = WJEChild(e, "a", WJE_GET))) {
+				c->client = &x;
+				c->freecb = StreamFreeCB;
+			}
+
+			if (i == 1) {
+				WJEInt32(e, "a.c", WJE_NEW, 2);
+			}
+			WJECloseDocument(e);
+		}
+		WJRCloseDocument(reader);
+
+		if (i != 2 || x != 1) r = __LINE__;
+	}
+
+	/* A rejected record is skipped, without ending the stream */
+	if (!r && (reader = WJROpenMemDocument(json, NULL, 0))) {
+		f = 0;
+		for (i = x = 0; WJENextDocument(reader, 0, StreamLoadCB, &f, &e); i++) {
+			if (e) {
+				x++;
+			}
+			WJECloseDocument(e);
+		}
+		WJRCloseDocument(reader);
+
+		if (i != 9 || x != 8) r = __LINE__;
+	}
+
+	/*
+		A malformed record is reported, and the stream picks up again with the
+		record on the next line.
+	*/
+	for (f = 0; !r && f < (int) (sizeof(flags) / sizeof(flags[0])); f++) {
+		if (!(reader = WJROpenMemDocument("{\"a\":1}\n{bad}\n{\"a\":4}\nxyz\n{\"a\":5}\n", NULL, 0))) {
+			r = __LINE__;
+			break;
+		}
+
+		for (i = x = 0; i < 10; i++) {
+			if (!WJENextDocument(reader, flags[f], NULL, NULL, &e)) {
+				if (EILSEQ != errno) break;
+
+				if (e) r = __LINE__;
+				x++;
+				continue;
+			}
+
+			if (!e || i - x > 2 || WJEInt32(e, "a", WJE_GET, 0) != good[i - x]) r = __LINE__;
+			WJECloseDocument(e);
+		}
+		WJRCloseDocument(reader);
+
+		if (!r && (i != 5 || x != 2 || errno)) r = __LINE__;
+	}
+
+	MemRelease(&json);
+	MemRelease(&big);
+	return(r);
+}
+
+typedef struct {
+	uint32		count;
+	uint32		stop;
+	XplBool		ordered;
+	XplBool		failed;
+	char		*seen;
+} ParallelState;
+
+#define PARALLEL_RECORDS	50000
+#define PARALLEL_BIG		500
+
+static XplBool ParallelRecordCB(WJElement doc, void *data)
+{
+	ParallelState	*state	= (ParallelState *) data;
+	int32			n		= WJEInt32(doc, "n", WJE_GET, -1);
+
+	if (n < 0 || n >= PARALLEL_RECORDS || state->seen[n] ||
+		(state->ordered && (uint32) n != state->count) ||
+		(n == PARALLEL_BIG && WJEString(doc, "s", WJE_GET, "")[0] != 'x')
+	) {
+		state->failed = TRUE;
+	} else {
+		state->seen[n] = 1;
+	}
+	WJECloseDocument(doc);
+
+	/* Only counted when delivered in order, since it isn't thread safe */
+	if (state->ordered) {
+		state->count++;
+	}
+	return(!state->stop || state->count < state->stop);
+}
+
+static void ParallelReset(ParallelState *state, XplBool ordered, uint32 stop)
+{
+	state->count	= 0;
+	state->stop		= stop;
+	state->ordered	= ordered;
+	state->failed	= FALSE;
+
+	memset(state->seen, 0, PARALLEL_RECORDS);
+}
+
+static int ParallelTest(WJElement doc)
+{
+	ParallelState	state;
+	char			*json, *p;
+	size_t			len, big	= 2 * 1024 * 1024;
+	uint32			flags[]		= { WJE_STREAM_ORDERED, WJE_STREAM_ORDERED | WJE_STREAM_ARENA, 0 };
+	int				threads[]	= { 1, 4, 0 };
+	int				i, t, n;
+	int				r			= 0;
+
+	len = PARALLEL_RECORDS * 64 + big;
+	if (!(json = MemMalloc(len))) return(__LINE__);
+	if (!(state.seen = MemMalloc(PARALLEL_RECORDS))) return(__LINE__);
+
+	/* One record is larger than a chunk, and there are some blank lines */
+	for (p = json, n = 0; n < PARALLEL_RECORDS; n++) {
+		if (n == PARALLEL_BIG) {
+			p += sprintf(p, "{\"n\":%d,\"s\":\"", n);
+			memset(p, 'x', big);
+			p += big;
+			p += sprintf(p, "\"}\n");
+		} else {
+			p += sprintf(p, "{\"n\":%d,\"s\":\"record %d\",\"a\":[1,2,3]}\n%s",
+				n, n, (n % 1000) ? "" : "\n");
+		}
+	}
+	*p = '\0';
+
+	for (t = 0; !r && t < (int) (sizeof(threads) / sizeof(threads[0])); t++) {
+		for (i = 0; !r && i < (int) (sizeof(flags) / sizeof(flags[0])); i++) {
+			ParallelReset(&state, (flags[i] & WJE_STREAM_ORDERED) || threads[t] == 1, 0);
+
+			if (!WJELoadParallelMem(json, p - json, threads[t], flags[i], NULL, ParallelRecordCB, &state)) {
+				r = __LINE__;
+			}
+			for (n = 0; n < PARALLEL_RECORDS; n++) {
+				if (!state.seen[n]) state.failed = TRUE;
+			}
+			if (!r && state.failed) r = __LINE__;
+
+			/* Read through a callback rather than in place */
+			ParallelReset(&state, (flags[i] & WJE_STREAM_ORDERED) || threads[t] == 1, 0);
+
+			if (!r && !WJELoadParallel(WJRMemCallback, json, threads[t], flags[i], NULL, ParallelRecordCB, &state)) {
+				r = __LINE__;
+			}
+			for (n = 0; n < PARALLEL_RECORDS; n++) {
+				if (!state.seen[n]) state.failed = TRUE;
+			}
+			if (!r && state.failed) r = __LINE__;
+		}
+
+		/* The consumer may stop the load part way through */
+		ParallelReset(&state, TRUE, 1000);
+
+		if (!r && WJELoadParallelMem(json, p - json, threads[t], WJE_STREAM_ORDERED, NULL, ParallelRecordCB, &state)) {
+			r = __LINE__;
+		}
+		if (!r && (state.failed || state.count != 1000)) r = __LINE__;
+	}
+
+	/* A malformed record is reported, and the records after it are still loaded */
+	len = p - json;
+	if (!r && !(p = strstr(json, "{\"n\":5000,"))) r = __LINE__;
+	if (!r) memcpy(p, "{bad:", 5);
+
+	for (t = 0; !r && t < 2; t++) {
+		ParallelReset(&state, FALSE, 0);
+
+		if (WJELoadParallelMem(json, len, threads[t], WJE_STREAM_ORDERED, NULL, ParallelRecordCB, &state) ||
+			EILSEQ != errno
+		) {
+			r = __LINE__;
+		}
+		for (n = 0; n < PARALLEL_RECORDS; n++) {
+			if (!state.seen[n] != (n == 5000)) state.failed = TRUE;
+		}
+		if (!r && state.failed) r = __LINE__;
+	}
+
+	MemRelease(&state.seen);
+	MemRelease(&json);
+	return(r);
+}
+
+/* Compare a parallel load of an array to loading it in place */
+static int ParallelArrayCompare(char *json, int threads)
+{
+	char		*copy;
+	char		*a		= NULL;
+	char		*b		= NULL;
+	WJElement	x, y;
+	int			r		= 0;
+
+	if (!(copy = MemStrdup(json))) return(__LINE__);
+
+	x = WJEOpenDocumentInSitu(copy, strlen(copy), NULL, NULL);
+	y = WJEOpenArrayParallel(json, strlen(json), threads, NULL, NULL);
+
+	if (!x != !y) {
+		r = __LINE__;
+	} else if (x) {
+		a = WJEToString(x, FALSE);
+		b = WJEToString(y, FALSE);
+
+		if (!a || !b || strcmp(a, b) || x->count != y->count ||
+			x->changes != y->changes
+		) {
+			r = __LINE__;
+		}
+	}
+
+	MemRelease(&a);
+	MemRelease(&b);
+	WJECloseDocument(x);
+	WJECloseDocument(y);
+	MemRelease(&copy);
+	return(r);
+}
+
+static int ParallelArrayTest(WJElement doc)
+{
+	char		*item	= "{\"s\":\"a, ] } [ \\\"# x\",\"n\":[1,{\"x\":\"]\"}],\"m\":{}}";
+	char		*json, *p;
+	size_t		len;
+	int			i, r;
+
+	json = GenerateBigJSONStr(100000);
+	r = ParallelArrayCompare(json, 4);
+	MemRelease(&json);
+	if (r) return(r);
+
+	/* Names and strings with structural characters, comments and a trailing comma */
+	len = 20000 * (strlen(item) + 32);
+	if (!(json = MemMalloc(len))) return(__LINE__);
+
+	p = json + sprintf(json, " [ ");
+	for (i = 0; i < 20000; i++) {
+		p += sprintf(p, "%s%s,\n", (i % 1000) ? "" : "# A comment, with ] and \" in it\n", item);
+	}
+	strcpy(p, "]");
+
+	if ((r = ParallelArrayCompare(json, 4))) goto done;
+	if ((r = ParallelArrayCompare(json, 1))) goto done;
+	if ((r = ParallelArrayCompare(json, 0))) goto done;
+
+	/* An error late in the document must fail the whole load */
+	p[-20] = ':';
+	if ((r = ParallelArrayCompare(json, 4))) goto done;
+	if (!r && WJEOpenArrayParallel(json, strlen(json), 4, NULL, NULL)) r = __LINE__;
+
+done:
+	MemRelease(&json);
+	if (r) return(r);
+
+	/* Anything other than an array is loaded as usual */
+	if (!(p = GenerateBigJSONStr(100000))) return(__LINE__);
+	if (!(json = MemMalloc(strlen(p) + 16))) return(__LINE__);
+	sprintf(json, "{\"a\":%s}", p);
+	MemRelease(&p);
+
+	r = ParallelArrayCompare(json, 4);
+	MemRelease(&json);
+	return(r);
+}
+
+static int ProjectionLoad(char *json, size_t buffersize, WJEProjection projection, char *expected)
+{
+	WJReader	reader;
+	WJElement	doc;
+	char		*str;
+	int			r		= 0;
+
+	if (!(reader = WJROpenMemDocument(json, NULL, buffersize))) return(__LINE__);
+	doc = WJEOpenDocumentProjected(reader, NULL, projection);
+	WJRCloseDocument(reader);
+	if (!doc) return(__LINE__);
+
+	if (!(str = WJEToString(doc, FALSE)) || strcmp(str, expected)) {
+		printf("e: Expected %s, got %s\n", expected, str ? str : "NULL");
+		r = __LINE__;
+	}
+
+	MemRelease(&str);
+	WJECloseDocument(doc);
+	return(r);
+}
+
+/* Load a document with a projection, and read a number back with a selector */
+static int ProjectionRead(char *json, WJEProjection projection, const char *path, int32 value)
+{
+	WJElement	doc;
+	char		*copy;
+	int			r		= 0;
+
+	if (!(copy = MemStrdup(json))) return(__LINE__);
+
+	if (!(doc = WJEOpenDocumentInSitu(copy, strlen(copy), WJEProjectionLoadCB, projection)) ||
+		WJEInt32(doc, path, WJE_GET, -1) != value
+	) {
+		r = __LINE__;
+	}
+
+	WJECloseDocument(doc);
+	MemRelease(&copy);
+	return(r);
+}
+
+static int ProjectionTest(WJElement doc)
+{
+	const char		*selectors[]	= {
+		"id", "user.name", "list[].id", "list[2]", "[\"a.b\"]", "['x*'].v", "deep.one.two"
+	};
+	char			*skipped		= "{\"s\":\"a, ] } [ \\\"# x\\\\\",\"n\":[1,{\"x\":\"]\"}],\"m\":{}}";
+	const char		*offsets[]		= { "a.c[2].d", "g[1]", "a.c[1]" };
+	char			*indexed		=
+		"{\"a\":{\"c\":[10,20,{\"d\":1,\"e\":2},30],\"z\":1},\"g\":[{\"x\":1},{\"x\":2}],\"h\":[1]}";
+	char			*expected		=
+		"{\"id\":7,\"user\":{\"name\":\"Bob\"},"
+		"\"list\":[{\"id\":0},{\"id\":1},{\"id\":2,\"big\":[1,2,3]},{}],"
+		"\"a.b\":true,\"x1\":{\"v\":1},\"x2\":{\"v\":[2]},\"deep\":{\"one\":{\"two\":null}}}";
+	WJEProjection	projection;
+	WJElement		e;
+	char			*json, *p;
+	size_t			len;
+	int				i, r		= 0;
+
+	if (!(projection = WJEOpenProjection(selectors, 7))) return(__LINE__);
+
+	/*
+		Everything that isn't wanted is large enough to need several reads with
+		a small buffer, and is full of strings with brackets, quotes, escapes
+		and comment characters.
+	*/
+	len = 200 * strlen(skipped) + 1024;
+	if (!(json = MemMalloc(4 * len))) {
+		WJECloseProjection(projection);
+		return(__LINE__);
+	}
+
+	p = json + sprintf(json, "{\"skip\":[");
+	for (i = 0; i < 200; i++) {
+		p += sprintf(p, "%s%s,", skipped, (i % 50) ? "" : "\n# A comment with ] and \" in it\n");
+	}
+	p += sprintf(p, "{}],\"id\":7,\"user\":{\"name\":\"Bob\",\"prefs\":");
+	for (i = 0; i < 100; i++) p += sprintf(p, "[%s,", skipped);
+	for (i = 0; i < 100; i++) p += sprintf(p, "0]");
+	p += sprintf(p, ",\"email\":\"bob\"},\"list\":[{\"id\":0,\"x\":%s},{\"skip\":%s,\"id\":1},", skipped, skipped);
+	p += sprintf(p, "{\"id\":2,\"big\":[1,2,3]},{\"no\":%s}],", skipped);
+	p += sprintf(p, "\"a.b\":true,\"a\":{\"b\":%s},\"x1\":{\"v\":1,\"w\":%s},\"x2\":{\"v\":[2]},\"y\":{\"v\":3},", skipped, skipped);
+	sprintf(p, "\"deep\":{\"one\":{\"two\":null,\"three\":%s},\"four\":%s}}", skipped, skipped);
+
+	/* A tiny buffer, the default buffer and a buffer that holds everything */
+	if ((r = ProjectionLoad(json, 1, projection, expected)) ||
+		(r = ProjectionLoad(json, 0, projection, expected)) ||
+		(r = ProjectionLoad(json, strlen(json) * 2, projection, expected))
+	) {
+		goto done;
+	}
+
+	/* The same projection while parsing in place */
+	if (!(e = WJEOpenDocumentInSitu(json, strlen(json), WJEProjectionLoadCB, projection))) {
+		r = __LINE__;
+		goto done;
+	}
+	if (!(p = WJEToString(e, FALSE)) || strcmp(p, expected)) r = __LINE__;
+	MemRelease(&p);
+	WJECloseDocument(e);
+	if (r) goto done;
+
+	/* A document that contains none of it, and the projection still works after */
+	if ((r = ProjectionLoad("{\"other\":[1,2,{\"id\":3}]}", 0, projection, "{}")) ||
+		(r = ProjectionLoad("[{\"id\":1}]", 0, projection, "[]")) ||
+		(r = ProjectionLoad("{\"list\":[{\"id\":4,\"x\":5}],\"id\":6}", 0, projection,
+			"{\"list\":[{\"id\":4}],\"id\":6}"))
+	) {
+		goto done;
+	}
+	WJECloseProjection(projection);
+
+	/* An offset refers to the same element in the projection as in the source */
+	if (!(projection = WJEOpenProjection(offsets, 2))) {
+		r = __LINE__;
+		goto done;
+	}
+
+	if ((r = ProjectionLoad(indexed, 0, projection,
+			"{\"a\":{\"c\":[10,20,{\"d\":1}]},\"g\":[{},{\"x\":2}]}")) ||
+		(r = ProjectionRead(indexed, projection, offsets[0], 1)) ||
+		(r = ProjectionRead(indexed, projection, "g[1].x", 2))
+	) {
+		goto done;
+	}
+	WJECloseProjection(projection);
+
+	/* A lone offset */
+	if (!(projection = WJEOpenProjection(offsets + 2, 1))) {
+		r = __LINE__;
+		goto done;
+	}
+
+	if ((r = ProjectionLoad(indexed, 0, projection, "{\"a\":{\"c\":[10,20]}}")) ||
+		(r = ProjectionRead(indexed, projection, offsets[2], 20))
+	) {
+		goto done;
+	}
+
+done:
+	MemRelease(&json);
+	WJECloseProjection(projection);
+	return(r);
+}
+
+static int LazyHashCB(void *context, void *data, size_t size)
+{
+	return(0);
+}
+
+static int LazyTest(WJElement doc)
+{
+	char		path[]	= "wjeunit-lazy.json";
+	char		json[]	= "{ \"a\": { \"b\": [ 1, { \"c\": \"x]}\\\"\" }, [] ], # ] }\n"
+						  "\"d\": 2 }, \"e\": [ true, ], \"f\": { \"g\" 1 }, \"h\": 3 }";
+	char		*a, *b;
+	WJElement	d, e, c;
+	int			changes;
+	int			i;
+	int			r		= 0;
+
+	/* The whole document must match the original once it has been written */
+	if (!(a = WJEToString(doc, FALSE))) return(__LINE__);
+	if ((d = WJEOpenDocumentLazy(a, strlen(a)))) {
+		b = WJEToString(d, FALSE);
+		if (!b || strcmp(a, b)) r = __LINE__;
+		MemRelease(&b);
+		WJECloseDocument(d);
+	} else {
+		r = __LINE__;
+	}
+	if (!r && !WJEToFile(doc, FALSE, path)) r = __LINE__;
+	if (!r && (d = WJEOpenDocumentLazyPath(path))) {
+		if (strcmp(WJEString(d, "string", WJE_GET, ""), "This is a single string")) r = __LINE__;
+		b = WJEToString(d, FALSE);
+		if (!r && (!b || strcmp(a, b))) r = __LINE__;
+		MemRelease(&b);
+		WJECloseDocument(d);
+	} else if (!r) {
+		r = __LINE__;
+	}
+	remove(path);
+	MemRelease(&a);
+	if (r) return(r);
+
+	if (!(d = WJEOpenDocumentLazy(json, strlen(json)))) return(__LINE__);
+
+	/* Only the top level is parsed until something below it is needed */
+	if (!(e = WJEChild(d, "a", WJE_GET)) || e->child || e->count) {
+		r = __LINE__;
+		goto done;
+	}
+
+	changes = d->changes;
+	if (2 != WJEInt32(d, "a.d", WJE_GET, -1)) r = __LINE__;
+	if (!r && 2 != e->count) r = __LINE__;
+	if (!r && strcmp(WJEString(d, "a.b[1].c", WJE_GET, ""), "x]}\"")) r = __LINE__;
+	if (!r && (!(c = WJEArray(d, "a.b[2]", WJE_GET)) || c->count)) r = __LINE__;
+	if (!r && (d->changes != changes || e->changes)) r = __LINE__;
+	if (r) goto done;
+
+	/* A branch can be parsed all at once to walk the children directly */
+	if (!(c = WJEChild(d, "e", WJE_GET)) || !WJEMaterialize(c, TRUE) ||
+		!c->child || WJR_TYPE_TRUE != c->child->type || 1 != c->count
+	) {
+		r = __LINE__;
+		goto done;
+	}
+
+	/* A badly formed branch is only found once it is needed, and is left empty */
+	if (3 != WJEInt32(d, "h", WJE_GET, -1)) r = __LINE__;
+	if (!r && WJEMaterialize(d, TRUE)) r = __LINE__;
+	if (!r && (!(c = WJEChild(d, "f", WJE_GET)) || c->count || WJEGet(d, "f.g", NULL))) r = __LINE__;
+	if (r) goto done;
+	WJECloseDocument(d);
+
+	/* Writing, copying or hashing a badly formed branch fails */
+	for (i = 0; i < 3 && !r; i++) {
+		if (!(d = WJEOpenDocumentLazy(json, strlen(json)))) return(__LINE__);
+
+		switch (i) {
+			case 0:
+				if ((a = WJEToString(d, FALSE))) r = __LINE__;
+				MemRelease(&a);
+				break;
+
+			case 1:
+				if ((e = WJECopyDocument(NULL, d, NULL, NULL))) r = __LINE__;
+				WJECloseDocument(e);
+				break;
+
+			case 2:
+				if (WJEHash(d, LazyHashCB, NULL)) r = __LINE__;
+				break;
+		}
+
+		WJECloseDocument(d);
+	}
+	if (r) return(r);
+	if (!(d = WJEOpenDocumentLazy(json, strlen(json)))) return(__LINE__);
+
+	/* A branch that outlives its document still refers to the source */
+	c = WJEChild(d, "a", WJE_GET);
+	WJEDetach(c);
+	WJECloseDocument(d);
+
+	if (!(d = WJEOpenDocumentLazy(json, strlen(json)))) {
+		WJECloseDocument(c);
+		return(__LINE__);
+	}
+
+	/* Changes to a branch that hasn't been parsed yet keep what was there */
+	WJERename(c, "z");
+	WJEAttach(WJEChild(d, "a", WJE_GET), c);
+	WJEInt32(d, "a.new", WJE_NEW, 4);
+	e = WJECopyDocument(NULL, WJEChild(d, "a", WJE_GET), NULL, NULL);
+
+	a = WJEToString(e, FALSE);
+	if (!a || strcmp(a, "{\"b\":[1,{\"c\":\"x]}\\\"\"},[]],\"d\":2,"
+		"\"z\":{\"b\":[1,{\"c\":\"x]}\\\"\"},[]],\"d\":2},\"new\":4}")
+	) {
+		r = __LINE__;
+	}
+	MemRelease(&a);
+	WJECloseDocument(e);
+
+done:
+	WJECloseDocument(d);
+	return(r);
+}
+
+static int GrowLoad(char *json, size_t maxbuffersize, WJElement *doc)
+{
+	WJReader	reader;
+
+	if (!(reader = WJROpenMemDocument(json, NULL, 0))) return(__LINE__);
+	reader->maxbuffersize = maxbuffersize;
+
+	*doc = WJEOpenDocument(reader, NULL, NULL, NULL);
+	WJRCloseDocument(reader);
+
+	return(*doc ? 0 : __LINE__);
+}
+
+static int GrowTest(WJElement doc)
+{
+	size_t		lengths[]	= { 20000, 70000, 5000, 300000 };
+	char		*parts[4];
+	char		*json, *a, *p;
+	WJReader	reader;
+	WJElement	e;
+	int			i, r		= 0;
+
+	/* Names that are much larger than the default buffer, at several depths */
+	memset(parts, 0, sizeof(parts));
+	for (i = 0; i < 4; i++) {
+		if (!(parts[i] = MemMalloc(lengths[i] + 1))) {
+			r = __LINE__;
+			goto done;
+		}
+		memset(parts[i], 'a' + i, lengths[i]);
+		parts[i][lengths[i]] = '\0';
+	}
+
+	/* A long string value, with escapes throughout */
+	for (p = parts[3]; p + 1000 < parts[3] + lengths[3]; p += 1000) {
+		p[0] = '\\';
+		p[1] = (p - parts[3]) % 2000 ? '"' : 'n';
+	}
+
+	if (!(json = MemMalloc(lengths[0] + lengths[1] + lengths[2] + lengths[3] * 2 + 128))) {
+		r = __LINE__;
+		goto done;
+	}
+	sprintf(json, "{\"%s\":{\"%s\":{\"%s\":\"%s\",\"x\":[1,2]},\"y\":true},\"z\":\"%s\"}",
+		parts[0], parts[1], parts[2], parts[3], parts[3]);
+
+	/* Everything must be loaded in full */
+	if (!(r = GrowLoad(json, (size_t) -1, &e))) {
+		a = WJEToString(e, FALSE);
+		if (!a || strcmp(a, json)) r = __LINE__;
+		if (!r && !WJEGet(e, "[0][0].x[1]", NULL)) r = __LINE__;
+		MemRelease(&a);
+		WJECloseDocument(e);
+	}
+
+	/* A limit that is too small for the longest name truncates it, as before */
+	if (!r && !(r = GrowLoad(json, 64 * 1024, &e))) {
+		if (!(p = WJEGet(e, "[0][0]", NULL) ? WJEGet(e, "[0][0]", NULL)->name : NULL) ||
+			strlen(p) >= lengths[1] || strncmp(p, parts[1], strlen(p)) ||
+			!WJEGet(e, "z", NULL)
+		) {
+			r = __LINE__;
+		}
+		WJECloseDocument(e);
+	}
+
+	/* The pointers returned by WJRNext() stay valid as the buffer grows */
+	if (!r && (reader = WJROpenMemDocument(json, NULL, 0))) {
+		reader->maxbuffersize = (size_t) -1;
+
+		if (!(a = WJRNext(NULL, (size_t) -1, reader)) || WJR_TYPE_OBJECT != *a ||
+			!(p = WJRNext(a, (size_t) -1, reader)) || strcmp(p + 1, parts[0]) ||
+			!WJRSkip(p, reader) ||
+			!(p = WJRNext(a, (size_t) -1, reader)) || strcmp(p + 1, "z") ||
+			WJR_TYPE_OBJECT != *a || WJRNext(a, (size_t) -1, reader)
+		) {
+			r = __LINE__;
+		}
+		WJRCloseDocument(reader);
+	}
+
+	MemRelease(&json);
+
+done:
+	for (i = 0; i < 4; i++) {
+		MemRelease(&parts[i]);
+	}
+	return(r);
+}
+
+typedef struct {
+	char		data[128];
+	size_t		length;
+} ResetSink;
+
+static size_t ResetWrite(char *data, size_t size, void *writedata)
+{
+	ResetSink	*sink = (ResetSink *) writedata;
+
+	if (sink->length + size >= sizeof(sink->data)) {
+		return(0);
+	}
+
+	memcpy(sink->data + sink->length, data, size);
+	sink->length += size;
+	sink->data[sink->length] = '\0';
+	return(size);
+}
+
+static int ResetTest(WJElement doc)
+{
+	char		first[]		= "{\"one\":1,\"list\":[true,null]}";
+	char		second[]	= "[\"two\",{\"x\":2}]";
+	char		name[]		= "{\"xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx\":1}";
+	char		*big;
+	ResetSink	sinks[2];
+	WJReader	reader, pooled;
+	WJWriter	writer, pooledw;
+	WJElement	a, b;
+	int			i, r		= 0;
+
+	/* A reader that is reset reads the next document as if it were new */
+	if (!(reader = WJROpenMemDocument(first, NULL, 0))) return(__LINE__);
+	a = WJEOpenDocument(reader, NULL, NULL, NULL);
+
+	if (!WJRResetDocument(reader, WJRMemCallback, second)) r = __LINE__;
+	b = WJEOpenDocument(reader, NULL, NULL, NULL);
+
+	if (!r && (!a || WJEInt32(a, "one", WJE_GET, 0) != 1 ||
+		!WJEGet(a, "list[1]", NULL))
+	) {
+		r = __LINE__;
+	}
+	if (!r && (!b || WJEInt32(b, "[1].x", WJE_GET, 0) != 2 ||
+		strcmp(WJEString(b, "[0]", WJE_GET, ""), "two"))
+	) {
+		r = __LINE__;
+	}
+	if (!r && WJRResetDocument(reader, NULL, NULL)) r = __LINE__;
+
+	/* The settings and a grown buffer are kept */
+	if (!r) {
+		if (!(big = MemMalloc(20000 + sizeof(name)))) {
+			r = __LINE__;
+		} else {
+			sprintf(big, "{\"%020000d\":[1]}", 0);
+			reader->maxbuffersize = (size_t) -1;
+
+			WJECloseDocument(a);
+			WJRResetDocument(reader, WJRMemCallback, big);
+			if (!(a = WJEOpenDocument(reader, NULL, NULL, NULL)) ||
+				!a->child || strlen(a->child->name) != 20000
+			) {
+				r = __LINE__;
+			}
+
+			WJECloseDocument(a);
+			WJRResetDocument(reader, WJRMemCallback, name);
+			if (!r && (!(a = WJEOpenDocument(reader, NULL, NULL, NULL)) ||
+				!a->child || reader->maxbuffersize != (size_t) -1)
+			) {
+				r = __LINE__;
+			}
+			MemRelease(&big);
+		}
+	}
+	WJRCloseDocument(reader);
+
+	/* A writer that is reset writes the next document to the new callback */
+	memset(sinks, 0, sizeof(sinks));
+	if (!r && (writer = WJWOpenDocument(FALSE, ResetWrite, &sinks[0]))) {
+		WJEWriteDocument(a, writer, NULL);
+
+		writer->base = 16;
+		if (!WJWResetDocument(writer, ResetWrite, &sinks[1])) r = __LINE__;
+		WJEWriteDocument(b, writer, NULL);
+		WJWUInt32(NULL, 255, writer);
+
+		if (!WJWCloseDocument(writer)) r = __LINE__;
+
+		if (!r && (strcmp(sinks[0].data, name) ||
+			strcmp(sinks[1].data, "[\"two\",{\"x\":0x0000000000000002}],0x000000ff"))
+		) {
+			r = __LINE__;
+		}
+	} else if (!r) {
+		r = __LINE__;
+	}
+
+	/* Closing a pooled reader or writer makes it available to open again */
+	for (i = 0; !r && i < 2; i++) {
+		if (!(pooled = WJROpenPooledDocument(WJRMemCallback, i ? second : first)) ||
+			!(pooledw = WJWOpenPooledDocument(FALSE, ResetWrite, &sinks[i]))
+		) {
+			r = __LINE__;
+			break;
+		}
+
+		if (i && (pooled != reader || pooledw != writer)) r = __LINE__;
+		reader = pooled;
+		writer = pooledw;
+
+		sinks[i].length = 0;
+		WJECloseDocument(a);
+		a = WJEOpenDocument(reader, NULL, NULL, NULL);
+		WJEWriteDocument(a, writer, NULL);
+
+		WJRCloseDocument(reader);
+		if (!WJWCloseDocument(writer)) r = __LINE__;
+	}
+
+	if (!r && (strcmp(sinks[0].data, first) || strcmp(sinks[1].data, second))) {
+		r = __LINE__;
+	}
+
+	WJRFreePool();
+	WJWFreePool();
+
+	WJECloseDocument(a);
+	WJECloseDocument(b);
+	return(r);
+}
+
+static int InternTest(WJElement doc)
+{
+	char		first[]		= "[{\"id\":1,\"status\":\"ok\"},{\"id\":2,\"status\":\"failed\"},"
+								"{\"id\":3,\"status\":\"ok\",\"note\":\"a value that is too long to share\"}]";
+	char		second[]	= "{\"id\":4,\"status\":\"ok\",\"note\":\"a value that is too long to share\"}";
+	WJESymbols	symbols;
+	WJReader	reader;
+	WJElement	a, b, e;
+	char		*json;
+	int			r		= 0;
+
+	/* A table of the document's own shares names but not values */
+	if (!(reader = WJROpenMemDocument(first, NULL, 0))) return(__LINE__);
+	a = WJEOpenDocumentInterned(reader, NULL, NULL, NULL, NULL);
+	WJRCloseDocument(reader);
+
+	if (!a || !(json = WJEToString(a, FALSE))) return(__LINE__);
+	if (strcmp(json, first)) r = __LINE__;
+	MemRelease(&json);
+
+	if (!r && (WJEGet(a, "[0].id", NULL)->name != WJEGet(a, "[2].id", NULL)->name ||
+		WJEGet(a, "[0].status", NULL)->name != WJEGet(a, "[1].status", NULL)->name ||
+		WJEString(a, "[0].status", WJE_GET, NULL) == WJEString(a, "[2].status", WJE_GET, NULL))
+	) {
+		r = __LINE__;
+	}
+
+	/* Names of elements that are added later are shared as well */
+	if (!r && (!(e = WJEObject(a, "[1].nested", WJE_NEW)) ||
+		WJEInt32(e, "id", WJE_NEW, 5) != 5 ||
+		WJEGet(e, "id", NULL)->name != WJEGet(a, "[0].id", NULL)->name)
+	) {
+		r = __LINE__;
+	}
+
+	/* A detached element keeps the table alive */
+	if (!r && (e = WJEGet(a, "[2]", NULL))) {
+		WJEDetach(e);
+		WJECloseDocument(a);
+		a = NULL;
+
+		if (strcmp(WJEString(e, "status", WJE_GET, ""), "ok") ||
+			!WJERename(WJEGet(e, "note", NULL), "comment") ||
+			!WJEGet(e, "comment", NULL) || !WJEGet(e, "id", NULL)
+		) {
+			r = __LINE__;
+		}
+		WJECloseDocument(e);
+	}
+	WJECloseDocument(a);
+
+	/* A shared table, which may be closed once the documents are loaded */
+	if (!r && !(symbols = WJEOpenSymbols(WJE_SYMBOLS_VALUES))) r = __LINE__;
+	if (!r) {
+		reader = WJROpenMemDocument(first, NULL, 0);
+		a = WJEOpenDocumentInterned(reader, NULL, NULL, NULL, symbols);
+		WJRCloseDocument(reader);
+
+		reader = WJROpenMemDocument(second, NULL, 0);
+		b = WJEOpenDocumentInterned(reader, NULL, NULL, NULL, symbols);
+		WJRCloseDocument(reader);
+
+		WJECloseSymbols(symbols);
+
+		if (!a || !b) {
+			r = __LINE__;
+		} else if (WJEGet(a, "[0].id", NULL)->name != WJEGet(b, "id", NULL)->name ||
+			WJEString(a, "[0].status", WJE_GET, NULL) != WJEString(b, "status", WJE_GET, NULL) ||
+			WJEString(a, "[0].status", WJE_GET, NULL) != WJEString(a, "[2].status", WJE_GET, NULL) ||
+			WJEString(a, "[2].note", WJE_GET, NULL) == WJEString(b, "note", WJE_GET, NULL) ||
+			strcmp(WJEString(a, "[2].note", WJE_GET, ""), WJEString(b, "note", WJE_GET, ""))
+		) {
+			r = __LINE__;
+		}
+
+		/* Setting a short value shares it too */
+		if (!r && (WJEString(b, "status", WJE_SET, "failed") != WJEString(a, "[1].status", WJE_GET, NULL) ||
+			strcmp(WJEString(a, "[0].status", WJE_GET, ""), "ok"))
+		) {
+			r = __LINE__;
+		}
+
+		WJECloseDocument(a);
+		WJECloseDocument(b);
+	}
+
+	return(r);
+}
+
+static int FreezeTest(WJElement doc)
+{
+	char		json[]		= "{\"name\":\"widget\",\"count\":3,\"price\":-2.5,\"active\":true,"
+								"\"tags\":[\"a\",\"b\",\"a\"],\"parts\":[{\"id\":1,\"name\":\"bolt\"},"
+								"{\"id\":2,\"name\":\"nut\"}],\"empty\":{},\"none\":null}";
+	WJReader	reader;
+	WJElement	frozen, e;
+	char		*out, *expected;
+	int			r			= 0;
+
+	/* A copy of an existing document */
+	if (!(frozen = WJEFreeze(doc))) return(__LINE__);
+	out			= WJEToString(frozen, TRUE);
+	expected	= WJEToString(doc, TRUE);
+
+	if (!out || !expected || strcmp(out, expected)) r = __LINE__;
+	MemRelease(&out);
+	MemRelease(&expected);
+	WJECloseDocument(frozen);
+	if (r) return(r);
+
+	if (!(reader = WJROpenMemDocument(json, NULL, 0))) return(__LINE__);
+	frozen = WJEOpenDocumentFrozen(reader, NULL, NULL, NULL);
+	WJRCloseDocument(reader);
+	if (!frozen) return(__LINE__);
+
+	/* Writing it and reading values with the typed getters leaves it frozen */
+	if (!(out = WJEToString(frozen, FALSE))) return(__LINE__);
+	if (strcmp(out, json)) r = __LINE__;
+	MemRelease(&out);
+
+	if (!r && (strcmp(WJEString(frozen, "name", WJE_GET, ""), "widget") ||
+		WJEInt32(frozen, "count", WJE_GET, 0) != 3 ||
+		WJEDouble(frozen, "price", WJE_GET, 0) != -2.5 ||
+		!WJEBool(frozen, "active", WJE_GET, FALSE) ||
+		strcmp(WJEString(frozen, "tags[1]", WJE_GET, ""), "b") ||
+		strcmp(WJEString(frozen, "parts[1].name", WJE_GET, ""), "nut") ||
+		WJEInt32(frozen, "parts[0].id", WJE_GET, 0) != 1 ||
+		WJEInt32(frozen, "parts[2].id", WJE_GET, -1) != -1 ||
+		WJEString(frozen, "missing", WJE_GET, NULL) ||
+		frozen->child || frozen->count)
+	) {
+		r = __LINE__;
+	}
+
+	/* Anything else materializes only what it needs */
+	if (!r && (!(e = WJEGet(frozen, "parts[0]", NULL)) ||
+		frozen->count != 8 || e->child ||
+		WJEInt32(e, "id", WJE_GET, 0) != 1 ||
+		strcmp(WJEString(frozen, "parts[].name == 'nut'", WJE_GET, ""), "nut"))
+	) {
+		r = __LINE__;
+	}
+
+	/* Once materialized it may be modified */
+	if (!r && (WJEInt32(frozen, "parts[0].id", WJE_SET, 7) != 7 ||
+		!WJEString(frozen, "tags[$]", WJE_NEW, "c") ||
+		!WJECloseDocument(WJEGet(frozen, "none", NULL)))
+	) {
+		r = __LINE__;
+	}
+
+	if (!r && (!(out = WJEToString(frozen, FALSE)) ||
+		strcmp(out, "{\"name\":\"widget\",\"count\":3,\"price\":-2.5,\"active\":true,"
+			"\"tags\":[\"a\",\"b\",\"a\",\"c\"],\"parts\":[{\"id\":7,\"name\":\"bolt\"},"
+			"{\"id\":2,\"name\":\"nut\"}],\"empty\":{}}"))
+	) {
+		r = __LINE__;
+	}
+	MemRelease(&out);
+
+	/* A detached element keeps the tape alive */
+	if (!r && (e = WJEGet(frozen, "parts[1]", NULL))) {
+		WJEDetach(e);
+		WJECloseDocument(frozen);
+		frozen = NULL;
+
+		if (strcmp(WJEString(e, "name", WJE_GET, ""), "nut")) r = __LINE__;
+		WJECloseDocument(e);
+	}
+	WJECloseDocument(frozen);
+
+	return(r);
+}
+
+static XplBool ShareCopyCB(WJElement destination, WJElement object, void *data, const char *file, const int line)
+{
+	return(TRUE);
+}
+
+static int ShareTest(WJElement doc)
+{
+	WJElement	base, a, b, e;
+	char		*x, *y;
+	int			r			= 0;
+
+	if (!(base = WJEFreeze(doc))) return(__LINE__);
+
+	/* Copies of a frozen document share it until they are changed */
+	a = WJECopyDocument(NULL, base, NULL, NULL);
+	b = WJECopyDocument(NULL, base, NULL, NULL);
+	if (!a || !b || a->child || b->child) r = __LINE__;
+
+	if (!r && (WJEInt32(a, "one", WJE_SET, 100) != 100 ||
+		!WJEString(a, "sender.address", WJE_SET, "changed") ||
+		WJEInt32(b, "digits[3]", WJE_SET, 30) != 30)
+	) {
+		r = __LINE__;
+	}
+
+	/* Only the path to each change was copied */
+	if (!r && (!(e = WJEGet(a, "digits", NULL)) || e->child ||
+		WJEInt32(base, "one", WJE_GET, 0) != 1 ||
+		WJEInt32(b, "one", WJE_GET, 0) != 1 ||
+		WJEInt32(a, "digits[3]", WJE_GET, 0) != 3 ||
+		WJEInt32(base, "digits[3]", WJE_GET, 0) != 3 ||
+		strcmp(WJEString(b, "sender.address", WJE_GET, ""),
+			WJEString(doc, "sender.address", WJE_GET, "")))
+	) {
+		r = __LINE__;
+	}
+
+	/* The copies remain valid after the original has been closed */
+	WJECloseDocument(base);
+	if (!r) {
+		WJEInt32(doc, "one", WJE_SET, 100);
+		WJEString(doc, "sender.address", WJE_SET, "changed");
+
+		x = WJEToString(a, FALSE);
+		y = WJEToString(doc, FALSE);
+		if (!x || !y || strcmp(x, y)) r = __LINE__;
+		MemRelease(&x);
+		MemRelease(&y);
+	}
+
+	/* A copy of a copy, and a copy with a callback, work as well */
+	if (!r) {
+		e = WJECopyDocument(NULL, b, NULL, NULL);
+		WJECloseDocument(b);
+		b = WJECopyDocument(NULL, e, ShareCopyCB, NULL);
+		WJECloseDocument(e);
+
+		if (!b || WJEInt32(b, "digits[3]", WJE_GET, 0) != 30 || !b->child) {
+			r = __LINE__;
+		}
+	}
+
+	WJECloseDocument(a);
+	WJECloseDocument(b);
+	return(r);
+}
+
+static int SnapshotClosed	= 0;
+
+static XplBool SnapshotFreeCB(WJElement document)
+{
+	SnapshotClosed++;
+	return(TRUE);
+}
+
+static int SnapshotTest(WJElement doc)
+{
+	WJESnapshot			snapshot;
+	WJESnapshotReader	a, b;
+	WJElement			first, second, copy;
+	int					r			= 0;
+
+	if (!(snapshot = WJEOpenSnapshot(WJECopyDocument(NULL, doc, NULL, NULL)))) return(__LINE__);
+	if (WJEOpenSnapshot(WJEGet(doc, "digits", NULL))) return(__LINE__);
+
+	a = WJEOpenSnapshotReader(snapshot);
+	b = WJEOpenSnapshotReader(snapshot);
+	if (!a || !b) return(__LINE__);
+
+	SnapshotClosed = 0;
+	if (!(first = WJEReadSnapshot(a)) || WJEReadSnapshot(b) != first ||
+		WJEInt32(first, "one", WJE_GET, 0) != 1
+	) {
+		r = __LINE__;
+	}
+	first->freecb = SnapshotFreeCB;
+
+	/* A new version is built from a copy of the current one */
+	if (!r && (!(copy = WJECopySnapshot(snapshot)) ||
+		WJEInt32(copy, "one", WJE_SET, 100) != 100 ||
+		!WJEPublishSnapshot(snapshot, copy))
+	) {
+		r = __LINE__;
+	}
+
+	/* Readers that are still using the old version may keep using it */
+	if (!r && (!(second = WJEReadSnapshot(b)) || second == first ||
+		WJEInt32(second, "one", WJE_GET, 0) != 100 ||
+		WJEInt32(first, "one", WJE_GET, 0) != 1 || SnapshotClosed)
+	) {
+		r = __LINE__;
+	}
+
+	/* It is closed once the last reader is done with it */
+	WJEReclaimSnapshot(snapshot);
+	if (!r && SnapshotClosed) r = __LINE__;
+
+	WJEReleaseSnapshot(a);
+	WJEReclaimSnapshot(snapshot);
+	if (!r && SnapshotClosed != 1) r = __LINE__;
+
+	if (!r && WJEReadSnapshot(a) != second) r = __LINE__;
+
+	WJECloseSnapshotReader(a);
+	WJECloseSnapshotReader(b);
+	WJECloseSnapshot(snapshot);
+
+	return(r);
+}
+
+/*
+	Return the number of elements below e, if each element has counted every
+	element below it as a change, or -1 if not.
+*/
+static int ChangesCounted(WJElement e)
+{
+	WJElement	c;
+	int			count	= 0;
+
+	for (c = e->child; c; c = c->next) {
+		if (ChangesCounted(c) < 0) return(-1);
+		count += 1 + c->changes;
+	}
+
+	return(e->changes == count ? count : -1);
+}
+
+static int ChangesTest(WJElement doc)
+{
+	WJEPushParser	parser;
+	WJReader		reader;
+	WJElement		loaded, parsed, pushed, copy, digits, built, e;
+	char			*json;
+	size_t			used;
+	int				changes, r		= 0;
+
+	if (!(json = WJEToString(doc, FALSE))) return(__LINE__);
+
+	/* However it is loaded, each element counts the elements below it */
+	reader = WJROpenMemDocument(json, NULL, 0);
+	loaded = WJEOpenDocument(reader, NULL, NULL, NULL);
+	WJRCloseDocument(reader);
+
+	parsed = WJEFromString(json);
+	copy = WJECopyDocument(NULL, doc, NULL, NULL);
+
+	if ((parser = WJEOpenPushParser(NULL, NULL)) &&
+		WJE_PUSH_DONE != WJEFeed(parser, json, strlen(json), 0, &used)
+	) {
+		r = __LINE__;
+	}
+	pushed = WJEClosePushParser(parser);
+
+	if (!r && (!loaded || !parsed || !copy || !pushed)) r = __LINE__;
+	if (!r && (changes = ChangesCounted(loaded)) <= 0) r = __LINE__;
+	if (!r && (ChangesCounted(parsed) != changes ||
+		ChangesCounted(copy) != changes || ChangesCounted(pushed) != changes)
+	) {
+		r = __LINE__;
+	}
+
+	/* A change is counted by the element and each of its ancestors */
+	if (!r && !(digits = WJEArray(copy, "digits", WJE_GET))) r = __LINE__;
+	if (!r) {
+		copy->changes	= 0;
+		digits->changes	= 0;
+
+		WJEInt32(copy, "digits[0]", WJE_SET, 10);
+		if (copy->changes != 1 || digits->changes != 1) r = __LINE__;
+	}
+
+	/* Copying into a document counts each copied element for every ancestor */
+	if (!r) {
+		WJECopyDocument(digits, WJEArray(doc, "digits", WJE_GET), NULL, NULL);
+		if (copy->changes != 11 || digits->changes != 11) r = __LINE__;
+	}
+
+	/* Nothing is counted while changes are suspended, which may be nested */
+	if (!r) {
+		WJESuspendChanges();
+		WJESuspendChanges();
+
+		built = WJEFromString(json);
+		WJEInt32(copy, "digits[0]", WJE_SET, 11);
+		if ((e = WJEGet(copy, "digits[1]", NULL))) {
+			WJEDetach(e);
+			WJECloseDocument(e);
+		}
+
+		WJEResumeChanges();
+		WJEInt32(copy, "digits[0]", WJE_SET, 12);
+
+		if (!built || built->changes || copy->changes != 11) r = __LINE__;
+		WJECloseDocument(built);
+
+		WJEResumeChanges();
+		WJEInt32(copy, "digits[0]", WJE_SET, 13);
+		if (!r && (copy->changes != 12 || digits->changes != 12)) r = __LINE__;
+	}
+
+	WJECloseDocument(loaded);
+	WJECloseDocument(parsed);
+	WJECloseDocument(pushed);
+	WJECloseDocument(copy);
+	MemRelease(&json);
+
+	return(r);
+}
+
 static int SchemaTest(WJElement doc)
 {
 	int			result			= 0;
@@ -777,6 +3046,31 @@ struct {
 	{ "realbigdoc",	RealBigDocTest	},
 	{ "realbigdoc2",LargeDoc2Test	},
 	{ "schema",		SchemaTest		},
+	{ "index",		IndexTest		},
+	{ "arena",		ArenaTest		},
+	{ "insitu",		InSituTest		},
+	{ "mapfile",		MapFileTest		},
+	{ "scan",			ScanTest		},
+	{ "numbers",		NumbersTest		},
+	{ "doubles",		DoublesTest		},
+	{ "integers",		IntegersTest	},
+	{ "escape",		EscapeTest		},
+	{ "selector",		SelectorTest	},
+	{ "tobuffer",		ToBufferTest	},
+	{ "tofile",		ToFileTest		},
+	{ "push",			PushTest		},
+	{ "stream",		StreamTest		},
+	{ "parallel",		ParallelTest	},
+	{ "parallelarray",	ParallelArrayTest	},
+	{ "projection",		ProjectionTest		},
+	{ "lazy",			LazyTest			},
+	{ "grow",			GrowTest			},
+	{ "reset",			ResetTest			},
+	{ "intern",			InternTest			},
+	{ "freeze",			FreezeTest			},
+	{ "share",			ShareTest			},
+	{ "snapshot",		SnapshotTest		},
+	{ "changes",		ChangesTest		},
 
 	/*
 		TODO: Write the following tests
@@ -25,11 +25,6 @@
 
 #include <wjreader.h>
 
-#if defined(_MSC_VER)
-#define strtoull(nptr, endptr, base) _strtoui64(nptr, endptr, base)
-#define strtoll(nptr, endptr, base) _strtoi64(nptr, endptr, base)
-#endif
-
 /*
 	JSON syntax (http://www.json.org/)
 	==================================
@@ -136,6 +131,9 @@
 	}
 */
 
+/* The default buffer size used by WJROpenPathDocument() */
+#define WJR_PATH_BUFFER_SIZE	(64 * 1024)
+
 #define HexDigit(c)				((c) <= '9' ? (c) - '0' : (toupper((c)) & 7) + 9)
 
 /*
@@ -151,7 +149,7 @@
 	avaliable because there is always at least one character between elements.
 */
 
-typedef struct {
+typedef struct WJIReader {
 	WJReaderPublic		pub;
 
 	/* Internal depth, may not match the depth in the public structure		*/
@@ -166,6 +164,9 @@ typedef struct {
 	/* Points to the end of a value that needs to be protected.				*/
 	char				*protect;
 
+	/* Is a name being read, which must fit in the buffer in one piece?		*/
+	XplBool				naming;
+
 	/* The current position to read from the buffer at.						*/
 	char				*read;
 
@@ -192,17 +193,521 @@ typedef struct {
 	WJReadCallback		callback;
 	int					seen;
 
+	/*
+		If set then the data source belongs to the reader, and this is called
+		by WJRCloseDocument() to release it rather than reading the rest of the
+		document.
+	*/
+	void				(* closecb)(void *userdata);
+
+	/*
+		Set if the reader came from WJROpenPooledDocument(), in which case it
+		is returned to the pool of the thread that closes it. next links the
+		readers in the pool.
+	*/
+	XplBool				pooled;
+	struct WJIReader	*next;
+
+	/*
+		The buffer that is in use, which starts out as the storage that follows
+		the structure, and is replaced by a larger block each time it grows.
+	*/
+	char				*buffer;
 	size_t				buffersize;
-	char				buffer[];
+
+	/*
+		Every block that has been allocated for the buffer, newest first. The
+		older blocks are kept until the document is closed, because the
+		consumer may still hold pointers into them.
+	*/
+	struct WJRBlock		*blocks;
+	size_t				storagesize;
+
+	char				storage[];
 } WJIReader;
 
+typedef struct WJRBlock {
+	struct WJRBlock		*next;
+	size_t				size;
+
+	char				data[];
+} WJRBlock;
+
 #ifdef DEBUG_ASSERT
 #define WJRDocAssert(d)	if ((d)->free) MemAssert((d));
 #else
 #define WJRDocAssert(d)
 #endif
 
+/*
+	Vectorised scanning
+
+	Most of the time spent reading a document goes to walking past whitespace
+	between tokens, and walking through the body of a string looking for the
+	closing quote. Both are done here 16 bytes at a time with SSE2, or 32 bytes
+	at a time with AVX2 when cpuid reports that the processor supports it, with
+	a plain byte at a time version for everything else.
+
+	Each scan looks at the bytes from p up to end, and returns a pointer to the
+	first byte that is interesting, or end if there are none. A scan never
+	reads at or past end, so end must be the write pointer of the buffer (which
+	is always terminated) and not an arbitrary limit.
+
+	Define WJR_NO_SIMD to build with only the byte at a time versions.
+*/
+#if !defined(WJR_NO_SIMD) && \
+	(defined(__x86_64__) || defined(_M_X64) || (defined(__i386__) && defined(__SSE2__)))
+# define WJR_SIMD_SSE2
+# include <emmintrin.h>
+
+# if defined(__GNUC__) || defined(__clang__)
+#  define WJR_SIMD_AVX2
+#  define WJR_TARGET_AVX2		__attribute__((target("avx2")))
+#  include <immintrin.h>
+# elif defined(_MSC_VER)
+#  define WJR_SIMD_AVX2
+#  define WJR_TARGET_AVX2
+#  include <immintrin.h>
+#  include <intrin.h>
+# endif
+#endif
+
+typedef const char * (* WJRScanFunc)(const char *p, const char *end);
+
+/* The same set of characters as isspace() in the "C" locale */
+#define WJRIsSpace(c)			((c) == ' ' || (unsigned char) ((c) - '\t') <= '\r' - '\t')
+
+/* The characters that end a run of plain characters in a string */
+#define WJRIsStringSpecial(c)	((c) == '"' || (c) == '\\' || (c) == '\0')
+
+/*
+	The characters that matter when skipping past an object or array, outside of
+	any strings. Setting 0x20 turns '[' into '{' and ']' into '}'.
+*/
+#define WJRIsSkipSpecial(c)		((c) == '"' || (c) == '#' || (c) == '\0' || \
+								((c) | 0x20) == '{' || ((c) | 0x20) == '}')
+
+static const char * WJRScanSpaceScalar(const char *p, const char *end)
+{
+	for (; p < end && WJRIsSpace(*p); p++);
+	return(p);
+}
+
+static const char * WJRScanStringScalar(const char *p, const char *end)
+{
+	for (; p < end && !WJRIsStringSpecial(*p); p++);
+	return(p);
+}
+
+static const char * WJRScanSkipScalar(const char *p, const char *end)
+{
+	for (; p < end && !WJRIsSkipSpecial(*p); p++);
+	return(p);
+}
+
+#ifdef WJR_SIMD_SSE2
+static __inline unsigned int WJRFirstBit(uint32 mask)
+{
+#if defined(_MSC_VER)
+	unsigned long	i;
+
+	_BitScanForward(&i, mask);
+	return((unsigned int) i);
+#else
+	return((unsigned int) __builtin_ctz(mask));
+#endif
+}
+
+static const char * WJRScanSpaceSSE2(const char *p, const char *end)
+{
+	const __m128i	space	= _mm_set1_epi8(' ');
+	const __m128i	tab		= _mm_set1_epi8('\t');
+	const __m128i	range	= _mm_set1_epi8('\r' - '\t');
+	__m128i			c, s;
+	uint32			mask;
+
+	while (end - p >= 16) {
+		c = _mm_loadu_si128((const __m128i *) p);
+
+		/* '\t' through '\r' are the only characters where c - '\t' <= 4 */
+		s = _mm_sub_epi8(c, tab);
+		s = _mm_cmpeq_epi8(_mm_min_epu8(s, range), s);
+		s = _mm_or_si128(s, _mm_cmpeq_epi8(c, space));
+
+		if ((mask = ~((uint32) _mm_movemask_epi8(s)) & 0xFFFF)) {
+			return(p + WJRFirstBit(mask));
+		}
+		p += 16;
+	}
+
+	return(WJRScanSpaceScalar(p, end));
+}
+
+static const char * WJRScanStringSSE2(const char *p, const char *end)
+{
+	const __m128i	quote	= _mm_set1_epi8('"');
+	const __m128i	slash	= _mm_set1_epi8('\\');
+	const __m128i	zero	= _mm_setzero_si128();
+	__m128i			c, s;
+	uint32			mask;
+
+	while (end - p >= 16) {
+		c = _mm_loadu_si128((const __m128i *) p);
+
+		s = _mm_or_si128(_mm_cmpeq_epi8(c, quote), _mm_cmpeq_epi8(c, slash));
+		s = _mm_or_si128(s, _mm_cmpeq_epi8(c, zero));
+
+		if ((mask = (uint32) _mm_movemask_epi8(s))) {
+			return(p + WJRFirstBit(mask));
+		}
+		p += 16;
+	}
+
+	return(WJRScanStringScalar(p, end));
+}
+
+static const char * WJRScanSkipSSE2(const char *p, const char *end)
+{
+	const __m128i	quote	= _mm_set1_epi8('"');
+	const __m128i	hash	= _mm_set1_epi8('#');
+	const __m128i	zero	= _mm_setzero_si128();
+	const __m128i	lower	= _mm_set1_epi8(0x20);
+	const __m128i	open	= _mm_set1_epi8('{');
+	const __m128i	close	= _mm_set1_epi8('}');
+	__m128i			c, l, s;
+	uint32			mask;
+
+	while (end - p >= 16) {
+		c = _mm_loadu_si128((const __m128i *) p);
+		l = _mm_or_si128(c, lower);
+
+		s = _mm_or_si128(_mm_cmpeq_epi8(c, quote), _mm_cmpeq_epi8(c, hash));
+		s = _mm_or_si128(s, _mm_cmpeq_epi8(c, zero));
+		s = _mm_or_si128(s, _mm_cmpeq_epi8(l, open));
+		s = _mm_or_si128(s, _mm_cmpeq_epi8(l, close));
+
+		if ((mask = (uint32) _mm_movemask_epi8(s))) {
+			return(p + WJRFirstBit(mask));
+		}
+		p += 16;
+	}
+
+	return(WJRScanSkipScalar(p, end));
+}
+#endif /* WJR_SIMD_SSE2 */
+
+#ifdef WJR_SIMD_AVX2
+WJR_TARGET_AVX2 static const char * WJRScanSpaceAVX2(const char *p, const char *end)
+{
+	const __m256i	space	= _mm256_set1_epi8(' ');
+	const __m256i	tab		= _mm256_set1_epi8('\t');
+	const __m256i	range	= _mm256_set1_epi8('\r' - '\t');
+	__m256i			c, s;
+	uint32			mask;
+
+	while (end - p >= 32) {
+		c = _mm256_loadu_si256((const __m256i *) p);
+
+		s = _mm256_sub_epi8(c, tab);
+		s = _mm256_cmpeq_epi8(_mm256_min_epu8(s, range), s);
+		s = _mm256_or_si256(s, _mm256_cmpeq_epi8(c, space));
+
+		if ((mask = ~((uint32) _mm256_movemask_epi8(s)))) {
+			return(p + WJRFirstBit(mask));
+		}
+		p += 32;
+	}
+
+	return(WJRScanSpaceSSE2(p, end));
+}
+
+WJR_TARGET_AVX2 static const char * WJRScanStringAVX2(const char *p, const char *end)
+{
+	const __m256i	quote	= _mm256_set1_epi8('"');
+	const __m256i	slash	= _mm256_set1_epi8('\\');
+	const __m256i	zero	= _mm256_setzero_si256();
+	__m256i			c, s;
+	uint32			mask;
+
+	while (end - p >= 32) {
+		c = _mm256_loadu_si256((const __m256i *) p);
+
+		s = _mm256_or_si256(_mm256_cmpeq_epi8(c, quote), _mm256_cmpeq_epi8(c, slash));
+		s = _mm256_or_si256(s, _mm256_cmpeq_epi8(c, zero));
+
+		if ((mask = (uint32) _mm256_movemask_epi8(s))) {
+			return(p + WJRFirstBit(mask));
+		}
+		p += 32;
+	}
+
+	return(WJRScanStringSSE2(p, end));
+}
+
+WJR_TARGET_AVX2 static const char * WJRScanSkipAVX2(const char *p, const char *end)
+{
+	const __m256i	quote	= _mm256_set1_epi8('"');
+	const __m256i	hash	= _mm256_set1_epi8('#');
+	const __m256i	zero	= _mm256_setzero_si256();
+	const __m256i	lower	= _mm256_set1_epi8(0x20);
+	const __m256i	open	= _mm256_set1_epi8('{');
+	const __m256i	close	= _mm256_set1_epi8('}');
+	__m256i			c, l, s;
+	uint32			mask;
+
+	while (end - p >= 32) {
+		c = _mm256_loadu_si256((const __m256i *) p);
+		l = _mm256_or_si256(c, lower);
+
+		s = _mm256_or_si256(_mm256_cmpeq_epi8(c, quote), _mm256_cmpeq_epi8(c, hash));
+		s = _mm256_or_si256(s, _mm256_cmpeq_epi8(c, zero));
+		s = _mm256_or_si256(s, _mm256_cmpeq_epi8(l, open));
+		s = _mm256_or_si256(s, _mm256_cmpeq_epi8(l, close));
+
+		if ((mask = (uint32) _mm256_movemask_epi8(s))) {
+			return(p + WJRFirstBit(mask));
+		}
+		p += 32;
+	}
+
+	return(WJRScanSkipSSE2(p, end));
+}
+
+static XplBool WJRHasAVX2(void)
+{
+#if defined(_MSC_VER)
+	int				info[4];
+
+	__cpuid(info, 0);
+	if (info[0] < 7) {
+		return(FALSE);
+	}
+
+	/* The OS must also have enabled saving the AVX registers */
+	__cpuid(info, 1);
+	if (!(info[2] & (1 << 27)) || !(info[2] & (1 << 28)) || (_xgetbv(0) & 6) != 6) {
+		return(FALSE);
+	}
+
+	__cpuidex(info, 7, 0);
+	return((info[1] & (1 << 5)) ? TRUE : FALSE);
+#else
+	__builtin_cpu_init();
+	return(__builtin_cpu_supports("avx2") ? TRUE : FALSE);
+#endif
+}
+#endif /* WJR_SIMD_AVX2 */
+
+static const char * WJRScanSpaceFirst(const char *p, const char *end);
+static const char * WJRScanStringFirst(const char *p, const char *end);
+static const char * WJRScanSkipFirst(const char *p, const char *end);
+
+static WJRScanFunc WJRScanSpaceFunc		= WJRScanSpaceFirst;
+static WJRScanFunc WJRScanStringFunc	= WJRScanStringFirst;
+static WJRScanFunc WJRScanSkipFunc		= WJRScanSkipFirst;
+
+/*
+	Pick the best versions of the scans the first time that one is used. If
+	more than one thread gets here at once they will all store the same values.
+*/
+static void WJRScanSelect(void)
+{
+	WJRScanFunc		space	= WJRScanSpaceScalar;
+	WJRScanFunc		string	= WJRScanStringScalar;
+	WJRScanFunc		skip	= WJRScanSkipScalar;
+
+#ifdef WJR_SIMD_SSE2
+	space	= WJRScanSpaceSSE2;
+	string	= WJRScanStringSSE2;
+	skip	= WJRScanSkipSSE2;
+#endif
+#ifdef WJR_SIMD_AVX2
+	if (WJRHasAVX2()) {
+		space	= WJRScanSpaceAVX2;
+		string	= WJRScanStringAVX2;
+		skip	= WJRScanSkipAVX2;
+	}
+#endif
+
+	WJRScanSpaceFunc	= space;
+	WJRScanStringFunc	= string;
+	WJRScanSkipFunc		= skip;
+}
+
+static const char * WJRScanSpaceFirst(const char *p, const char *end)
+{
+	WJRScanSelect();
+	return(WJRScanSpaceFunc(p, end));
+}
+
+static const char * WJRScanStringFirst(const char *p, const char *end)
+{
+	WJRScanSelect();
+	return(WJRScanStringFunc(p, end));
+}
+
+static const char * WJRScanSkipFirst(const char *p, const char *end)
+{
+	WJRScanSelect();
+	return(WJRScanSkipFunc(p, end));
+}
+
+/*
+	Skip any whitespace at the read pointer. There is very often none at all,
+	or just one character, so check for that before doing a full scan.
+*/
+static __inline void WJRSkipSpace(WJIReader *doc)
+{
+	if (doc->read < doc->write && WJRIsSpace(*doc->read)) {
+		doc->read = (char *) WJRScanSpaceFunc(doc->read + 1, doc->write);
+	}
+}
+
+/*
+	Skip anything between the end of a string and the delimiter that follows it.
+	At the top level of a stream the next value may follow straight away, so
+	nothing is skipped there.
+*/
+static __inline void WJRSkipToDelimiter(WJIReader *doc)
+{
+	if (doc->pub.stream && doc->depth <= 1) {
+		return;
+	}
+
+	for (; doc->read < doc->write && *doc->read && *doc->read != ':' && *doc->read != ',' && *doc->read != ']' && *doc->read != '}'; doc->read++);
+}
+
+/*
+	Return TRUE if all of the characters of the escape sequence that starts with
+	the character at p are in the buffer. This is at most 11 characters (for a
+	\u surrogate pair) so it isn't worth finding the length of the rest of the
+	buffer.
+*/
+static XplBool WJREscapeAvailable(const char *p)
+{
+	size_t			needed;
+	size_t			i;
+	unsigned int	c;
+
+	switch (toupper(*p)) {
+		case 'U':	needed = 5;	break;
+		case 'X':	needed = 3;	break;
+		default:	needed = 1;	break;
+	}
+
+	for (i = 0; i < needed; i++) {
+		if (!p[i]) {
+			return(FALSE);
+		}
+	}
+
+	if (needed == 5) {
+		c = (HexDigit(p[1]) << 12) + (HexDigit(p[2]) << 8) +
+			(HexDigit(p[3]) << 4) + (HexDigit(p[4]));
+
+		/*
+			A high surrogate should be followed by a low surrogate, which must be
+			in the buffer as well or the pair would be split.
+		*/
+		if (c >= 0xD800 && c <= 0xDBFF && (!p[5] ||
+			(p[5] == '\\' && (!p[6] || toupper(p[6]) == 'U')))
+		) {
+			for (i = 5; i < 11; i++) {
+				if (!p[i]) {
+					return(FALSE);
+				}
+			}
+		}
+	}
+
+	return(TRUE);
+}
+
+/*
+	Return the offset from the read pointer of the first character at or after
+	offset i that may end a run of plain characters in a string.
+*/
+static __inline size_t WJRScanString(WJIReader *doc, size_t i)
+{
+	char		*p = doc->read + i;
+
+	if (p >= doc->write || WJRIsStringSpecial(*p)) {
+		return(i);
+	}
+
+	return(WJRScanStringFunc(p + 1, doc->write) - doc->read);
+}
+
+
+
+
+/*
+	Replace the buffer with one that is twice the size, up to maxbuffersize. The
+	type list and the buffered data keep the same offsets in the new buffer.
+*/
+static XplBool WJRGrow(WJIReader *doc)
+{
+	WJRBlock	*block;
+	size_t		size;
+
+	if (doc->buffersize >= doc->pub.maxbuffersize) {
+		return(FALSE);
+	}
+
+	size = doc->buffersize * 2;
+	if (size < doc->buffersize || size > doc->pub.maxbuffersize) {
+		size = doc->pub.maxbuffersize;
+	}
+
+	if (!(block = MemMalloc(sizeof(WJRBlock) + size + 1))) {
+		return(FALSE);
+	}
+
+	block->next	= doc->blocks;
+	block->size	= size;
+	doc->blocks	= block;
+
+	memcpy(block->data, doc->buffer, doc->write - doc->buffer + 1);
+
+	doc->read		= block->data + (doc->read - doc->buffer);
+	doc->write		= block->data + (doc->write - doc->buffer);
+	if (doc->current) {
+		doc->current = block->data + (doc->current - doc->buffer);
+	}
+	if (doc->protect) {
+		doc->protect = block->data + (doc->protect - doc->buffer);
+	}
+
+	doc->buffer		= block->data;
+	doc->buffersize	= size;
+
+	return(TRUE);
+}
+
+/*
+	Return the position in the current buffer of a pointer that the consumer
+	was given before the buffer grew.
+*/
+static char * WJRRebase(WJIReader *doc, char *p)
+{
+	WJRBlock	*block;
+
+	if (!doc->blocks || (p >= doc->buffer && p <= doc->buffer + doc->buffersize)) {
+		return(p);
+	}
+
+	if (p >= doc->storage && p <= doc->storage + doc->storagesize) {
+		return(doc->buffer + (p - doc->storage));
+	}
+
+	for (block = doc->blocks->next; block; block = block->next) {
+		if (p >= block->data && p <= block->data + block->size) {
+			return(doc->buffer + (p - block->data));
+		}
+	}
 
+	return(p);
+}
 
 /*
 	Fill the buffer as much as possible.  The type list that is currently in use
@@ -219,6 +724,7 @@ static int WJRFillBuffer(WJIReader *doc)
 		*/
 		char	*r;
 		int		depth;
+		size_t	keep;
 
 		if (doc->depth > 0) {
 			depth = doc->depth;
@@ -244,6 +750,9 @@ static int WJRFillBuffer(WJIReader *doc)
 			r = doc->current + doc->pub.maxdepth - depth + 1;
 		}
 
+		/* The type list and names that have to be kept */
+		keep = r - doc->buffer;
+
 		if (r < doc->read) {
 			doc->write = doc->read + strlen(doc->read);
 			WJRDocAssert(doc);
@@ -256,6 +765,20 @@ static int WJRFillBuffer(WJIReader *doc)
 			r = doc->read;
 		}
 
+		if (doc->pub.maxbuffersize && (keep > doc->buffersize / 2 || (doc->naming &&
+			(size_t) (doc->write - doc->buffer) > doc->buffersize / 2)) && WJRGrow(doc)
+		) {
+			/*
+				Grow before the buffer fills, so that the names and the name
+				being read are never more than half of it. Every byte that is
+				moved down is then matched by at least as many new bytes.
+
+				A string value is returned in pieces instead, so it never needs
+				to fit.
+			*/
+			r = doc->read;
+		}
+
 		if (doc->write < doc->buffer + doc->buffersize && r < doc->buffer + doc->buffersize) {
 			/* Fill the rest of the buffer */
 			if (doc->write < doc->buffer + doc->buffersize) {
@@ -312,7 +835,7 @@ static int WJRDown(WJIReader *doc)
 
 	for (;;) {
 		do {
-			for (; doc->read < doc->write && isspace(*doc->read); doc->read++);
+			WJRSkipSpace(doc);
 		} while ((doc->read >= doc->write || *doc->read == '\0') && WJRFillBuffer(doc) > 0);
 
 		switch (*doc->read) {
@@ -412,6 +935,102 @@ static int WJRDown(WJIReader *doc)
 	return(0);
 }
 
+/*
+	Prepare the buffer to read a new document with the given callback. This is
+	used by _WJROpenDocument(), and by WJRResetDocument() to start over with a
+	reader that has already been used.
+*/
+static void WJRInitDocument(WJIReader *doc, WJReadCallback callback, void *userdata)
+{
+	doc->pub.depth				= 0;
+	doc->pub.userdata			= userdata;
+
+	doc->depth					= 0;
+	doc->naming					= FALSE;
+	doc->negative				= FALSE;
+	doc->punchout				= '\0';
+	doc->callback				= callback;
+	doc->seen					= 0;
+	doc->closecb				= NULL;
+
+	memset(doc->buffer, 0, doc->pub.maxdepth + 1);
+
+	doc->current				= doc->buffer;
+	doc->protect				= NULL;
+
+	/*
+		Add a psudeo container on the stack that we never return, as a place
+		holder.  The type must be ARRAY because the values in the document will
+		not have a name.	Preceeding the value with a comma will allow finding a
+		value just as if we where already in the middle of the document.
+	*/
+	doc->current[0]				= WJR_TYPE_ARRAY;
+	doc->current[1]				= '\0';
+
+	doc->read					= doc->buffer + doc->pub.maxdepth + 1;
+	doc->write					= doc->buffer + doc->pub.maxdepth + 2;
+
+	*doc->read					= ',';
+	*doc->write					= '\0';
+
+	WJRFillBuffer(doc);
+}
+
+/*
+	Finish with the current document, as WJRCloseDocument() does, but without
+	freeing the reader. The buffer is left as it is.
+*/
+static void WJRFinishDocument(WJIReader *doc)
+{
+	size_t		c;
+
+	/*
+		Read the remaining data from the document.	This is very important
+		when dealing with a network stream where we will get out of sync
+		with the client if the entire document is not read.
+	*/
+	WJRDocAssert(doc);
+	if (doc->closecb) {
+		doc->closecb(doc->pub.userdata);
+		doc->closecb = NULL;
+		doc->callback = NULL;
+	}
+
+	while (doc->callback &&
+		(c = doc->callback(doc->buffer, doc->buffersize, doc->seen, doc->pub.userdata)) &&
+		c > 0
+	) {
+		doc->seen += c;
+		WJRDocAssert(doc);
+	}
+	doc->callback = NULL;
+}
+
+/* Free the blocks the buffer grew into, keeping the newest one if asked to */
+static void WJRFreeBlocks(WJIReader *doc, XplBool keepnewest)
+{
+	WJRBlock	*block;
+	WJRBlock	*newest	= NULL;
+
+	if (keepnewest && (newest = doc->blocks)) {
+		doc->blocks = newest->next;
+		newest->next = NULL;
+	}
+
+	while ((block = doc->blocks)) {
+		doc->blocks = block->next;
+		MemFree(block);
+	}
+
+	if ((doc->blocks = newest)) {
+		doc->buffer		= newest->data;
+		doc->buffersize	= newest->size;
+	} else {
+		doc->buffer		= doc->storage;
+		doc->buffersize	= doc->storagesize;
+	}
+}
+
 EXPORT WJReader _WJROpenDocument(WJReadCallback callback, void *userdata, char *buffer, size_t buffersize, uint32 maxdepth)
 {
 	WJIReader	*doc	= NULL;
@@ -430,77 +1049,121 @@ EXPORT WJReader _WJROpenDocument(WJReadCallback callback, void *userdata, char *
 				buffersize = (sizeof(WJIReader) + 512);
 			}
 
-			doc = MemMallocEx(NULL, buffersize, &buffersize, TRUE, FALSE);
-		} else {
-			doc = (WJIReader *)buffer;
+			doc = MemMallocEx(NULL, buffersize, &buffersize, TRUE, FALSE);
+		} else {
+			doc = (WJIReader *)buffer;
+		}
+
+		if (doc) {
+			memset(doc, 0, sizeof(WJIReader));
+
+			doc->buffer					= doc->storage;
+			doc->buffersize				= buffersize - sizeof(WJIReader) - 1;
+			doc->storagesize			= doc->buffersize;
+			doc->free					= buffer ? FALSE : TRUE;
+			doc->pub.maxdepth			= maxdepth;
+
+			WJRInitDocument(doc, callback, userdata);
 		}
+	}
 
-		if (doc) {
-			memset(doc, 0, sizeof(WJIReader) + maxdepth);
+	return((WJReader) doc);
+}
 
-			doc->buffersize				= buffersize - sizeof(WJIReader) - 1;
-			doc->callback				= callback;
-			doc->pub.userdata			= userdata;
+EXPORT XplBool WJRResetDocument(WJReader indoc, WJReadCallback callback, void *userdata)
+{
+	WJIReader	*doc = (WJIReader *)indoc;
+
+	if (!doc || !callback) {
+		return(FALSE);
+	}
 
-			doc->current				= doc->buffer;
-			doc->protect				= NULL;
+	WJRFinishDocument(doc);
 
-			doc->free					= buffer ? FALSE : TRUE;
+	/*
+		Nothing from the previous document can be in use anymore, so only the
+		largest buffer is worth keeping.
+	*/
+	WJRFreeBlocks(doc, TRUE);
 
-			/* Leave one character for the type stack */
-			doc->read					= doc->buffer + 1;
-			doc->write					= doc->buffer + 1;
+	WJRInitDocument(doc, callback, userdata);
+	return(TRUE);
+}
 
-			*doc->read					= '\0';
+/*
+	Pooled Readers
 
-			/*
-				Add a psudeo container on the stack that we never return, as a
-				place holder.  The type must be ARRAY because the values in the
-				document will not have a name.	Preceeding the value with a
-				comma will allow finding a value just as if we where already in
-				the middle of the document.
-			*/
-			doc->current[0]				= WJR_TYPE_ARRAY;
-			doc->current[1]				= '\0';
+	Each thread keeps a short list of readers that have been closed, so that
+	they can be handed out again by WJROpenPooledDocument() without allocating.
+*/
+#ifndef WJR_POOL_SIZE
+#define WJR_POOL_SIZE			8
+#endif
 
-			doc->pub.maxdepth			= maxdepth;
-			doc->read					= doc->buffer + doc->pub.maxdepth + 1;
-			doc->write					= doc->buffer + doc->pub.maxdepth + 2;
+#if defined(_MSC_VER)
+#define WJR_THREAD_LOCAL		__declspec(thread)
+#else
+#define WJR_THREAD_LOCAL		__thread
+#endif
 
-			*doc->read					= ',';
-			*doc->write					= '\0';
+static WJR_THREAD_LOCAL WJIReader	*WJRPool		= NULL;
+static WJR_THREAD_LOCAL int			WJRPoolCount	= 0;
 
-			WJRFillBuffer(doc);
+EXPORT WJReader WJROpenPooledDocument(WJReadCallback callback, void *userdata)
+{
+	WJIReader	*doc;
+
+	if (!callback) {
+		return(NULL);
+	}
+
+	if (!(doc = WJRPool)) {
+		if ((doc = (WJIReader *) WJROpenDocument(callback, userdata, NULL, 0))) {
+			doc->pooled = TRUE;
 		}
+
+		return((WJReader) doc);
 	}
 
+	WJRPool = doc->next;
+	WJRPoolCount--;
+
+	doc->next					= NULL;
+	doc->pub.maxdepth			= 250;
+	doc->pub.stream				= FALSE;
+	doc->pub.maxbuffersize		= 0;
+
+	WJRInitDocument(doc, callback, userdata);
 	return((WJReader) doc);
 }
 
+EXPORT void WJRFreePool(void)
+{
+	WJIReader	*doc;
+
+	while ((doc = WJRPool)) {
+		WJRPool = doc->next;
+		MemFree(doc);
+	}
+	WJRPoolCount = 0;
+}
+
 EXPORT XplBool WJRCloseDocument(WJReader indoc)
 {
 	WJIReader	*doc = (WJIReader *)indoc;
-	size_t		c;
 
 	if (!doc) {
 		return(FALSE);
 	}
 
-	/*
-		Read the remaining data from the document.	This is very important
-		when dealing with a network stream where we will get out of sync
-		with the client if the entire document is not read.
-	*/
-	WJRDocAssert(doc);
-	while (doc->callback &&
-		(c = doc->callback(doc->buffer, doc->buffersize, doc->seen, doc->pub.userdata)) &&
-		c > 0
-	) {
-		doc->seen += c;
-		WJRDocAssert(doc);
-	}
+	WJRFinishDocument(doc);
+	WJRFreeBlocks(doc, FALSE);
 
-	if (doc->free) {
+	if (doc->pooled && WJRPoolCount < WJR_POOL_SIZE) {
+		doc->next = WJRPool;
+		WJRPool = doc;
+		WJRPoolCount++;
+	} else if (doc->free) {
 		MemFree(doc);
 	}
 	return(TRUE);
@@ -588,6 +1251,100 @@ EXPORT size_t WJRMemCallback(char *buffer, size_t length, size_t seen, void *use
 	return(len);
 }
 
+typedef struct {
+	XplFileMap		map;
+	FILE			*file;
+
+	/* The number of bytes skipped at the start of the file, for a BOM */
+	size_t			skipped;
+} WJRPathSource;
+
+static size_t WJRMapCallback(char *buffer, size_t length, size_t seen, void *userdata)
+{
+	WJRPathSource	*source = (WJRPathSource *) userdata;
+	char			*data;
+
+	if (!source) {
+		return(0);
+	}
+
+	if (seen == 0 && source->map.length >= 3 && source->map.data[0] == (char) 0xEF &&
+		source->map.data[1] == (char) 0xBB && source->map.data[2] == (char) 0xBF
+	) {
+		/* Ignore the BOM, as WJRFileCallback() does */
+		source->skipped = 3;
+	}
+
+	seen += source->skipped;
+	if (seen >= source->map.length) {
+		return(0);
+	}
+
+	data = source->map.data + seen;
+	if (length > source->map.length - seen) {
+		length = source->map.length - seen;
+	}
+
+	memcpy(buffer, data, length);
+	return(length);
+}
+
+static size_t WJRPathCallback(char *buffer, size_t length, size_t seen, void *userdata)
+{
+	WJRPathSource	*source = (WJRPathSource *) userdata;
+
+	return(source ? WJRFileCallback(buffer, length, seen, source->file) : 0);
+}
+
+static void WJRPathClose(void *userdata)
+{
+	WJRPathSource	*source = (WJRPathSource *) userdata;
+
+	if (source) {
+		if (source->file) {
+			fclose(source->file);
+		}
+
+		XplFileMapClose(&source->map);
+		MemFree(source);
+	}
+}
+
+EXPORT WJReader _WJROpenPathDocument(const char *path, char *buffer, size_t buffersize, uint32 maxdepth)
+{
+	WJRPathSource	*source;
+	WJIReader		*doc;
+
+	if (!path || !(source = MemMalloc(sizeof(WJRPathSource)))) {
+		return(NULL);
+	}
+	memset(source, 0, sizeof(WJRPathSource));
+
+	if (!buffer && !buffersize) {
+		/*
+			There is no point in using a tiny buffer when the data is already
+			in memory, since the unread portion is moved on each fill.
+		*/
+		buffersize = WJR_PATH_BUFFER_SIZE;
+	}
+
+	if (XplFileMapOpenPath(&source->map, path)) {
+		doc = (WJIReader *) _WJROpenDocument(WJRMapCallback, source, buffer, buffersize, maxdepth);
+	} else if ((source->file = fopen(path, "rb"))) {
+		doc = (WJIReader *) _WJROpenDocument(WJRPathCallback, source, buffer, buffersize, maxdepth);
+	} else {
+		doc = NULL;
+	}
+
+	if (!doc) {
+		WJRPathClose(source);
+		return(NULL);
+	}
+
+	doc->closecb = WJRPathClose;
+	return((WJReader) doc);
+}
+
 /*
 	Move current back up one level
 
@@ -646,6 +1403,11 @@ static XplBool WJRSkipString(WJReader indoc)
 		}
 
 		for (i = 0; ; i++) {
+			if (!skip) {
+				/* Skip ahead to the next character that needs attention */
+				i = (signed int) WJRScanString(doc, i);
+			}
+
 			if (doc->read[i] == '\0') {
 				/*
 					Since none of this data is needed, we can move
@@ -717,7 +1479,7 @@ static XplBool WJRSkipString(WJReader indoc)
 					doc->read += i + 1;
 					WJRDocAssert(doc);
 
-					for (; doc->read < doc->write && *doc->read && *doc->read != ':' && *doc->read != ',' && *doc->read != ']' && *doc->read != '}'; doc->read++);
+					WJRSkipToDelimiter(doc);
 
 					/*
 						This element is complete.  Walk back up the stack one
@@ -745,14 +1507,20 @@ static XplBool WJRSkipString(WJReader indoc)
 EXPORT char * WJRNext(char *parent, size_t maxnamelen, WJReader indoc)
 {
 	WJIReader	*doc	= (WJIReader *)indoc;
-	char		*child;
+	size_t		offset, child;
 
 	if (!parent) {
 		parent = doc->buffer;
+	} else {
+		parent = WJRRebase(doc, parent);
 	}
 
-	/* The position that a direct child of parent will be at */
-	child = parent + strlen(parent) + 1;
+	/*
+		The offsets of parent and of the position that a direct child of parent
+		will be at, which stay the same if the buffer grows.
+	*/
+	offset	= parent - doc->buffer;
+	child	= offset + strlen(parent) + 1;
 
 	if (doc) {
 		while (doc->current) {
@@ -764,7 +1532,7 @@ EXPORT char * WJRNext(char *parent, size_t maxnamelen, WJReader indoc)
 			}
 
 			do {
-				for (; doc->read < doc->write && isspace(*doc->read); doc->read++);
+				WJRSkipSpace(doc);
 			} while ((doc->read >= doc->write || *doc->read == '\0') && WJRFillBuffer(doc) > 0);
 
 			switch (*doc->current) {
@@ -799,8 +1567,17 @@ EXPORT char * WJRNext(char *parent, size_t maxnamelen, WJReader indoc)
 				case WJR_TYPE_ARRAY: {
 					char		*current = doc->current;
 
-					if (*doc->read == ',') {
-						doc->read++;
+					if (*doc->read == ',' || (doc->pub.stream &&
+						current == doc->buffer && doc->read < doc->write &&
+						*doc->read && *doc->read != ']' && *doc->read != '}')
+					) {
+						/*
+							In a stream the top level values don't need to be
+							separated by a comma, so act as if there was one.
+						*/
+						if (*doc->read == ',') {
+							doc->read++;
+						}
 
 						/*
 							Insert an item on the stack for the next value.
@@ -838,7 +1615,7 @@ EXPORT char * WJRNext(char *parent, size_t maxnamelen, WJReader indoc)
 								Read off the string, and store it as a name for
 								the real value which is to follow.
 							*/
-							if (child == doc->current) {
+							if (doc->current == doc->buffer + child) {
 								/*
 									Rather than finding a value, a name for the
 									value has been found (which is the exact
@@ -856,14 +1633,26 @@ EXPORT char * WJRNext(char *parent, size_t maxnamelen, WJReader indoc)
 								XplBool		complete	= FALSE;
 								size_t		length		= 0;
 
-								if ((name = WJRStringEx(&complete, &length, indoc))) {
+								doc->naming = TRUE;
+								name = WJRStringEx(&complete, &length, indoc);
+								doc->naming = FALSE;
+
+								if (name) {
 									char		*to;
 
 									/*
 										Cut off any portion of the string that
-										isn't needed
+										isn't needed. A name that didn't fit is
+										cut to half of the buffer, to leave room
+										to read past the rest of it.
 									*/
-									name[xpl_min(maxnamelen, length)] = '\0';
+									if (!complete && length > doc->buffersize / 2) {
+										length = doc->buffersize / 2;
+									}
+									if (length > maxnamelen) {
+										length = maxnamelen;
+									}
+									name[length] = '\0';
 
 									/*
 										Determine where the name needs to go.
@@ -902,7 +1691,7 @@ EXPORT char * WJRNext(char *parent, size_t maxnamelen, WJReader indoc)
 							while (!WJRSkipString(indoc));
 
 							while ((doc->read >= doc->write || *doc->read == '\0') && WJRFillBuffer(doc) > 0) {
-								for (; doc->read < doc->write && isspace(*doc->read); doc->read++);
+								WJRSkipSpace(doc);
 							}
 
 							if (*doc->read == ':') {
@@ -923,7 +1712,7 @@ EXPORT char * WJRNext(char *parent, size_t maxnamelen, WJReader indoc)
 								/* Turn off protection, if it was on */
 								doc->protect = NULL;
 
-								if (child == doc->current) {
+								if (doc->current == doc->buffer + child) {
 									return(doc->current);
 								}
 							}
@@ -938,7 +1727,7 @@ EXPORT char * WJRNext(char *parent, size_t maxnamelen, WJReader indoc)
 								doc->current = NULL;
 							}
 						} else if (*current == WJR_TYPE_ARRAY) {
-							if (child == doc->current) {
+							if (doc->current == doc->buffer + child) {
 								return(doc->current);
 							}
 						}
@@ -982,7 +1771,7 @@ EXPORT char * WJRNext(char *parent, size_t maxnamelen, WJReader indoc)
 							had trailing garbage.
 						*/
 						do {
-							for (; doc->read < doc->write && isspace(*doc->read); doc->read++);
+							WJRSkipSpace(doc);
 						} while ((doc->read >= doc->write || *doc->read == '\0') && WJRFillBuffer(doc) > 0);
 
 						if (*doc->read && doc->read < doc->write) {
@@ -990,7 +1779,7 @@ EXPORT char * WJRNext(char *parent, size_t maxnamelen, WJReader indoc)
 						}
 					}
 
-					if (doc->current < parent) {
+					if (doc->current < doc->buffer + offset) {
 						/*
 							We are back to the parent object, or have past it.
 							This implies that we are done with it's children.
@@ -1008,6 +1797,243 @@ EXPORT char * WJRNext(char *parent, size_t maxnamelen, WJReader indoc)
 	return(NULL);
 }
 
+EXPORT XplBool WJRSkip(char *value, WJReader indoc)
+{
+	WJIReader	*doc	= (WJIReader *)indoc;
+	uint32		depth	= 1;
+	XplBool		string	= FALSE;
+	XplBool		escape	= FALSE;
+	XplBool		comment	= FALSE;
+	char		*p;
+
+	if (!doc || !value || WJRRebase(doc, value) != doc->current || (
+		*value != WJR_TYPE_OBJECT && *value != WJR_TYPE_ARRAY)
+	) {
+		return(FALSE);
+	}
+
+	if (*doc->read == '\0' && doc->punchout != '\0') {
+		*doc->read = doc->punchout;
+		doc->punchout = '\0';
+	}
+
+	/* WJRDown() replaced the opening bracket with a comma */
+	p = doc->read + 1;
+
+	for (;;) {
+		if (p >= doc->write) {
+			/* None of the data is needed, so throw it all away and read more */
+			doc->read = doc->write;
+			*doc->read = '\0';
+
+			if (WJRFillBuffer(doc) <= 0) {
+				/* The document ended before the value did */
+				p = doc->write;
+				break;
+			}
+			p = doc->read;
+			continue;
+		}
+
+		if (escape) {
+			escape = FALSE;
+			p++;
+		} else if (string) {
+			p = (char *) WJRScanStringFunc(p, doc->write);
+
+			if (p < doc->write) {
+				switch (*p) {
+					case '\\':	escape = TRUE;	break;
+					case '"':	string = FALSE;	break;
+					default:					break;
+				}
+				p++;
+			}
+		} else if (comment) {
+			if ((p = memchr(p, '\n', doc->write - p))) {
+				comment = FALSE;
+				p++;
+			} else {
+				p = doc->write;
+			}
+		} else {
+			p = (char *) WJRScanSkipFunc(p, doc->write);
+
+			if (p < doc->write) {
+				switch (*(p++)) {
+					case '"':	string = TRUE;	break;
+					case '#':	comment = TRUE;	break;
+					case '[':	case '{':
+						depth++;
+						break;
+
+					case ']':	case '}':
+						depth--;
+						break;
+
+					default:
+						break;
+				}
+
+				if (!depth) {
+					break;
+				}
+			}
+		}
+	}
+
+	/* The value is now closed, just as if each of its children had been read */
+	doc->read = p;
+	WJRUp(doc);
+
+	return(TRUE);
+}
+
+EXPORT XplBool WJRSkipLine(WJReader indoc)
+{
+	WJIReader	*doc	= (WJIReader *)indoc;
+	char		*p;
+
+	if (!doc) {
+		return(FALSE);
+	}
+
+	if (doc->read > doc->write) {
+		doc->read = doc->write;
+	}
+
+	if (*doc->read == '\0' && doc->punchout != '\0') {
+		*doc->read = doc->punchout;
+	}
+	doc->punchout = '\0';
+
+	/* Start over at the top level, as if nothing had been read yet */
+	doc->pub.depth	= 0;
+	doc->depth		= 0;
+	doc->naming		= FALSE;
+	doc->protect	= NULL;
+
+	doc->current	= doc->buffer;
+	doc->current[0]	= WJR_TYPE_ARRAY;
+	doc->current[1]	= '\0';
+
+	for (;;) {
+		if ((p = memchr(doc->read, '\n', doc->write - doc->read))) {
+			doc->read = p + 1;
+			return(TRUE);
+		}
+
+		/* None of the data is needed, so throw it all away and read more */
+		doc->read = doc->write;
+		*doc->read = '\0';
+
+		if (WJRFillBuffer(doc) <= 0) {
+			/* There are no more lines */
+			return(FALSE);
+		}
+	}
+}
+
+/*
+	Decode the escape sequence that starts with the backslash at p, and store
+	the resulting bytes in out. The number of bytes stored is returned, and the
+	length of the escape sequence is stored in seqlen.
+
+	The caller must ensure that WJREscapeAvailable() is true for p + 1.
+*/
+static size_t WJRUnescape(const char *p, char *out, size_t *seqlen)
+{
+	unsigned int	c, d, e;
+
+	*seqlen = 2;
+
+	switch (toupper(p[1])) {
+		default:
+		case '"':	case '\\':	case '/':
+			/* Simply move the character over */
+			out[0] = p[1];
+			return(1);
+
+		/* Replace with the escape character */
+		case 'B':	out[0] = '\b'; return(1);
+		case 'F':	out[0] = '\f'; return(1);
+		case 'N':	out[0] = '\n'; return(1);
+		case 'R':	out[0] = '\r'; return(1);
+		case 'T':	out[0] = '\t'; return(1);
+
+		case 'U':
+			/* Replace four hex digits with a utf-8 encoding */
+			*seqlen = sizeof("\\u0000") - 1;
+			c = (HexDigit(p[2]) << 12) + (HexDigit(p[3]) << 8) +
+				(HexDigit(p[4]) << 4) + (HexDigit(p[5]));
+
+			if (c < 0x80) {
+				out[0] = (char) c;
+				return(1);
+			} else if (c < 0x800) {
+				out[0] = (char) 0xC0 | (c >> 6);
+				out[1] = (char) 0x80 | (c & 0x3F);
+				return(2);
+			} else if (c >= 0xD800 && c <= 0xDBFF) {
+				/* high surrogate codepoint, must be followed by low surrogate */
+				if (p[6] == '\\' && WJREscapeAvailable(p + 7) && toupper(p[7]) == 'U') {
+					d = (HexDigit(p[8]) << 12) + (HexDigit(p[9]) << 8) +
+						(HexDigit(p[10]) << 4) + (HexDigit(p[11]));
+
+					if (d >= 0xDC00 && d <= 0xDFFF) {
+						/* surrogate pair */
+						e = 0x10000 + (((c & 0x3ff) << 10) | (d & 0x3ff));
+						*seqlen = sizeof("\\u0000\\u0000") - 1;
+
+						out[0] = (char) 0xF0 | (e >> 18);
+						out[1] = (char) 0x80 | ((e >> 12) & 0x3F);
+						out[2] = (char) 0x80 | ((e >> 6) & 0x3F);
+						out[3] = (char) 0x80 | (e & 0x3F);
+						return(4);
+					}
+				}
+
+				/* An unpaired high surrogate is dropped */
+				return(0);
+			} else if (c >= 0xDC00 && c <= 0xDFFF) {
+				/* low surrogate codepoint is invalid here */
+				return(0);
+			}
+
+			out[0] = (char) 0xE0 | (c >> 12);
+			out[1] = (char) 0x80 | ((c >> 6) & 0x3F);
+			out[2] = (char) 0x80 | (c & 0x3F);
+			return(3);
+
+		case 'X':
+			/* Replace two hex digits with a non-utf-8 byte */
+			*seqlen = sizeof("\\x00") - 1;
+			out[0] = (char) ((HexDigit(p[2]) << 4) + HexDigit(p[3]));
+			return(1);
+	}
+}
+
+/*
+	Move the rest of the buffered data down to close the gap left behind by
+	unescaping part of a string.
+*/
+static void WJRCloseGap(WJIReader *doc, size_t *i, size_t *gap)
+{
+	if (*gap) {
+		if (doc->write < doc->read + *i) {
+			doc->write = doc->read + *i + strlen(doc->read + *i);
+		}
+
+		WJRDocAssert(doc);
+		memmove(doc->read + *i - *gap, doc->read + *i, doc->write - (doc->read + *i) + 1);
+		WJRDocAssert(doc);
+
+		doc->write	-= *gap;
+		*i			-= *gap;
+		*gap		= 0;
+	}
+}
+
 EXPORT char * WJRStringEx(XplBool *complete, size_t *length, WJReader indoc)
 {
 	WJIReader	  *doc = (WJIReader *)indoc;
@@ -1016,13 +2042,20 @@ EXPORT char * WJRStringEx(XplBool *complete, size_t *length, WJReader indoc)
 		/*
 			Starting at the read pointer look for escaped characters, and for
 			non-escaped quotes of the correct type.  If an escaped character is
-			found, unescape it, and memmove the rest of the data that is in the
-			buffer (and update the write pointer to match).  If the write
-			pointer is reached without finding the closing quote then the buffer
-			will need to be filled.
+			found, unescape it in place.  If the write pointer is reached
+			without finding the closing quote then the buffer will need to be
+			filled.
+
+			An unescaped character is shorter than the escape sequence, which
+			leaves a gap between the unescaped data and the rest of the buffer.
+			The plain characters that follow are moved down to close the gap as
+			they are found, so the rest of the buffer only has to be moved if it
+			is about to be filled.
 		*/
-		unsigned int	i;
-		unsigned int	utf8CharLen;
+		size_t			i, j;
+		size_t			gap		= 0;
+		size_t			seqlen, n;
+		char			out[4];
 
 		if (*doc->read == '\0') {
 			WJRDocAssert(doc);
@@ -1033,13 +2066,27 @@ EXPORT char * WJRStringEx(XplBool *complete, size_t *length, WJReader indoc)
 			while (*doc->read == '\0' && WJRFillBuffer(doc) > 0);
 		}
 
-		for (i = 0,utf8CharLen = 1; ; i += utf8CharLen, utf8CharLen = 1) {
+		for (i = 0; ; ) {
+			/* Skip ahead to the next character that needs attention */
+			j = WJRScanString(doc, i);
+			if (gap && j > i) {
+				memmove(doc->read + i - gap, doc->read + i, j - i);
+			}
+			i = j;
+
 			switch (doc->read[i]) {
 				default: {
+					/* A plain character that the scan stopped on */
+					if (gap) {
+						doc->read[i - gap] = doc->read[i];
+					}
+					i++;
 					break;
 				}
 
 				case '\0': {
+					WJRCloseGap(doc, &i, &gap);
+
 					switch (WJRFillBuffer(doc)) {
 						case 0: {
 							/*
@@ -1091,11 +2138,7 @@ EXPORT char * WJRStringEx(XplBool *complete, size_t *length, WJReader indoc)
 						}
 
 						default: {
-							/*
-								We now have data there, so back up one character
-								and work on it
-							*/
-							i--;
+							/* We now have data there, so work on it */
 							break;
 						}
 					}
@@ -1104,12 +2147,11 @@ EXPORT char * WJRStringEx(XplBool *complete, size_t *length, WJReader indoc)
 				}
 
 				case '\\': {
-					unsigned int	move = 0;
-
-					if (strlen(doc->read + i + 1) < (toupper(doc->read[i + 1]) == 'U' ? 5 : (toupper(doc->read[i + 1]) == 'X' ? 3 : 1))) {
+					if (!WJREscapeAvailable(doc->read + i + 1)) {
 						/* Make sure we have enough characters */
+						WJRCloseGap(doc, &i, &gap);
 						WJRFillBuffer(doc);
-						if (strlen(doc->read + i + 1) < (toupper(doc->read[i + 1]) == 'U' ? 5 : (toupper(doc->read[i + 1]) == 'X' ? 3 : 1))) {
+						if (!WJREscapeAvailable(doc->read + i + 1)) {
 							/*
 								Even after filling the buffer there aren't
 								enough characters.  This means that this is the
@@ -1150,98 +2192,19 @@ EXPORT char * WJRStringEx(XplBool *complete, size_t *length, WJReader indoc)
 						}
 					}
 
-					switch (toupper(doc->read[i + 1])) {
-						default:
-						case '"':	case '\\':	case '/': {
-							/* Simply move the character over */
-							move = 1;
-							break;
-						}
-
-						/* Replace with the escape character */
-						case 'B':	doc->read[i + 1] = '\b'; move = 1; break;
-						case 'F':	doc->read[i + 1] = '\f'; move = 1; break;
-						case 'N':	doc->read[i + 1] = '\n'; move = 1; break;
-						case 'R':	doc->read[i + 1] = '\r'; move = 1; break;
-						case 'T':	doc->read[i + 1] = '\t'; move = 1; break;
-
-						case 'U': {
-							/* Replace four hex digits with a utf-8 encoding */
-							unsigned int	c = (HexDigit(doc->read[i + 2]) << 12)	+
-												(HexDigit(doc->read[i + 3]) << 8)	+
-												(HexDigit(doc->read[i + 4]) << 4)	+
-												(HexDigit(doc->read[i + 5]));
-							// We right-justify the bytes we output on top of the characters
-							// read so memmove works correctly
-							if (c < 0x80) {
-								/* The 4 hex digits took 1 space, move 5 */
-								doc->read[i + 5]	= (char) c;
-								// utf8CharLen = 1; /* one byte is all we used */
-							} else if (c < 0x800) {
-								/* The 4 hex digits took 2 spaces, move 4 */
-								doc->read[i + 4]	= (char) 0xC0 | (c >> 6);
-								doc->read[i + 5]	= (char) 0x80 | (c & 0x3F);
-								utf8CharLen = 2; /* we used two bytes */
-							} else if ((c >= 0xD800) && (c <= 0xDBFF)) {
-								/* high surrogate codepoint */
-								utf8CharLen = 0;
-								/* must be followed by low surrogate */
-								if((doc->read[i + 6] == '\\') && (toupper(doc->read[i + 7] == 'U'))) {
-									unsigned int	d = (HexDigit(doc->read[i + 8]) << 12)	+
-														(HexDigit(doc->read[i + 9]) << 8)	+
-														(HexDigit(doc->read[i + 10]) << 4)	+
-														(HexDigit(doc->read[i + 11]));
-									if ((d >= 0xDC00) && (d <= 0xDFFF)) {
-										unsigned int	e = 0x10000 + (((c & 0x3ff) << 10) | (d & 0x3ff));
-										/* surrogate pair */
-										utf8CharLen = 4; /* we used 4 bytes */
-										doc->read[i+3] = (char) 0xF0 | (e >> 18);
-										doc->read[i+4] = (char) 0x80 | ((e >> 12) & 0x3F);
-										doc->read[i+5] = (char) 0x80 | ((e >> 6) & 0x3F);
-										doc->read[i+6] = (char) 0x80 | (e & 0x3F);
-
-										move = sizeof("\\u0000\\u0000")-1 - utf8CharLen;
-										break; /* don't use the normal exit from this case */
-									}
-								}
-							} else if ((c >= 0xDC00) && (c <= 0xDFFF)) {
-								/* low surrogate codepoint is invalid here */
-								utf8CharLen = 0;
-							} else {
-								/* The 4 hex digits took 3 spaces, move 3 */
-								doc->read[i + 3]	= (char) 0xE0 | (c >> 12);
-								doc->read[i + 4]	= (char) 0x80 | ((c >> 6) & 0x3F);
-								doc->read[i + 5]	= (char) 0x80 | (c & 0x3F);
-								utf8CharLen = 3; /* we used three bytes */
-							}
-							move = sizeof("\\u0000")-1 - utf8CharLen;
-							break;
-						}
-						case 'X': {
-							/* Replace two hex digits with a non-utf-8 byte */
-							unsigned int	c = (HexDigit(doc->read[i + 2]) << 4)	+
-												(HexDigit(doc->read[i + 3]));
-
-							/*
-								We right-justify the bytes we output on top of
-								the characters read so memmove works correctly.
-							*/
-
-							/* The 2 hex digits took 1 space, move 3 */
-							doc->read[i+3] = (char) c;
-							move = sizeof("\\x00") - 1 - utf8CharLen;
-							break;
-						}
-					}
+					/*
+						The unescaped value is never longer than the escape
+						sequence, so it can't overwrite anything that hasn't
+						been read yet.
+					*/
+					n = WJRUnescape(doc->read + i, out, &seqlen);
 
 					WJRDocAssert(doc);
-					memmove(
-						doc->read + i,			/* to	*/
-						doc->read + i + move,	/* from	*/
-
-						/* Length, including terminator and at least 1 char */
-						strlen(doc->read + i + move + 1) + 2);
+					memcpy(doc->read + i - gap, out, n);
 					WJRDocAssert(doc);
+
+					gap	+= seqlen - n;
+					i	+= seqlen;
 					break;
 				}
 
@@ -1249,11 +2212,11 @@ EXPORT char * WJRStringEx(XplBool *complete, size_t *length, WJReader indoc)
 					char		*result = doc->read;
 
 					WJRDocAssert(doc);
-					doc->read[i] = '\0';
+					doc->read[i - gap] = '\0';
 					WJRDocAssert(doc);
 					doc->read += i + 1;
 
-					for (; doc->read < doc->write && *doc->read && *doc->read != ':' && *doc->read != ',' && *doc->read != ']' && *doc->read != '}'; doc->read++);
+					WJRSkipToDelimiter(doc);
 
 					/*
 						This element is complete.  Walk back up the stack one
@@ -1270,7 +2233,7 @@ EXPORT char * WJRStringEx(XplBool *complete, size_t *length, WJReader indoc)
 					}
 
 					if (length) {
-						*length = i;
+						*length = i - gap;
 					}
 
 					return(result);
@@ -1306,90 +2269,63 @@ typedef struct
 	double		d;
 } WJRMixedNumber;
 
+/*
+	A valid number in a JSON document must be followed by whitespace, a comma or
+	the end of an array or object.
+*/
+#define WJRNumberEnd(c)		((c) == ',' || (c) == ']' || (c) == '}' || WJRIsSpace((c)))
+
 static void WJRNumber(void *value, WJRNumberType type, WJReader indoc)
 {
 	WJIReader	*doc	= (WJIReader *)indoc;
 
 	/* WJRDown() has already advanced past any leading whitespace */
 	if (doc && doc->current && *doc->current == WJR_TYPE_NUMBER) {
+		WJRMixedNumber	n;
 		char			*end;
 
+		memset(&n, 0, sizeof(n));
+		end = WJRParseNumber(doc->read, doc->write, &n.hasDecimalPoint, &n.i, &n.d);
+
+		if (end <= doc->read || end >= doc->write || !WJRNumberEnd(*end)) {
+			/*
+				It is likely that we didn't get the entire value. Anything
+				else following the number indicates that there is a portion of
+				the number that wasn't parsed and the buffer needs to be filled.
+			*/
+			WJRFillBuffer(doc);
+			end = WJRParseNumber(doc->read, doc->write, &n.hasDecimalPoint, &n.i, &n.d);
+		}
+
 		switch (type) {
 			default:
 			case WJR_TYPE_INT32:
-				*((int32 *) value) = strtol(doc->read, &end, 0);
+				*((int32 *) value) = (int32) n.i;
 				break;
 			case WJR_TYPE_UINT32:
-				*((uint32 *) value) = strtoul(doc->read, &end, 0);
+				*((uint32 *) value) = (uint32) n.i;
 				break;
 			case WJR_TYPE_INT64:
-				*((int64 *) value) = strtoll(doc->read, &end, 0);
+				*((int64 *) value) = n.i > INT64_MAX ? INT64_MAX : (int64) n.i;
 				break;
 			case WJR_TYPE_UINT64:
-				*((uint64 *) value) = strtoull(doc->read, &end, 0);
+				*((uint64 *) value) = n.i;
 				break;
 			case WJR_TYPE_DOUBLE:
-				*((double *) value) = strtod(doc->read, &end);
+				*((double *) value) = n.d;
 				break;
 			case WJR_TYPE_MIXED:
-				((WJRMixedNumber *) value)->hasDecimalPoint = FALSE;
-				((WJRMixedNumber *) value)->i = strtoll(doc->read, &end, 0);
-
-				if (end && '.' == *end) {
-					/* A decimal point was found, parse again as a double */
-					((WJRMixedNumber *) value)->hasDecimalPoint = TRUE;
-					((WJRMixedNumber *) value)->d = strtod(doc->read, &end);
-				}
+				*((WJRMixedNumber *) value) = n;
 				break;
 		}
 
-		if ((char *) end <= doc->read || !end || !*end ||
-			(*end != ',' && !isspace(*end))
-		) {
-			/*
-				It is likely that we didn't get the entire value.  A valid
-				number in a JSON document must be followed by whitespace or a
-				comma.  Anything else indicates that there is a portion of the
-				number that wasn't parsed and the buffer needs to be filled.
-			*/
-			WJRFillBuffer(doc);
-			switch (type) {
-				default:
-				case WJR_TYPE_INT32:
-					*((int32 *) value) = strtol(doc->read, &end, 0);
-					break;
-				case WJR_TYPE_UINT32:
-					*((uint32 *) value) = strtoul(doc->read, &end, 0);
-					break;
-				case WJR_TYPE_INT64:
-					*((int64 *) value) = strtoll(doc->read, &end, 0);
-					break;
-				case WJR_TYPE_UINT64:
-					*((uint64 *) value) = strtoull(doc->read, &end, 0);
-					break;
-				case WJR_TYPE_DOUBLE:
-					*((double *) value) = strtod(doc->read, &end);
-					break;
-				case WJR_TYPE_MIXED:
-					((WJRMixedNumber *) value)->hasDecimalPoint = FALSE;
-					((WJRMixedNumber *) value)->i = strtoll(doc->read, &end, 0);
-
-					if (end && '.' == *end) {
-						/* A decimal point was found, parse again as a double */
-						((WJRMixedNumber *) value)->hasDecimalPoint = TRUE;
-						((WJRMixedNumber *) value)->d = strtod(doc->read, &end);
-					}
-					break;
-			}
-		}
-
 		if (end) {
 			doc->read = end;
 		}
 
 		/* Skip past any whitespace */
 		do {
-			for (; doc->read < doc->write && isspace(*doc->read); doc->read++);
+			WJRSkipSpace(doc);
 		} while ((doc->read >= doc->write || *doc->read == '\0') && WJRFillBuffer(doc) > 0);
 	}
 
@@ -1462,17 +2398,10 @@ EXPORT XplBool WJRIntOrDouble(WJReader doc, uint64 *i, double *d)
 	memset(&result, 0, sizeof(result));
 	WJRNumber(&result, WJR_TYPE_MIXED, doc);
 
-	if (result.hasDecimalPoint) {
-		if (i) *i = (uint64) result.d;
-		if (d) *d = result.d;
+	if (i) *i = result.i;
+	if (d) *d = result.d;
 
-		return(TRUE);
-	} else {
-		if (i) *i = result.i;
-		if (d) *d = (double) result.i;
-
-		return(FALSE);
-	}
+	return(result.hasDecimalPoint);
 }
 
 EXPORT XplBool WJRBoolean(WJReader indoc)
@@ -1494,7 +2423,7 @@ EXPORT XplBool WJRBoolean(WJReader indoc)
 
 		/* Skip past any whitespace */
 		do {
-			for (; doc->read < doc->write && isspace(*doc->read); doc->read++);
+			WJRSkipSpace(doc);
 		} while ((doc->read >= doc->write || *doc->read == '\0') && WJRFillBuffer(doc) > 0);
 	}
 
@@ -0,0 +1,465 @@
+/*
+    This file is part of WJElement.
+
+    WJElement is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation.
+
+    WJElement is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with WJElement.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <string.h>
+#include <stdlib.h>
+
+#include <xpl.h>
+#include <nmutil.h>
+#include <memmgr.h>
+
+#include <wjwriter.h>
+
+/*
+	Number formatting
+
+	Doubles are written with the Grisu2 algorithm (Florian Loitsch, "Printing
+	Floating-Point Numbers Quickly and Accurately with Integers"). The digits
+	that are produced always read back as exactly the same double, and are the
+	shortest possible representation in all but a tiny fraction of cases, in
+	which one extra digit may be written.
+
+	All of the work is done with 64 bit integer math, so it does not depend on
+	the current locale and does not need the C library at all.
+*/
+
+/* A floating point value with a 64 bit significand, f * 2^e */
+typedef struct {
+	uint64			f;
+	int				e;
+} WJWDiyFp;
+
+#define WJW_DP_SIGNIFICAND_SIZE		52
+#define WJW_DP_EXPONENT_BIAS		(0x3FF + WJW_DP_SIGNIFICAND_SIZE)
+#define WJW_DP_MIN_EXPONENT			(-WJW_DP_EXPONENT_BIAS)
+#define WJW_DP_EXPONENT_MASK		0x7FF0000000000000ULL
+#define WJW_DP_SIGNIFICAND_MASK		0x000FFFFFFFFFFFFFULL
+#define WJW_DP_HIDDEN_BIT			0x0010000000000000ULL
+
+/*
+	64 bit approximations (rounded to nearest) of every 8th power of ten from
+	1e-348 to 1e340, normalized so that the most significant bit is set.
+*/
+static const struct {
+	uint64			f;
+	int16			e;
+} WJWCachedPowers[] = {
+	{ 0xFA8FD5A0081C0288ULL, -1220 },	/* 1e-348 */
+	{ 0xBAAEE17FA23EBF76ULL, -1193 },	/* 1e-340 */
+	{ 0x8B16FB203055AC76ULL, -1166 },	/* 1e-332 */
+	{ 0xCF42894A5DCE35EAULL, -1140 },	/* 1e-324 */
+	{ 0x9A6BB0AA55653B2DULL, -1113 },	/* 1e-316 */
+	{ 0xE61ACF033D1A45DFULL, -1087 },	/* 1e-308 */
+	{ 0xAB70FE17C79AC6CAULL, -1060 },	/* 1e-300 */
+	{ 0xFF77B1FCBEBCDC4FULL, -1034 },	/* 1e-292 */
+	{ 0xBE5691EF416BD60CULL, -1007 },	/* 1e-284 */
+	{ 0x8DD01FAD907FFC3CULL,  -980 },	/* 1e-276 */
+	{ 0xD3515C2831559A83ULL,  -954 },	/* 1e-268 */
+	{ 0x9D71AC8FADA6C9B5ULL,  -927 },	/* 1e-260 */
+	{ 0xEA9C227723EE8BCBULL,  -901 },	/* 1e-252 */
+	{ 0xAECC49914078536DULL,  -874 },	/* 1e-244 */
+	{ 0x823C12795DB6CE57ULL,  -847 },	/* 1e-236 */
+	{ 0xC21094364DFB5637ULL,  -821 },	/* 1e-228 */
+	{ 0x9096EA6F3848984FULL,  -794 },	/* 1e-220 */
+	{ 0xD77485CB25823AC7ULL,  -768 },	/* 1e-212 */
+	{ 0xA086CFCD97BF97F4ULL,  -741 },	/* 1e-204 */
+	{ 0xEF340A98172AACE5ULL,  -715 },	/* 1e-196 */
+	{ 0xB23867FB2A35B28EULL,  -688 },	/* 1e-188 */
+	{ 0x84C8D4DFD2C63F3BULL,  -661 },	/* 1e-180 */
+	{ 0xC5DD44271AD3CDBAULL,  -635 },	/* 1e-172 */
+	{ 0x936B9FCEBB25C996ULL,  -608 },	/* 1e-164 */
+	{ 0xDBAC6C247D62A584ULL,  -582 },	/* 1e-156 */
+	{ 0xA3AB66580D5FDAF6ULL,  -555 },	/* 1e-148 */
+	{ 0xF3E2F893DEC3F126ULL,  -529 },	/* 1e-140 */
+	{ 0xB5B5ADA8AAFF80B8ULL,  -502 },	/* 1e-132 */
+	{ 0x87625F056C7C4A8BULL,  -475 },	/* 1e-124 */
+	{ 0xC9BCFF6034C13053ULL,  -449 },	/* 1e-116 */
+	{ 0x964E858C91BA2655ULL,  -422 },	/* 1e-108 */
+	{ 0xDFF9772470297EBDULL,  -396 },	/* 1e-100 */
+	{ 0xA6DFBD9FB8E5B88FULL,  -369 },	/* 1e-92 */
+	{ 0xF8A95FCF88747D94ULL,  -343 },	/* 1e-84 */
+	{ 0xB94470938FA89BCFULL,  -316 },	/* 1e-76 */
+	{ 0x8A08F0F8BF0F156BULL,  -289 },	/* 1e-68 */
+	{ 0xCDB02555653131B6ULL,  -263 },	/* 1e-60 */
+	{ 0x993FE2C6D07B7FACULL,  -236 },	/* 1e-52 */
+	{ 0xE45C10C42A2B3B06ULL,  -210 },	/* 1e-44 */
+	{ 0xAA242499697392D3ULL,  -183 },	/* 1e-36 */
+	{ 0xFD87B5F28300CA0EULL,  -157 },	/* 1e-28 */
+	{ 0xBCE5086492111AEBULL,  -130 },	/* 1e-20 */
+	{ 0x8CBCCC096F5088CCULL,  -103 },	/* 1e-12 */
+	{ 0xD1B71758E219652CULL,   -77 },	/* 1e-4 */
+	{ 0x9C40000000000000ULL,   -50 },	/* 1e4 */
+	{ 0xE8D4A51000000000ULL,   -24 },	/* 1e12 */
+	{ 0xAD78EBC5AC620000ULL,     3 },	/* 1e20 */
+	{ 0x813F3978F8940984ULL,    30 },	/* 1e28 */
+	{ 0xC097CE7BC90715B3ULL,    56 },	/* 1e36 */
+	{ 0x8F7E32CE7BEA5C70ULL,    83 },	/* 1e44 */
+	{ 0xD5D238A4ABE98068ULL,   109 },	/* 1e52 */
+	{ 0x9F4F2726179A2245ULL,   136 },	/* 1e60 */
+	{ 0xED63A231D4C4FB27ULL,   162 },	/* 1e68 */
+	{ 0xB0DE65388CC8ADA8ULL,   189 },	/* 1e76 */
+	{ 0x83C7088E1AAB65DBULL,   216 },	/* 1e84 */
+	{ 0xC45D1DF942711D9AULL,   242 },	/* 1e92 */
+	{ 0x924D692CA61BE758ULL,   269 },	/* 1e100 */
+	{ 0xDA01EE641A708DEAULL,   295 },	/* 1e108 */
+	{ 0xA26DA3999AEF774AULL,   322 },	/* 1e116 */
+	{ 0xF209787BB47D6B85ULL,   348 },	/* 1e124 */
+	{ 0xB454E4A179DD1877ULL,   375 },	/* 1e132 */
+	{ 0x865B86925B9BC5C2ULL,   402 },	/* 1e140 */
+	{ 0xC83553C5C8965D3DULL,   428 },	/* 1e148 */
+	{ 0x952AB45CFA97A0B3ULL,   455 },	/* 1e156 */
+	{ 0xDE469FBD99A05FE3ULL,   481 },	/* 1e164 */
+	{ 0xA59BC234DB398C25ULL,   508 },	/* 1e172 */
+	{ 0xF6C69A72A3989F5CULL,   534 },	/* 1e180 */
+	{ 0xB7DCBF5354E9BECEULL,   561 },	/* 1e188 */
+	{ 0x88FCF317F22241E2ULL,   588 },	/* 1e196 */
+	{ 0xCC20CE9BD35C78A5ULL,   614 },	/* 1e204 */
+	{ 0x98165AF37B2153DFULL,   641 },	/* 1e212 */
+	{ 0xE2A0B5DC971F303AULL,   667 },	/* 1e220 */
+	{ 0xA8D9D1535CE3B396ULL,   694 },	/* 1e228 */
+	{ 0xFB9B7CD9A4A7443CULL,   720 },	/* 1e236 */
+	{ 0xBB764C4CA7A44410ULL,   747 },	/* 1e244 */
+	{ 0x8BAB8EEFB6409C1AULL,   774 },	/* 1e252 */
+	{ 0xD01FEF10A657842CULL,   800 },	/* 1e260 */
+	{ 0x9B10A4E5E9913129ULL,   827 },	/* 1e268 */
+	{ 0xE7109BFBA19C0C9DULL,   853 },	/* 1e276 */
+	{ 0xAC2820D9623BF429ULL,   880 },	/* 1e284 */
+	{ 0x80444B5E7AA7CF85ULL,   907 },	/* 1e292 */
+	{ 0xBF21E44003ACDD2DULL,   933 },	/* 1e300 */
+	{ 0x8E679C2F5E44FF8FULL,   960 },	/* 1e308 */
+	{ 0xD433179D9C8CB841ULL,   986 },	/* 1e316 */
+	{ 0x9E19DB92B4E31BA9ULL,  1013 },	/* 1e324 */
+	{ 0xEB96BF6EBADF77D9ULL,  1039 },	/* 1e332 */
+	{ 0xAF87023B9BF0EE6BULL,  1066 },	/* 1e340 */
+};
+
+static const uint64 WJWPow10[] = {
+	1ULL,
+	10ULL,
+	100ULL,
+	1000ULL,
+	10000ULL,
+	100000ULL,
+	1000000ULL,
+	10000000ULL,
+	100000000ULL,
+	1000000000ULL,
+	10000000000ULL,
+	100000000000ULL,
+	1000000000000ULL,
+	10000000000000ULL,
+	100000000000000ULL,
+	1000000000000000ULL,
+	10000000000000000ULL,
+	100000000000000000ULL,
+	1000000000000000000ULL,
+	10000000000000000000ULL
+};
+
+/* Multiply, keeping the (rounded) high 64 bits of the product */
+static WJWDiyFp WJWDiyFpMul(WJWDiyFp x, WJWDiyFp y)
+{
+	WJWDiyFp	r;
+	uint64		a	= x.f >> 32;
+	uint64		b	= x.f & 0xFFFFFFFFULL;
+	uint64		c	= y.f >> 32;
+	uint64		d	= y.f & 0xFFFFFFFFULL;
+	uint64		ac	= a * c;
+	uint64		bc	= b * c;
+	uint64		ad	= a * d;
+	uint64		bd	= b * d;
+	uint64		tmp;
+
+	tmp = (bd >> 32) + (ad & 0xFFFFFFFFULL) + (bc & 0xFFFFFFFFULL);
+	tmp += 1ULL << 31;
+
+	r.f = ac + (ad >> 32) + (bc >> 32) + (tmp >> 32);
+	r.e = x.e + y.e + 64;
+	return(r);
+}
+
+static WJWDiyFp WJWDiyFpNormalize(WJWDiyFp x)
+{
+	while (!(x.f & (1ULL << 63))) {
+		x.f <<= 1;
+		x.e--;
+	}
+
+	return(x);
+}
+
+/*
+	Split a positive, finite double into its significand and exponent, and find
+	the boundaries halfway between it and its neighbours. Both boundaries are
+	returned with the same exponent.
+*/
+static WJWDiyFp WJWDiyFpFromDouble(double value, WJWDiyFp *minus, WJWDiyFp *plus)
+{
+	WJWDiyFp	v;
+	uint64		bits;
+	int			biased;
+
+	memcpy(&bits, &value, sizeof(bits));
+	biased	= (int) ((bits & WJW_DP_EXPONENT_MASK) >> WJW_DP_SIGNIFICAND_SIZE);
+	v.f		= bits & WJW_DP_SIGNIFICAND_MASK;
+
+	if (biased) {
+		v.f += WJW_DP_HIDDEN_BIT;
+		v.e = biased - WJW_DP_EXPONENT_BIAS;
+	} else {
+		/* Subnormal */
+		v.e = WJW_DP_MIN_EXPONENT + 1;
+	}
+
+	plus->f = (v.f << 1) + 1;
+	plus->e = v.e - 1;
+	while (!(plus->f & (WJW_DP_HIDDEN_BIT << 1))) {
+		plus->f <<= 1;
+		plus->e--;
+	}
+	plus->f <<= 64 - WJW_DP_SIGNIFICAND_SIZE - 2;
+	plus->e -= 64 - WJW_DP_SIGNIFICAND_SIZE - 2;
+
+	if (v.f == WJW_DP_HIDDEN_BIT) {
+		/* The gap to the next lower value is half as large on a power of two */
+		minus->f = (v.f << 2) - 1;
+		minus->e = v.e - 2;
+	} else {
+		minus->f = (v.f << 1) - 1;
+		minus->e = v.e - 1;
+	}
+	minus->f <<= minus->e - plus->e;
+	minus->e = plus->e;
+
+	return(v);
+}
+
+/*
+	Find a cached power of ten, 10^-k, that will bring a value with a binary
+	exponent of e into the range where the digits can be generated.
+*/
+static WJWDiyFp WJWCachedPower(int e, int *k)
+{
+	WJWDiyFp	r;
+	double		dk;
+	int			i;
+	int			index;
+
+	dk = (-61 - e) * 0.30102999566398114 + 347;
+	i = (int) dk;
+	if (dk - i > 0.0) {
+		i++;
+	}
+
+	index = (i >> 3) + 1;
+	*k = -(-348 + (index << 3));
+
+	r.f = WJWCachedPowers[index].f;
+	r.e = WJWCachedPowers[index].e;
+	return(r);
+}
+
+static int WJWCountDigits32(uint32 n)
+{
+	if (n < 10) return(1);
+	if (n < 100) return(2);
+	if (n < 1000) return(3);
+	if (n < 10000) return(4);
+	if (n < 100000) return(5);
+	if (n < 1000000) return(6);
+	if (n < 10000000) return(7);
+	if (n < 100000000) return(8);
+
+	/* DigitGen never needs more than 9 */
+	return(9);
+}
+
+/* Nudge the last digit towards the real value while it is in range */
+static void WJWGrisuRound(char *buffer, int len, uint64 delta, uint64 rest, uint64 tenkappa, uint64 wpw)
+{
+	while (rest < wpw && delta - rest >= tenkappa &&
+		(rest + tenkappa < wpw || wpw - rest > rest + tenkappa - wpw)
+	) {
+		buffer[len - 1]--;
+		rest += tenkappa;
+	}
+}
+
+static int WJWDigitGen(WJWDiyFp w, WJWDiyFp mp, uint64 delta, char *buffer, int *k)
+{
+	uint64		one		= 1ULL << -mp.e;
+	uint64		wpw		= mp.f - w.f;
+	uint32		p1		= (uint32) (mp.f >> -mp.e);
+	uint64		p2		= mp.f & (one - 1);
+	int			kappa	= WJWCountDigits32(p1);
+	int			len		= 0;
+	uint64		tmp;
+	uint32		d;
+
+	while (kappa > 0) {
+		d = p1 / (uint32) WJWPow10[kappa - 1];
+		p1 %= (uint32) WJWPow10[kappa - 1];
+
+		if (d || len) {
+			buffer[len++] = (char) ('0' + d);
+		}
+		kappa--;
+
+		tmp = ((uint64) p1 << -mp.e) + p2;
+		if (tmp <= delta) {
+			*k += kappa;
+			WJWGrisuRound(buffer, len, delta, tmp, WJWPow10[kappa] << -mp.e, wpw);
+			return(len);
+		}
+	}
+
+	for (;;) {
+		p2 *= 10;
+		delta *= 10;
+		d = (uint32) (p2 >> -mp.e);
+
+		if (d || len) {
+			buffer[len++] = (char) ('0' + d);
+		}
+		p2 &= one - 1;
+		kappa--;
+
+		if (p2 < delta) {
+			*k += kappa;
+			WJWGrisuRound(buffer, len, delta, p2, one,
+				-kappa < 20 ? wpw * WJWPow10[-kappa] : 0);
+			return(len);
+		}
+	}
+}
+
+/*
+	Write the shortest digits of a positive, finite, non-zero double. The value
+	is buffer * 10^k.
+*/
+static int WJWGrisu2(double value, char *buffer, int *k)
+{
+	WJWDiyFp	v, w, wm, wp, c;
+
+	v = WJWDiyFpFromDouble(value, &wm, &wp);
+	c = WJWCachedPower(wp.e, k);
+
+	w	= WJWDiyFpMul(WJWDiyFpNormalize(v), c);
+	wp	= WJWDiyFpMul(wp, c);
+	wm	= WJWDiyFpMul(wm, c);
+	wm.f++;
+	wp.f--;
+
+	return(WJWDigitGen(w, wp, wp.f - wm.f, buffer, k));
+}
+
+static char * WJWExponent(int k, char *out)
+{
+	if (k < 0) {
+		*out++ = '-';
+		k = -k;
+	}
+
+	if (k >= 100) {
+		*out++ = (char) ('0' + k / 100);
+		k %= 100;
+		*out++ = (char) ('0' + k / 10);
+		*out++ = (char) ('0' + k % 10);
+	} else if (k >= 10) {
+		*out++ = (char) ('0' + k / 10);
+		*out++ = (char) ('0' + k % 10);
+	} else {
+		*out++ = (char) ('0' + k);
+	}
+
+	return(out);
+}
+
+/*
+	Place the decimal point in the digits, which are value * 10^k. Values of a
+	reasonable magnitude are written in plain notation and anything else with
+	an exponent. A value that happens to be an integer still gets a fraction
+	(1.0 rather than 1) so that it reads back as a double.
+*/
+static char * WJWPrettify(char *buffer, int len, int k)
+{
+	int			kk	= len + k;
+	int			i;
+
+	if (k >= 0 && kk <= 21) {
+		/* 1234e7 -> 12340000000.0 */
+		for (i = len; i < kk; i++) {
+			buffer[i] = '0';
+		}
+		buffer[kk] = '.';
+		buffer[kk + 1] = '0';
+		return(buffer + kk + 2);
+	} else if (kk > 0 && kk <= 21) {
+		/* 1234e-2 -> 12.34 */
+		memmove(buffer + kk + 1, buffer + kk, len - kk);
+		buffer[kk] = '.';
+		return(buffer + len + 1);
+	} else if (kk > -6 && kk <= 0) {
+		/* 1234e-6 -> 0.001234 */
+		i = 2 - kk;
+		memmove(buffer + i, buffer, len);
+		buffer[0] = '0';
+		buffer[1] = '.';
+		memset(buffer + 2, '0', i - 2);
+		return(buffer + len + i);
+	} else if (len == 1) {
+		/* 1e30 */
+		buffer[1] = 'e';
+		return(WJWExponent(kk - 1, buffer + 2));
+	} else {
+		/* 1234e30 -> 1.234e33 */
+		memmove(buffer + 2, buffer + 1, len - 1);
+		buffer[1] = '.';
+		buffer[len + 1] = 'e';
+		return(WJWExponent(kk - 1, buffer + len + 2));
+	}
+}
+
+EXPORT size_t WJWFormatDouble(double value, char *buffer)
+{
+	char		*p	= buffer;
+	uint64		bits;
+	int			len;
+	int			k	= 0;
+
+	memcpy(&bits, &value, sizeof(bits));
+	if ((bits & WJW_DP_EXPONENT_MASK) == WJW_DP_EXPONENT_MASK) {
+		/* There is no JSON representation of NaN or infinity */
+		return(0);
+	}
+
+	if (bits >> 63) {
+		*p++ = '-';
+		value = -value;
+	}
+
+	if (value == 0.0) {
+		memcpy(p, "0.0", 3);
+		p += 3;
+	} else {
+		len = WJWGrisu2(value, p, &k);
+		p = WJWPrettify(p, len, k);
+	}
+
+	*p = '\0';
+	return(p - buffer);
+}
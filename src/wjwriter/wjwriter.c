@@ -29,6 +29,14 @@
 typedef SSIZE_T ssize_t;
 #endif
 
+#include <errno.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
 /*
 	JSON syntax (http://www.json.org/)
 	==================================
@@ -135,7 +143,26 @@ typedef SSIZE_T ssize_t;
 	}
 */
 
+/*
+	The destination of a document opened with WJWOpenMemDocument() or
+	WJWOpenBufferDocument().
+
+	If mem is set then the allocation it points to is grown as needed, doubling
+	in size each time so that writing a document takes linear time. Otherwise
+	the data is copied into the caller's buffer until it is full, and length
+	keeps counting so that the caller can find out how much room is needed.
+*/
+#define WJW_MEM_MIN_SIZE		256
+
 typedef struct {
+	char				**mem;
+	char				*buffer;
+	size_t				size;
+	size_t				length;
+	size_t				*needed;
+} WJWMemSink;
+
+typedef struct WJIWriter {
 	WJWriterPublic		public;
 
 	/*
@@ -148,6 +175,23 @@ typedef struct {
 	XplBool				instring;
 	int					depth;
 
+	WJWMemSink			sink;
+
+	/*
+		Called once all buffered data has been written, with the write data and
+		a flag indicating if the document was written successfully. Returning
+		FALSE causes WJWCloseDocument() to fail.
+	*/
+	XplBool				(* closecb)(void *data, XplBool ok);
+
+	/*
+		Set if the writer came from WJWOpenPooledDocument(), in which case it
+		is returned to the pool of the thread that closes it. next links the
+		writers in the pool.
+	*/
+	XplBool				pooled;
+	struct WJIWriter	*next;
+
 	size_t				size;
 	size_t				used;
 	char				buffer[1];
@@ -172,6 +216,14 @@ static int WJWrite(WJIWriter *doc, char *data, size_t length)
 	}
 
 	DebugAssert(doc->used <= doc->size);
+	if (length <= doc->size - doc->used) {
+		/* The common case, where it all fits in the buffer */
+		memcpy(doc->buffer + doc->used, data, length);
+		doc->used += length;
+		doc->buffer[doc->used] = '\0';
+		return((int) length);
+	}
+
 	while (length) {
 		/* Fill our buffer as much as possible */
 		if (doc->used < doc->size) {
@@ -229,6 +281,46 @@ static int WJWrite(WJIWriter *doc, char *data, size_t length)
 	return(result);
 }
 
+/* Restore the settings in the public structure to their defaults */
+static void WJWDefaults(WJIWriter *doc, XplBool pretty)
+{
+	doc->public.pretty				= pretty;
+	doc->public.escapeInvalidChars	= TRUE;
+	doc->public.base				= 10;
+#ifdef WJW_LEGACY_DOUBLE_FORMAT
+	doc->public.doubleFormat		= "%e";
+#else
+	doc->public.doubleFormat		= NULL;
+#endif
+}
+
+/*
+	Prepare to write a new document with the given callback. This is used by
+	_WJWOpenDocument(), and by WJWResetDocument() to start over with a writer
+	that has already been used.
+*/
+static void WJWInitDocument(WJIWriter *doc, WJWriteCallback callback, void *writedata)
+{
+	doc->public.write.cb	= callback;
+	doc->public.write.data	= writedata;
+	doc->public.user.data	= NULL;
+	doc->public.user.freecb	= NULL;
+
+	/*
+		The first value after opening a document should not be preceded by a
+		comma.  skipcomma will be reset after reading that first value.
+	*/
+	doc->skipcomma			= TRUE;
+	doc->skipbreak			= TRUE;
+	doc->instring			= FALSE;
+	doc->depth				= 0;
+	doc->closecb			= NULL;
+	doc->used				= 0;
+	doc->buffer[0]			= '\0';
+
+	memset(&doc->sink, 0, sizeof(doc->sink));
+}
+
 EXPORT WJWriter _WJWOpenDocument(XplBool pretty, WJWriteCallback callback, void *writedata, size_t buffersize)
 {
 	WJIWriter	*doc	= NULL;
@@ -246,8 +338,6 @@ EXPORT WJWriter _WJWOpenDocument(XplBool pretty, WJWriteCallback callback, void
 	doc = MemMallocEx(NULL, size, &size, TRUE, FALSE);
 	memset(doc, 0, sizeof(WJIWriter));
 
-	doc->public.write.cb	= callback;
-	doc->public.write.data	= writedata;
 	if (buffersize != 0) {
 		/*
 			Use the avaliable size returned by MemMallocEx so that the write
@@ -263,61 +353,162 @@ EXPORT WJWriter _WJWOpenDocument(XplBool pretty, WJWriteCallback callback, void
 		doc->size			= 0;
 	}
 
-	/*
-		The first value after opening a document should not be preceded by a
-		comma.  skipcomma will be reset after reading that first value.
-	*/
-	doc->public.pretty				= pretty;
-	doc->public.escapeInvalidChars	= TRUE;
-	doc->public.base				= 10;
-	doc->skipcomma					= TRUE;
-	doc->skipbreak					= TRUE;
+	WJWDefaults(doc, pretty);
+	WJWInitDocument(doc, callback, writedata);
 
 	return((WJWriter) doc);
 }
 
-EXPORT XplBool WJWCloseDocument(WJWriter indoc)
+/*
+	Finish the current document, as WJWCloseDocument() does, but without
+	freeing the writer.
+*/
+static XplBool WJWFinishDocument(WJIWriter *doc)
 {
-	WJIWriter	*doc	= (WJIWriter *)indoc;
 	XplBool		result	= FALSE;
 
-	if (doc) {
-		if (doc->size) {
-			size_t		size;
-			size_t		offset;
-
-			DebugAssert(doc->used <= doc->size);
-
-			/* Write any remaining buffered data */
-			offset = 0;
-			while (doc->public.write.cb && offset < doc->used) {
-				size = doc->public.write.cb(doc->buffer + offset, doc->used - offset,
-							doc->public.write.data);
-				DebugAssert((signed int) size >= 0 && size <= doc->used - offset);
-				offset += size;
-
-				if (!size) {
-					/* The callback failed */
-					doc->public.write.cb = NULL;
-					doc->used -= offset;
-					break;
-				}
+	if (doc->size) {
+		size_t		size;
+		size_t		offset;
+
+		DebugAssert(doc->used <= doc->size);
+
+		/* Write any remaining buffered data */
+		offset = 0;
+		while (doc->public.write.cb && offset < doc->used) {
+			size = doc->public.write.cb(doc->buffer + offset, doc->used - offset,
+						doc->public.write.data);
+			DebugAssert((signed int) size >= 0 && size <= doc->used - offset);
+			offset += size;
+
+			if (!size) {
+				/* The callback failed */
+				doc->public.write.cb = NULL;
+				doc->used -= offset;
+				break;
 			}
-			doc->used -= offset;
-			DebugAssert(doc->used <= doc->size);
 		}
+		doc->used -= offset;
+		DebugAssert(doc->used <= doc->size);
+	}
+
+	if (doc->public.user.freecb) {
+		doc->public.user.freecb(doc->public.user.data);
+	}
+
+	if (doc->sink.mem && *doc->sink.mem &&
+		doc->sink.size - doc->sink.length > WJW_MEM_MIN_SIZE
+	) {
+		/* Give back whatever was left over from growing the allocation */
+		char	*mem;
 
-		if (doc->public.user.freecb) {
-			doc->public.user.freecb(doc->public.user.data);
+		if ((mem = MemRealloc(*doc->sink.mem, doc->sink.length + 1))) {
+			*doc->sink.mem = mem;
 		}
+	}
 
-		if (doc->public.write.cb) {
-			/* If the callback is still set then there where no errors */
-			result = TRUE;
+	if (doc->public.write.cb) {
+		/* If the callback is still set then there where no errors */
+		result = TRUE;
+	}
+
+	if (doc->closecb && !doc->closecb(doc->public.write.data, result)) {
+		result = FALSE;
+	}
+
+	return(result);
+}
+
+EXPORT XplBool WJWResetDocument(WJWriter indoc, WJWriteCallback callback, void *writedata)
+{
+	WJIWriter	*doc	= (WJIWriter *)indoc;
+	XplBool		result;
+
+	if (!doc || !callback) {
+		errno = EINVAL;
+		return(FALSE);
+	}
+
+	result = WJWFinishDocument(doc);
+	WJWInitDocument(doc, callback, writedata);
+
+	return(result);
+}
+
+/*
+	Pooled Writers
+
+	Each thread keeps a short list of writers that have been closed, so that
+	they can be handed out again by WJWOpenPooledDocument() without allocating.
+*/
+#ifndef WJW_POOL_SIZE
+#define WJW_POOL_SIZE			8
+#endif
+
+#if defined(_MSC_VER)
+#define WJW_THREAD_LOCAL		__declspec(thread)
+#else
+#define WJW_THREAD_LOCAL		__thread
+#endif
+
+static WJW_THREAD_LOCAL WJIWriter	*WJWPool		= NULL;
+static WJW_THREAD_LOCAL int			WJWPoolCount	= 0;
+
+EXPORT WJWriter WJWOpenPooledDocument(XplBool pretty, WJWriteCallback callback, void *writedata)
+{
+	WJIWriter	*doc;
+
+	if (!callback) {
+		errno = EINVAL;
+		return(NULL);
+	}
+
+	if (!(doc = WJWPool)) {
+		if ((doc = (WJIWriter *) WJWOpenDocument(pretty, callback, writedata))) {
+			doc->pooled = TRUE;
 		}
 
+		return((WJWriter) doc);
+	}
+
+	WJWPool = doc->next;
+	WJWPoolCount--;
+	doc->next = NULL;
+
+	WJWDefaults(doc, pretty);
+	WJWInitDocument(doc, callback, writedata);
+
+	return((WJWriter) doc);
+}
+
+EXPORT void WJWFreePool(void)
+{
+	WJIWriter	*doc;
+
+	while ((doc = WJWPool)) {
+		WJWPool = doc->next;
 		MemFree(doc);
 	}
+	WJWPoolCount = 0;
+}
+
+EXPORT XplBool WJWCloseDocument(WJWriter indoc)
+{
+	WJIWriter	*doc	= (WJIWriter *)indoc;
+	XplBool		result	= FALSE;
+
+	if (doc) {
+		result = WJWFinishDocument(doc);
+
+		if (doc->pooled && WJWPoolCount < WJW_POOL_SIZE) {
+			doc->public.write.cb = NULL;
+			doc->next = WJWPool;
+			WJWPool = doc;
+			WJWPoolCount++;
+		} else {
+			MemFree(doc);
+		}
+	}
 
 	return(result);
 }
@@ -337,37 +528,531 @@ EXPORT size_t WJWFileCallback(char *buffer, size_t length, void *data)
 	return(0);
 }
 
+#ifndef _WIN32
+/*
+	The destination of a document opened with WJWOpenFDDocument() or
+	WJWOpenPathDocument().
+
+	Data reaches the sink in large blocks from the writer's own buffer, and is
+	written straight to the descriptor without going through stdio.
+*/
+typedef struct {
+	int					fd;
+	uint32				flags;
+	XplBool				owned;
+
+	/* The offset the document started at, and how much has been written */
+	off_t				start;
+	uint64				written;
+	uint64				reserved;
+
+	/* The final path, and the temporary path used for an atomic write */
+	char				*path;
+	char				*temp;
+} WJWFileSink;
+
+static size_t WJWFDCallback(char *buffer, size_t length, void *data)
+{
+	WJWFileSink	*sink	= data;
+	size_t		offset	= 0;
+	ssize_t		size;
+
+	if (!sink) {
+		return(0);
+	}
+
+	while (offset < length) {
+		if ((size = write(sink->fd, buffer + offset, length - offset)) <= 0) {
+			if (size < 0 && errno == EINTR) {
+				continue;
+			}
+			break;
+		}
+		offset += size;
+	}
+
+	sink->written += offset;
+	return(offset);
+}
+
+static XplBool WJWSyncFD(int fd)
+{
+#if defined(__APPLE__)
+	return(!fsync(fd));
+#else
+	return(!fdatasync(fd));
+#endif
+}
+
+/*
+	Sync the directory that contains path, so that a rename within it is
+	durable.
+*/
+static XplBool WJWSyncDirectory(const char *path)
+{
+	char		*dir;
+	char		*slash;
+	XplBool		result	= FALSE;
+	int			fd;
+
+	if (!(dir = MemStrdup(path))) {
+		return(FALSE);
+	}
+
+	if (!(slash = strrchr(dir, '/'))) {
+		strcpy(dir, ".");
+	} else if (slash == dir) {
+		slash[1] = '\0';
+	} else {
+		*slash = '\0';
+	}
+
+	if ((fd = open(dir, O_RDONLY)) >= 0) {
+		result = !fsync(fd);
+		close(fd);
+	}
+
+	MemFree(dir);
+	return(result);
+}
+
+static XplBool WJWFileClose(void *data, XplBool ok)
+{
+	WJWFileSink	*sink	= data;
+
+	if (!sink) {
+		return(FALSE);
+	}
+
+	if (ok && sink->reserved > sink->written &&
+		ftruncate(sink->fd, sink->start + sink->written)
+	) {
+		/* Drop whatever was preallocated beyond the end of the document */
+		ok = FALSE;
+	}
+
+	if (ok && (sink->flags & WJW_FILE_SYNC) && !WJWSyncFD(sink->fd)) {
+		ok = FALSE;
+	}
+
+	if (sink->owned && close(sink->fd)) {
+		ok = FALSE;
+	}
+
+	if (sink->temp) {
+		if (ok && rename(sink->temp, sink->path)) {
+			ok = FALSE;
+		}
+
+		if (!ok) {
+			unlink(sink->temp);
+		} else if (sink->flags & WJW_FILE_SYNC) {
+			ok = WJWSyncDirectory(sink->path);
+		}
+	}
+
+	if (sink->path) {
+		MemFree(sink->path);
+	}
+	if (sink->temp) {
+		MemFree(sink->temp);
+	}
+	MemFree(sink);
+
+	return(ok);
+}
+
+static WJWriter WJWOpenFileSinkDocument(XplBool pretty, WJWFileSink *sink, uint64 size)
+{
+	WJIWriter	*doc;
+
+#if defined(__linux__) || defined(__FreeBSD__)
+	if ((sink->flags & WJW_FILE_PREALLOCATE) && size &&
+		(sink->start = lseek(sink->fd, 0, SEEK_CUR)) >= 0 &&
+		!posix_fallocate(sink->fd, sink->start, size)
+	) {
+		sink->reserved = size;
+	}
+#endif
+
+	if (!(doc = (WJIWriter *) _WJWOpenDocument(pretty, WJWFDCallback, sink, WJW_FILE_BUFFER_SIZE))) {
+		WJWFileClose(sink, FALSE);
+		return(NULL);
+	}
+
+	doc->closecb = WJWFileClose;
+	return((WJWriter) doc);
+}
+#endif
+
+EXPORT WJWriter WJWOpenFDDocument(XplBool pretty, int fd, uint32 flags)
+{
+#ifndef _WIN32
+	WJWFileSink	*sink;
+
+	if (fd < 0) {
+		errno = EINVAL;
+		return(NULL);
+	}
+
+	if (!(sink = MemMalloc(sizeof(WJWFileSink)))) {
+		return(NULL);
+	}
+	memset(sink, 0, sizeof(WJWFileSink));
+
+	sink->fd	= fd;
+	sink->flags	= flags & ~WJW_FILE_ATOMIC;
+
+	return(WJWOpenFileSinkDocument(pretty, sink, 0));
+#else
+	errno = ENOSYS;
+	return(NULL);
+#endif
+}
+
+EXPORT WJWriter WJWOpenPathDocument(XplBool pretty, const char *path, uint32 flags, uint64 size)
+{
+#ifndef _WIN32
+	static unsigned int	counter	= 0;
+	WJWFileSink			*sink;
+	struct stat			st;
+	size_t				length;
+	int					attempts;
+
+	if (!path) {
+		errno = EINVAL;
+		return(NULL);
+	}
+
+	if (!(sink = MemMalloc(sizeof(WJWFileSink)))) {
+		return(NULL);
+	}
+	memset(sink, 0, sizeof(WJWFileSink));
+
+	sink->fd	= -1;
+	sink->flags	= flags;
+	sink->owned	= TRUE;
+
+	if (flags & WJW_FILE_ATOMIC) {
+		/*
+			Write to a uniquely named file next to the destination, so that
+			it can be renamed over the destination once it is complete.
+		*/
+		length = strlen(path) + 32;
+
+		if (!(sink->path = MemStrdup(path)) || !(sink->temp = MemMalloc(length))) {
+			WJWFileClose(sink, FALSE);
+			return(NULL);
+		}
+
+		for (attempts = 0; sink->fd < 0 && attempts < 100; attempts++) {
+			strprintf(sink->temp, length, NULL, "%s.%lx.%x.tmp",
+				path, (unsigned long) getpid(), counter++);
+
+			if ((sink->fd = open(sink->temp, O_WRONLY | O_CREAT | O_EXCL, 0666)) < 0 &&
+				errno != EEXIST
+			) {
+				break;
+			}
+		}
+
+		if (sink->fd < 0) {
+			/* There is nothing to unlink */
+			MemFree(sink->temp);
+			sink->temp = NULL;
+		} else if (!stat(path, &st) && fchmod(sink->fd, st.st_mode & 07777)) {
+			/* The file being replaced must keep its mode */
+			WJWFileClose(sink, FALSE);
+			return(NULL);
+		}
+	} else {
+		sink->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+	}
+
+	if (sink->fd < 0) {
+		sink->owned = FALSE;
+		WJWFileClose(sink, FALSE);
+		return(NULL);
+	}
+
+	return(WJWOpenFileSinkDocument(pretty, sink, size));
+#else
+	errno = ENOSYS;
+	return(NULL);
+#endif
+}
+
 static size_t WJWMemCallback(char *buffer, size_t length, void *data)
 {
-	char		**mem = data;
-	size_t		l;
+	WJWMemSink	*sink	= data;
+	char		*mem;
+	size_t		size;
 
-	if (mem) {
-		if (!*mem) {
-			*mem = MemMallocWait(length + 1);
-			memcpy(*mem, buffer, length);
-			(*mem)[length] = '\0';
-		} else {
-			l = strlen(*mem);
+	if (!sink) {
+		return(0);
+	}
+
+	if (sink->mem) {
+		if (!*sink->mem || sink->size - sink->length <= length) {
+			size = xpl_max(sink->size * 2, WJW_MEM_MIN_SIZE);
+			if (size <= sink->length + length) {
+				size = sink->length + length + 1;
+			}
+
+			if (!(mem = MemRealloc(*sink->mem, size))) {
+				return(0);
+			}
 
-			*mem = MemReallocWait(*mem, l + length + 1);
-			memcpy(*mem + l, buffer, length);
-			(*mem)[l + length] = '\0';
+			*sink->mem	= mem;
+			sink->size	= size;
 		}
 
-		return(length);
+		memcpy(*sink->mem + sink->length, buffer, length);
+		sink->length += length;
+		(*sink->mem)[sink->length] = '\0';
+	} else {
+		/* Copy as much as will fit, and leave room for a terminator */
+		if (sink->length + 1 < sink->size) {
+			size = xpl_min(length, sink->size - sink->length - 1);
+
+			memcpy(sink->buffer + sink->length, buffer, size);
+			sink->buffer[sink->length + size] = '\0';
+		}
+		sink->length += length;
 	}
 
-	return(0);
+	if (sink->needed) {
+		*sink->needed = sink->length;
+	}
+	return(length);
+}
+
+static WJWriter WJWOpenSinkDocument(XplBool pretty, WJWMemSink *sink)
+{
+	WJIWriter	*doc;
+
+	/*
+		The sink is a buffer already, so the writer's own buffering is disabled
+		to avoid copying everything twice.
+	*/
+	if ((doc = (WJIWriter *) _WJWOpenDocument(pretty, WJWMemCallback, NULL, 0))) {
+		doc->sink				= *sink;
+		doc->public.write.data	= &doc->sink;
+	}
+
+	return((WJWriter) doc);
 }
 
 EXPORT WJWriter WJWOpenMemDocument(XplBool pretty, char **mem)
 {
+	return(WJWOpenMemDocumentEx(pretty, mem, 0));
+}
+
+EXPORT WJWriter WJWOpenMemDocumentEx(XplBool pretty, char **mem, size_t size)
+{
+	WJWMemSink	sink;
+	char		*buffer;
+
 	if (!mem) {
+		errno = EINVAL;
 		return(NULL);
 	}
 
-	return(_WJWOpenDocument(pretty, WJWMemCallback, mem, 0));
+	memset(&sink, 0, sizeof(sink));
+	sink.mem = mem;
+
+	if (*mem) {
+		/* Append to the existing string */
+		sink.length	= strlen(*mem);
+		sink.size	= sink.length + 1;
+	}
+
+	if (size && sink.size < sink.length + size + 1) {
+		if (!(buffer = MemRealloc(*mem, sink.length + size + 1))) {
+			return(NULL);
+		}
+		buffer[sink.length]	= '\0';
+		sink.size			= sink.length + size + 1;
+		*mem				= buffer;
+	}
+
+	return(WJWOpenSinkDocument(pretty, &sink));
+}
+
+EXPORT WJWriter WJWOpenBufferDocument(XplBool pretty, char *buffer, size_t size, size_t *needed)
+{
+	WJWMemSink	sink;
+
+	if (!buffer && size) {
+		errno = EINVAL;
+		return(NULL);
+	}
+
+	memset(&sink, 0, sizeof(sink));
+	sink.buffer	= buffer;
+	sink.size	= size;
+	sink.needed	= needed;
+
+	if (size) {
+		buffer[0] = '\0';
+	}
+	if (needed) {
+		*needed = 0;
+	}
+
+	return(WJWOpenSinkDocument(pretty, &sink));
+}
+
+/*
+	Vectorised scanning
+
+	Most strings need no escaping at all, so WJWriteString() looks for the next
+	character that needs attention (a quote, a backslash, a control character
+	or any non-ASCII byte) 16 bytes at a time with SSE2, or 32 bytes at a time
+	with AVX2 when cpuid reports that the processor supports it, and writes
+	everything before it in a single piece.
+
+	Define WJW_NO_SIMD to build with only the byte at a time version.
+*/
+#if !defined(WJW_NO_SIMD) && \
+	(defined(__x86_64__) || defined(_M_X64) || (defined(__i386__) && defined(__SSE2__)))
+# define WJW_SIMD_SSE2
+# include <emmintrin.h>
+
+# if defined(__GNUC__) || defined(__clang__)
+#  define WJW_SIMD_AVX2
+#  define WJW_TARGET_AVX2		__attribute__((target("avx2")))
+#  include <immintrin.h>
+# elif defined(_MSC_VER)
+#  define WJW_SIMD_AVX2
+#  define WJW_TARGET_AVX2
+#  include <immintrin.h>
+#  include <intrin.h>
+# endif
+#endif
+
+typedef const char * (* WJWScanFunc)(const char *p, const char *end);
+
+/* The characters that can't be copied into a string as is */
+#define WJWIsStringSpecial(c)	((c) == '"' || (c) == '\\' || \
+									(unsigned char) (c) < 0x20 || (unsigned char) (c) >= 0x80)
+
+static const char * WJWScanStringScalar(const char *p, const char *end)
+{
+	for (; p < end && !WJWIsStringSpecial(*p); p++);
+	return(p);
+}
+
+#ifdef WJW_SIMD_SSE2
+static __inline unsigned int WJWFirstBit(uint32 mask)
+{
+#if defined(_MSC_VER)
+	unsigned long	i;
+
+	_BitScanForward(&i, mask);
+	return((unsigned int) i);
+#else
+	return((unsigned int) __builtin_ctz(mask));
+#endif
+}
+
+static const char * WJWScanStringSSE2(const char *p, const char *end)
+{
+	const __m128i	quote	= _mm_set1_epi8('"');
+	const __m128i	slash	= _mm_set1_epi8('\\');
+	const __m128i	space	= _mm_set1_epi8(' ');
+	__m128i			c, s;
+	uint32			mask;
+
+	while (end - p >= 16) {
+		c = _mm_loadu_si128((const __m128i *) p);
+
+		/* As signed bytes both control characters and non-ASCII are < ' ' */
+		s = _mm_or_si128(_mm_cmpeq_epi8(c, quote), _mm_cmpeq_epi8(c, slash));
+		s = _mm_or_si128(s, _mm_cmplt_epi8(c, space));
+
+		if ((mask = (uint32) _mm_movemask_epi8(s))) {
+			return(p + WJWFirstBit(mask));
+		}
+		p += 16;
+	}
+
+	return(WJWScanStringScalar(p, end));
+}
+#endif /* WJW_SIMD_SSE2 */
+
+#ifdef WJW_SIMD_AVX2
+WJW_TARGET_AVX2 static const char * WJWScanStringAVX2(const char *p, const char *end)
+{
+	const __m256i	quote	= _mm256_set1_epi8('"');
+	const __m256i	slash	= _mm256_set1_epi8('\\');
+	const __m256i	space	= _mm256_set1_epi8(' ');
+	__m256i			c, s;
+	uint32			mask;
+
+	while (end - p >= 32) {
+		c = _mm256_loadu_si256((const __m256i *) p);
+
+		s = _mm256_or_si256(_mm256_cmpeq_epi8(c, quote), _mm256_cmpeq_epi8(c, slash));
+		s = _mm256_or_si256(s, _mm256_cmpgt_epi8(space, c));
+
+		if ((mask = (uint32) _mm256_movemask_epi8(s))) {
+			return(p + WJWFirstBit(mask));
+		}
+		p += 32;
+	}
+
+	return(WJWScanStringSSE2(p, end));
+}
+
+static XplBool WJWHasAVX2(void)
+{
+#if defined(_MSC_VER)
+	int				info[4];
+
+	__cpuid(info, 0);
+	if (info[0] < 7) {
+		return(FALSE);
+	}
+
+	/* The OS must also have enabled saving the AVX registers */
+	__cpuid(info, 1);
+	if (!(info[2] & (1 << 27)) || !(info[2] & (1 << 28)) || (_xgetbv(0) & 6) != 6) {
+		return(FALSE);
+	}
+
+	__cpuidex(info, 7, 0);
+	return((info[1] & (1 << 5)) ? TRUE : FALSE);
+#else
+	__builtin_cpu_init();
+	return(__builtin_cpu_supports("avx2") ? TRUE : FALSE);
+#endif
+}
+#endif /* WJW_SIMD_AVX2 */
+
+static const char * WJWScanStringFirst(const char *p, const char *end);
+
+static WJWScanFunc WJWScanStringFunc	= WJWScanStringFirst;
+
+/*
+	Pick the best version of the scan the first time that it is used. If more
+	than one thread gets here at once they will all store the same value.
+*/
+static const char * WJWScanStringFirst(const char *p, const char *end)
+{
+	WJWScanFunc		string	= WJWScanStringScalar;
+
+#ifdef WJW_SIMD_SSE2
+	string	= WJWScanStringSSE2;
+#endif
+#ifdef WJW_SIMD_AVX2
+	if (WJWHasAVX2()) {
+		string	= WJWScanStringAVX2;
+	}
+#endif
+
+	WJWScanStringFunc = string;
+	return(string(p, end));
 }
 
 /*
@@ -433,12 +1118,24 @@ static ssize_t WJWUTF8CharSize(char *str, size_t length)
 	return(r);
 }
 
+/* The short escapes for control characters, or 0 to use the \u00xx form */
+static const char WJWControlEscapes[0x20] = {
+	0,		0,		0,		0,		0,		0,		0,		0,
+	'b',	't',	'n',	0,		'f',	'r',	0,		0,
+	0,		0,		0,		0,		0,		0,		0,		0,
+	0,		0,		0,		0,		0,		0,		0,		0
+};
+
+static const char WJWHexDigits[] = "0123456789abcdef";
+
 static XplBool WJWriteString(char *value, size_t length, XplBool done, WJIWriter *doc)
 {
-	char		*v;
-	char		*e;
-	ssize_t		l;
-	char		esc[3];
+	char			*v;
+	char			*e;
+	char			*end	= value + length;
+	ssize_t			l;
+	unsigned char	c;
+	char			esc[6];
 
 	if (!doc || !doc->public.write.cb) {
 		return(FALSE);
@@ -448,72 +1145,70 @@ static XplBool WJWriteString(char *value, size_t length, XplBool done, WJIWriter
 		WJWrite(doc, "\"", 1);
 	}
 
-	*(esc + 0) = '\\';
-	*(esc + 1) = '\0';
-	*(esc + 2) = '\0';
-
-	for (v = e = value; e < value + length; e++) {
-		switch (*e) {
-			case '\\':	*(esc + 1) = '\\';	break;
-			case '"':	*(esc + 1) = '"';	break;
-			case '\n':	*(esc + 1) = 'n';	break;
-			case '\b':	*(esc + 1) = 'b';	break;
-			case '\t':	*(esc + 1) = 't';	break;
-			case '\f':	*(esc + 1) = 'f';	break;
-			case '\r':	*(esc + 1) = 'r';	break;
-
-			default:
-				l = WJWUTF8CharSize(e, length - (e - value));
-				if (l > 1 || (l == 1 && *e >= '\x20')) {
-					/*
-						*e is the primary octect of a multi-octet UTF8
-						character.  The remaining characters have been verified
-						as valid UTF8 and can be skipped.
-					*/
-					e += (l - 1);
-				} else if (l == 1) {
-					/*
-						*e is valid UTF8 but is not a printable character, and
-						will be escaped before being sent, using the
-						JSON-standard "\u00xx" form
-					*/
-					char	unicodeHex[sizeof("\\u0000")];
-
-					WJWrite(doc, v, e - v);
-
-					sprintf(unicodeHex, "\\u00%02x", (unsigned char) *e);
-					WJWrite(doc, unicodeHex, sizeof(unicodeHex)-1);
-
-					v = e + 1;
-				} else if (l < 0) {
-					/*
-						*e is not valid UTF8 data, and must be escaped before
-						being sent. But JSON-standard does not give us a
-						mechanism so we chose "\xhh" format because of its
-						almost universal comprehension.
-					*/
-					char	nonUnicodeHex[sizeof("\\x00")];
-
-					WJWrite(doc, v, e - v);
-
-					if (doc->public.escapeInvalidChars) {
-						sprintf(nonUnicodeHex, "\\x%02x", (unsigned char) *e);
-						WJWrite(doc, nonUnicodeHex, sizeof(nonUnicodeHex)-1);
-					}
-
-					v = e + 1;
-				}
+	for (v = e = value; e < end; ) {
+		/* Skip over any run of characters that can be written as is */
+		if ((e = (char *) WJWScanStringFunc(e, end)) == end) {
+			break;
+		}
+
+		c = (unsigned char) *e;
+		if (c >= 0x80) {
+			if ((l = WJWUTF8CharSize(e, end - e)) > 0) {
+				/*
+					*e is the primary octect of a multi-octet UTF8 character.
+					The remaining characters have been verified as valid UTF8
+					and can be skipped.
+				*/
+				e += l;
 				continue;
+			}
+
+			/*
+				*e is not valid UTF8 data, and must be escaped before being
+				sent. But JSON-standard does not give us a mechanism so we
+				chose "\xhh" format because of its almost universal
+				comprehension.
+			*/
+			WJWrite(doc, v, e - v);
+
+			if (doc->public.escapeInvalidChars) {
+				esc[0] = '\\';
+				esc[1] = 'x';
+				esc[2] = WJWHexDigits[c >> 4];
+				esc[3] = WJWHexDigits[c & 0xf];
+				WJWrite(doc, esc, 4);
+			}
+
+			v = ++e;
+			continue;
 		}
 
 		WJWrite(doc, v, e - v);
-		v = e + 1;
 
-		WJWrite(doc, esc, 2);
-		continue;
+		esc[0] = '\\';
+		if (c == '"' || c == '\\') {
+			esc[1] = (char) c;
+			WJWrite(doc, esc, 2);
+		} else if (WJWControlEscapes[c]) {
+			esc[1] = WJWControlEscapes[c];
+			WJWrite(doc, esc, 2);
+		} else {
+			/*
+				*e is valid UTF8 but is not a printable character, and will be
+				escaped using the JSON-standard "\u00xx" form
+			*/
+			esc[1] = 'u';
+			esc[2] = '0';
+			esc[3] = '0';
+			esc[4] = WJWHexDigits[c >> 4];
+			esc[5] = WJWHexDigits[c & 0xf];
+			WJWrite(doc, esc, 6);
+		}
+
+		v = ++e;
 	}
 
-	WJWrite(doc, v, length - (v - value));
+	WJWrite(doc, v, end - v);
 
 	if (done) {
 		WJWrite(doc, "\"", 1);
@@ -726,22 +1421,107 @@ static XplBool WJWNumber(char *name, char *value, size_t size, WJWriter indoc)
 	return(FALSE);
 }
 
+/*
+	Integers are formatted by hand rather than with printf, since they make up
+	the bulk of many documents. Decimal digits are produced two at a time using
+	a table of every pair of digits.
+*/
+static const char WJWDigitPairs[201] =
+	"0001020304050607080910111213141516171819"
+	"2021222324252627282930313233343536373839"
+	"4041424344454647484950515253545556575859"
+	"6061626364656667686970717273747576777879"
+	"8081828384858687888990919293949596979899";
+
+static size_t WJWDecimal(uint64 value, XplBool negative, char *out)
+{
+	char		digits[20];
+	char		*p		= digits + sizeof(digits);
+	size_t		len;
+	unsigned	i;
+
+	while (value >= 100) {
+		i = (unsigned) (value % 100) * 2;
+		value /= 100;
+
+		*--p = WJWDigitPairs[i + 1];
+		*--p = WJWDigitPairs[i];
+	}
+
+	if (value >= 10) {
+		i = (unsigned) value * 2;
+
+		*--p = WJWDigitPairs[i + 1];
+		*--p = WJWDigitPairs[i];
+	} else {
+		*--p = (char) ('0' + value);
+	}
+
+	len = digits + sizeof(digits) - p;
+	if (negative) {
+		*out++ = '-';
+	}
+	memcpy(out, p, len);
+
+	return(len + (negative ? 1 : 0));
+}
+
+/* 0x followed by at least width digits, as "0x%08x" or "0x%016llx" would */
+static size_t WJWHex(uint64 value, int width, char *out)
+{
+	int			len		= width;
+	int			i;
+
+	while (len < 16 && (value >> (len * 4))) {
+		len++;
+	}
+
+	*out++ = '0';
+	*out++ = 'x';
+	for (i = len - 1; i >= 0; i--) {
+		out[i] = "0123456789abcdef"[value & 0xf];
+		value >>= 4;
+	}
+
+	return(len + 2);
+}
+
+/* A leading 0 followed by the octal digits, as "0%o" would */
+static size_t WJWOctal(uint64 value, char *out)
+{
+	char		digits[22];
+	char		*p		= digits + sizeof(digits);
+	size_t		len;
+
+	do {
+		*--p = (char) ('0' + (value & 7));
+		value >>= 3;
+	} while (value);
+
+	len = digits + sizeof(digits) - p;
+	*out++ = '0';
+	memcpy(out, p, len);
+
+	return(len + 1);
+}
+
 EXPORT XplBool WJWInt32(char *name, int32 value, WJWriter doc)
 {
-	char		v[256];
+	char		v[32];
 	size_t		s;
 
 	switch (doc->base) {
 		default:
 		case 10:
-			s = strprintf(v, sizeof(v), NULL, "%ld",		(long) value);
+			s = WJWDecimal(value < 0 ? -((int64) value) : value, value < 0, v);
 			break;
+
 		case 16:
-			s = strprintf(v, sizeof(v), NULL, "0x%08lx",	(long) value);
+			s = WJWHex((uint32) value, 8, v);
 			break;
 
 		case 8:
-			s = strprintf(v, sizeof(v), NULL, "0%lo",		(long) value);
+			s = WJWOctal((uint32) value, v);
 			break;
 	}
 
@@ -750,21 +1530,21 @@ EXPORT XplBool WJWInt32(char *name, int32 value, WJWriter doc)
 
 EXPORT XplBool WJWUInt32(char *name, uint32 value, WJWriter doc)
 {
-	char		v[256];
+	char		v[32];
 	size_t		s;
 
 	switch (doc->base) {
 		default:
 		case 10:
-			s = strprintf(v, sizeof(v), NULL, "%lu",		(unsigned long) value);
+			s = WJWDecimal(value, FALSE, v);
 			break;
 
 		case 16:
-			s = strprintf(v, sizeof(v), NULL, "0x%08lx",	(unsigned long) value);
+			s = WJWHex(value, 8, v);
 			break;
 
 		case 8:
-			s = strprintf(v, sizeof(v), NULL, "0%lo",		(unsigned long) value);
+			s = WJWOctal(value, v);
 			break;
 	}
 
@@ -773,21 +1553,21 @@ EXPORT XplBool WJWUInt32(char *name, uint32 value, WJWriter doc)
 
 EXPORT XplBool WJWInt64(char *name, int64 value, WJWriter doc)
 {
-	char		v[256];
+	char		v[32];
 	size_t		s;
 
 	switch (doc->base) {
 		default:
 		case 10:
-			s = strprintf(v, sizeof(v), NULL, "%lld",		(long long) value);
+			s = WJWDecimal(value < 0 ? -((uint64) value) : (uint64) value, value < 0, v);
 			break;
 
 		case 16:
-			s = strprintf(v, sizeof(v), NULL, "0x%016llx",	(long long) value);
+			s = WJWHex((uint64) value, 16, v);
 			break;
 
 		case 8:
-			s = strprintf(v, sizeof(v), NULL, "0%llo",		(long long) value);
+			s = WJWOctal((uint64) value, v);
 			break;
 	}
 
@@ -796,21 +1576,21 @@ EXPORT XplBool WJWInt64(char *name, int64 value, WJWriter doc)
 
 EXPORT XplBool WJWUInt64(char *name, uint64 value, WJWriter doc)
 {
-	char		v[256];
+	char		v[32];
 	size_t		s;
 
 	switch (doc->base) {
 		default:
 		case 10:
-			s = strprintf(v, sizeof(v), NULL, "%llu",		(unsigned long long) value);
+			s = WJWDecimal(value, FALSE, v);
 			break;
 
 		case 16:
-			s = strprintf(v, sizeof(v), NULL, "0x%016llx",	(unsigned long long) value);
+			s = WJWHex(value, 16, v);
 			break;
 
 		case 8:
-			s = strprintf(v, sizeof(v), NULL, "0%llo",		(unsigned long long) value);
+			s = WJWOctal(value, v);
 			break;
 	}
 
@@ -822,7 +1602,11 @@ EXPORT XplBool WJWDouble(char *name, double value, WJWriter doc)
 	char		v[256];
 	size_t		s;
 
-	s = strprintf(v, sizeof(v), NULL, "%e", value);
+	if (doc->doubleFormat || !(s = WJWFormatDouble(value, v))) {
+		/* NaN and infinity still go through printf, as they always have */
+		s = strprintf(v, sizeof(v), NULL, doc->doubleFormat ? doc->doubleFormat : "%e", value);
+	}
+
 	return(WJWNumber(name, v, s, doc));
 }
 